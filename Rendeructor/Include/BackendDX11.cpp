@@ -6,6 +6,10 @@
 #include <string>
 #include <vector>
 
+// Every pass is compiled for shader model 5.0 (vs_5_0, ps_5_0, cs_5_0), which 10.x devices cannot run: asking for
+// 11_0 only makes device creation fail up front instead of every pass failing later
+static const D3D_FEATURE_LEVEL kRequiredFeatureLevel = D3D_FEATURE_LEVEL_11_0;
+
 struct SimpleVertex {
     float x, y, z;
     float u, v;
@@ -22,14 +26,16 @@ BackendDX11::~BackendDX11() {
 bool BackendDX11::Initialize(const BackendConfig& config) {
     LogDebug("[BackendDX11] Initializing...");
 
-    if (!config.WindowHandle) {
+    if (!config.WindowHandle && !config.Headless) {
         LogDebug("[BackendDX11] Error: WindowHandle is NULL");
         return false;
     }
     m_hwnd = (HWND)config.WindowHandle;
+    m_headless = config.Headless;
 
     m_screenWidth = config.Width;
     m_screenHeight = config.Height;
+    m_depthCacheBudget = config.AutoDepthBudgetBytes;
 
     if (!InitD3D(config)) {
         LogDebug("[BackendDX11] Error: InitD3D failed.");
@@ -43,7 +49,7 @@ bool BackendDX11::Initialize(const BackendConfig& config) {
     return true;
 }
 
-bool BackendDX11::InitD3D(const BackendConfig& config) {
+bool BackendDX11::CreateDeviceAndSwapChain(const BackendConfig& config) {
     LogDebug("[BackendDX11] Setting up SwapChain...");
 
     DXGI_SWAP_CHAIN_DESC scd = {};
@@ -66,11 +72,7 @@ bool BackendDX11::InitD3D(const BackendConfig& config) {
     UINT flags = 0;
     //flags |= D3D11_CREATE_DEVICE_DEBUG;
 
-    D3D_FEATURE_LEVEL featureLevels[] = {
-        D3D_FEATURE_LEVEL_11_0,
-        D3D_FEATURE_LEVEL_10_1,
-        D3D_FEATURE_LEVEL_10_0,
-    };
+    D3D_FEATURE_LEVEL featureLevels[] = { kRequiredFeatureLevel };
     D3D_FEATURE_LEVEL featureLevel;
 
     LogDebug("[BackendDX11] Calling D3D11CreateDeviceAndSwapChain...");
@@ -82,7 +84,7 @@ bool BackendDX11::InitD3D(const BackendConfig& config) {
     );
 
     if (FAILED(hr)) {
-        LogDebug("[BackendDX11] HARDWARE Creation FAILED! HRESULT: 0x%08X", (unsigned int)hr);
+        LogDebug("[BackendDX11] HARDWARE Creation FAILED (feature level 11_0 required)! HRESULT: 0x%08X", (unsigned int)hr);
         return false;
     }
     else {
@@ -103,6 +105,49 @@ bool BackendDX11::InitD3D(const BackendConfig& config) {
         return false;
     }
 
+    m_backBuffer = {};
+    m_backBuffer.Texture = backBuffer;
+    m_backBuffer.RTV = m_backBufferRTV;
+    TrackMemory(backBuffer.Get(), MemoryCategory::Framebuffer, (size_t)config.Width * config.Height * 4);
+    m_backBuffer.Width = config.Width;
+    m_backBuffer.Height = config.Height;
+    m_backBuffer.Depth = 1;
+    m_backBuffer.Type = TextureType::Tex2D;
+    return true;
+}
+
+bool BackendDX11::CreateHeadlessDevice(const BackendConfig& config) {
+    LogDebug("[BackendDX11] Headless mode: creating device without SwapChain...");
+
+    D3D_FEATURE_LEVEL featureLevels[] = { kRequiredFeatureLevel };
+    D3D_FEATURE_LEVEL featureLevel;
+
+    HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0, featureLevels, ARRAYSIZE(featureLevels),
+        D3D11_SDK_VERSION, m_device.GetAddressOf(), &featureLevel, m_context.GetAddressOf());
+    if (FAILED(hr)) {
+        // На серверах без GPU остается программный WARP
+        LogDebug("[BackendDX11] HARDWARE Creation FAILED (0x%08X), falling back to WARP", (unsigned int)hr);
+        hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, featureLevels, ARRAYSIZE(featureLevels),
+            D3D11_SDK_VERSION, m_device.GetAddressOf(), &featureLevel, m_context.GetAddressOf());
+    }
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Device Creation FAILED (feature level 11_0 required)! HRESULT: 0x%08X", (unsigned int)hr);
+        return false;
+    }
+    LogDebug("[BackendDX11] Headless Device Created successfully. Feature Level: 0x%X", featureLevel);
+
+    return CreateHeadlessBackBuffer(config.Width, config.Height);
+}
+
+bool BackendDX11::InitD3D(const BackendConfig& config) {
+    if (m_headless) {
+        if (!CreateHeadlessDevice(config)) return false;
+    }
+    else {
+        if (!CreateDeviceAndSwapChain(config)) return false;
+    }
+    HRESULT hr = S_OK;
+
     // --- Создаем Rasterizer State (Отключаем Culling для теста) ---
     D3D11_RASTERIZER_DESC rd = {};
     rd.FillMode = D3D11_FILL_SOLID;
@@ -316,6 +361,8 @@ void BackendDX11::SetPipelineState(const PipelineState& newState) {
 void BackendDX11::ResetPipelineStateCache() {
     m_firstStateSet = true;
     m_activeShader = nullptr;
+    // Привязки IA могли смениться в обход кэша (через GetContext): следующая отрисовка ставит буферы и топологию заново
+    RememberGeometry(nullptr, 0, nullptr);
     m_context->VSSetShader(nullptr, nullptr, 0);
     m_context->PSSetShader(nullptr, nullptr, 0);
 }
@@ -364,6 +411,7 @@ ID3D11DepthStencilState* BackendDX11::GetDepthState(CompareFunc func, bool write
 }
 
 void BackendDX11::CreateDepthResources(int width, int height) {
+    UntrackMemory(m_depthStencilBuffer.Get());
     m_depthStencilBuffer.Reset();
     m_depthStencilView.Reset();
 
@@ -378,17 +426,26 @@ void BackendDX11::CreateDepthResources(int width, int height) {
     descDepth.BindFlags = D3D11_BIND_DEPTH_STENCIL;
 
     if (FAILED(m_device->CreateTexture2D(&descDepth, nullptr, m_depthStencilBuffer.GetAddressOf()))) return;
+    TrackMemory(m_depthStencilBuffer.Get(), MemoryCategory::Framebuffer, (size_t)width * height * 4);
     if (FAILED(m_device->CreateDepthStencilView(m_depthStencilBuffer.Get(), nullptr, m_depthStencilView.GetAddressOf()))) return;
 }
 
 void BackendDX11::Shutdown() {
     LogDebug("[BackendDX11] Shutdown called.");
-    m_depthCache.clear();
-    for (auto* t : m_textures) delete t;
-    m_textures.clear();
-    for (auto* s : m_samplers) delete s;
-    m_samplers.clear();
+    ClearDepthCache();
+    for (auto* t : m_textures.TakeAll()) delete t;
+    for (auto* s : m_samplers.TakeAll()) delete s;
+    for (auto* r : m_readbackSlots) delete r;
+    m_readbackSlots.clear();
+    for (auto& srv : m_computeSRVs) srv.Reset();
+    for (auto& uav : m_computeUAVs) uav.Reset();
+    m_computeTextures.clear();
+    m_activeCompute = nullptr;
+    m_activeShader = nullptr;
     m_shaderCache.clear();
+    RememberGeometry(nullptr, 0, nullptr);
+    // Остальное (swap chain, буферы клиента) уходит вместе с устройством
+    if (m_memoryTracker) m_memoryTracker->Clear();
 }
 
 void BackendDX11::Resize(int width, int height) {
@@ -396,7 +453,13 @@ void BackendDX11::Resize(int width, int height) {
     m_screenHeight = height;
     if (!m_context) return;
 
-    m_depthCache.clear();
+    if (m_headless && (m_backBuffer.Width != width || m_backBuffer.Height != height)) {
+        bool wasBound = !m_boundRTVs.empty() && m_boundRTVs[0] == m_backBufferRTV.Get();
+        CreateHeadlessBackBuffer(width, height);
+        if (wasBound) SetRenderTargetsInternal(nullptr, 0);
+    }
+
+    ClearDepthCache();
 
     CreateDepthResources(width, height); // Пересоздаем глубину
 
@@ -415,7 +478,47 @@ void BackendDX11::EndFrame() {
     if (m_swapChain) m_swapChain->Present(1, 0);
 }
 
+bool BackendDX11::CreateHeadlessBackBuffer(int width, int height) {
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // Как у swap chain
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+    ComPtr<ID3D11Texture2D> texture;
+    HRESULT hr = m_device->CreateTexture2D(&desc, nullptr, texture.GetAddressOf());
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Failed to create headless back buffer. HRESULT: 0x%08X", (unsigned int)hr);
+        return false;
+    }
+
+    UntrackMemory(m_backBuffer.Texture.Get());
+    TrackMemory(texture.Get(), MemoryCategory::Framebuffer, (size_t)width * height * 4);
+    m_backBuffer = {};
+    m_backBuffer.Texture = texture;
+    m_device->CreateShaderResourceView(texture.Get(), nullptr, m_backBuffer.SRV.GetAddressOf());
+    m_device->CreateRenderTargetView(texture.Get(), nullptr, m_backBuffer.RTV.GetAddressOf());
+    m_backBuffer.Width = width;
+    m_backBuffer.Height = height;
+    m_backBuffer.Depth = 1;
+    m_backBuffer.Type = TextureType::Tex2D;
+    m_backBufferRTV = m_backBuffer.RTV;
+    return m_backBufferRTV.Get() != nullptr;
+}
+
 void* BackendDX11::CreateTextureResource(int width, int height, int format, const void* initialData) {
+    return CreateTexture2DInternal(width, height, format, initialData, false);
+}
+
+void* BackendDX11::CreateStorageTextureResource(int width, int height, int format, const void* initialData) {
+    return CreateTexture2DInternal(width, height, format, initialData, true);
+}
+
+void* BackendDX11::CreateTexture2DInternal(int width, int height, int format, const void* initialData, bool storage) {
     auto* wrapper = new DX11TextureWrapper();
     wrapper->Width = width;
     wrapper->Height = height;
@@ -429,6 +532,8 @@ void* BackendDX11::CreateTextureResource(int width, int height, int format, cons
     desc.SampleDesc.Count = 1;
     desc.Usage = D3D11_USAGE_DEFAULT;
     desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    // UAV только по запросу: на части железа он отключает сжатие цели
+    if (storage) desc.BindFlags |= D3D11_BIND_UNORDERED_ACCESS;
 
     // Определяем формат и размер пикселя для загрузки данных
     int bytesPerPixel = 4;
@@ -478,8 +583,11 @@ void* BackendDX11::CreateTextureResource(int width, int height, int format, cons
 
     m_device->CreateShaderResourceView(wrapper->Texture.Get(), nullptr, wrapper->SRV.GetAddressOf());
     m_device->CreateRenderTargetView(wrapper->Texture.Get(), nullptr, wrapper->RTV.GetAddressOf());
+    // Все наши форматы поддерживают типизированную запись через UAV (чтение - только одноканальные 32-битные)
+    if (storage) m_device->CreateUnorderedAccessView(wrapper->Texture.Get(), nullptr, wrapper->UAV.GetAddressOf());
 
-    m_textures.push_back(wrapper);
+    TrackTextureMemory(wrapper, (TextureFormat)format, width, height, 1, TextureType::Tex2D);
+    RegisterTexture(wrapper);
     return wrapper;
 }
 
@@ -529,10 +637,97 @@ void* BackendDX11::CreateTextureCubeResource(int width, int height, int format,
         return nullptr;
     }
 
-    m_textures.push_back(wrapper);
+    TrackTextureMemory(wrapper, TextureFormat::RGBA8, width, height, 6, TextureType::TexCube);
+    RegisterTexture(wrapper);
     return wrapper;
 }
 
+void* BackendDX11::CreateDepthTextureResource(int width, int height, int format, bool shaderReadable) {
+    auto* wrapper = new DX11TextureWrapper();
+    wrapper->Width = width;
+    wrapper->Height = height;
+    wrapper->Depth = 1;
+    wrapper->Type = TextureType::Tex2D;
+
+    // Текстура typeless, чтобы на один ресурс можно было повесить и DSV, и SRV
+    DXGI_FORMAT texFormat = DXGI_FORMAT_R32_TYPELESS;
+    DXGI_FORMAT dsvFormat = DXGI_FORMAT_D32_FLOAT;
+    DXGI_FORMAT srvFormat = DXGI_FORMAT_R32_FLOAT;
+    if ((DepthFormat)format == DepthFormat::D24S8) {
+        texFormat = DXGI_FORMAT_R24G8_TYPELESS;
+        dsvFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+        srvFormat = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+        wrapper->HasStencil = true;
+    }
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = texFormat;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_DEPTH_STENCIL | (shaderReadable ? D3D11_BIND_SHADER_RESOURCE : 0);
+
+    HRESULT hr = m_device->CreateTexture2D(&desc, nullptr, wrapper->Texture.GetAddressOf());
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Failed create depth texture. Hr: 0x%X", hr);
+        delete wrapper;
+        return nullptr;
+    }
+
+    D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+    dsvDesc.Format = dsvFormat;
+    dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+    hr = m_device->CreateDepthStencilView(wrapper->Texture.Get(), &dsvDesc, wrapper->DSV.GetAddressOf());
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Failed create depth stencil view. Hr: 0x%X", hr);
+        delete wrapper;
+        return nullptr;
+    }
+
+    if (shaderReadable) {
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = srvFormat;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MipLevels = 1;
+        m_device->CreateShaderResourceView(wrapper->Texture.Get(), &srvDesc, wrapper->SRV.GetAddressOf());
+    }
+
+    // Оба формата глубины - 4 байта на пиксель
+    TrackMemory(wrapper, MemoryCategory::DepthTexture, (size_t)width * height * 4);
+    RegisterTexture(wrapper);
+    return wrapper;
+}
+
+void BackendDX11::RegisterTexture(DX11TextureWrapper* wrapper) {
+    m_textures.Insert(wrapper);
+}
+
+void BackendDX11::ReleaseTexture(void* handle) {
+    if (!handle) return;
+    auto* tex = (DX11TextureWrapper*)handle;
+
+    // Ресурс еще привязан как цель - отвязываем, иначе m_currentDSV / m_boundRTVs повиснут
+    bool bound = (tex->DSV && tex->DSV.Get() == m_currentDSV);
+    for (auto* rtv : m_boundRTVs) {
+        if (tex->RTV && rtv == tex->RTV.Get()) bound = true;
+    }
+    if (bound) {
+        UnbindResources();
+        m_context->OMSetRenderTargets(0, nullptr, nullptr);
+        m_boundRTVs.clear();
+        m_currentDSV = nullptr;
+    }
+
+    m_computeTextures.erase(std::remove(m_computeTextures.begin(), m_computeTextures.end(), tex), m_computeTextures.end());
+
+    m_textures.Erase(tex);
+    UntrackMemory(tex);
+    delete tex;
+}
+
 void BackendDX11::CopyTexture(void* dstHandle, void* srcHandle) {
     if (!dstHandle || !srcHandle) return;
     auto* dst = (DX11TextureWrapper*)dstHandle;
@@ -542,6 +737,107 @@ void BackendDX11::CopyTexture(void* dstHandle, void* srcHandle) {
     m_context->CopyResource(dst->Texture.Get(), src->Texture.Get());
 }
 
+bool BackendDX11::ReadTexture(void* handle, void* data, size_t rowPitch) {
+    if (!data) return false;
+    // Тот же путь, что и у асинхронного чтения, только с ожиданием GPU
+    void* ticket = RequestTextureReadback(handle);
+    if (!ticket) return false;
+    return ResolveTextureReadback(ticket, data, rowPitch, true) == 1;
+}
+
+static size_t GetFormatBytes(DXGI_FORMAT format) {
+    switch (format) {
+    case DXGI_FORMAT_R8_UNORM: return 1;
+    case DXGI_FORMAT_R16_FLOAT: return 2;
+    case DXGI_FORMAT_R16G16B16A16_FLOAT: return 8;
+    case DXGI_FORMAT_R32G32B32A32_FLOAT: return 16;
+    default: return 4;
+    }
+}
+
+void* BackendDX11::RequestTextureReadback(void* handle) {
+    auto* tex = (DX11TextureWrapper*)handle;
+    if (!tex || !tex->Texture || tex->Type != TextureType::Tex2D) return nullptr;
+
+    D3D11_TEXTURE2D_DESC desc;
+    tex->Texture->GetDesc(&desc);
+
+    // 1. Свободный слот того же размера и формата
+    DX11ReadbackSlot* slot = nullptr;
+    for (auto* s : m_readbackSlots) {
+        if (!s->InFlight && s->Width == desc.Width && s->Height == desc.Height && s->Format == desc.Format) {
+            slot = s;
+            break;
+        }
+    }
+
+    // 2. Нет подходящего - новый слот; при заполненном кольце пересоздаем любой свободный
+    if (!slot) {
+        if ((int)m_readbackSlots.size() < kMaxReadbackSlots) {
+            slot = new DX11ReadbackSlot();
+            m_readbackSlots.push_back(slot);
+        }
+        else {
+            for (auto* s : m_readbackSlots) {
+                if (!s->InFlight) {
+                    slot = s;
+                    break;
+                }
+            }
+            if (!slot) return nullptr; // Все слоты ждут GPU - ждать здесь значит останавливать конвейер
+        }
+
+        D3D11_TEXTURE2D_DESC stagingDesc = desc;
+        stagingDesc.MipLevels = 1;
+        stagingDesc.ArraySize = 1;
+        stagingDesc.Usage = D3D11_USAGE_STAGING;
+        stagingDesc.BindFlags = 0;
+        stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        stagingDesc.MiscFlags = 0;
+
+        UntrackMemory(slot->Staging.Get());
+        slot->Staging.Reset();
+        HRESULT hr = m_device->CreateTexture2D(&stagingDesc, nullptr, slot->Staging.GetAddressOf());
+        if (FAILED(hr)) {
+            LogDebug("[BackendDX11] Failed to create readback texture. Hr: 0x%X", hr);
+            slot->Width = slot->Height = 0;
+            return nullptr;
+        }
+        TrackMemory(slot->Staging.Get(), MemoryCategory::Readback, (size_t)desc.Width * desc.Height * GetFormatBytes(desc.Format));
+        slot->Width = desc.Width;
+        slot->Height = desc.Height;
+        slot->Format = desc.Format;
+    }
+
+    m_context->CopySubresourceRegion(slot->Staging.Get(), 0, 0, 0, 0, tex->Texture.Get(), 0, nullptr);
+    slot->InFlight = true;
+    return slot;
+}
+
+int BackendDX11::ResolveTextureReadback(void* ticket, void* data, size_t rowPitch, bool wait) {
+    auto* slot = (DX11ReadbackSlot*)ticket;
+    if (!slot || !slot->InFlight) return -1;
+
+    // Без ожидания Map сразу возвращает WAS_STILL_DRAWING, пока копия не выполнена
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hr = m_context->Map(slot->Staging.Get(), 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING) return 0;
+
+    slot->InFlight = false;
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Failed to map readback texture. Hr: 0x%X", hr);
+        return -1;
+    }
+    if (data) {
+        size_t copySize = std::min(rowPitch, (size_t)mapped.RowPitch);
+        for (UINT y = 0; y < slot->Height; ++y) {
+            memcpy((char*)data + y * rowPitch, (const char*)mapped.pData + y * mapped.RowPitch, copySize);
+        }
+    }
+    m_context->Unmap(slot->Staging.Get(), 0);
+    return 1;
+}
+
 void BackendDX11::SetRenderTarget(void* target1, void* target2,
     void* target3, void* target4) {
     // Собираем все ненулевые цели
@@ -565,6 +861,28 @@ void BackendDX11::SetRenderTarget(void* target1, void* target2,
     SetRenderTargetsInternal(rtvs, count);
 }
 
+void BackendDX11::SetRenderTargetWithDepth(void* target1, void* target2, void* target3, void* target4, void* depthHandle, bool autoDepth) {
+    ID3D11RenderTargetView* rtvs[4] = { nullptr, nullptr, nullptr, nullptr };
+    int count = 0;
+
+    for (void* handle : { target1, target2, target3, target4 }) {
+        auto* tex = (DX11TextureWrapper*)handle;
+        if (tex && tex->RTV) {
+            rtvs[count++] = tex->RTV.Get();
+        }
+    }
+
+    auto* depth = (DX11TextureWrapper*)depthHandle;
+    if (depth && !depth->DSV) depth = nullptr;
+
+    SetRenderTargetsInternal(rtvs, count, depth, autoDepth);
+}
+
+void BackendDX11::SetAutoDepthBudget(size_t bytes) {
+    m_depthCacheBudget = bytes;
+    TrimDepthCache(0);
+}
+
 // Хелпер для очистки конкретного RTV
 void BackendDX11::ClearRTV(ID3D11RenderTargetView* rtv, float r, float g, float b, float a) {
     if (rtv) {
@@ -587,13 +905,17 @@ ID3D11DepthStencilView* BackendDX11::GetDepthStencilForSize(int width, int heigh
     uint64_t key = PackSize(width, height);
     auto it = m_depthCache.find(key);
     if (it != m_depthCache.end()) {
+        it->second.LastUse = ++m_depthUseCounter;
         return it->second.DSV.Get();
     }
 
-    // 3. Не нашли - создаем новый
-    LogDebug("[BackendDX11] Creating new auto-depth buffer for resolution %dx%d", width, height);
-
+    // 3. Не нашли - освобождаем место и создаем новый
     DepthBufferCacheItem item;
+    item.Bytes = (size_t)width * height * 4;
+    item.LastUse = ++m_depthUseCounter;
+    TrimDepthCache(item.Bytes);
+
+    LogDebug("[BackendDX11] Creating new auto-depth buffer for resolution %dx%d", width, height);
 
     D3D11_TEXTURE2D_DESC descDepth = {};
     descDepth.Width = width;
@@ -614,18 +936,68 @@ ID3D11DepthStencilView* BackendDX11::GetDepthStencilForSize(int width, int heigh
 
     // Сохраняем в кэш
     m_depthCache[key] = item;
+    m_depthCacheBytes += item.Bytes;
+    TrackMemory(item.Texture.Get(), MemoryCategory::AutoDepth, item.Bytes);
+    if (m_depthCacheBytes > m_depthCacheBudget) {
+        LogDebug("[BackendDX11] Auto-depth cache over budget: %zu of %zu bytes", m_depthCacheBytes, m_depthCacheBudget);
+    }
     return item.DSV.Get();
 }
 
-void BackendDX11::SetRenderTargetsInternal(ID3D11RenderTargetView* rtvs[], int count) {
+void BackendDX11::TrimDepthCache(size_t incomingBytes) {
+    // Бюджет мягкий: привязанный сейчас буфер не трогаем, даже если он один его превышает
+    while (!m_depthCache.empty() && m_depthCacheBytes + incomingBytes > m_depthCacheBudget) {
+        auto oldest = m_depthCache.end();
+        for (auto it = m_depthCache.begin(); it != m_depthCache.end(); ++it) {
+            if (it->second.DSV.Get() == m_currentDSV) continue;
+            if (oldest == m_depthCache.end() || it->second.LastUse < oldest->second.LastUse) oldest = it;
+        }
+        if (oldest == m_depthCache.end()) break;
+
+        LogDebug("[BackendDX11] Evicting auto-depth buffer %dx%d", (int)(oldest->first >> 32), (int)(oldest->first & 0xFFFFFFFF));
+        m_depthCacheBytes -= oldest->second.Bytes;
+        UntrackMemory(oldest->second.Texture.Get());
+        m_depthCache.erase(oldest);
+    }
+}
+
+void BackendDX11::ClearDepthCache() {
+    for (auto& entry : m_depthCache) UntrackMemory(entry.second.Texture.Get());
+    m_depthCache.clear();
+    m_depthCacheBytes = 0;
+}
+
+void BackendDX11::TrackMemory(const void* key, MemoryCategory category, size_t bytes) {
+    if (m_memoryTracker) m_memoryTracker->Track(key, category, bytes);
+}
+
+void BackendDX11::TrackTextureMemory(const void* key, TextureFormat format, int width, int height, int depth, TextureType type) {
+    if (m_memoryTracker) m_memoryTracker->TrackTexture(key, MemoryTracker::GetTextureBytes(format, width, height, depth), format, type);
+}
+
+void BackendDX11::UntrackMemory(const void* key) {
+    if (m_memoryTracker) m_memoryTracker->Untrack(key);
+}
+
+void BackendDX11::SetRenderTargetsInternal(ID3D11RenderTargetView* rtvs[], int count, DX11TextureWrapper* depth, bool autoDepth) {
     UnbindResources();
     m_boundRTVs.clear();
 
     ID3D11DepthStencilView* dsvToBind = nullptr;
+    bool hasStencil = true;
     int targetW = m_screenWidth;
     int targetH = m_screenHeight;
 
-    if (count > 0 && rtvs[0] != nullptr) {
+    if (depth && count == 0) {
+        // Только глубина (теневые карты, depth prepass)
+        dsvToBind = depth->DSV.Get();
+        hasStencil = depth->HasStencil;
+        targetW = depth->Width;
+        targetH = depth->Height;
+
+        m_context->OMSetRenderTargets(0, nullptr, dsvToBind);
+    }
+    else if (count > 0 && rtvs[0] != nullptr) {
         ID3D11Resource* res = nullptr;
         rtvs[0]->GetResource(&res);
         D3D11_TEXTURE2D_DESC desc;
@@ -635,7 +1007,13 @@ void BackendDX11::SetRenderTargetsInternal(ID3D11RenderTargetView* rtvs[], int c
         targetW = desc.Width;
         targetH = desc.Height;
 
-        dsvToBind = GetDepthStencilForSize(targetW, targetH);
+        if (depth) {
+            dsvToBind = depth->DSV.Get();
+            hasStencil = depth->HasStencil;
+        }
+        else if (autoDepth) {
+            dsvToBind = GetDepthStencilForSize(targetW, targetH);
+        }
 
         m_context->OMSetRenderTargets(count, rtvs, dsvToBind);
 
@@ -655,6 +1033,7 @@ void BackendDX11::SetRenderTargetsInternal(ID3D11RenderTargetView* rtvs[], int c
     }
 
     m_currentDSV = dsvToBind;
+    m_currentDSVHasStencil = hasStencil;
 
     D3D11_VIEWPORT vp = {};
     vp.Width = (float)targetW;
@@ -673,7 +1052,7 @@ void BackendDX11::Clear(float r, float g, float b, float a) {
     }
 
     if (m_currentDSV) {
-        m_context->ClearDepthStencilView(m_currentDSV, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+        m_context->ClearDepthStencilView(m_currentDSV, D3D11_CLEAR_DEPTH | (m_currentDSVHasStencil ? D3D11_CLEAR_STENCIL : 0), 1.0f, 0);
     }
 }
 
@@ -688,7 +1067,7 @@ void BackendDX11::ClearTexture(void* textureHandle, float r, float g, float b, f
 
 void BackendDX11::ClearDepth(float depth, int stencil) {
     if (m_currentDSV) {
-        m_context->ClearDepthStencilView(m_currentDSV, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, depth, (UINT8)stencil);
+        m_context->ClearDepthStencilView(m_currentDSV, D3D11_CLEAR_DEPTH | (m_currentDSVHasStencil ? D3D11_CLEAR_STENCIL : 0), depth, (UINT8)stencil);
     }
 }
 
@@ -719,7 +1098,8 @@ void* BackendDX11::CreateTexture3DResource(int width, int height, int depth, int
         delete wrapper; return nullptr;
     }
 
-    m_textures.push_back(wrapper);
+    TrackTextureMemory(wrapper, TextureFormat::RGBA32F, width, height, depth, TextureType::Tex3D);
+    RegisterTexture(wrapper);
     return wrapper;
 }
 
@@ -733,7 +1113,7 @@ void* BackendDX11::CreateSamplerResource(const std::string& filterMode) {
     else desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
 
     m_device->CreateSamplerState(&desc, wrapper->State.GetAddressOf());
-    m_samplers.push_back(wrapper);
+    m_samplers.Insert(wrapper);
     return wrapper;
 }
 
@@ -752,12 +1132,14 @@ void BackendDX11::InitQuadGeometry() {
     D3D11_SUBRESOURCE_DATA initData = {};
     initData.pSysMem = vertices;
     m_device->CreateBuffer(&bd, &initData, m_quadVertexBuffer.GetAddressOf());
+    TrackMemory(m_quadVertexBuffer.Get(), MemoryCategory::VertexBuffer, bd.ByteWidth);
 
     unsigned long indices[] = { 0, 1, 2, 2, 1, 3 };
     bd.ByteWidth = sizeof(unsigned long) * 6;
     bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
     initData.pSysMem = indices;
     m_device->CreateBuffer(&bd, &initData, m_quadIndexBuffer.GetAddressOf());
+    TrackMemory(m_quadIndexBuffer.Get(), MemoryCategory::IndexBuffer, bd.ByteWidth);
 }
 
 bool BackendDX11::CompileShader(const std::string& path, const std::string& entry, const std::string& profile, ID3DBlob** outBlob) {
@@ -810,6 +1192,14 @@ DX11ReflectionData BackendDX11::ReflectShader(ID3DBlob* blob) {
         else if (bindDesc.Type == D3D_SIT_SAMPLER) {
             data.SamplerSlots[name] = bindDesc.BindPoint;
         }
+        else if (bindDesc.Type == D3D_SIT_STRUCTURED || bindDesc.Type == D3D_SIT_BYTEADDRESS) {
+            data.BufferSlots[name] = bindDesc.BindPoint;
+        }
+        else if (bindDesc.Type == D3D_SIT_UAV_RWTYPED || bindDesc.Type == D3D_SIT_UAV_RWSTRUCTURED ||
+                 bindDesc.Type == D3D_SIT_UAV_RWBYTEADDRESS || bindDesc.Type == D3D_SIT_UAV_APPEND_STRUCTURED ||
+                 bindDesc.Type == D3D_SIT_UAV_CONSUME_STRUCTURED || bindDesc.Type == D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER) {
+            data.UAVSlots[name] = bindDesc.BindPoint;
+        }
     }
 
     // 2. Теперь читаем содержимое буферов и создаем наши структуры
@@ -849,13 +1239,47 @@ DX11ReflectionData BackendDX11::ReflectShader(ID3DBlob* blob) {
     return data;
 }
 
-void BackendDX11::PrepareShaderPass(const ShaderPass& pass) {
+std::string BackendDX11::GetPassKey(const ShaderPass& pass) {
+    if (pass.IsCompute()) return "CS:" + pass.ComputeShaderPath + ":" + pass.ComputeShaderEntryPoint;
     std::string key = pass.VertexShaderPath + ":" + pass.VertexShaderEntryPoint + "|" + pass.PixelShaderPath + ":" + pass.PixelShaderEntryPoint;
+    if (pass.HasInstancedVariant()) key += "|I:" + pass.InstancedVertexShaderEntryPoint;
+    return key;
+}
+
+void BackendDX11::CreateConstantBuffers(DX11ReflectionData& reflectionData) {
+    for (auto& cb : reflectionData.Buffers) {
+        D3D11_BUFFER_DESC bd = {};
+        bd.ByteWidth = (cb.Size + 15) / 16 * 16;
+        bd.Usage = D3D11_USAGE_DYNAMIC;
+        bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        m_device->CreateBuffer(&bd, nullptr, cb.HardwareBuffer.GetAddressOf());
+        TrackMemory(cb.HardwareBuffer.Get(), MemoryCategory::ConstantBuffer, bd.ByteWidth);
+        cb.ShadowData.resize(bd.ByteWidth, 0);
+    }
+}
+
+void BackendDX11::PrepareShaderPass(const ShaderPass& pass) {
+    std::string key = GetPassKey(pass);
     if (m_shaderCache.find(key) != m_shaderCache.end()) return;
 
     LogDebug("[BackendDX11] Compiling Shader Pass: %s", key.c_str());
 
     DX11ShaderWrapper sw;
+
+    // --- COMPUTE SHADER ---
+    if (pass.IsCompute()) {
+        ID3DBlob* csBlob = nullptr;
+        if (CompileShader(pass.ComputeShaderPath, pass.ComputeShaderEntryPoint, "cs_5_0", &csBlob)) {
+            m_device->CreateComputeShader(csBlob->GetBufferPointer(), csBlob->GetBufferSize(), nullptr, sw.ComputeShader.GetAddressOf());
+            sw.ReflectionCS = ReflectShader(csBlob);
+            CreateConstantBuffers(sw.ReflectionCS);
+            csBlob->Release();
+        }
+        m_shaderCache[key] = sw;
+        return;
+    }
+
     ID3DBlob* vsBlob = nullptr;
     ID3DBlob* psBlob = nullptr;
 
@@ -865,15 +1289,7 @@ void BackendDX11::PrepareShaderPass(const ShaderPass& pass) {
         sw.ReflectionVS = ReflectShader(vsBlob);
 
         // Создаем буферы для VS
-        for (auto& cb : sw.ReflectionVS.Buffers) {
-            D3D11_BUFFER_DESC bd = {};
-            bd.ByteWidth = (cb.Size + 15) / 16 * 16;
-            bd.Usage = D3D11_USAGE_DYNAMIC;
-            bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-            bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-            m_device->CreateBuffer(&bd, nullptr, cb.HardwareBuffer.GetAddressOf());
-            cb.ShadowData.resize(bd.ByteWidth, 0);
-        }
+        CreateConstantBuffers(sw.ReflectionVS);
 
         std::vector<char> bytecode((char*)vsBlob->GetBufferPointer(), (char*)vsBlob->GetBufferPointer() + vsBlob->GetBufferSize());
         CreateInputLayoutFromShader(bytecode, sw.InputLayout.GetAddressOf());
@@ -881,20 +1297,24 @@ void BackendDX11::PrepareShaderPass(const ShaderPass& pass) {
         vsBlob->Release();
     }
 
+    // --- INSTANCED VERTEX SHADER (автоинстансинг) ---
+    ID3DBlob* vsInstancedBlob = nullptr;
+    if (pass.HasInstancedVariant() && CompileShader(pass.VertexShaderPath, pass.InstancedVertexShaderEntryPoint, "vs_5_0", &vsInstancedBlob)) {
+        m_device->CreateVertexShader(vsInstancedBlob->GetBufferPointer(), vsInstancedBlob->GetBufferSize(), nullptr, sw.InstancedVertexShader.GetAddressOf());
+        sw.ReflectionVSInstanced = ReflectShader(vsInstancedBlob);
+        CreateConstantBuffers(sw.ReflectionVSInstanced);
+
+        std::vector<char> bytecode((char*)vsInstancedBlob->GetBufferPointer(), (char*)vsInstancedBlob->GetBufferPointer() + vsInstancedBlob->GetBufferSize());
+        CreateInputLayoutFromShader(bytecode, sw.InstancedInputLayout.GetAddressOf());
+
+        vsInstancedBlob->Release();
+    }
+
     // --- PIXEL SHADER ---
     if (CompileShader(pass.PixelShaderPath, pass.PixelShaderEntryPoint, "ps_5_0", &psBlob)) {
         m_device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, sw.PixelShader.GetAddressOf());
         sw.ReflectionPS = ReflectShader(psBlob);
-
-        for (auto& cb : sw.ReflectionPS.Buffers) {
-            D3D11_BUFFER_DESC bd = {};
-            bd.ByteWidth = (cb.Size + 15) / 16 * 16;
-            bd.Usage = D3D11_USAGE_DYNAMIC;
-            bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-            bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-            m_device->CreateBuffer(&bd, nullptr, cb.HardwareBuffer.GetAddressOf());
-            cb.ShadowData.resize(bd.ByteWidth, 0);
-        }
+        CreateConstantBuffers(sw.ReflectionPS);
 
         psBlob->Release();
     }
@@ -903,9 +1323,13 @@ void BackendDX11::PrepareShaderPass(const ShaderPass& pass) {
 }
 
 void BackendDX11::SetShaderPass(const ShaderPass& pass) {
+    if (pass.IsCompute()) {
+        SetComputePass(pass);
+        return;
+    }
+
     // 1. Генерируем ключ для поиска в кэше
-    std::string key = pass.VertexShaderPath + ":" + pass.VertexShaderEntryPoint + "|" +
-        pass.PixelShaderPath + ":" + pass.PixelShaderEntryPoint;
+    std::string key = GetPassKey(pass);
 
     // Если шейдер не скомпилирован или не найден — выходим
     if (m_shaderCache.find(key) == m_shaderCache.end()) return;
@@ -1001,6 +1425,187 @@ void BackendDX11::SetShaderPass(const ShaderPass& pass) {
         }
     }
 
+    // 7. Привязка DepthTexture (только созданные с shaderReadable)
+    for (const auto& depthPair : pass.GetDepthTextures()) {
+        const std::string& name = depthPair.first;
+        auto* tex = (DX11TextureWrapper*)depthPair.second->GetHandle();
+
+        if (tex && tex->SRV) {
+            if (m_activeShader->ReflectionPS.TextureSlots.count(name)) {
+                UINT slot = m_activeShader->ReflectionPS.TextureSlots[name];
+                m_context->PSSetShaderResources(slot, 1, tex->SRV.GetAddressOf());
+            }
+            if (m_activeShader->ReflectionVS.TextureSlots.count(name)) {
+                UINT slot = m_activeShader->ReflectionVS.TextureSlots[name];
+                m_context->VSSetShaderResources(slot, 1, tex->SRV.GetAddressOf());
+            }
+        }
+    }
+
+    // 8. Привязка буферов только для чтения (StructuredBuffer / ByteAddressBuffer)
+    auto bindBuffer = [&](const std::string& name, DX11BufferWrapper* buffer) {
+        if (buffer && buffer->SRV) {
+            if (m_activeShader->ReflectionPS.BufferSlots.count(name)) {
+                UINT slot = m_activeShader->ReflectionPS.BufferSlots[name];
+                m_context->PSSetShaderResources(slot, 1, buffer->SRV.GetAddressOf());
+            }
+            if (m_activeShader->ReflectionVS.BufferSlots.count(name)) {
+                UINT slot = m_activeShader->ReflectionVS.BufferSlots[name];
+                m_context->VSSetShaderResources(slot, 1, buffer->SRV.GetAddressOf());
+            }
+        }
+    };
+    for (const auto& bufferPair : pass.GetBuffers()) bindBuffer(bufferPair.first, (DX11BufferWrapper*)bufferPair.second->GetHandle());
+    for (const auto& bufferPair : pass.GetStructuredBuffers()) bindBuffer(bufferPair.first, (DX11BufferWrapper*)bufferPair.second->GetHandle());
+}
+
+void BackendDX11::SetComputePass(const ShaderPass& pass) {
+    auto it = m_shaderCache.find(GetPassKey(pass));
+    if (it == m_shaderCache.end() || !it->second.ComputeShader) return;
+
+    m_activeCompute = &it->second;
+    m_context->CSSetShader(m_activeCompute->ComputeShader.Get(), nullptr, 0);
+
+    // SRV/UAV только запоминаем: привязываются на время Dispatch
+    for (auto& srv : m_computeSRVs) srv.Reset();
+    for (auto& uav : m_computeUAVs) uav.Reset();
+    m_computeTextures.clear();
+
+    DX11ReflectionData& reflection = m_activeCompute->ReflectionCS;
+    auto setSRV = [&](const std::map<std::string, UINT>& slots, const std::string& name, ID3D11ShaderResourceView* srv) {
+        auto slot = slots.find(name);
+        if (!srv || slot == slots.end() || slot->second >= (UINT)kMaxComputeSRVs) return false;
+        m_computeSRVs[slot->second] = srv;
+        return true;
+    };
+    auto setTexture = [&](const std::string& name, void* handle) {
+        auto* tex = (DX11TextureWrapper*)handle;
+        if (tex && setSRV(reflection.TextureSlots, name, tex->SRV.Get())) m_computeTextures.push_back(tex);
+    };
+    auto setUAV = [&](const std::string& name, ID3D11UnorderedAccessView* uav) {
+        auto slot = reflection.UAVSlots.find(name);
+        if (!uav || slot == reflection.UAVSlots.end() || slot->second >= (UINT)kMaxComputeUAVs) return false;
+        m_computeUAVs[slot->second] = uav;
+        return true;
+    };
+
+    for (const auto& texPair : pass.GetTextures()) setTexture(texPair.first, texPair.second->GetHandle());
+    for (const auto& texPair : pass.GetTextures3D()) setTexture(texPair.first, texPair.second->GetHandle());
+    for (const auto& texPair : pass.GetTexturesCube()) setTexture(texPair.first, texPair.second->GetHandle());
+    for (const auto& depthPair : pass.GetDepthTextures()) setTexture(depthPair.first, depthPair.second->GetHandle());
+    for (const auto& bufferPair : pass.GetBuffers()) {
+        auto* buffer = (DX11BufferWrapper*)bufferPair.second->GetHandle();
+        if (buffer) setSRV(reflection.BufferSlots, bufferPair.first, buffer->SRV.Get());
+    }
+    for (const auto& bufferPair : pass.GetStructuredBuffers()) {
+        auto* buffer = (DX11BufferWrapper*)bufferPair.second->GetHandle();
+        if (buffer) setSRV(reflection.BufferSlots, bufferPair.first, buffer->SRV.Get());
+    }
+
+    for (const auto& texPair : pass.GetStorageTextures()) {
+        auto* tex = (DX11TextureWrapper*)texPair.second->GetHandle();
+        if (!tex || !tex->UAV) {
+            LogDebug("[BackendDX11] Storage texture '%s' was not created with CreateStorage", texPair.first.c_str());
+            continue;
+        }
+        if (setUAV(texPair.first, tex->UAV.Get())) m_computeTextures.push_back(tex);
+    }
+    for (const auto& bufferPair : pass.GetStorageBuffers()) {
+        auto* buffer = (DX11BufferWrapper*)bufferPair.second->GetHandle();
+        if (buffer) setUAV(bufferPair.first, buffer->UAV.Get());
+    }
+
+    // Семплеры конфликтов не создают - привязываем сразу
+    for (const auto& sampPair : pass.GetSamplers()) {
+        auto* smp = (DX11SamplerWrapper*)sampPair.second->GetHandle();
+        if (smp && reflection.SamplerSlots.count(sampPair.first)) {
+            m_context->CSSetSamplers(reflection.SamplerSlots[sampPair.first], 1, smp->State.GetAddressOf());
+        }
+    }
+}
+
+void BackendDX11::BindComputeResources() {
+    // Текстура compute прохода не может оставаться целью рендера: рантайм молча обнулил бы ее SRV/UAV
+    bool targetConflict = false;
+    for (auto* tex : m_computeTextures) {
+        if (tex->RTV && std::find(m_boundRTVs.begin(), m_boundRTVs.end(), tex->RTV.Get()) != m_boundRTVs.end()) targetConflict = true;
+        if (tex->DSV && tex->DSV.Get() == m_currentDSV) targetConflict = true;
+    }
+    if (targetConflict) {
+        m_context->OMSetRenderTargets(0, nullptr, nullptr);
+        m_boundRTVs.clear();
+        m_currentDSV = nullptr;
+    }
+
+    // Графические SRV могут ссылаться на ресурсы, в которые будет писать compute.
+    // Снимаем их на время Dispatch и возвращаем после: отрисовка без нового SetShaderPass должна видеть свои текстуры
+    bool writes = false;
+    for (auto& uav : m_computeUAVs) writes = writes || uav.Get() != nullptr;
+    if (writes) {
+        ID3D11ShaderResourceView* ps[kMaxGraphicsSRVs] = {};
+        ID3D11ShaderResourceView* vs[kMaxGraphicsSRVs] = {};
+        m_context->PSGetShaderResources(0, kMaxGraphicsSRVs, ps);
+        m_context->VSGetShaderResources(0, kMaxGraphicsSRVs, vs);
+        // Get* добавляет ссылку - ComPtr забирает ее без повторного AddRef
+        for (int i = 0; i < kMaxGraphicsSRVs; ++i) {
+            m_savedPSSRVs[i].Attach(ps[i]);
+            m_savedVSSRVs[i].Attach(vs[i]);
+        }
+        m_graphicsSRVsSaved = true;
+        UnbindResources();
+    }
+
+    ID3D11ShaderResourceView* srvs[kMaxComputeSRVs] = {};
+    ID3D11UnorderedAccessView* uavs[kMaxComputeUAVs] = {};
+    for (int i = 0; i < kMaxComputeSRVs; ++i) srvs[i] = m_computeSRVs[i].Get();
+    for (int i = 0; i < kMaxComputeUAVs; ++i) uavs[i] = m_computeUAVs[i].Get();
+
+    m_context->CSSetShaderResources(0, kMaxComputeSRVs, srvs);
+    m_context->CSSetUnorderedAccessViews(0, kMaxComputeUAVs, uavs, nullptr);
+}
+
+void BackendDX11::UnbindComputeResources() {
+    ID3D11ShaderResourceView* nullSRVs[kMaxComputeSRVs] = {};
+    ID3D11UnorderedAccessView* nullUAVs[kMaxComputeUAVs] = {};
+    m_context->CSSetShaderResources(0, kMaxComputeSRVs, nullSRVs);
+    m_context->CSSetUnorderedAccessViews(0, kMaxComputeUAVs, nullUAVs, nullptr);
+
+    if (m_graphicsSRVsSaved) {
+        ID3D11ShaderResourceView* ps[kMaxGraphicsSRVs];
+        ID3D11ShaderResourceView* vs[kMaxGraphicsSRVs];
+        for (int i = 0; i < kMaxGraphicsSRVs; ++i) {
+            ps[i] = m_savedPSSRVs[i].Get();
+            vs[i] = m_savedVSSRVs[i].Get();
+        }
+        m_context->PSSetShaderResources(0, kMaxGraphicsSRVs, ps);
+        m_context->VSSetShaderResources(0, kMaxGraphicsSRVs, vs);
+        for (int i = 0; i < kMaxGraphicsSRVs; ++i) {
+            m_savedPSSRVs[i].Reset();
+            m_savedVSSRVs[i].Reset();
+        }
+        m_graphicsSRVsSaved = false;
+    }
+}
+
+void BackendDX11::Dispatch(int groupsX, int groupsY, int groupsZ) {
+    if (!m_activeCompute || !m_activeCompute->ComputeShader) return;
+    if (groupsX <= 0 || groupsY <= 0 || groupsZ <= 0) return;
+
+    BindComputeResources();
+    UploadConstants(m_activeCompute->ReflectionCS, ShaderType::Compute);
+    m_context->Dispatch((UINT)groupsX, (UINT)groupsY, (UINT)groupsZ);
+    UnbindComputeResources();
+}
+
+void BackendDX11::DispatchIndirect(void* argsHandle, unsigned int byteOffset) {
+    auto* args = (DX11BufferWrapper*)argsHandle;
+    if (!m_activeCompute || !m_activeCompute->ComputeShader || !args || !args->Buffer) return;
+    if (byteOffset + 3 * sizeof(UINT) > args->Size) return;
+
+    BindComputeResources();
+    UploadConstants(m_activeCompute->ReflectionCS, ShaderType::Compute);
+    m_context->DispatchIndirect(args->Buffer.Get(), byteOffset);
+    UnbindComputeResources();
 }
 
 void BackendDX11::UpdateConstantRaw(const std::string& name, const void* data, size_t size) {
@@ -1068,6 +1673,9 @@ void BackendDX11::UploadConstants(DX11ReflectionData& reflectionData, ShaderType
         if (SType == ShaderType::Vertex) {
             m_context->VSSetConstantBuffers(cb.Slot, 1, cb.HardwareBuffer.GetAddressOf());
         }
+        else if (SType == ShaderType::Compute) {
+            m_context->CSSetConstantBuffers(cb.Slot, 1, cb.HardwareBuffer.GetAddressOf());
+        }
         else {
             m_context->PSSetConstantBuffers(cb.Slot, 1, cb.HardwareBuffer.GetAddressOf());
         }
@@ -1142,6 +1750,7 @@ void BackendDX11::DrawFullScreenQuad() {
     m_context->IASetVertexBuffers(0, 1, m_quadVertexBuffer.GetAddressOf(), &stride, &offset);
     m_context->IASetIndexBuffer(m_quadIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
     m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    RememberGeometry(m_quadVertexBuffer.Get(), stride, m_quadIndexBuffer.Get());
 
     m_context->DrawIndexed(6, 0, 0);
 
@@ -1163,7 +1772,8 @@ void* BackendDX11::CreateBufferInternal(const void* data, size_t size, UINT bind
     D3D11_SUBRESOURCE_DATA initData = {};
     initData.pSysMem = data;
 
-    HRESULT hr = m_device->CreateBuffer(&bd, &initData, wrapper->Buffer.GetAddressOf());
+    // Без начальных данных буфер создается пустым (заполняется позже через UpdateBuffer)
+    HRESULT hr = m_device->CreateBuffer(&bd, data ? &initData : nullptr, wrapper->Buffer.GetAddressOf());
     if (FAILED(hr)) {
         LogDebug("[BackendDX11] Failed to create buffer. Hr: 0x%X", hr);
         delete wrapper;
@@ -1177,24 +1787,315 @@ void* BackendDX11::CreateVertexBuffer(const void* data, size_t size, int stride)
 
     if (w) {
         w->Stride = (UINT)stride;
+        TrackMemory(w, MemoryCategory::VertexBuffer, size);
     }
 
     return w;
 }
 
 void* BackendDX11::CreateIndexBuffer(const void* data, size_t size) {
-    return CreateBufferInternal(data, size, D3D11_BIND_INDEX_BUFFER);
+    void* w = CreateBufferInternal(data, size, D3D11_BIND_INDEX_BUFFER);
+    if (w) TrackMemory(w, MemoryCategory::IndexBuffer, size);
+    return w;
 }
 
 void* BackendDX11::CreateInstanceBuffer(const void* data, size_t size, int stride) {
     auto* w = (DX11BufferWrapper*)CreateBufferInternal(data, size, D3D11_BIND_VERTEX_BUFFER);
     if (w) {
         w->Stride = (UINT)stride;
+        TrackMemory(w, MemoryCategory::InstanceBuffer, size);
     }
     return w;
 }
 
-void BackendDX11::DrawMesh(void* vbHandle, void* ibHandle, int indexCount) {
+void* BackendDX11::CreateDynamicInstanceBuffer(const void* data, size_t size, int stride) {
+    auto* w = (DX11BufferWrapper*)CreateInstanceBuffer(data, size, stride);
+    if (!w) return nullptr;
+
+    CreateUploadRing(w, size);
+    return w;
+}
+
+void BackendDX11::CreateUploadRing(DX11BufferWrapper* w, size_t size) {
+    // Кольцо на несколько полных обновлений: пока GPU читает старые участки, пишем в следующие без ожидания
+    const UINT ringFrames = 3;
+
+    D3D11_BUFFER_DESC bd = {};
+    bd.Usage = D3D11_USAGE_DYNAMIC;
+    bd.ByteWidth = (UINT)((size + 15) & ~(size_t)15) * ringFrames;
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    HRESULT hr = m_device->CreateBuffer(&bd, nullptr, w->Upload.GetAddressOf());
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Failed to create upload ring. Hr: 0x%X", hr);
+        // Буфер остается рабочим, обновления пойдут через UpdateSubresource
+        return;
+    }
+
+    w->UploadSize = bd.ByteWidth;
+    w->UploadCursor = w->UploadSize; // первая запись начнется с DISCARD
+    TrackMemory(w->Upload.Get(), MemoryCategory::UploadRing, bd.ByteWidth);
+}
+
+void BackendDX11::UpdateBuffer(void* handle, const void* data, size_t size, size_t offset) {
+    auto* w = (DX11BufferWrapper*)handle;
+    if (!w || !w->Buffer || !data || size == 0 || offset >= w->Size) return;
+
+    // Передаем только указанный диапазон - остаток буфера не трогаем
+    const UINT begin = (UINT)offset;
+    const UINT bytes = (UINT)std::min(size, (size_t)w->Size - offset);
+
+    if (w->Upload && bytes <= w->UploadSize) {
+        D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+        if (w->UploadCursor + bytes > w->UploadSize) {
+            // Кольцо закончилось: DISCARD отдает новую память, GPU дочитывает старую
+            mapType = D3D11_MAP_WRITE_DISCARD;
+            w->UploadCursor = 0;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        if (SUCCEEDED(m_context->Map(w->Upload.Get(), 0, mapType, 0, &mapped))) {
+            memcpy((unsigned char*)mapped.pData + w->UploadCursor, data, bytes);
+            m_context->Unmap(w->Upload.Get(), 0);
+
+            D3D11_BOX src = {};
+            src.left = w->UploadCursor;
+            src.right = w->UploadCursor + bytes;
+            src.top = 0; src.bottom = 1;
+            src.front = 0; src.back = 1;
+            m_context->CopySubresourceRegion(w->Buffer.Get(), 0, begin, 0, 0, w->Upload.Get(), 0, &src);
+
+            w->UploadCursor += (bytes + 15) & ~15u;
+            return;
+        }
+    }
+
+    D3D11_BOX box = {};
+    box.left = begin;
+    box.right = begin + bytes;
+    box.top = 0; box.bottom = 1;
+    box.front = 0; box.back = 1;
+
+    m_context->UpdateSubresource(w->Buffer.Get(), 0, &box, data, 0, 0);
+}
+
+void* BackendDX11::CreateStructuredBuffer(const void* data, size_t count, int stride, bool dynamic) {
+    auto* wrapper = new DX11BufferWrapper();
+    wrapper->Size = (UINT)(count * stride);
+    wrapper->Stride = (UINT)stride;
+
+    // Только чтение из шейдера: без UAV буфер остается обычным DEFAULT ресурсом, обновляется диапазонами
+    D3D11_BUFFER_DESC bd = {};
+    bd.Usage = D3D11_USAGE_DEFAULT;
+    bd.ByteWidth = wrapper->Size;
+    bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    bd.StructureByteStride = (UINT)stride;
+
+    D3D11_SUBRESOURCE_DATA initData = {};
+    initData.pSysMem = data;
+
+    HRESULT hr = m_device->CreateBuffer(&bd, data ? &initData : nullptr, wrapper->Buffer.GetAddressOf());
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Failed to create structured buffer. Hr: 0x%X", hr);
+        delete wrapper;
+        return nullptr;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    srvDesc.Buffer.FirstElement = 0;
+    srvDesc.Buffer.NumElements = (UINT)count;
+    m_device->CreateShaderResourceView(wrapper->Buffer.Get(), &srvDesc, wrapper->SRV.GetAddressOf());
+    TrackMemory(wrapper, MemoryCategory::StructuredBuffer, wrapper->Size);
+
+    // Обновляемые каждый кадр данные идут через кольцо, как у динамических инстанс-буферов
+    if (dynamic) CreateUploadRing(wrapper, wrapper->Size);
+
+    return wrapper;
+}
+
+void* BackendDX11::CreateComputeBuffer(const void* data, size_t count, int stride, int type) {
+    const ComputeBufferType bufferType = (ComputeBufferType)type;
+    auto* wrapper = new DX11BufferWrapper();
+    wrapper->Size = (UINT)(count * stride);
+    wrapper->Stride = (UINT)stride;
+
+    D3D11_BUFFER_DESC bd = {};
+    bd.Usage = D3D11_USAGE_DEFAULT;
+    bd.ByteWidth = wrapper->Size;
+    bd.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+    if (bufferType == ComputeBufferType::Structured) {
+        bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        bd.StructureByteStride = (UINT)stride;
+    }
+    else {
+        // Аргументы indirect вызовов пишутся шейдером как RWByteAddressBuffer
+        bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+        if (bufferType == ComputeBufferType::IndirectArgs) bd.MiscFlags |= D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+    }
+
+    D3D11_SUBRESOURCE_DATA initData = {};
+    initData.pSysMem = data;
+
+    HRESULT hr = m_device->CreateBuffer(&bd, data ? &initData : nullptr, wrapper->Buffer.GetAddressOf());
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Failed to create compute buffer. Hr: 0x%X", hr);
+        delete wrapper;
+        return nullptr;
+    }
+
+    const bool raw = bufferType != ComputeBufferType::Structured;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = raw ? DXGI_FORMAT_R32_TYPELESS : DXGI_FORMAT_UNKNOWN;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+    srvDesc.BufferEx.FirstElement = 0;
+    srvDesc.BufferEx.NumElements = (UINT)count;
+    srvDesc.BufferEx.Flags = raw ? D3D11_BUFFEREX_SRV_FLAG_RAW : 0;
+    m_device->CreateShaderResourceView(wrapper->Buffer.Get(), &srvDesc, wrapper->SRV.GetAddressOf());
+
+    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+    uavDesc.Format = raw ? DXGI_FORMAT_R32_TYPELESS : DXGI_FORMAT_UNKNOWN;
+    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    uavDesc.Buffer.FirstElement = 0;
+    uavDesc.Buffer.NumElements = (UINT)count;
+    uavDesc.Buffer.Flags = raw ? D3D11_BUFFER_UAV_FLAG_RAW : 0;
+    m_device->CreateUnorderedAccessView(wrapper->Buffer.Get(), &uavDesc, wrapper->UAV.GetAddressOf());
+
+    TrackMemory(wrapper, MemoryCategory::ComputeBuffer, wrapper->Size);
+    return wrapper;
+}
+
+bool BackendDX11::ReadBuffer(void* handle, void* data, size_t size) {
+    auto* w = (DX11BufferWrapper*)handle;
+    if (!w || !w->Buffer || !data) return false;
+
+    // Отладочное / редкое чтение: staging буфер создается на каждый вызов
+    D3D11_BUFFER_DESC bd = {};
+    bd.Usage = D3D11_USAGE_STAGING;
+    bd.ByteWidth = w->Size;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    ComPtr<ID3D11Buffer> staging;
+    HRESULT hr = m_device->CreateBuffer(&bd, nullptr, staging.GetAddressOf());
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Failed to create staging buffer. Hr: 0x%X", hr);
+        return false;
+    }
+
+    m_context->CopyResource(staging.Get(), w->Buffer.Get());
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    if (FAILED(m_context->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped))) return false;
+    memcpy(data, mapped.pData, std::min(size, (size_t)w->Size));
+    m_context->Unmap(staging.Get(), 0);
+    return true;
+}
+
+void BackendDX11::CopyBufferRegion(void* dstHandle, size_t dstOffset, void* srcHandle, size_t srcOffset, size_t size) {
+    auto* dst = (DX11BufferWrapper*)dstHandle;
+    auto* src = (DX11BufferWrapper*)srcHandle;
+    if (!dst || !src || !dst->Buffer || !src->Buffer || dst == src || size == 0) return;
+    if (dstOffset + size > dst->Size || srcOffset + size > src->Size) return;
+
+    D3D11_BOX box = {};
+    box.left = (UINT)srcOffset;
+    box.right = (UINT)(srcOffset + size);
+    box.top = 0; box.bottom = 1;
+    box.front = 0; box.back = 1;
+    m_context->CopySubresourceRegion(dst->Buffer.Get(), 0, (UINT)dstOffset, 0, 0, src->Buffer.Get(), 0, &box);
+}
+
+void BackendDX11::BindGeometry(ID3D11Buffer* vb, UINT stride, ID3D11Buffer* ib) {
+    if (vb != m_boundVertexBuffer || stride != m_boundVertexStride) {
+        UINT offset = 0;
+        m_context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+    }
+    if (ib != m_boundIndexBuffer) {
+        // Формат R32_UINT означает unsigned int
+        m_context->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
+    }
+    if (!m_boundVertexBuffer) {
+        // Топология у всех отрисовок одна, ставится при первой привязке
+        m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    }
+    RememberGeometry(vb, stride, ib);
+}
+
+void BackendDX11::RememberGeometry(ID3D11Buffer* vb, UINT stride, ID3D11Buffer* ib) {
+    // Указатели не держат ссылок: пока буфер привязан к IA, его держит контекст и адрес не переиспользуется
+    m_boundVertexBuffer = vb;
+    m_boundVertexStride = stride;
+    m_boundIndexBuffer = ib;
+}
+
+void BackendDX11::ReleaseBuffer(void* handle) {
+    auto* w = (DX11BufferWrapper*)handle;
+    if (!w) return;
+    UntrackMemory(w->Upload.Get());
+    UntrackMemory(w);
+    // ComPtr внутри обертки освобождает D3D ресурсы
+    delete w;
+}
+
+void* BackendDX11::CreateGPUTimer() {
+    auto* timer = new DX11TimerWrapper();
+
+    D3D11_QUERY_DESC desc = {};
+    desc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+    HRESULT hr = m_device->CreateQuery(&desc, timer->Disjoint.GetAddressOf());
+    desc.Query = D3D11_QUERY_TIMESTAMP;
+    if (SUCCEEDED(hr)) hr = m_device->CreateQuery(&desc, timer->Start.GetAddressOf());
+    if (SUCCEEDED(hr)) hr = m_device->CreateQuery(&desc, timer->End.GetAddressOf());
+
+    if (FAILED(hr)) {
+        LogDebug("[BackendDX11] Failed to create timestamp queries. Hr: 0x%X", hr);
+        delete timer;
+        return nullptr;
+    }
+    return timer;
+}
+
+void BackendDX11::BeginGPUTimer(void* handle) {
+    auto* timer = (DX11TimerWrapper*)handle;
+    if (!timer) return;
+    m_context->Begin(timer->Disjoint.Get());
+    m_context->End(timer->Start.Get());
+}
+
+void BackendDX11::EndGPUTimer(void* handle) {
+    auto* timer = (DX11TimerWrapper*)handle;
+    if (!timer) return;
+    m_context->End(timer->End.Get());
+    m_context->End(timer->Disjoint.Get());
+}
+
+bool BackendDX11::GetGPUTimerResult(void* handle, double& milliseconds) {
+    auto* timer = (DX11TimerWrapper*)handle;
+    if (!timer) return false;
+
+    // DONOTFLUSH: только проверяем готовность, не заставляя драйвер отправлять команды
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+    if (m_context->GetData(timer->Disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) return false;
+
+    UINT64 start = 0, end = 0;
+    if (m_context->GetData(timer->Start.Get(), &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) return false;
+    if (m_context->GetData(timer->End.Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) return false;
+
+    // Disjoint - частота менялась (энергосбережение и т.п.), результату верить нельзя
+    if (disjoint.Disjoint || disjoint.Frequency == 0) milliseconds = -1.0;
+    else milliseconds = (double)(end - start) * 1000.0 / (double)disjoint.Frequency;
+    return true;
+}
+
+void BackendDX11::ReleaseGPUTimer(void* handle) {
+    delete (DX11TimerWrapper*)handle;
+}
+
+void BackendDX11::DrawMesh(void* vbHandle, void* ibHandle, int indexCount, int startIndex, int baseVertex) {
     // Базовые проверки
     if (!m_activeShader || !vbHandle || !ibHandle) return;
 
@@ -1211,22 +2112,13 @@ void BackendDX11::DrawMesh(void* vbHandle, void* ibHandle, int indexCount) {
     // -----------------------------------------------------------
     // 3. Установка геометрии (Input Assembler)
     // -----------------------------------------------------------
-    UINT stride = vb->Stride; // Размер одной вершины (шаг)
-    UINT offset = 0;
-
-    // Устанавливаем Вершинный Буфер
-    m_context->IASetVertexBuffers(0, 1, vb->Buffer.GetAddressOf(), &stride, &offset);
-
-    // Устанавливаем Индексный Буфер (Формат R32_UINT означает unsigned int)
-    m_context->IASetIndexBuffer(ib->Buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-
-    // Указываем тип примитивов (список треугольников)
-    m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    // Сетки из одной страницы GeometryArena делят буферы - тогда между ними меняются только смещения отрисовки
+    BindGeometry(vb->Buffer.Get(), vb->Stride, ib->Buffer.Get());
 
     // -----------------------------------------------------------
     // 4. Отрисовка
     // -----------------------------------------------------------
-    m_context->DrawIndexed(indexCount, 0, 0);
+    m_context->DrawIndexed(indexCount, startIndex, baseVertex);
 
     // -----------------------------------------------------------
     // 5. Очистка ресурсов
@@ -1236,7 +2128,76 @@ void BackendDX11::DrawMesh(void* vbHandle, void* ibHandle, int indexCount) {
     m_context->PSSetShaderResources(0, 8, nullSRVs);
 }
 
-void BackendDX11::DrawMeshInstanced(void* vbHandle, void* ibHandle, int indexCount, void* instHandle, int instanceCount, int instanceStride) {
+bool BackendDX11::DrawMeshInstancedVariant(void* vbHandle, void* ibHandle, int indexCount, void* instHandle, int instanceCount, int instanceStride,
+                                           int startIndex, int baseVertex, int startInstance) {
+    if (!m_activeShader || !m_activeShader->InstancedVertexShader || !m_activeShader->InstancedInputLayout) return false;
+    if (!vbHandle || !ibHandle || !instHandle) return false;
+
+    // На время вызова подменяем вершинный шейдер и layout, PS и ресурсы прохода остаются прежними
+    m_context->IASetInputLayout(m_activeShader->InstancedInputLayout.Get());
+    m_context->VSSetShader(m_activeShader->InstancedVertexShader.Get(), nullptr, 0);
+
+    auto* vb = (DX11BufferWrapper*)vbHandle;
+    auto* ib = (DX11BufferWrapper*)ibHandle;
+    auto* instBuffer = (DX11BufferWrapper*)instHandle;
+
+    // Константы VS варианта живут в его собственных буферах
+    UploadConstants(m_activeShader->ReflectionVSInstanced, ShaderType::Vertex);
+    UploadConstants(m_activeShader->ReflectionPS, ShaderType::Pixel);
+
+    ID3D11Buffer* vbs[] = { vb->Buffer.Get(), instBuffer->Buffer.Get() };
+    UINT strides[] = { vb->Stride, (UINT)instanceStride };
+    UINT offsets[] = { 0, 0 };
+    m_context->IASetVertexBuffers(0, 2, vbs, strides, offsets);
+    m_context->IASetIndexBuffer(ib->Buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+    m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    RememberGeometry(vbs[0], strides[0], ib->Buffer.Get());
+    m_context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+
+    ID3D11ShaderResourceView* nullSRVs[8] = { nullptr };
+    m_context->PSSetShaderResources(0, 8, nullSRVs);
+
+    m_context->IASetInputLayout(m_activeShader->InputLayout.Get());
+    m_context->VSSetShader(m_activeShader->VertexShader.Get(), nullptr, 0);
+    return true;
+}
+
+void BackendDX11::DrawMeshIndirect(void* vbHandle, void* ibHandle, void* instHandle, int instanceStride,
+                                   void* argsHandle, unsigned int byteOffset, int drawCount, unsigned int argsStride) {
+    auto* args = (DX11BufferWrapper*)argsHandle;
+    if (!m_activeShader || !vbHandle || !ibHandle || !args || !args->Buffer) return;
+
+    auto* vb = (DX11BufferWrapper*)vbHandle;
+    auto* ib = (DX11BufferWrapper*)ibHandle;
+    auto* instBuffer = (DX11BufferWrapper*)instHandle;
+
+    UploadConstants(m_activeShader->ReflectionVS, ShaderType::Vertex);
+    UploadConstants(m_activeShader->ReflectionPS, ShaderType::Pixel);
+
+    // Геометрия и инстансы ставятся один раз на все записи
+    ID3D11Buffer* vbs[] = { vb->Buffer.Get(), instBuffer ? instBuffer->Buffer.Get() : nullptr };
+    UINT strides[] = { vb->Stride, (UINT)instanceStride };
+    UINT offsets[] = { 0, 0 };
+    m_context->IASetVertexBuffers(0, instBuffer ? 2 : 1, vbs, strides, offsets);
+    m_context->IASetIndexBuffer(ib->Buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+    m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    RememberGeometry(vbs[0], strides[0], ib->Buffer.Get());
+
+    // В DX11 нет multi-draw indirect: по вызову на запись, но без смены состояния между ними.
+    // Записи за пределами буфера отбрасываются - драйвер их не проверяет
+    const UINT recordSize = (UINT)sizeof(DrawIndexedIndirectArgs);
+    for (int i = 0; i < drawCount; ++i) {
+        const UINT offset = byteOffset + (UINT)i * argsStride;
+        if (offset + recordSize > args->Size) break;
+        m_context->DrawIndexedInstancedIndirect(args->Buffer.Get(), offset);
+    }
+
+    ID3D11ShaderResourceView* nullSRVs[8] = { nullptr };
+    m_context->PSSetShaderResources(0, 8, nullSRVs);
+}
+
+void BackendDX11::DrawMeshInstanced(void* vbHandle, void* ibHandle, int indexCount, void* instHandle, int instanceCount, int instanceStride,
+                                    int startIndex, int baseVertex, int startInstance) {
     if (!m_activeShader || !vbHandle || !ibHandle || !instHandle) return;
 
     auto* vb = (DX11BufferWrapper*)vbHandle;
@@ -1258,9 +2219,10 @@ void BackendDX11::DrawMeshInstanced(void* vbHandle, void* ibHandle, int indexCou
     m_context->IASetVertexBuffers(0, 2, vbs, strides, offsets);
     m_context->IASetIndexBuffer(ib->Buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
     m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    RememberGeometry(vbs[0], strides[0], ib->Buffer.Get());
 
-    // 3. Рисуем
-    m_context->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
+    // 3. Рисуем (StartInstanceLocation сдвигает и чтение инстанс-данных)
+    m_context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
 
     // 4. Очистка
     ID3D11ShaderResourceView* nullSRVs[8] = { nullptr };
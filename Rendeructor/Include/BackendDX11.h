@@ -1,5 +1,7 @@
 #pragma once
 #include "BackendInterface.h"
+#include "MemoryTracker.h"
+#include "ShardedRegistry.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -8,6 +10,9 @@ struct DX11TextureWrapper {
     ComPtr<ID3D11Texture3D> Texture3D;
     ComPtr<ID3D11ShaderResourceView> SRV;
     ComPtr<ID3D11RenderTargetView> RTV;
+    ComPtr<ID3D11DepthStencilView> DSV; //   DepthTexture
+    ComPtr<ID3D11UnorderedAccessView> UAV; //   storage 
+    bool HasStencil = false;
     int Width;
     int Height;
     int Depth;
@@ -37,6 +42,8 @@ struct DX11ReflectionData {
     std::vector<ReflectedConstantBuffer> Buffers;
     std::map<std::string, UINT> TextureSlots;
     std::map<std::string, UINT> SamplerSlots;
+    std::map<std::string, UINT> BufferSlots; // StructuredBuffer / ByteAddressBuffer (t )
+    std::map<std::string, UINT> UAVSlots;    // RWTexture / RW  (u )
 };
 
 struct DX11ShaderWrapper {
@@ -45,12 +52,43 @@ struct DX11ShaderWrapper {
     ComPtr<ID3D11InputLayout> InputLayout;
     DX11ReflectionData ReflectionVS;
     DX11ReflectionData ReflectionPS;
+    //      (ShaderPass::InstancedVertexShaderEntryPoint)
+    ComPtr<ID3D11VertexShader> InstancedVertexShader;
+    ComPtr<ID3D11InputLayout> InstancedInputLayout;
+    DX11ReflectionData ReflectionVSInstanced;
+    ComPtr<ID3D11ComputeShader> ComputeShader;
+    DX11ReflectionData ReflectionCS;
 };
 
 struct DX11BufferWrapper {
     ComPtr<ID3D11Buffer> Buffer;
     UINT Size; //   
     UINT Stride; //    ( VB)
+
+    //     (DYNAMIC,   NO_OVERWRITE,   - DISCARD)
+    ComPtr<ID3D11Buffer> Upload;
+    UINT UploadSize = 0;
+    UINT UploadCursor = 0;
+
+    //   compute:  (SRV)   (UAV)  
+    ComPtr<ID3D11ShaderResourceView> SRV;
+    ComPtr<ID3D11UnorderedAccessView> UAV;
+};
+
+//     + disjoint  (    )
+struct DX11TimerWrapper {
+    ComPtr<ID3D11Query> Disjoint;
+    ComPtr<ID3D11Query> Start;
+    ComPtr<ID3D11Query> End;
+};
+
+//   readback: STAGING  , ,  GPU  
+struct DX11ReadbackSlot {
+    ComPtr<ID3D11Texture2D> Staging;
+    UINT Width = 0;
+    UINT Height = 0;
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+    bool InFlight = false;
 };
 
 class BackendDX11 : public BackendInterface {
@@ -58,6 +96,7 @@ public:
     BackendDX11();
     ~BackendDX11();
 
+    void SetMemoryTracker(MemoryTracker* tracker) override { m_memoryTracker = tracker; }
     bool Initialize(const BackendConfig& config) override;
     void Shutdown() override;
     void Resize(int width, int height) override;
@@ -66,17 +105,27 @@ public:
 
     void* GetDevice() override { return m_device.Get(); }
     void* GetContext() override { return m_context.Get(); }
+    void* GetBackBufferHandle() override { return m_backBuffer.Texture ? &m_backBuffer : nullptr; }
 
     void SetPipelineState(const PipelineState& state) override;
     void ResetPipelineStateCache() override;
     void SetScissorRect(int x, int y, int width, int height);
 
     void* CreateTextureResource(int width, int height, int format, const void* initialData) override;
+    void* CreateStorageTextureResource(int width, int height, int format, const void* initialData) override;
     void* CreateTexture3DResource(int width, int height, int depth, int format, const void* initialData) override;
     void* CreateTextureCubeResource(int width, int height, int format, const void** initialData) override;
+    void* CreateDepthTextureResource(int width, int height, int format, bool shaderReadable) override;
     void* CreateSamplerResource(const std::string& filterMode) override;
+    void ReleaseTexture(void* handle) override;
     void CopyTexture(void* dstHandle, void* srcHandle) override;
+    bool ReadTexture(void* handle, void* data, size_t rowPitch) override;
+    void* RequestTextureReadback(void* handle) override;
+    int ResolveTextureReadback(void* ticket, void* data, size_t rowPitch, bool wait) override;
     void SetRenderTarget(void* target1, void* target2 = nullptr, void* target3 = nullptr, void* target4 = nullptr) override;
+    void SetRenderTargetWithDepth(void* target1, void* target2, void* target3, void* target4, void* depthHandle, bool autoDepth) override;
+    void SetAutoDepthBudget(size_t bytes) override;
+    size_t GetAutoDepthMemory() override { return m_depthCacheBytes; }
     void Clear(float r, float g, float b, float a) override;
     void ClearTexture(void* textureHandle, float r, float g, float b, float a) override;
     void ClearDepth(float depth, int stencil) override;
@@ -88,18 +137,52 @@ public:
     void* CreateVertexBuffer(const void* data, size_t size, int stride) override;
     void* CreateIndexBuffer(const void* data, size_t size) override;
     void* CreateInstanceBuffer(const void* data, size_t size, int stride) override;
-    void DrawMeshInstanced(void* vbHandle, void* ibHandle, int indexCount, void* instHandle, int instanceCount, int instanceStride) override;
-    void DrawMesh(void* vbHandle, void* ibHandle, int indexCount) override;
+    void* CreateDynamicInstanceBuffer(const void* data, size_t size, int stride) override;
+    void UpdateBuffer(void* handle, const void* data, size_t size, size_t offset = 0) override;
+    void* CreateStructuredBuffer(const void* data, size_t count, int stride, bool dynamic) override;
+    void* CreateComputeBuffer(const void* data, size_t count, int stride, int type) override;
+    bool ReadBuffer(void* handle, void* data, size_t size) override;
+    void CopyBufferRegion(void* dstHandle, size_t dstOffset, void* srcHandle, size_t srcOffset, size_t size) override;
+    void ReleaseBuffer(void* handle) override;
+    void* CreateGPUTimer() override;
+    void BeginGPUTimer(void* handle) override;
+    void EndGPUTimer(void* handle) override;
+    bool GetGPUTimerResult(void* handle, double& milliseconds) override;
+    void ReleaseGPUTimer(void* handle) override;
+    void DrawMeshInstanced(void* vbHandle, void* ibHandle, int indexCount, void* instHandle, int instanceCount, int instanceStride,
+                           int startIndex, int baseVertex, int startInstance) override;
+    void DrawMesh(void* vbHandle, void* ibHandle, int indexCount, int startIndex, int baseVertex) override;
+    bool DrawMeshInstancedVariant(void* vbHandle, void* ibHandle, int indexCount, void* instHandle, int instanceCount, int instanceStride,
+                                  int startIndex, int baseVertex, int startInstance) override;
+    void DrawMeshIndirect(void* vbHandle, void* ibHandle, void* instHandle, int instanceStride,
+                          void* argsHandle, unsigned int byteOffset, int drawCount, unsigned int argsStride) override;
+    void Dispatch(int groupsX, int groupsY, int groupsZ) override;
+    void DispatchIndirect(void* argsHandle, unsigned int byteOffset) override;
 
 private:
     bool InitD3D(const BackendConfig& config);
+    bool CreateDeviceAndSwapChain(const BackendConfig& config);
+    // Headless:   ,   - off-screen 
+    bool CreateHeadlessDevice(const BackendConfig& config);
+    bool CreateHeadlessBackBuffer(int width, int height);
     void InitQuadGeometry();
+    void* CreateTexture2DInternal(int width, int height, int format, const void* initialData, bool storage);
+    static std::string GetPassKey(const ShaderPass& pass);
+    void CreateConstantBuffers(DX11ReflectionData& reflectionData);
+    void SetComputePass(const ShaderPass& pass);
+    //  Dispatch  SRV/UAV compute ,  - ,      
+    void BindComputeResources();
+    void UnbindComputeResources();
     bool CompileShader(const std::string& path, const std::string& entry, const std::string& profile, ID3DBlob** outBlob);
     DX11ReflectionData ReflectShader(ID3DBlob* blob);
     void* CreateBufferInternal(const void* data, size_t size, UINT bindFlags);
+    // Input assembler slot 0 + index buffer, skipped when the same buffers are already bound
+    void BindGeometry(ID3D11Buffer* vb, UINT stride, ID3D11Buffer* ib);
+    void RememberGeometry(ID3D11Buffer* vb, UINT stride, ID3D11Buffer* ib);
+    void CreateUploadRing(DX11BufferWrapper* wrapper, size_t size);
     void CreateDepthResources(int width, int height);
     void CreateInputLayoutFromShader(const std::vector<char>& shaderBytecode, ID3D11InputLayout** outLayout);
-    void SetRenderTargetsInternal(ID3D11RenderTargetView* rtvs[], int count);
+    void SetRenderTargetsInternal(ID3D11RenderTargetView* rtvs[], int count, DX11TextureWrapper* depth = nullptr, bool autoDepth = true);
     void ClearRTV(ID3D11RenderTargetView* rtv, float r, float g, float b, float a);
     void UnbindResources();
     void InitRenderStates();
@@ -113,13 +196,37 @@ private:
     ComPtr<ID3D11DeviceContext> m_context;
     ComPtr<IDXGISwapChain> m_swapChain;
     ComPtr<ID3D11RenderTargetView> m_backBufferRTV;
+    DX11TextureWrapper m_backBuffer = {}; //      readback (   m_textures)
+    bool m_headless = false;
     ComPtr<ID3D11Buffer> m_quadVertexBuffer;
     ComPtr<ID3D11Buffer> m_quadIndexBuffer;
+    ID3D11Buffer* m_boundVertexBuffer = nullptr;
+    UINT m_boundVertexStride = 0;
+    ID3D11Buffer* m_boundIndexBuffer = nullptr;
+
+    //       ( D3D11 ):      
+    // ,       
+    ShardedRegistry<DX11TextureWrapper> m_textures;
+    ShardedRegistry<DX11SamplerWrapper> m_samplers;
 
-    std::vector<DX11TextureWrapper*> m_textures;
-    std::vector<DX11SamplerWrapper*> m_samplers;
+    //  staging   :    ,       
+    static const int kMaxReadbackSlots = 8;
+    std::vector<DX11ReadbackSlot*> m_readbackSlots;
     std::map<std::string, DX11ShaderWrapper> m_shaderCache;
     DX11ShaderWrapper* m_activeShader = nullptr;
+    DX11ShaderWrapper* m_activeCompute = nullptr; // Compute     
+
+    //  compute ,    Dispatch
+    static const int kMaxComputeSRVs = 16;
+    static const int kMaxComputeUAVs = D3D11_PS_CS_UAV_REGISTER_COUNT;
+    ComPtr<ID3D11ShaderResourceView> m_computeSRVs[kMaxComputeSRVs];
+    ComPtr<ID3D11UnorderedAccessView> m_computeUAVs[kMaxComputeUAVs];
+    std::vector<DX11TextureWrapper*> m_computeTextures; //  compute :     
+    // SRVs of the graphics pass, unbound while a dispatch writes and restored after it
+    static const int kMaxGraphicsSRVs = 16;
+    ComPtr<ID3D11ShaderResourceView> m_savedPSSRVs[kMaxGraphicsSRVs];
+    ComPtr<ID3D11ShaderResourceView> m_savedVSSRVs[kMaxGraphicsSRVs];
+    bool m_graphicsSRVsSaved = false;
 
     struct StoredConstant { std::vector<uint8_t> Data; };
     std::map<std::string, StoredConstant> m_cpuConstantsStorage;
@@ -141,6 +248,7 @@ private:
 
     ID3D11RenderTargetView* m_currentRTV = nullptr;
     ID3D11DepthStencilView* m_currentDSV = nullptr;
+    bool m_currentDSVHasStencil = true;
 
     std::vector<ID3D11RenderTargetView*> m_boundRTVs;
 
@@ -159,11 +267,26 @@ private:
     struct DepthBufferCacheItem {
         ComPtr<ID3D11Texture2D> Texture;
         ComPtr<ID3D11DepthStencilView> DSV;
+        size_t Bytes = 0;
+        uint64_t LastUse = 0; //  m_depthUseCounter   
     };
 
     // map   ,      
     std::map<uint64_t, DepthBufferCacheItem> m_depthCache;
+    size_t m_depthCacheBytes = 0;
+    size_t m_depthCacheBudget = 256ull << 20;
+    uint64_t m_depthUseCounter = 0;
 
     // :    DSV  
     ID3D11DepthStencilView* GetDepthStencilForSize(int width, int height);
+    //     ,    incomingBytes    
+    void TrimDepthCache(size_t incomingBytes);
+    void ClearDepthCache();
+    void RegisterTexture(DX11TextureWrapper* wrapper);
+
+    //   (Rendeructor::GetMemoryStats),  -    D3D 
+    MemoryTracker* m_memoryTracker = nullptr;
+    void TrackMemory(const void* key, MemoryCategory category, size_t bytes);
+    void TrackTextureMemory(const void* key, TextureFormat format, int width, int height, int depth, TextureType type);
+    void UntrackMemory(const void* key);
 };
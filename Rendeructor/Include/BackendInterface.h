@@ -1,11 +1,15 @@
 #pragma once
 #include "RendeructorDefines.h"
 
+class MemoryTracker;
+
 class BackendInterface
 {
 public:
     virtual ~BackendInterface() = default;
 
+    // Every resource the backend creates is reported to the tracker. Set before Initialize; nullptr disables reporting
+    virtual void SetMemoryTracker(MemoryTracker* tracker) = 0;
     virtual bool Initialize(const BackendConfig& config) = 0;
     virtual void Shutdown() = 0;
     virtual void Resize(int width, int height) = 0;
@@ -14,24 +18,65 @@ public:
 
     virtual void* GetDevice() = 0;
     virtual void* GetContext() = 0;
+    // Texture handle of the back buffer (readback / copy source), valid until EndFrame presents it
+    virtual void* GetBackBufferHandle() = 0;
 
     // State Management
     virtual void SetPipelineState(const PipelineState& state) = 0;
     virtual void ResetPipelineStateCache() = 0;
     virtual void SetScissorRect(int x, int y, int width, int height) = 0;
 
-    // Resources
+    // Resources. The Create* functions (not CreateGPUTimer) may be called from any thread, concurrently with rendering;
+    // releasing, updating, copying and reading back belong to the render thread
     virtual void* CreateTextureResource(int width, int height, int format, const void* initialData) = 0;
+    // Render target that compute shaders can also write (unordered access)
+    virtual void* CreateStorageTextureResource(int width, int height, int format, const void* initialData) = 0;
     virtual void* CreateSamplerResource(const std::string& filterMode) = 0;
     virtual void* CreateTexture3DResource(int width, int height, int depth, int format, const void* initialData) = 0;
     virtual void* CreateTextureCubeResource(int width, int height, int format, const void** initialData) = 0;
+    virtual void* CreateDepthTextureResource(int width, int height, int format, bool shaderReadable) = 0;
+    // Textures and depth textures
+    virtual void ReleaseTexture(void* handle) = 0;
     virtual void* CreateVertexBuffer(const void* data, size_t size, int stride) = 0;
     virtual void* CreateIndexBuffer(const void* data, size_t size) = 0;
     virtual void* CreateInstanceBuffer(const void* data, size_t size, int stride) = 0;
+    // Instance buffer meant to be rewritten every frame: updates go through a CPU-writable upload ring
+    virtual void* CreateDynamicInstanceBuffer(const void* data, size_t size, int stride) = 0;
+    // Writes size bytes at byte offset; only the written range is transferred
+    virtual void UpdateBuffer(void* handle, const void* data, size_t size, size_t offset = 0) = 0;
+    // Shader read-only structured buffer, updated in ranges with UpdateBuffer. dynamic: updates go through an upload ring
+    virtual void* CreateStructuredBuffer(const void* data, size_t count, int stride, bool dynamic) = 0;
+    // Shader read/write buffer; type is a ComputeBufferType. Updated with UpdateBuffer, released with ReleaseBuffer
+    virtual void* CreateComputeBuffer(const void* data, size_t count, int stride, int type) = 0;
+    // Copies size bytes back to CPU memory, blocks until the GPU has finished writing the buffer
+    virtual bool ReadBuffer(void* handle, void* data, size_t size) = 0;
+    // Copies size bytes from one buffer into another (not within the same buffer)
+    virtual void CopyBufferRegion(void* dstHandle, size_t dstOffset, void* srcHandle, size_t srcOffset, size_t size) = 0;
+    virtual void ReleaseBuffer(void* handle) = 0;
+
+    // GPU timing with timestamp queries. nullptr when the backend cannot measure GPU time
+    virtual void* CreateGPUTimer() = 0;
+    virtual void BeginGPUTimer(void* handle) = 0;
+    virtual void EndGPUTimer(void* handle) = 0;
+    // false while the result is not ready yet; a ready but unreliable (disjoint) measurement gives milliseconds < 0
+    virtual bool GetGPUTimerResult(void* handle, double& milliseconds) = 0;
+    virtual void ReleaseGPUTimer(void* handle) = 0;
 
     // Operations
     virtual void CopyTexture(void* dstHandle, void* srcHandle) = 0;
+    // Copies the texture back to CPU memory (rows of rowPitch bytes). Blocks until the GPU has finished writing it
+    virtual bool ReadTexture(void* handle, void* data, size_t rowPitch) = 0;
+    // Asynchronous readback: queues a copy into a CPU readable staging slot. nullptr when every slot is still in flight
+    virtual void* RequestTextureReadback(void* handle) = 0;
+    // 1: copied to data and the ticket is freed, 0: GPU not done yet (only without wait), -1: failed, ticket freed
+    virtual int ResolveTextureReadback(void* ticket, void* data, size_t rowPitch, bool wait) = 0;
     virtual void SetRenderTarget(void* target1, void* target2 = nullptr, void* target3 = nullptr, void* target4 = nullptr) = 0;
+    // depthHandle: explicit depth texture (may be bound without color targets); otherwise autoDepth selects the cached
+    // depth buffer of the target size or none at all
+    virtual void SetRenderTargetWithDepth(void* target1, void* target2, void* target3, void* target4, void* depthHandle, bool autoDepth) = 0;
+    // Memory the cached automatic depth buffers may take before the least recently used ones are released
+    virtual void SetAutoDepthBudget(size_t bytes) = 0;
+    virtual size_t GetAutoDepthMemory() = 0;
     virtual void Clear(float r, float g, float b, float a) = 0;
     virtual void ClearTexture(void* textureHandle, float r, float g, float b, float a) = 0;
     virtual void ClearDepth(float depth, int stencil) = 0;
@@ -41,6 +86,20 @@ public:
     virtual void UpdateConstantRaw(const std::string& name, const void* data, size_t size) = 0;
 
     virtual void DrawFullScreenQuad() = 0;
-    virtual void DrawMesh(void* vbHandle, void* ibHandle, int indexCount) = 0;
-    virtual void DrawMeshInstanced(void* vbHandle, void* ibHandle, int indexCount, void* instHandle, int instanceCount, int instanceStride) = 0;
+    // indexCount indices from startIndex; baseVertex is added to every index, startInstance offsets the instance data
+    virtual void DrawMesh(void* vbHandle, void* ibHandle, int indexCount, int startIndex, int baseVertex) = 0;
+    virtual void DrawMeshInstanced(void* vbHandle, void* ibHandle, int indexCount, void* instHandle, int instanceCount, int instanceStride,
+                                   int startIndex, int baseVertex, int startInstance) = 0;
+    // Same as DrawMeshInstanced, but with the bound pass's InstancedVertexShaderEntryPoint; false if it has none
+    virtual bool DrawMeshInstancedVariant(void* vbHandle, void* ibHandle, int indexCount, void* instHandle, int instanceCount, int instanceStride,
+                                          int startIndex, int baseVertex, int startInstance) = 0;
+    // drawCount DrawIndexedIndirectArgs records, argsStride bytes apart, starting at byteOffset of an IndirectArgs buffer.
+    // instHandle may be null for meshes drawn without per-instance data
+    virtual void DrawMeshIndirect(void* vbHandle, void* ibHandle, void* instHandle, int instanceStride,
+                                  void* argsHandle, unsigned int byteOffset, int drawCount, unsigned int argsStride) = 0;
+
+    // Runs the compute pass bound by SetShaderPass; the graphics pass stays bound
+    virtual void Dispatch(int groupsX, int groupsY, int groupsZ) = 0;
+    // Group counts are three uints at byteOffset of an IndirectArgs buffer
+    virtual void DispatchIndirect(void* argsHandle, unsigned int byteOffset) = 0;
 };
@@ -0,0 +1,164 @@
+﻿#include "pch.h"
+#include "FrameWriter.h"
+#include "ImageWriter.h"
+#include <filesystem>
+#include <chrono>
+#include <iostream>
+
+FrameWriter::~FrameWriter() {
+    Stop();
+}
+
+void FrameWriter::Start(int threads, int maxPending) {
+    Stop();
+
+    if (threads <= 0) threads = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+    m_maxPending = std::max(maxPending, 1);
+    m_stopping = false;
+    for (int i = 0; i < threads; ++i) {
+        m_threads.emplace_back(&FrameWriter::WorkerLoop, this);
+    }
+}
+
+void FrameWriter::Stop() {
+    if (m_threads.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobAvailable.notify_all();
+    for (auto& thread : m_threads) thread.join();
+    m_threads.clear();
+}
+
+void FrameWriter::Submit(const std::string& path, int width, int height, TextureFormat format, std::vector<unsigned char>&& pixels) {
+    Job job;
+    job.Path = path;
+    job.Width = width;
+    job.Height = height;
+    job.Format = format;
+    job.Pixels = std::move(pixels);
+
+    // Без рабочих потоков (Start не вызывался) кодируем на месте, чтобы кадр не потерялся
+    if (m_threads.empty()) {
+        double ms = 0.0;
+        bool ok = WriteJob(job, ms);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.Submitted++;
+        ok ? m_stats.Written++ : m_stats.Failed++;
+        m_stats.LastEncodeMilliseconds = ms;
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // Очередь полна - ждем: кодирование не успевает за рендером, копить кадры в памяти бесконечно нельзя
+    m_jobFinished.wait(lock, [this] { return (int)m_jobs.size() < m_maxPending; });
+    m_jobs.push_back(std::move(job));
+    m_stats.Submitted++;
+    m_stats.Pending = (int)m_jobs.size() + m_active;
+    lock.unlock();
+    m_jobAvailable.notify_one();
+}
+
+void FrameWriter::Flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobFinished.wait(lock, [this] { return m_jobs.empty() && m_active == 0; });
+}
+
+FrameWriterStats FrameWriter::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+bool FrameWriter::FormatFramePath(const std::string& pattern, int frame, std::string& path) {
+    std::string result;
+    result.reserve(pattern.size() + 16);
+    int conversions = 0;
+
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%') {
+            result += pattern[i];
+            continue;
+        }
+        if (++i < pattern.size() && pattern[i] == '%') {
+            result += '%';
+            continue;
+        }
+
+        bool zeroPad = false;
+        if (i < pattern.size() && pattern[i] == '0') {
+            zeroPad = true;
+            ++i;
+        }
+        // Ширина ограничена, чтобы шаблон не мог заказать гигантскую строку
+        int width = 0;
+        while (i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9') {
+            width = width * 10 + (pattern[i] - '0');
+            if (width > 32) return false;
+            ++i;
+        }
+        if (i >= pattern.size()) return false;
+
+        long long value = frame;
+        if (pattern[i] == 'u') value = (unsigned int)frame;
+        else if (pattern[i] != 'd' && pattern[i] != 'i') return false;
+        if (++conversions > 1) return false;
+
+        std::string digits = std::to_string(value < 0 ? -value : value);
+        const size_t sign = value < 0 ? 1 : 0;
+        if (digits.size() + sign < (size_t)width) {
+            const size_t padding = (size_t)width - digits.size() - sign;
+            if (zeroPad) digits.insert(0, padding, '0');
+            else result.append(padding, ' ');
+        }
+        if (sign) result += '-';
+        result += digits;
+    }
+
+    // Без номера кадра все кадры писались бы в один файл
+    if (conversions != 1) return false;
+    path = std::move(result);
+    return true;
+}
+
+bool FrameWriter::WriteJob(const Job& job, double& milliseconds) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(job.Path).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+
+    bool ok = ImageWriter::Write(job.Path, job.Width, job.Height, job.Format, job.Pixels.data());
+    if (!ok) std::cerr << "[FrameWriter] Failed to write " << job.Path << std::endl;
+
+    milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return ok;
+}
+
+void FrameWriter::WorkerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            // При остановке очередь все равно дописывается до конца
+            if (m_jobs.empty()) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_active++;
+        }
+        m_jobFinished.notify_all();
+
+        double ms = 0.0;
+        bool ok = WriteJob(job, ms);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active--;
+            ok ? m_stats.Written++ : m_stats.Failed++;
+            m_stats.LastEncodeMilliseconds = ms;
+            m_stats.Pending = (int)m_jobs.size() + m_active;
+        }
+        m_jobFinished.notify_all();
+    }
+}
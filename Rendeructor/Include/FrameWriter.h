@@ -0,0 +1,64 @@
+#pragma once
+#include "RendeructorDefines.h"
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct FrameWriterStats {
+    unsigned long long Submitted = 0;
+    unsigned long long Written = 0;
+    unsigned long long Failed = 0;
+    int Pending = 0;                 // queued or being encoded
+    double LastEncodeMilliseconds = 0.0;
+};
+
+// Encodes and writes images (ImageWriter) on worker threads.
+// Submit() takes the pixels and returns immediately; it only waits when MaxPending images are already in the queue,
+// which bounds the memory when encoding is slower than rendering. Missing directories of the path are created.
+class RENDER_API FrameWriter {
+public:
+    FrameWriter() = default;
+    ~FrameWriter();
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    // threads = 0: one less than the hardware threads, at least one
+    void Start(int threads = 0, int maxPending = 8);
+    // Writes everything still queued, then joins the workers
+    void Stop();
+    bool IsRunning() const { return !m_threads.empty(); }
+
+    void Submit(const std::string& path, int width, int height, TextureFormat format, std::vector<unsigned char>&& pixels);
+    // Waits until every submitted image is on disk
+    void Flush();
+
+    FrameWriterStats GetStats() const;
+
+    // Expands a frame output pattern such as "frames/frame_%04d.png" without passing it to printf. The pattern must
+    // contain exactly one integer conversion (%d, %i or %u with an optional '0' flag and width); "%%" is a literal
+    // percent sign. Returns false, leaving 'path' untouched, for any other pattern
+    static bool FormatFramePath(const std::string& pattern, int frame, std::string& path);
+
+private:
+    struct Job {
+        std::string Path;
+        int Width = 0;
+        int Height = 0;
+        TextureFormat Format = TextureFormat::RGBA8;
+        std::vector<unsigned char> Pixels;
+    };
+
+    void WorkerLoop();
+    static bool WriteJob(const Job& job, double& milliseconds);
+
+    std::vector<std::thread> m_threads;
+    std::deque<Job> m_jobs;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::condition_variable m_jobFinished;
+    int m_maxPending = 8;
+    int m_active = 0;
+    bool m_stopping = false;
+    FrameWriterStats m_stats;
+};
@@ -0,0 +1,444 @@
+﻿#include "pch.h"
+#include "GeometryArena.h"
+#include "BackendInterface.h"
+#include <bit>
+#include <iostream>
+
+// ---------------------------------------------------------------------------
+// GeometryAllocator
+// ---------------------------------------------------------------------------
+
+void GeometryAllocator::Initialize(uint32_t capacity) {
+    Reset();
+    m_capacity = std::min(capacity, 1u << 31);
+    m_freeLists.assign(kFirstLevelCount * kSecondLevelCount, kNone);
+    if (m_capacity > 0) {
+        m_firstBlock = NewBlock(0, m_capacity);
+        InsertFree(m_firstBlock);
+    }
+}
+
+void GeometryAllocator::Reset() {
+    m_blocks.clear();
+    m_unusedBlocks.clear();
+    m_freeLists.assign(kFirstLevelCount * kSecondLevelCount, kNone);
+    m_firstLevelBitmap = 0;
+    for (uint32_t& bitmap : m_secondLevelBitmap) bitmap = 0;
+    m_usedByOffset.clear();
+    m_firstBlock = kNone;
+    m_capacity = 0;
+    m_used = 0;
+    m_allocations = 0;
+}
+
+void GeometryAllocator::MapSize(uint32_t size, int& firstLevel, int& secondLevel) {
+    // Маленькие размеры идут в нулевой уровень по одному на класс, остальные - 16 классов на каждую степень двойки
+    if (size < (uint32_t)kSecondLevelCount) {
+        firstLevel = 0;
+        secondLevel = (int)size;
+        return;
+    }
+    const int log2 = 31 - std::countl_zero(size);
+    secondLevel = (int)((size >> (log2 - kSecondLevelBits)) ^ (uint32_t)kSecondLevelCount);
+    firstLevel = log2 - kSecondLevelBits + 1;
+}
+
+int GeometryAllocator::NewBlock(uint32_t offset, uint32_t size) {
+    int index;
+    if (!m_unusedBlocks.empty()) {
+        index = m_unusedBlocks.back();
+        m_unusedBlocks.pop_back();
+        m_blocks[index] = Block();
+    }
+    else {
+        index = (int)m_blocks.size();
+        m_blocks.emplace_back();
+    }
+    m_blocks[index].Offset = offset;
+    m_blocks[index].Size = size;
+    return index;
+}
+
+void GeometryAllocator::DeleteBlock(int index) {
+    m_blocks[index] = Block();
+    m_unusedBlocks.push_back(index);
+}
+
+void GeometryAllocator::InsertFree(int index) {
+    int firstLevel, secondLevel;
+    MapSize(m_blocks[index].Size, firstLevel, secondLevel);
+
+    int& head = m_freeLists[firstLevel * kSecondLevelCount + secondLevel];
+    m_blocks[index].PrevFree = kNone;
+    m_blocks[index].NextFree = head;
+    if (head != kNone) m_blocks[head].PrevFree = index;
+    head = index;
+
+    m_firstLevelBitmap |= 1u << firstLevel;
+    m_secondLevelBitmap[firstLevel] |= 1u << secondLevel;
+}
+
+void GeometryAllocator::RemoveFree(int index) {
+    int firstLevel, secondLevel;
+    MapSize(m_blocks[index].Size, firstLevel, secondLevel);
+
+    Block& block = m_blocks[index];
+    int& head = m_freeLists[firstLevel * kSecondLevelCount + secondLevel];
+    if (block.PrevFree != kNone) m_blocks[block.PrevFree].NextFree = block.NextFree;
+    if (block.NextFree != kNone) m_blocks[block.NextFree].PrevFree = block.PrevFree;
+    if (head == index) head = block.NextFree;
+    block.PrevFree = kNone;
+    block.NextFree = kNone;
+
+    if (head == kNone) {
+        m_secondLevelBitmap[firstLevel] &= ~(1u << secondLevel);
+        if (m_secondLevelBitmap[firstLevel] == 0) m_firstLevelBitmap &= ~(1u << firstLevel);
+    }
+}
+
+int GeometryAllocator::FindFree(uint32_t size) const {
+    int exactFirst, exactSecond;
+    MapSize(size, exactFirst, exactSecond);
+
+    // Округляем вверх до следующего класса: любой блок найденного списка тогда гарантированно не меньше size
+    uint32_t rounded = size;
+    if (size >= (uint32_t)kSecondLevelCount) {
+        const int log2 = 31 - std::countl_zero(size);
+        rounded += (1u << (log2 - kSecondLevelBits)) - 1;
+    }
+
+    int firstLevel, secondLevel;
+    MapSize(rounded, firstLevel, secondLevel);
+    if (firstLevel < kFirstLevelCount) {
+        uint32_t secondMap = m_secondLevelBitmap[firstLevel] & (~0u << secondLevel);
+        if (!secondMap) {
+            const uint32_t firstMap = (firstLevel + 1 < 32) ? m_firstLevelBitmap & (~0u << (firstLevel + 1)) : 0;
+            if (firstMap) {
+                firstLevel = std::countr_zero(firstMap);
+                secondMap = m_secondLevelBitmap[firstLevel];
+            }
+        }
+        if (secondMap) return m_freeLists[firstLevel * kSecondLevelCount + std::countr_zero(secondMap)];
+    }
+
+    // Больших классов нет - блок подходящего размера может лежать в том же классе, что и size
+    // (например, страница, созданная ровно под одну сетку)
+    for (int index = m_freeLists[exactFirst * kSecondLevelCount + exactSecond]; index != kNone; index = m_blocks[index].NextFree) {
+        if (m_blocks[index].Size >= size) return index;
+    }
+    return kNone;
+}
+
+bool GeometryAllocator::Allocate(uint32_t size, uint32_t& offset) {
+    if (size == 0 || size > m_capacity - m_used) return false;
+
+    const int index = FindFree(size);
+    if (index == kNone) return false;
+    RemoveFree(index);
+
+    // Остаток блока сразу возвращается в свободные
+    if (m_blocks[index].Size > size) {
+        const int rest = NewBlock(m_blocks[index].Offset + size, m_blocks[index].Size - size);
+        Block& block = m_blocks[index];
+        m_blocks[rest].PrevPhysical = index;
+        m_blocks[rest].NextPhysical = block.NextPhysical;
+        if (block.NextPhysical != kNone) m_blocks[block.NextPhysical].PrevPhysical = rest;
+        block.NextPhysical = rest;
+        block.Size = size;
+        InsertFree(rest);
+    }
+
+    Block& block = m_blocks[index];
+    block.Used = true;
+    offset = block.Offset;
+    m_usedByOffset[offset] = index;
+    m_used += size;
+    m_allocations++;
+    return true;
+}
+
+bool GeometryAllocator::Free(uint32_t offset) {
+    auto it = m_usedByOffset.find(offset);
+    if (it == m_usedByOffset.end()) return false;
+    int index = it->second;
+    m_usedByOffset.erase(it);
+
+    Block& block = m_blocks[index];
+    block.Used = false;
+    m_used -= block.Size;
+    m_allocations--;
+
+    // Склеиваем со свободными соседями, чтобы свободное место не дробилось
+    const int next = block.NextPhysical;
+    if (next != kNone && !m_blocks[next].Used) {
+        RemoveFree(next);
+        block.Size += m_blocks[next].Size;
+        block.NextPhysical = m_blocks[next].NextPhysical;
+        if (block.NextPhysical != kNone) m_blocks[block.NextPhysical].PrevPhysical = index;
+        DeleteBlock(next);
+    }
+
+    const int prev = m_blocks[index].PrevPhysical;
+    if (prev != kNone && !m_blocks[prev].Used) {
+        RemoveFree(prev);
+        m_blocks[prev].Size += m_blocks[index].Size;
+        m_blocks[prev].NextPhysical = m_blocks[index].NextPhysical;
+        if (m_blocks[prev].NextPhysical != kNone) m_blocks[m_blocks[prev].NextPhysical].PrevPhysical = prev;
+        DeleteBlock(index);
+        index = prev;
+    }
+
+    InsertFree(index);
+    return true;
+}
+
+void GeometryAllocator::Defragment(std::vector<Move>& moves) {
+    moves.clear();
+
+    std::vector<uint32_t> sizes;
+    uint32_t cursor = 0;
+    for (int index = m_firstBlock; index != kNone; index = m_blocks[index].NextPhysical) {
+        const Block& block = m_blocks[index];
+        if (!block.Used) continue;
+        if (block.Offset != cursor) moves.push_back({ block.Offset, cursor, block.Size });
+        sizes.push_back(block.Size);
+        cursor += block.Size;
+    }
+
+    // Пересобираем с нуля: из единственного свободного блока выделения ложатся подряд от начала
+    const uint32_t capacity = m_capacity;
+    Initialize(capacity);
+    uint32_t offset = 0;
+    for (uint32_t size : sizes) Allocate(size, offset);
+}
+
+uint32_t GeometryAllocator::GetLargestFreeBlock() const {
+    uint32_t largest = 0;
+    for (int index = m_firstBlock; index != kNone; index = m_blocks[index].NextPhysical) {
+        if (!m_blocks[index].Used) largest = std::max(largest, m_blocks[index].Size);
+    }
+    return largest;
+}
+
+// ---------------------------------------------------------------------------
+// GeometryArena
+// ---------------------------------------------------------------------------
+
+GeometryArena::~GeometryArena() {
+    Shutdown();
+}
+
+void GeometryArena::Initialize(BackendInterface* backend, int verticesPerPage, int indicesPerPage) {
+    Shutdown();
+    m_backend = backend;
+    m_verticesPerPage = (uint32_t)std::max(verticesPerPage, 1);
+    m_indicesPerPage = (uint32_t)std::max(indicesPerPage, 3);
+    m_defragmentations = 0;
+    m_movedAllocations = 0;
+}
+
+void GeometryArena::Shutdown() {
+    for (Page& page : m_pages) ReleasePage(page);
+    m_pages.clear();
+    m_allocations.clear();
+    m_unusedIds.clear();
+    m_backend = nullptr;
+}
+
+int GeometryArena::CreatePage(uint32_t vertices, uint32_t indices) {
+    void* vb = m_backend->CreateVertexBuffer(nullptr, (size_t)vertices * sizeof(Vertex), sizeof(Vertex));
+    void* ib = vb ? m_backend->CreateIndexBuffer(nullptr, (size_t)indices * sizeof(unsigned int)) : nullptr;
+    if (!vb || !ib) {
+        if (vb) m_backend->ReleaseBuffer(vb);
+        std::cerr << "[GeometryArena] Failed to create a page of " << vertices << " vertices / " << indices << " indices" << std::endl;
+        return -1;
+    }
+
+    int index = -1;
+    for (int i = 0; i < (int)m_pages.size(); ++i) {
+        if (!m_pages[i].VB) { index = i; break; }
+    }
+    if (index < 0) {
+        index = (int)m_pages.size();
+        m_pages.emplace_back();
+    }
+
+    Page& page = m_pages[index];
+    page.VB = vb;
+    page.IB = ib;
+    page.Vertices.Initialize(vertices);
+    page.Indices.Initialize(indices);
+    return index;
+}
+
+void GeometryArena::ReleasePage(Page& page) {
+    if (m_backend) {
+        if (page.VB) m_backend->ReleaseBuffer(page.VB);
+        if (page.IB) m_backend->ReleaseBuffer(page.IB);
+    }
+    page.VB = nullptr;
+    page.IB = nullptr;
+    page.Vertices.Reset();
+    page.Indices.Reset();
+}
+
+int GeometryArena::Allocate(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+    if (!m_backend || !vertices || !indices || vertexCount == 0 || indexCount == 0) return -1;
+    if (vertexCount > (1u << 31) || indexCount > (1u << 31)) return -1;
+
+    const uint32_t vertexUnits = (uint32_t)vertexCount;
+    const uint32_t indexUnits = (uint32_t)indexCount;
+
+    Allocation allocation;
+    auto tryPage = [&](int pageIndex) {
+        Page& page = m_pages[pageIndex];
+        if (!page.VB) return false;
+        if (!page.Vertices.Allocate(vertexUnits, allocation.VertexOffset)) return false;
+        if (!page.Indices.Allocate(indexUnits, allocation.IndexOffset)) {
+            page.Vertices.Free(allocation.VertexOffset);
+            return false;
+        }
+        allocation.Page = pageIndex;
+        return true;
+    };
+
+    for (int i = 0; i < (int)m_pages.size() && allocation.Page < 0; ++i) tryPage(i);
+
+    // Места хватает, но оно раздроблено - уплотняем страницу, это дешевле новой
+    for (int i = 0; i < (int)m_pages.size() && allocation.Page < 0; ++i) {
+        const Page& page = m_pages[i];
+        if (!page.VB || page.Vertices.GetFree() < vertexUnits || page.Indices.GetFree() < indexUnits) continue;
+        if (DefragmentPage(i)) tryPage(i);
+    }
+
+    if (allocation.Page < 0) {
+        const int pageIndex = CreatePage(std::max(m_verticesPerPage, vertexUnits), std::max(m_indicesPerPage, indexUnits));
+        if (pageIndex < 0 || !tryPage(pageIndex)) return -1;
+    }
+
+    allocation.VertexCount = vertexUnits;
+    allocation.IndexCount = indexUnits;
+
+    const Page& page = m_pages[allocation.Page];
+    m_backend->UpdateBuffer(page.VB, vertices, (size_t)vertexUnits * sizeof(Vertex), (size_t)allocation.VertexOffset * sizeof(Vertex));
+    m_backend->UpdateBuffer(page.IB, indices, (size_t)indexUnits * sizeof(unsigned int), (size_t)allocation.IndexOffset * sizeof(unsigned int));
+
+    int id;
+    if (!m_unusedIds.empty()) {
+        id = m_unusedIds.back();
+        m_unusedIds.pop_back();
+        m_allocations[id] = allocation;
+    }
+    else {
+        id = (int)m_allocations.size();
+        m_allocations.push_back(allocation);
+    }
+    return id;
+}
+
+void GeometryArena::Free(int id) {
+    if (id < 0 || id >= (int)m_allocations.size()) return;
+    Allocation& allocation = m_allocations[id];
+    if (allocation.Page < 0) return;
+
+    Page& page = m_pages[allocation.Page];
+    page.Vertices.Free(allocation.VertexOffset);
+    page.Indices.Free(allocation.IndexOffset);
+
+    allocation = Allocation();
+    m_unusedIds.push_back(id);
+}
+
+GeometryArenaRange GeometryArena::GetRange(int id) const {
+    GeometryArenaRange range;
+    if (id < 0 || id >= (int)m_allocations.size()) return range;
+    const Allocation& allocation = m_allocations[id];
+    if (allocation.Page < 0) return range;
+
+    const Page& page = m_pages[allocation.Page];
+    range.VB = page.VB;
+    range.IB = page.IB;
+    range.BaseVertex = (int)allocation.VertexOffset;
+    range.StartIndex = (int)allocation.IndexOffset;
+    return range;
+}
+
+bool GeometryArena::DefragmentPage(int pageIndex) {
+    Page& page = m_pages[pageIndex];
+    if (!page.VB) return false;
+
+    const bool vertexGaps = page.Vertices.GetLargestFreeBlock() < page.Vertices.GetFree();
+    const bool indexGaps = page.Indices.GetLargestFreeBlock() < page.Indices.GetFree();
+    if (!vertexGaps && !indexGaps) return false;
+
+    // D3D11 не копирует внутри одного буфера, поэтому живые данные переезжают в новую пару буферов.
+    // Создаем ее до изменения аллокаторов: при нехватке памяти страница остается как была
+    const uint32_t vertexCapacity = page.Vertices.GetCapacity();
+    const uint32_t indexCapacity = page.Indices.GetCapacity();
+    void* vb = m_backend->CreateVertexBuffer(nullptr, (size_t)vertexCapacity * sizeof(Vertex), sizeof(Vertex));
+    void* ib = vb ? m_backend->CreateIndexBuffer(nullptr, (size_t)indexCapacity * sizeof(unsigned int)) : nullptr;
+    if (!vb || !ib) {
+        if (vb) m_backend->ReleaseBuffer(vb);
+        return false;
+    }
+
+    std::vector<GeometryAllocator::Move> vertexMoves, indexMoves;
+    page.Vertices.Defragment(vertexMoves);
+    page.Indices.Defragment(indexMoves);
+
+    std::unordered_map<uint32_t, uint32_t> vertexTarget, indexTarget;
+    for (const auto& move : vertexMoves) vertexTarget[move.From] = move.To;
+    for (const auto& move : indexMoves) indexTarget[move.From] = move.To;
+
+    for (Allocation& allocation : m_allocations) {
+        if (allocation.Page != pageIndex) continue;
+
+        auto vertexIt = vertexTarget.find(allocation.VertexOffset);
+        auto indexIt = indexTarget.find(allocation.IndexOffset);
+        const uint32_t newVertexOffset = vertexIt != vertexTarget.end() ? vertexIt->second : allocation.VertexOffset;
+        const uint32_t newIndexOffset = indexIt != indexTarget.end() ? indexIt->second : allocation.IndexOffset;
+        if (newVertexOffset != allocation.VertexOffset || newIndexOffset != allocation.IndexOffset) m_movedAllocations++;
+
+        m_backend->CopyBufferRegion(vb, (size_t)newVertexOffset * sizeof(Vertex),
+            page.VB, (size_t)allocation.VertexOffset * sizeof(Vertex), (size_t)allocation.VertexCount * sizeof(Vertex));
+        m_backend->CopyBufferRegion(ib, (size_t)newIndexOffset * sizeof(unsigned int),
+            page.IB, (size_t)allocation.IndexOffset * sizeof(unsigned int), (size_t)allocation.IndexCount * sizeof(unsigned int));
+
+        allocation.VertexOffset = newVertexOffset;
+        allocation.IndexOffset = newIndexOffset;
+    }
+
+    m_backend->ReleaseBuffer(page.VB);
+    m_backend->ReleaseBuffer(page.IB);
+    page.VB = vb;
+    page.IB = ib;
+    m_defragmentations++;
+    return true;
+}
+
+int GeometryArena::Defragment() {
+    if (!m_backend) return 0;
+    const unsigned long long movedBefore = m_movedAllocations;
+    for (int i = 0; i < (int)m_pages.size(); ++i) DefragmentPage(i);
+    return (int)(m_movedAllocations - movedBefore);
+}
+
+void GeometryArena::Trim() {
+    for (Page& page : m_pages) {
+        if (page.VB && page.Vertices.GetAllocationCount() == 0) ReleasePage(page);
+    }
+}
+
+GeometryArenaStats GeometryArena::GetStats() const {
+    GeometryArenaStats stats;
+    for (const Page& page : m_pages) {
+        if (!page.VB) continue;
+        stats.Pages++;
+        stats.Allocations += page.Vertices.GetAllocationCount();
+        stats.BytesAllocated += (size_t)page.Vertices.GetCapacity() * sizeof(Vertex) + (size_t)page.Indices.GetCapacity() * sizeof(unsigned int);
+        stats.BytesUsed += (size_t)page.Vertices.GetUsed() * sizeof(Vertex) + (size_t)page.Indices.GetUsed() * sizeof(unsigned int);
+    }
+    stats.Defragmentations = m_defragmentations;
+    stats.MovedAllocations = m_movedAllocations;
+    return stats;
+}
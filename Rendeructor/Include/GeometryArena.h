@@ -0,0 +1,151 @@
+#pragma once
+#include "RendeructorDefines.h"
+#include <cstdint>
+#include <unordered_map>
+
+class BackendInterface;
+
+// Two-level segregated fit (TLSF) allocator over an abstract range [0, capacity) of units.
+// Allocation and free are O(1): free blocks are kept in size-class lists found through two bitmaps, neighbouring
+// free blocks are merged on Free. Knows nothing about GPU memory, offsets are in whatever units the owner uses.
+class RENDER_API GeometryAllocator {
+public:
+    struct Move {
+        uint32_t From;
+        uint32_t To;
+        uint32_t Size;
+    };
+
+    GeometryAllocator() = default;
+
+    // Capacity is limited to 2^31 units
+    void Initialize(uint32_t capacity);
+    // Drops all blocks and the capacity; Initialize again before allocating
+    void Reset();
+
+    // false when no free block is large enough (the allocator may still hold that much in pieces, see Defragment)
+    bool Allocate(uint32_t size, uint32_t& offset);
+    // false for offsets that are not the start of an allocated block
+    bool Free(uint32_t offset);
+
+    // Packs all allocations to the start of the range, keeping their order. Moves are listed in address order with
+    // To <= From, so copying them one after another never overwrites data that is still to be moved
+    void Defragment(std::vector<Move>& moves);
+
+    uint32_t GetCapacity() const { return m_capacity; }
+    uint32_t GetUsed() const { return m_used; }
+    uint32_t GetFree() const { return m_capacity - m_used; }
+    uint32_t GetLargestFreeBlock() const;
+    int GetAllocationCount() const { return m_allocations; }
+
+private:
+    static constexpr int kSecondLevelBits = 4;
+    static constexpr int kSecondLevelCount = 1 << kSecondLevelBits;
+    static constexpr int kFirstLevelCount = 32 - kSecondLevelBits + 1;
+    static constexpr int kNone = -1;
+
+    struct Block {
+        uint32_t Offset = 0;
+        uint32_t Size = 0;
+        int PrevPhysical = kNone;
+        int NextPhysical = kNone;
+        int PrevFree = kNone;
+        int NextFree = kNone;
+        bool Used = false;
+    };
+
+    static void MapSize(uint32_t size, int& firstLevel, int& secondLevel);
+    int NewBlock(uint32_t offset, uint32_t size);
+    void DeleteBlock(int index);
+    void InsertFree(int index);
+    void RemoveFree(int index);
+    int FindFree(uint32_t size) const;
+
+    std::vector<Block> m_blocks;
+    std::vector<int> m_unusedBlocks;
+    std::vector<int> m_freeLists; // kFirstLevelCount * kSecondLevelCount heads
+    uint32_t m_firstLevelBitmap = 0;
+    uint32_t m_secondLevelBitmap[kFirstLevelCount] = {};
+    std::unordered_map<uint32_t, int> m_usedByOffset;
+    int m_firstBlock = kNone;
+    uint32_t m_capacity = 0;
+    uint32_t m_used = 0;
+    int m_allocations = 0;
+};
+
+struct GeometryArenaStats {
+    int Pages = 0;
+    int Allocations = 0;
+    size_t BytesAllocated = 0;     // size of all page buffers
+    size_t BytesUsed = 0;          // vertices and indices of live meshes
+    // Totals since Initialize
+    unsigned long long Defragmentations = 0;
+    unsigned long long MovedAllocations = 0;
+};
+
+// Location of a mesh inside the arena: draw with VB/IB and add the offsets to the index range
+struct GeometryArenaRange {
+    void* VB = nullptr;
+    void* IB = nullptr;
+    int BaseVertex = 0;
+    int StartIndex = 0;
+};
+
+// Suballocates mesh vertices and indices from a few large vertex/index buffers (pages) instead of one buffer pair per mesh,
+// so consecutive draws of different meshes keep the same buffers bound and only change the draw offsets.
+// A mesh that does not fit into a page of the default size gets a page of its own. Allocations are addressed by id;
+// their offsets (and, after Defragment, the page buffers) change, so look the range up at draw time.
+class RENDER_API GeometryArena {
+public:
+    GeometryArena() = default;
+    ~GeometryArena();
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    void Initialize(BackendInterface* backend, int verticesPerPage, int indicesPerPage);
+    // Releases all pages; ids handed out before are invalid afterwards
+    void Shutdown();
+    bool IsInitialized() const { return m_backend != nullptr; }
+
+    // Uploads the mesh data and returns its id, -1 when the buffers could not be created
+    int Allocate(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+    void Free(int id);
+    GeometryArenaRange GetRange(int id) const;
+
+    // Compacts every page whose free space is split into several blocks; the GPU copies go through new page buffers.
+    // Returns the number of moved allocations
+    int Defragment();
+    // Releases pages without allocations
+    void Trim();
+
+    GeometryArenaStats GetStats() const;
+
+private:
+    struct Page {
+        void* VB = nullptr;
+        void* IB = nullptr;
+        GeometryAllocator Vertices;
+        GeometryAllocator Indices;
+    };
+
+    struct Allocation {
+        int Page = -1;
+        uint32_t VertexOffset = 0;
+        uint32_t VertexCount = 0;
+        uint32_t IndexOffset = 0;
+        uint32_t IndexCount = 0;
+    };
+
+    int CreatePage(uint32_t vertices, uint32_t indices);
+    void ReleasePage(Page& page);
+    bool DefragmentPage(int pageIndex);
+
+    BackendInterface* m_backend = nullptr;
+    uint32_t m_verticesPerPage = 0;
+    uint32_t m_indicesPerPage = 0;
+    std::vector<Page> m_pages;  // released pages stay as empty slots so page indices remain valid
+    std::vector<Allocation> m_allocations;
+    std::vector<int> m_unusedIds;
+    unsigned long long m_defragmentations = 0;
+    unsigned long long m_movedAllocations = 0;
+};
@@ -0,0 +1,519 @@
+﻿#include "pch.h"
+#include "ImageWriter.h"
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+namespace ImageWriter {
+
+namespace {
+
+    // ---------------- Общие конвертеры ----------------
+
+    float HalfToFloat(uint16_t h) {
+        const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+        uint32_t exponent = (h >> 10) & 0x1F;
+        uint32_t mantissa = h & 0x3FF;
+        uint32_t bits;
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                bits = sign;
+            }
+            else {
+                // Денормализованное число - нормализуем
+                exponent = 127 - 15 + 1;
+                while (!(mantissa & 0x400)) { mantissa <<= 1; exponent--; }
+                bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+            }
+        }
+        else if (exponent == 31) {
+            bits = sign | 0x7F800000 | (mantissa << 13);
+        }
+        else {
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+        float f;
+        memcpy(&f, &bits, 4);
+        return f;
+    }
+
+    uint16_t FloatToHalf(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, 4);
+        const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+        const int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (((bits >> 23) & 0xFF) == 0xFF) return sign | 0x7C00 | (mantissa ? 0x200 : 0); // Inf / NaN
+        if (exponent >= 31) return sign | 0x7C00;
+        if (exponent <= 0) {
+            if (exponent < -10) return sign;
+            mantissa |= 0x800000;
+            const int shift = 14 - exponent;
+            uint16_t result = (uint16_t)(mantissa >> shift);
+            if ((mantissa >> (shift - 1)) & 1) result++; // округление
+            return sign | result;
+        }
+        uint16_t result = (uint16_t)((exponent << 10) | (mantissa >> 13));
+        if (mantissa & 0x1000) result++; // округление, перенос в экспоненту корректен
+        return sign | result;
+    }
+
+    // Любой формат текстуры -> float RGBA
+    std::vector<float> ToFloatRGBA(int width, int height, TextureFormat format, const void* pixels) {
+        const size_t count = (size_t)width * height;
+        std::vector<float> out(count * 4);
+        const unsigned char* bytes = (const unsigned char*)pixels;
+        for (size_t i = 0; i < count; ++i) {
+            float* o = &out[i * 4];
+            switch (format) {
+            case TextureFormat::R8:
+                o[0] = o[1] = o[2] = bytes[i] / 255.0f; o[3] = 1.0f;
+                break;
+            case TextureFormat::R16F: {
+                uint16_t h;
+                memcpy(&h, bytes + i * 2, 2);
+                o[0] = o[1] = o[2] = HalfToFloat(h); o[3] = 1.0f;
+                break;
+            }
+            case TextureFormat::R32F:
+                memcpy(&o[0], bytes + i * 4, 4);
+                o[1] = o[2] = o[0]; o[3] = 1.0f;
+                break;
+            case TextureFormat::RGBA16F: {
+                uint16_t h[4];
+                memcpy(h, bytes + i * 8, 8);
+                for (int c = 0; c < 4; ++c) o[c] = HalfToFloat(h[c]);
+                break;
+            }
+            case TextureFormat::RGBA32F:
+                memcpy(o, bytes + i * 16, 16);
+                break;
+            default:
+                for (int c = 0; c < 4; ++c) o[c] = bytes[i * 4 + c] / 255.0f;
+                break;
+            }
+        }
+        return out;
+    }
+
+    unsigned char ToByte(float value) {
+        if (!(value > 0.0f)) return 0; // и NaN
+        if (value >= 1.0f) return 255;
+        return (unsigned char)(value * 255.0f + 0.5f);
+    }
+
+    // ---------------- PNG ----------------
+
+    struct CrcTable {
+        uint32_t Values[256];
+        CrcTable() {
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                Values[n] = c;
+            }
+        }
+    };
+
+    uint32_t Crc32(const unsigned char* data, size_t size) {
+        // Кодирование идет с нескольких потоков - таблица строится потокобезопасной статикой
+        static const CrcTable table;
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; ++i) crc = table.Values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    uint32_t Adler32(const unsigned char* data, size_t size) {
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            // 5552 - максимальный блок, в котором сумма не переполняет 32 бита
+            size_t block = std::min<size_t>(size, 5552);
+            size -= block;
+            while (block--) { a += *data++; b += a; }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<unsigned char>& out) : m_out(out) {}
+
+        // Биты идут младшими вперед, как требует deflate
+        void Put(uint32_t value, int count) {
+            m_buffer |= (uint64_t)value << m_count;
+            m_count += count;
+            while (m_count >= 8) {
+                m_out.push_back((unsigned char)m_buffer);
+                m_buffer >>= 8;
+                m_count -= 8;
+            }
+        }
+
+        // Коды Хаффмана пишутся старшим битом вперед
+        void PutCode(uint32_t code, int length) {
+            uint32_t reversed = 0;
+            for (int i = 0; i < length; ++i) reversed |= ((code >> i) & 1) << (length - 1 - i);
+            Put(reversed, length);
+        }
+
+        void Flush() {
+            if (m_count > 0) m_out.push_back((unsigned char)m_buffer);
+            m_buffer = 0;
+            m_count = 0;
+        }
+
+    private:
+        std::vector<unsigned char>& m_out;
+        uint64_t m_buffer = 0;
+        int m_count = 0;
+    };
+
+    const int kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const int kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const int kDistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                                4097, 6145, 8193, 12289, 16385, 24577 };
+    const int kDistExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    // Фиксированная таблица Хаффмана (RFC 1951, 3.2.6)
+    void PutLiteral(BitWriter& bits, int symbol) {
+        if (symbol < 144) bits.PutCode(0x30 + symbol, 8);
+        else if (symbol < 256) bits.PutCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280) bits.PutCode(symbol - 256, 7);
+        else bits.PutCode(0xC0 + symbol - 280, 8);
+    }
+
+    void PutMatch(BitWriter& bits, int length, int distance) {
+        int code = 28;
+        while (kLengthBase[code] > length) code--;
+        PutLiteral(bits, 257 + code);
+        if (kLengthExtra[code]) bits.Put(length - kLengthBase[code], kLengthExtra[code]);
+
+        int dist = 29;
+        while (kDistBase[dist] > distance) dist--;
+        bits.PutCode(dist, 5);
+        if (kDistExtra[dist]) bits.Put(distance - kDistBase[dist], kDistExtra[dist]);
+    }
+
+    // zlib поток: LZ77 с хеш-цепочками + один блок с фиксированными кодами.
+    // Динамические таблицы дали бы еще процентов 10-20, но кодирование и так идет на рабочих потоках
+    std::vector<unsigned char> ZlibCompress(const std::vector<unsigned char>& data) {
+        const int kWindow = 32768;
+        const int kHashBits = 15;
+        const int kMaxChain = 32;
+        const int kMinMatch = 3;
+        const int kMaxMatch = 258;
+
+        std::vector<unsigned char> out;
+        out.reserve(data.size() / 2 + 64);
+        out.push_back(0x78);
+        out.push_back(0x01);
+
+        BitWriter bits(out);
+        bits.Put(1, 1); // BFINAL
+        bits.Put(1, 2); // BTYPE = фиксированные коды
+
+        std::vector<int> head(1 << kHashBits, -1);
+        std::vector<int> prev(kWindow, -1);
+        auto hashAt = [&](size_t pos) {
+            uint32_t v = (uint32_t)data[pos] | ((uint32_t)data[pos + 1] << 8) | ((uint32_t)data[pos + 2] << 16);
+            return (v * 2654435761u) >> (32 - kHashBits);
+        };
+        auto insert = [&](size_t pos) {
+            if (pos + kMinMatch > data.size()) return;
+            uint32_t h = hashAt(pos);
+            prev[pos & (kWindow - 1)] = head[h];
+            head[h] = (int)pos;
+        };
+
+        size_t pos = 0;
+        while (pos < data.size()) {
+            int bestLength = 0;
+            int bestDistance = 0;
+            if (pos + kMinMatch <= data.size()) {
+                const int maxLength = (int)std::min<size_t>(kMaxMatch, data.size() - pos);
+                int candidate = head[hashAt(pos)];
+                for (int chain = 0; candidate >= 0 && chain < kMaxChain; ++chain) {
+                    const int distance = (int)pos - candidate;
+                    if (distance > kWindow - 1) break;
+                    if (data[candidate + bestLength] == data[pos + bestLength]) {
+                        int length = 0;
+                        while (length < maxLength && data[candidate + length] == data[pos + length]) length++;
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestDistance = distance;
+                            if (length == maxLength) break;
+                        }
+                    }
+                    const int next = prev[candidate & (kWindow - 1)];
+                    if (next >= candidate) break; // слот уже перезаписан более новой позицией
+                    candidate = next;
+                }
+            }
+
+            if (bestLength >= kMinMatch) {
+                PutMatch(bits, bestLength, bestDistance);
+                for (int i = 0; i < bestLength; ++i) insert(pos + i);
+                pos += bestLength;
+            }
+            else {
+                PutLiteral(bits, data[pos]);
+                insert(pos);
+                pos++;
+            }
+        }
+        PutLiteral(bits, 256); // конец блока
+        bits.Flush();
+
+        const uint32_t adler = Adler32(data.data(), data.size());
+        out.push_back((unsigned char)(adler >> 24));
+        out.push_back((unsigned char)(adler >> 16));
+        out.push_back((unsigned char)(adler >> 8));
+        out.push_back((unsigned char)adler);
+        return out;
+    }
+
+    unsigned char Paeth(int a, int b, int c) {
+        const int p = a + b - c;
+        const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc) return (unsigned char)a;
+        return (unsigned char)(pb <= pc ? b : c);
+    }
+
+    void PutChunk(std::vector<unsigned char>& file, const char* type, const unsigned char* data, size_t size) {
+        const size_t start = file.size();
+        file.push_back((unsigned char)(size >> 24));
+        file.push_back((unsigned char)(size >> 16));
+        file.push_back((unsigned char)(size >> 8));
+        file.push_back((unsigned char)size);
+        file.insert(file.end(), type, type + 4);
+        if (size) file.insert(file.end(), data, data + size);
+        const uint32_t crc = Crc32(file.data() + start + 4, size + 4);
+        file.push_back((unsigned char)(crc >> 24));
+        file.push_back((unsigned char)(crc >> 16));
+        file.push_back((unsigned char)(crc >> 8));
+        file.push_back((unsigned char)crc);
+    }
+
+    // ---------------- EXR ----------------
+
+    void PutInt(std::vector<unsigned char>& out, uint32_t value) {
+        for (int i = 0; i < 4; ++i) out.push_back((unsigned char)(value >> (i * 8)));
+    }
+
+    void PutFloat(std::vector<unsigned char>& out, float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, 4);
+        PutInt(out, bits);
+    }
+
+    void PutAttribute(std::vector<unsigned char>& out, const char* name, const char* type, const std::vector<unsigned char>& value) {
+        out.insert(out.end(), name, name + strlen(name) + 1);
+        out.insert(out.end(), type, type + strlen(type) + 1);
+        PutInt(out, (uint32_t)value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    bool WriteFile(const std::string& path, const void* data, size_t size) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) return false;
+        file.write((const char*)data, (std::streamsize)size);
+        return (bool)file;
+    }
+}
+
+bool GetFormatFromPath(const std::string& path, FileFormat& format) {
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = path.substr(dot + 1);
+    for (auto& c : ext) c = (char)tolower((unsigned char)c);
+
+    if (ext == "png") format = FileFormat::PNG;
+    else if (ext == "exr") format = FileFormat::EXR;
+    else if (ext == "pfm") format = FileFormat::PFM;
+    else return false;
+    return true;
+}
+
+bool Write(const std::string& path, int width, int height, TextureFormat format, const void* pixels) {
+    if (width <= 0 || height <= 0 || !pixels) return false;
+
+    FileFormat fileFormat;
+    if (!GetFormatFromPath(path, fileFormat)) return false;
+
+    if (fileFormat == FileFormat::PNG && format == TextureFormat::RGBA8) {
+        return WritePNG(path, width, height, (const unsigned char*)pixels);
+    }
+
+    std::vector<float> rgba = ToFloatRGBA(width, height, format, pixels);
+    switch (fileFormat) {
+    case FileFormat::PNG: {
+        std::vector<unsigned char> bytes(rgba.size());
+        for (size_t i = 0; i < rgba.size(); ++i) bytes[i] = ToByte(rgba[i]);
+        return WritePNG(path, width, height, bytes.data());
+    }
+    case FileFormat::EXR: {
+        const bool fullFloat = (format == TextureFormat::RGBA32F || format == TextureFormat::R32F);
+        return WriteEXR(path, width, height, rgba.data(), !fullFloat);
+    }
+    default:
+        return WritePFM(path, width, height, rgba.data());
+    }
+}
+
+std::vector<unsigned char> EncodePNG(int width, int height, const unsigned char* rgba) {
+    const int bpp = 4;
+    const size_t stride = (size_t)width * bpp;
+
+    // Для каждой строки выбираем фильтр с минимальной суммой модулей (эвристика из спецификации PNG)
+    std::vector<unsigned char> filtered((stride + 1) * height);
+    std::vector<unsigned char> candidate(stride);
+    std::vector<unsigned char> zeroRow(stride, 0);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = rgba + y * stride;
+        const unsigned char* up = y > 0 ? rgba + (y - 1) * stride : zeroRow.data();
+        unsigned char* dst = &filtered[y * (stride + 1)];
+
+        uint64_t bestScore = UINT64_MAX;
+        for (int filter = 0; filter < 5; ++filter) {
+            uint64_t score = 0;
+            for (size_t x = 0; x < stride; ++x) {
+                const int a = x >= bpp ? row[x - bpp] : 0;
+                const int b = up[x];
+                const int c = x >= bpp ? up[x - bpp] : 0;
+                int predicted = 0;
+                switch (filter) {
+                case 1: predicted = a; break;
+                case 2: predicted = b; break;
+                case 3: predicted = (a + b) / 2; break;
+                case 4: predicted = Paeth(a, b, c); break;
+                }
+                const unsigned char value = (unsigned char)(row[x] - predicted);
+                candidate[x] = value;
+                score += value < 128 ? value : 256 - value;
+            }
+            if (score < bestScore) {
+                bestScore = score;
+                dst[0] = (unsigned char)filter;
+                memcpy(dst + 1, candidate.data(), stride);
+            }
+        }
+    }
+
+    std::vector<unsigned char> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    unsigned char header[13] = {
+        (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+        (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+        8, 6, 0, 0, 0 // 8 бит, RGBA, deflate, адаптивные фильтры, без интерлейса
+    };
+    PutChunk(file, "IHDR", header, sizeof(header));
+    const std::vector<unsigned char> compressed = ZlibCompress(filtered);
+    PutChunk(file, "IDAT", compressed.data(), compressed.size());
+    PutChunk(file, "IEND", nullptr, 0);
+    return file;
+}
+
+bool WritePNG(const std::string& path, int width, int height, const unsigned char* rgba) {
+    if (width <= 0 || height <= 0 || !rgba) return false;
+    const std::vector<unsigned char> file = EncodePNG(width, height, rgba);
+    return WriteFile(path, file.data(), file.size());
+}
+
+bool WriteEXR(const std::string& path, int width, int height, const float* rgba, bool halfChannels) {
+    if (width <= 0 || height <= 0 || !rgba) return false;
+
+    std::vector<unsigned char> out = { 0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0 }; // magic + версия 2, scanline файл
+
+    // Каналы в алфавитном порядке, в нем же они лежат в каждой строке
+    const char* channelNames[4] = { "A", "B", "G", "R" };
+    const int channelSource[4] = { 3, 2, 1, 0 };
+    const uint32_t pixelType = halfChannels ? 1 : 2; // HALF : FLOAT
+    const size_t channelBytes = halfChannels ? 2 : 4;
+
+    std::vector<unsigned char> value;
+    for (const char* name : channelNames) {
+        value.insert(value.end(), name, name + strlen(name) + 1);
+        PutInt(value, pixelType);
+        value.insert(value.end(), { 0, 0, 0, 0 }); // pLinear + reserved
+        PutInt(value, 1);
+        PutInt(value, 1);
+    }
+    value.push_back(0);
+    PutAttribute(out, "channels", "chlist", value);
+
+    PutAttribute(out, "compression", "compression", { 0 }); // NO_COMPRESSION
+
+    value.clear();
+    PutInt(value, 0); PutInt(value, 0); PutInt(value, (uint32_t)(width - 1)); PutInt(value, (uint32_t)(height - 1));
+    PutAttribute(out, "dataWindow", "box2i", value);
+    PutAttribute(out, "displayWindow", "box2i", value);
+
+    PutAttribute(out, "lineOrder", "lineOrder", { 0 }); // INCREASING_Y
+
+    value.clear();
+    PutFloat(value, 1.0f);
+    PutAttribute(out, "pixelAspectRatio", "float", value);
+    PutAttribute(out, "screenWindowWidth", "float", value);
+
+    value.clear();
+    PutFloat(value, 0.0f); PutFloat(value, 0.0f);
+    PutAttribute(out, "screenWindowCenter", "v2f", value);
+    out.push_back(0); // конец заголовка
+
+    // Таблица смещений: без сжатия каждая строка - отдельный блок
+    const size_t lineBytes = (size_t)width * 4 * channelBytes;
+    const size_t tableStart = out.size();
+    const size_t firstChunk = tableStart + (size_t)height * 8;
+    for (int y = 0; y < height; ++y) {
+        const uint64_t offset = firstChunk + (uint64_t)y * (8 + lineBytes);
+        for (int i = 0; i < 8; ++i) out.push_back((unsigned char)(offset >> (i * 8)));
+    }
+
+    out.reserve(firstChunk + (size_t)height * (8 + lineBytes));
+    for (int y = 0; y < height; ++y) {
+        PutInt(out, (uint32_t)y);
+        PutInt(out, (uint32_t)lineBytes);
+        for (int c = 0; c < 4; ++c) {
+            for (int x = 0; x < width; ++x) {
+                const float v = rgba[((size_t)y * width + x) * 4 + channelSource[c]];
+                if (halfChannels) {
+                    const uint16_t h = FloatToHalf(v);
+                    out.push_back((unsigned char)h);
+                    out.push_back((unsigned char)(h >> 8));
+                }
+                else {
+                    PutFloat(out, v);
+                }
+            }
+        }
+    }
+    return WriteFile(path, out.data(), out.size());
+}
+
+bool WritePFM(const std::string& path, int width, int height, const float* rgba) {
+    if (width <= 0 || height <= 0 || !rgba) return false;
+
+    // Отрицательный масштаб - little endian; строки идут снизу вверх
+    const std::string header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+    std::vector<float> rgb((size_t)width * height * 3);
+    for (int y = 0; y < height; ++y) {
+        const float* src = rgba + (size_t)(height - 1 - y) * width * 4;
+        float* dst = &rgb[(size_t)y * width * 3];
+        for (int x = 0; x < width; ++x) {
+            dst[x * 3 + 0] = src[x * 4 + 0];
+            dst[x * 3 + 1] = src[x * 4 + 1];
+            dst[x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    file.write(header.data(), (std::streamsize)header.size());
+    file.write((const char*)rgb.data(), (std::streamsize)(rgb.size() * sizeof(float)));
+    return (bool)file;
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "RendeructorDefines.h"
+
+// Minimal image encoders for offline output, no external dependencies.
+// PNG: 8-bit RGBA, adaptive row filters + fixed-Huffman deflate. EXR: uncompressed scanlines, half channels for 8/16-bit
+// sources and float channels for 32-bit ones. PFM: float RGB. Values are written as they are: no tone mapping or sRGB
+// conversion, PNG clamps to [0, 1].
+namespace ImageWriter {
+
+    enum class FileFormat { PNG, EXR, PFM };
+
+    // Picks the encoder from the extension (.png, .exr, .pfm); false for anything else
+    RENDER_API bool GetFormatFromPath(const std::string& path, FileFormat& format);
+
+    // Pixels in any TextureFormat, rows tightly packed; single channel formats are written as grey
+    RENDER_API bool Write(const std::string& path, int width, int height, TextureFormat format, const void* pixels);
+
+    RENDER_API std::vector<unsigned char> EncodePNG(int width, int height, const unsigned char* rgba);
+    RENDER_API bool WritePNG(const std::string& path, int width, int height, const unsigned char* rgba);
+    RENDER_API bool WriteEXR(const std::string& path, int width, int height, const float* rgba, bool halfChannels);
+    RENDER_API bool WritePFM(const std::string& path, int width, int height, const float* rgba);
+}
@@ -0,0 +1,375 @@
+﻿#include "pch.h"
+#include "InstanceCuller.h"
+#include <immintrin.h>
+#include <thread>
+#include <chrono>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC разрешает AVX-интринсики в любой функции, выбор пути делается в рантайме
+#define CULL_TARGET_AVX2
+#else
+#define CULL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+    // Меньше этого на поток - пробуждение рабочих потоков и сдвиг участков дороже самого теста
+    const int kMinInstancesPerThread = 8192;
+
+    bool DetectAVX2() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx) return false;
+
+        // ОС должна сохранять YMM-регистры
+        if ((_xgetbv(0) & 6) != 6) return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    const bool s_hasAVX2 = DetectAVX2();
+
+    inline int CountTrailingZeros(unsigned int mask) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return (int)index;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // Для каждой плоскости заранее выбираем "положительную" вершину AABB: по каждой оси - min или max
+    struct PlaneSelect {
+        float Nx, Ny, Nz, D;
+        const float* X;
+        const float* Y;
+        const float* Z;
+    };
+
+    struct Bounds {
+        const float* MinX; const float* MinY; const float* MinZ;
+        const float* MaxX; const float* MaxY; const float* MaxZ;
+    };
+
+    void SelectPlanes(const Frustum& frustum, const Bounds& b, PlaneSelect* out) {
+        for (int p = 0; p < 6; ++p) {
+            const Math::float4& plane = frustum.Planes[p];
+            out[p].Nx = plane.x; out[p].Ny = plane.y; out[p].Nz = plane.z; out[p].D = plane.w;
+            out[p].X = plane.x >= 0.0f ? b.MaxX : b.MinX;
+            out[p].Y = plane.y >= 0.0f ? b.MaxY : b.MinY;
+            out[p].Z = plane.z >= 0.0f ? b.MaxZ : b.MinZ;
+        }
+    }
+
+    int CullTail(const PlaneSelect* planes, int begin, int end, unsigned int* out) {
+        int n = 0;
+        for (int i = begin; i < end; ++i) {
+            bool visible = true;
+            for (int p = 0; p < 6 && visible; ++p) {
+                float d = planes[p].Nx * planes[p].X[i] + planes[p].Ny * planes[p].Y[i] + planes[p].Nz * planes[p].Z[i] + planes[p].D;
+                visible = d >= 0.0f;
+            }
+            if (visible) out[n++] = (unsigned int)i;
+        }
+        return n;
+    }
+
+    int CullRangeSSE(const PlaneSelect* planes, int begin, int end, unsigned int* out) {
+        int n = 0;
+        int i = begin;
+        const __m128 zero = _mm_setzero_ps();
+
+        for (; i + 4 <= end; i += 4) {
+            __m128 visible = _mm_cmpeq_ps(zero, zero);
+            for (int p = 0; p < 6; ++p) {
+                __m128 d = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].Nx), _mm_loadu_ps(planes[p].X + i)),
+                               _mm_mul_ps(_mm_set1_ps(planes[p].Ny), _mm_loadu_ps(planes[p].Y + i))),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].Nz), _mm_loadu_ps(planes[p].Z + i)),
+                               _mm_set1_ps(planes[p].D)));
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(d, zero));
+            }
+
+            unsigned int mask = (unsigned int)_mm_movemask_ps(visible);
+            while (mask) {
+                out[n++] = (unsigned int)(i + CountTrailingZeros(mask));
+                mask &= mask - 1;
+            }
+        }
+
+        return n + CullTail(planes, i, end, out + n);
+    }
+
+    CULL_TARGET_AVX2 int CullRangeAVX2(const PlaneSelect* planes, int begin, int end, unsigned int* out) {
+        int n = 0;
+        int i = begin;
+        const __m256 zero = _mm256_setzero_ps();
+
+        for (; i + 8 <= end; i += 8) {
+            __m256 visible = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+            for (int p = 0; p < 6; ++p) {
+                __m256 d = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].Nx), _mm256_loadu_ps(planes[p].X + i)),
+                                  _mm256_mul_ps(_mm256_set1_ps(planes[p].Ny), _mm256_loadu_ps(planes[p].Y + i))),
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].Nz), _mm256_loadu_ps(planes[p].Z + i)),
+                                  _mm256_set1_ps(planes[p].D)));
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+            }
+
+            unsigned int mask = (unsigned int)_mm256_movemask_ps(visible);
+            while (mask) {
+                out[n++] = (unsigned int)(i + CountTrailingZeros(mask));
+                mask &= mask - 1;
+            }
+        }
+
+        return n + CullTail(planes, i, end, out + n);
+    }
+}
+
+void InstanceCuller::Build(const InstanceBuffer& instances, const Mesh& mesh) {
+    m_count = instances.GetCount();
+    m_stride = instances.GetStride();
+    m_mesh = &mesh;
+
+    const unsigned char* data = instances.GetCPUData();
+    const int offset = std::max(instances.GetTransformOffset(), 0);
+    m_offset = offset;
+    if (!data && m_count > 0) {
+        std::cerr << "[InstanceCuller] Build: no CPU data, call SetKeepCPUData(true) before creating the instances" << std::endl;
+    }
+    if (!data || m_count <= 0 || offset + (int)sizeof(Math::float4x4) > m_stride) {
+        m_count = 0;
+        return;
+    }
+
+    m_records.assign(data, data + (size_t)m_count * m_stride);
+
+    m_minX.resize(m_count); m_minY.resize(m_count); m_minZ.resize(m_count);
+    m_maxX.resize(m_count); m_maxY.resize(m_count); m_maxZ.resize(m_count);
+
+    // AABB в мировом пространстве: центр переносим матрицей, полуразмеры - модулем ее 3x3 части (Arvo)
+    const Math::float3 center = mesh.GetBoundsCenter();
+    const Math::float3 extent = (mesh.GetBoundsMax() - mesh.GetBoundsMin()) * 0.5f;
+
+    for (int i = 0; i < m_count; ++i) {
+        Math::float4x4 world;
+        memcpy(&world, m_records.data() + (size_t)i * m_stride + offset, sizeof(Math::float4x4));
+
+        Math::float3 c = world.transform_point(center);
+        Math::float4 r0 = world.row0(), r1 = world.row1(), r2 = world.row2();
+        Math::float3 e(
+            std::abs(r0.x) * extent.x + std::abs(r1.x) * extent.y + std::abs(r2.x) * extent.z,
+            std::abs(r0.y) * extent.x + std::abs(r1.y) * extent.y + std::abs(r2.y) * extent.z,
+            std::abs(r0.z) * extent.x + std::abs(r1.z) * extent.y + std::abs(r2.z) * extent.z);
+
+        m_minX[i] = c.x - e.x; m_minY[i] = c.y - e.y; m_minZ[i] = c.z - e.z;
+        m_maxX[i] = c.x + e.x; m_maxY[i] = c.y + e.y; m_maxZ[i] = c.z + e.z;
+    }
+}
+
+InstanceCuller::~InstanceCuller() {
+    StopWorkers();
+}
+
+void InstanceCuller::StartWorkers(int count) {
+    StopWorkers();
+    m_stopping = false;
+    for (int i = 1; i <= count; ++i) {
+        m_workers.emplace_back(&InstanceCuller::WorkerLoop, this, i, m_jobGeneration);
+    }
+}
+
+void InstanceCuller::StopWorkers() {
+    if (m_workers.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_workerMutex);
+        m_stopping = true;
+    }
+    m_workReady.notify_all();
+    for (auto& worker : m_workers) worker.join();
+    m_workers.clear();
+}
+
+void InstanceCuller::WorkerLoop(int index, unsigned long long seen) {
+    for (;;) {
+        const std::function<void(int)>* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_workerMutex);
+            m_workReady.wait(lock, [&] { return m_stopping || m_jobGeneration != seen; });
+            if (m_stopping) return;
+            seen = m_jobGeneration;
+            // Потоки сверх нужного для этого вызова просто пропускают поколение
+            if (index >= m_jobThreads) continue;
+            job = m_job;
+        }
+
+        (*job)(index);
+
+        std::lock_guard<std::mutex> lock(m_workerMutex);
+        if (--m_jobsPending == 0) m_workDone.notify_one();
+    }
+}
+
+void InstanceCuller::RunParallel(int threads, const std::function<void(int)>& job) {
+    // Пул растет до максимума, который просили; меньшие вызовы используют его часть
+    if ((int)m_workers.size() < threads - 1) StartWorkers(threads - 1);
+
+    {
+        std::lock_guard<std::mutex> lock(m_workerMutex);
+        m_job = &job;
+        m_jobThreads = threads;
+        m_jobsPending = threads - 1;
+        m_jobGeneration++;
+    }
+    m_workReady.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(m_workerMutex);
+    m_workDone.wait(lock, [this] { return m_jobsPending == 0; });
+    m_job = nullptr;
+}
+
+InstanceCullStats InstanceCuller::Run(const Frustum& frustum, const OcclusionCuller* occlusion, const LODCamera* lodCamera, bool compact) {
+    InstanceCullStats stats;
+    stats.Total = m_count;
+    stats.AVX2 = s_hasAVX2;
+    m_lodCounts.clear();
+    if (m_count == 0) return stats;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    Bounds bounds = { m_minX.data(), m_minY.data(), m_minZ.data(), m_maxX.data(), m_maxY.data(), m_maxZ.data() };
+    PlaneSelect planes[6];
+    SelectPlanes(frustum, bounds, planes);
+
+    int threads = m_threadCount > 0 ? m_threadCount : (int)std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, m_count / kMinInstancesPerThread));
+    stats.Threads = threads;
+
+    // Каждый поток пишет индексы в свой участок (не больше своей доли), потом участки сдвигаются подряд
+    m_visible.resize(m_count);
+    std::vector<int> counts(threads, 0);
+    std::vector<int> occluded(threads, 0);
+    const int chunk = ((m_count + threads - 1) / threads + 7) & ~7;
+
+    auto work = [&](int t) {
+        int begin = t * chunk;
+        int end = std::min(m_count, begin + chunk);
+        if (begin >= end) return;
+        unsigned int* out = m_visible.data() + begin;
+        int count = s_hasAVX2 ? CullRangeAVX2(planes, begin, end, out) : CullRangeSSE(planes, begin, end, out);
+
+        // Тест перекрытия дороже - только для прошедших фрустум
+        if (occlusion) {
+            int kept = 0;
+            for (int k = 0; k < count; ++k) {
+                unsigned int i = out[k];
+                if (occlusion->IsVisible({ m_minX[i], m_minY[i], m_minZ[i] }, { m_maxX[i], m_maxY[i], m_maxZ[i] })) out[kept++] = i;
+            }
+            occluded[t] = count - kept;
+            count = kept;
+        }
+        counts[t] = count;
+    };
+
+    if (threads == 1) work(0);
+    else RunParallel(threads, work);
+
+    int visible = counts[0];
+    for (int t = 1; t < threads; ++t) {
+        if (counts[t] == 0) continue;
+        memmove(m_visible.data() + visible, m_visible.data() + t * chunk, counts[t] * sizeof(unsigned int));
+        visible += counts[t];
+    }
+    m_visible.resize(visible);
+    stats.Visible = visible;
+    for (int t = 0; t < threads; ++t) stats.Occluded += occluded[t];
+
+    if (compact && lodCamera && lodCamera->Enabled && m_mesh && m_mesh->GetLODCount() > 1) {
+        // Уровень для каждого видимого, затем сортировка подсчетом прямо при уплотнении - каждый уровень идет подряд
+        const int lodCount = m_mesh->GetLODCount();
+        m_lodCounts.assign(lodCount, 0);
+        m_levels.resize(visible);
+        for (int i = 0; i < visible; ++i) {
+            Math::float4x4 world;
+            memcpy(&world, m_records.data() + (size_t)m_visible[i] * m_stride + m_offset, sizeof(Math::float4x4));
+            m_levels[i] = m_mesh->SelectLOD(*lodCamera, world);
+            m_lodCounts[m_levels[i]]++;
+        }
+
+        std::vector<int> cursor(lodCount, 0);
+        for (int l = 1; l < lodCount; ++l) cursor[l] = cursor[l - 1] + m_lodCounts[l - 1];
+
+        m_compacted.resize((size_t)visible * m_stride);
+        for (int i = 0; i < visible; ++i) {
+            memcpy(m_compacted.data() + (size_t)cursor[m_levels[i]]++ * m_stride,
+                   m_records.data() + (size_t)m_visible[i] * m_stride, m_stride);
+        }
+    }
+    else if (compact) {
+        m_compacted.resize((size_t)visible * m_stride);
+        for (int i = 0; i < visible; ++i) {
+            memcpy(m_compacted.data() + (size_t)i * m_stride, m_records.data() + (size_t)m_visible[i] * m_stride, m_stride);
+        }
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.Milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    return stats;
+}
+
+void InstanceCuller::Upload(int visible, InstanceBuffer& visibleOut) {
+    // Выход переписывается каждый кадр - динамический буфер на весь набор, чтобы не пересоздавать
+    if (!visibleOut.IsDynamic() || visibleOut.GetStride() != m_stride || visibleOut.GetCapacity() < visible) {
+        visibleOut.CreateDynamic(nullptr, std::max(m_count, 1), m_stride);
+    }
+    visibleOut.Update(m_compacted.data(), visible);
+    // Update сбрасывает прежнюю разбивку; новая есть только если уровни выбирались
+    if (!m_lodCounts.empty()) visibleOut.SetLODRanges(m_mesh, m_lodCounts);
+}
+
+InstanceCullStats InstanceCuller::Cull(const Frustum& frustum, InstanceBuffer& visibleOut) {
+    InstanceCullStats stats = Run(frustum, nullptr, nullptr, true);
+    Upload(stats.Visible, visibleOut);
+    return stats;
+}
+
+InstanceCullStats InstanceCuller::Cull(const Frustum& frustum, const OcclusionCuller& occlusion, InstanceBuffer& visibleOut) {
+    InstanceCullStats stats = Run(frustum, &occlusion, nullptr, true);
+    Upload(stats.Visible, visibleOut);
+    return stats;
+}
+
+InstanceCullStats InstanceCuller::Cull(const Frustum& frustum, const LODCamera& lodCamera, InstanceBuffer& visibleOut) {
+    InstanceCullStats stats = Run(frustum, nullptr, &lodCamera, true);
+    Upload(stats.Visible, visibleOut);
+    return stats;
+}
+
+InstanceCullStats InstanceCuller::Cull(const Frustum& frustum, const OcclusionCuller& occlusion, const LODCamera& lodCamera,
+                                       InstanceBuffer& visibleOut) {
+    InstanceCullStats stats = Run(frustum, &occlusion, &lodCamera, true);
+    Upload(stats.Visible, visibleOut);
+    return stats;
+}
+
+InstanceCullStats InstanceCuller::Cull(const Frustum& frustum, std::vector<unsigned int>& visibleIndices, const OcclusionCuller* occlusion) {
+    InstanceCullStats stats = Run(frustum, occlusion, nullptr, false);
+    visibleIndices = m_visible;
+    return stats;
+}
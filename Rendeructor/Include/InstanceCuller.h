@@ -0,0 +1,90 @@
+#pragma once
+#include "RendeructorDefines.h"
+#include "OcclusionCuller.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+struct InstanceCullStats {
+    int Total = 0;
+    int Visible = 0;
+    int Occluded = 0; // passed the frustum test but hidden behind occluders
+    int Threads = 0;
+    bool AVX2 = false;
+    double Milliseconds = 0.0;
+
+    double InstancesPerMillisecond() const { return Milliseconds > 0.0 ? Total / Milliseconds : 0.0; }
+};
+
+// Frustum culling of instances on the CPU.
+// World-space AABBs live in SoA arrays and are tested 8 (AVX2, picked at runtime) or 4 (SSE) at a time, split across
+// threads for large sets. Visible instance records are compacted and uploaded, so every view draws only what it sees.
+// The worker threads are started on the first multithreaded Cull and sleep between calls; they are joined on destruction.
+class RENDER_API InstanceCuller {
+public:
+    InstanceCuller() = default;
+    ~InstanceCuller();
+    InstanceCuller(const InstanceCuller&) = delete;
+    InstanceCuller& operator=(const InstanceCuller&) = delete;
+
+    // Computes world AABBs from the mesh bounds and the float4x4 world matrix of every instance
+    // (at instances.GetTransformOffset(), or at the start of the record if no offset is set).
+    // The mesh is kept for LOD selection and must outlive the culls that use it.
+    void Build(const InstanceBuffer& instances, const Mesh& mesh);
+
+    // threads <= 0 - all hardware threads (only used when the set is large enough to pay for them)
+    void SetThreadCount(int threads) { m_threadCount = threads; }
+
+    // Writes the visible instances into visibleOut (created/grown as needed) and returns the timing of the test
+    InstanceCullStats Cull(const Frustum& frustum, InstanceBuffer& visibleOut);
+    // Additionally drops instances hidden behind the occluders rasterized into occlusion (after its End())
+    InstanceCullStats Cull(const Frustum& frustum, const OcclusionCuller& occlusion, InstanceBuffer& visibleOut);
+    // The visible instances are also grouped by the LOD lodCamera picks for them while being compacted, and the ranges
+    // are recorded in visibleOut (InstanceBuffer::SetLODRanges), so DrawMeshInstanced needs no second pass over them
+    InstanceCullStats Cull(const Frustum& frustum, const LODCamera& lodCamera, InstanceBuffer& visibleOut);
+    InstanceCullStats Cull(const Frustum& frustum, const OcclusionCuller& occlusion, const LODCamera& lodCamera,
+                           InstanceBuffer& visibleOut);
+    // Same test without the upload: indices of the visible instances
+    InstanceCullStats Cull(const Frustum& frustum, std::vector<unsigned int>& visibleIndices,
+                           const OcclusionCuller* occlusion = nullptr);
+
+    int GetCount() const { return m_count; }
+
+private:
+    InstanceCullStats Run(const Frustum& frustum, const OcclusionCuller* occlusion, const LODCamera* lodCamera, bool compact);
+    void Upload(int visible, InstanceBuffer& visibleOut);
+
+    // Runs job(0..threads-1): job 0 on the calling thread, the rest on the workers, and waits for all of them
+    void RunParallel(int threads, const std::function<void(int)>& job);
+    void StartWorkers(int count);
+    void StopWorkers();
+    // seen - the job generation at start, so a worker added to a grown pool does not pick up a finished job
+    void WorkerLoop(int index, unsigned long long seen);
+
+    int m_count = 0;
+    int m_stride = 0;
+    int m_offset = 0;
+    int m_threadCount = 0;
+    const Mesh* m_mesh = nullptr;
+
+    // SoA world-space bounds
+    std::vector<float> m_minX, m_minY, m_minZ;
+    std::vector<float> m_maxX, m_maxY, m_maxZ;
+
+    std::vector<unsigned char> m_records;   // copy of the source instance data
+    std::vector<unsigned int> m_visible;    // per-thread regions, then compacted
+    std::vector<unsigned char> m_compacted; // visible records, ready for upload
+    std::vector<int> m_levels;              // LOD of every visible instance
+    std::vector<int> m_lodCounts;           // visible instances per LOD, empty without a LOD camera
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_workerMutex;
+    std::condition_variable m_workReady;
+    std::condition_variable m_workDone;
+    const std::function<void(int)>* m_job = nullptr;
+    unsigned long long m_jobGeneration = 0;
+    int m_jobThreads = 0;
+    int m_jobsPending = 0;
+    bool m_stopping = false;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include "framework.h"
+
+// Read-only memory mapped file (Win32 file mapping).
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path) {
+        Close();
+
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size = {};
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+            Close();
+            return false;
+        }
+        m_size = (size_t)size.QuadPart;
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping) {
+            Close();
+            return false;
+        }
+
+        m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!m_data) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+        m_data = nullptr;
+        m_mapping = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+        m_size = 0;
+    }
+
+    const char* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+    bool IsOpen() const { return m_data != nullptr; }
+
+private:
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+};
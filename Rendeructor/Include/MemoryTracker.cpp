@@ -0,0 +1,173 @@
+﻿#include "pch.h"
+#include "MemoryTracker.h"
+
+const char* GetMemoryCategoryName(MemoryCategory category) {
+    switch (category) {
+    case MemoryCategory::Texture: return "Texture";
+    case MemoryCategory::DepthTexture: return "DepthTexture";
+    case MemoryCategory::AutoDepth: return "AutoDepth";
+    case MemoryCategory::Framebuffer: return "Framebuffer";
+    case MemoryCategory::VertexBuffer: return "VertexBuffer";
+    case MemoryCategory::IndexBuffer: return "IndexBuffer";
+    case MemoryCategory::InstanceBuffer: return "InstanceBuffer";
+    case MemoryCategory::ConstantBuffer: return "ConstantBuffer";
+    case MemoryCategory::StructuredBuffer: return "StructuredBuffer";
+    case MemoryCategory::ComputeBuffer: return "ComputeBuffer";
+    case MemoryCategory::UploadRing: return "UploadRing";
+    case MemoryCategory::Readback: return "Readback";
+    default: return "Unknown";
+    }
+}
+
+size_t MemoryTracker::GetTextureBytes(TextureFormat format, int width, int height, int depth) {
+    size_t bytesPerPixel = 4;
+    switch (format) {
+    case TextureFormat::R8: bytesPerPixel = 1; break;
+    case TextureFormat::R16F: bytesPerPixel = 2; break;
+    case TextureFormat::RGBA16F: bytesPerPixel = 8; break;
+    case TextureFormat::RGBA32F: bytesPerPixel = 16; break;
+    default: bytesPerPixel = 4; break;
+    }
+    return (size_t)std::max(width, 0) * (size_t)std::max(height, 0) * (size_t)std::max(depth, 0) * bytesPerPixel;
+}
+
+void MemoryTracker::Track(const void* key, MemoryCategory category, size_t bytes) {
+    Entry entry;
+    entry.Category = category;
+    entry.Bytes = bytes;
+    Add(key, entry);
+}
+
+void MemoryTracker::TrackTexture(const void* key, size_t bytes, TextureFormat format, TextureType type) {
+    Entry entry;
+    entry.Category = MemoryCategory::Texture;
+    entry.Bytes = bytes;
+    entry.Format = (int)format;
+    entry.Type = (int)type;
+    Add(key, entry);
+}
+
+void MemoryTracker::Add(const void* key, const Entry& entry) {
+    if (!key) return;
+
+    MemoryBudgetEvent event;
+    MemoryBudgetCallback notifier;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Тот же ключ - ресурс пересоздан на месте, старый размер больше не считается
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            Remove(it->second);
+            m_entries.erase(it);
+        }
+
+        const size_t before = m_stats.TotalBytes;
+        m_entries[key] = entry;
+
+        MemoryCategoryStats& category = m_stats.Categories[(int)entry.Category];
+        category.Bytes += entry.Bytes;
+        category.Resources++;
+        category.PeakBytes = std::max(category.PeakBytes, category.Bytes);
+        if (entry.Format >= 0 && entry.Format < MemoryTextureFormatCount) m_stats.TextureFormatBytes[entry.Format] += entry.Bytes;
+        if (entry.Type >= 0 && entry.Type < MemoryTextureTypeCount) m_stats.TextureTypeBytes[entry.Type] += entry.Bytes;
+
+        m_stats.TotalBytes += entry.Bytes;
+        m_stats.Resources++;
+        m_stats.PeakBytes = std::max(m_stats.PeakBytes, m_stats.TotalBytes);
+
+        const size_t budget = m_stats.BudgetBytes;
+        if (budget == 0 || m_stats.TotalBytes <= budget) return;
+        m_stats.OverBudgetAllocations++;
+
+        // Сообщаем только о переходе через бюджет, а не о каждом следующем ресурсе сверх него
+        if (before > budget) return;
+        event.Category = entry.Category;
+        event.AllocationBytes = entry.Bytes;
+        event.TotalBytes = m_stats.TotalBytes;
+        event.BudgetBytes = budget;
+        notifier = m_notifier;
+    }
+
+    if (notifier) notifier(event);
+    else NotifyBudgetCallbacks(event);
+}
+
+void MemoryTracker::NotifyBudgetCallbacks(const MemoryBudgetEvent& event) {
+    std::vector<MemoryBudgetCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& callback : m_callbacks) callbacks.push_back(callback.second);
+    }
+    // Без блокировки: колбэк обычно освобождает ресурсы, а это снова вызовы трекера
+    for (const auto& callback : callbacks) callback(event);
+}
+
+void MemoryTracker::SetBudgetNotifier(MemoryBudgetCallback notifier) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_notifier = std::move(notifier);
+}
+
+void MemoryTracker::Remove(const Entry& entry) {
+    MemoryCategoryStats& category = m_stats.Categories[(int)entry.Category];
+    category.Bytes -= entry.Bytes;
+    category.Resources--;
+    if (entry.Format >= 0 && entry.Format < MemoryTextureFormatCount) m_stats.TextureFormatBytes[entry.Format] -= entry.Bytes;
+    if (entry.Type >= 0 && entry.Type < MemoryTextureTypeCount) m_stats.TextureTypeBytes[entry.Type] -= entry.Bytes;
+    m_stats.TotalBytes -= entry.Bytes;
+    m_stats.Resources--;
+}
+
+void MemoryTracker::Untrack(const void* key) {
+    if (!key) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) return;
+    Remove(it->second);
+    m_entries.erase(it);
+}
+
+void MemoryTracker::Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+
+    MemoryStats cleared;
+    cleared.PeakBytes = m_stats.PeakBytes;
+    cleared.BudgetBytes = m_stats.BudgetBytes;
+    cleared.OverBudgetAllocations = m_stats.OverBudgetAllocations;
+    for (int i = 0; i < MemoryCategoryCount; ++i) cleared.Categories[i].PeakBytes = m_stats.Categories[i].PeakBytes;
+    m_stats = cleared;
+}
+
+void MemoryTracker::SetBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.BudgetBytes = bytes;
+}
+
+size_t MemoryTracker::GetBudget() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats.BudgetBytes;
+}
+
+int MemoryTracker::AddBudgetCallback(MemoryBudgetCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const int id = m_nextCallbackId++;
+    m_callbacks.emplace_back(id, std::move(callback));
+    return id;
+}
+
+void MemoryTracker::RemoveBudgetCallback(int id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_callbacks.erase(std::remove_if(m_callbacks.begin(), m_callbacks.end(),
+        [id](const auto& callback) { return callback.first == id; }), m_callbacks.end());
+}
+
+MemoryStats MemoryTracker::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+size_t MemoryTracker::GetTotalBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats.TotalBytes;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "RendeructorDefines.h"
+#include <mutex>
+#include <unordered_map>
+
+enum class MemoryCategory {
+    Texture,          // colour textures of all dimensions (render targets and storage textures included)
+    DepthTexture,     // DepthTexture resources
+    AutoDepth,        // cached automatic depth buffers of off-screen targets
+    Framebuffer,      // back buffer and the window's depth buffer
+    VertexBuffer,     // mesh vertices, GeometryArena pages included
+    IndexBuffer,
+    InstanceBuffer,
+    ConstantBuffer,   // constant buffers reflected from shaders
+    StructuredBuffer,
+    ComputeBuffer,
+    UploadRing,       // CPU-writable staging rings of dynamic buffers
+    Readback,         // staging textures of asynchronous readbacks
+    Count
+};
+
+constexpr int MemoryCategoryCount = (int)MemoryCategory::Count;
+constexpr int MemoryTextureFormatCount = (int)TextureFormat::R32F + 1;
+constexpr int MemoryTextureTypeCount = (int)TextureType::TexCube + 1;
+
+RENDER_API const char* GetMemoryCategoryName(MemoryCategory category);
+
+struct MemoryCategoryStats {
+    size_t Bytes = 0;
+    size_t PeakBytes = 0;
+    int Resources = 0;
+};
+
+struct MemoryStats {
+    size_t TotalBytes = 0;
+    size_t PeakBytes = 0;             // high-water mark since the renderer was created
+    size_t BudgetBytes = 0;           // 0: no budget
+    int Resources = 0;
+    unsigned long long OverBudgetAllocations = 0; // allocations that ended above the budget
+    MemoryCategoryStats Categories[MemoryCategoryCount];
+    // Colour textures only (MemoryCategory::Texture), by TextureFormat and by TextureType
+    size_t TextureFormatBytes[MemoryTextureFormatCount] = {};
+    size_t TextureTypeBytes[MemoryTextureTypeCount] = {};
+
+    const MemoryCategoryStats& Get(MemoryCategory category) const { return Categories[(int)category]; }
+};
+
+struct MemoryBudgetEvent {
+    MemoryCategory Category = MemoryCategory::Texture; // of the allocation that crossed the budget
+    size_t AllocationBytes = 0;
+    size_t TotalBytes = 0;
+    size_t BudgetBytes = 0;
+};
+
+using MemoryBudgetCallback = std::function<void(const MemoryBudgetEvent&)>;
+
+// Central account of the backend's GPU allocations (and their CPU-visible staging copies).
+// The backend reports every resource it creates with its byte size and drops it again on release; sizes are the
+// nominal texel/element bytes, the driver's padding and alignment are not known. Callbacks run when an allocation
+// takes the total from within the budget to above it, so they can release memory before a creation actually fails.
+// Thread safe; the callbacks are called without the lock held, on the thread that made the allocation unless a budget
+// notifier hands the event to another thread first (Rendeructor delivers them on its render thread).
+class RENDER_API MemoryTracker {
+public:
+    MemoryTracker() = default;
+    MemoryTracker(const MemoryTracker&) = delete;
+    MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+    void Track(const void* key, MemoryCategory category, size_t bytes);
+    void TrackTexture(const void* key, size_t bytes, TextureFormat format, TextureType type);
+    // Unknown keys are ignored
+    void Untrack(const void* key);
+    // Forgets all resources (backend shutdown); budget, callbacks and the peak stay
+    void Clear();
+
+    void SetBudget(size_t bytes);
+    size_t GetBudget() const;
+    // Returns an id for RemoveBudgetCallback
+    int AddBudgetCallback(MemoryBudgetCallback callback);
+    void RemoveBudgetCallback(int id);
+    // Receives budget events instead of the callbacks; it is expected to call NotifyBudgetCallbacks later, on a thread of
+    // its choice. nullptr: the callbacks run directly
+    void SetBudgetNotifier(MemoryBudgetCallback notifier);
+    // Calls the callbacks registered at the time of the call
+    void NotifyBudgetCallbacks(const MemoryBudgetEvent& event);
+
+    MemoryStats GetStats() const;
+    size_t GetTotalBytes() const;
+
+    static size_t GetTextureBytes(TextureFormat format, int width, int height, int depth = 1);
+
+private:
+    struct Entry {
+        MemoryCategory Category = MemoryCategory::Texture;
+        size_t Bytes = 0;
+        int Format = -1; // TextureFormat for colour textures
+        int Type = -1;   // TextureType for colour textures
+    };
+
+    void Add(const void* key, const Entry& entry);
+    void Remove(const Entry& entry);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<const void*, Entry> m_entries;
+    MemoryStats m_stats;
+    std::vector<std::pair<int, MemoryBudgetCallback>> m_callbacks;
+    MemoryBudgetCallback m_notifier;
+    int m_nextCallbackId = 1;
+};
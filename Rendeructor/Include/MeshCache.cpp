@@ -0,0 +1,257 @@
+﻿#include "pch.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "Rendeructor.h"
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <iostream>
+
+namespace MeshCache {
+
+namespace {
+
+    static_assert(sizeof(Header) == 112, "rmesh header layout changed - bump kVersion");
+
+    uint64_t AlignUp(uint64_t value) {
+        return (value + 15) & ~uint64_t(15);
+    }
+
+    bool GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time) {
+        std::error_code ec;
+        size = (uint64_t)std::filesystem::file_size(sourcePath, ec);
+        if (ec) return false;
+
+        auto writeTime = std::filesystem::last_write_time(sourcePath, ec);
+        if (ec) return false;
+
+        time = (int64_t)writeTime.time_since_epoch().count();
+        return true;
+    }
+
+    void WritePadding(std::ofstream& file, uint64_t from, uint64_t to) {
+        static const char zeros[16] = {};
+        if (to > from) file.write(zeros, (std::streamsize)(to - from));
+    }
+
+    // count элементов по elementSize байт с offset целиком внутри файла. Без сложений, которые могут переполниться
+    bool FitsInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize) {
+        if (offset > fileSize) return false;
+        return count <= (fileSize - offset) / elementSize;
+    }
+
+    bool Fail(std::string* error, const char* reason) {
+        if (error) *error = reason;
+        return false;
+    }
+
+    unsigned int MaxIndex(const unsigned int* indices, uint64_t count) {
+        unsigned int maxIndex = 0;
+        for (uint64_t i = 0; i < count; ++i) maxIndex = std::max(maxIndex, indices[i]);
+        return maxIndex;
+    }
+}
+
+std::string GetCachePath(const std::string& sourcePath) {
+    return sourcePath + ".rmesh";
+}
+
+bool Write(const std::string& cachePath, const std::string& sourcePath,
+           const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+           const Math::float3& boundsMin, const Math::float3& boundsMax, bool normalsFromFile,
+           const std::vector<SubMeshRecord>& subMeshes, const std::vector<std::string>& materialNames) {
+    Header header = {};
+    header.Magic = kMagic;
+    header.Version = kVersion;
+    if (!GetSourceStamp(sourcePath, header.SourceSize, header.SourceTime)) return false;
+
+    header.VertexFormat = VertexFormat_PosNormTanBitanUV;
+    header.VertexStride = sizeof(Vertex);
+    header.IndexFormat = IndexFormat_R32;
+    header.SubMeshCount = (uint32_t)subMeshes.size();
+    header.VertexCount = vertices.size();
+    header.IndexCount = indices.size();
+
+    header.BoundsMin[0] = boundsMin.x; header.BoundsMin[1] = boundsMin.y; header.BoundsMin[2] = boundsMin.z;
+    header.BoundsMax[0] = boundsMax.x; header.BoundsMax[1] = boundsMax.y; header.BoundsMax[2] = boundsMax.z;
+    header.Flags = normalsFromFile ? (uint32_t)Flag_NormalsFromFile : 0u;
+
+    const uint64_t vbBytes = vertices.size() * sizeof(Vertex);
+    const uint64_t ibBytes = indices.size() * sizeof(unsigned int);
+    const uint64_t smBytes = subMeshes.size() * sizeof(SubMeshRecord);
+
+    header.VertexOffset = AlignUp(sizeof(Header));
+    header.IndexOffset = AlignUp(header.VertexOffset + vbBytes);
+    header.SubMeshOffset = AlignUp(header.IndexOffset + ibBytes);
+
+    std::string names;
+    for (const std::string& name : materialNames) {
+        names += name;
+        names += '\0';
+    }
+    header.MaterialNameBytes = (uint32_t)names.size();
+    const uint64_t namesOffset = AlignUp(header.SubMeshOffset + smBytes);
+
+    // Пишем во временный файл и только потом переименовываем - оборванная запись не оставит битый кэш
+    const std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+
+        file.write((const char*)&header, sizeof(header));
+        WritePadding(file, sizeof(Header), header.VertexOffset);
+
+        file.write((const char*)vertices.data(), (std::streamsize)vbBytes);
+        WritePadding(file, header.VertexOffset + vbBytes, header.IndexOffset);
+
+        file.write((const char*)indices.data(), (std::streamsize)ibBytes);
+        WritePadding(file, header.IndexOffset + ibBytes, header.SubMeshOffset);
+
+        if (smBytes) file.write((const char*)subMeshes.data(), (std::streamsize)smBytes);
+        if (!names.empty()) {
+            WritePadding(file, header.SubMeshOffset + smBytes, namesOffset);
+            file.write(names.data(), (std::streamsize)names.size());
+        }
+
+        if (!file) {
+            file.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Validate(const char* data, size_t size, std::string* error) {
+    if (!data || size < sizeof(Header)) return Fail(error, "file is smaller than the header");
+
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+
+    if (header.Magic != kMagic || header.Version != kVersion) return Fail(error, "foreign file or another version");
+    if (header.VertexFormat != VertexFormat_PosNormTanBitanUV || header.VertexStride != sizeof(Vertex)) return Fail(error, "unknown vertex layout");
+    if (header.IndexFormat != IndexFormat_R32) return Fail(error, "unknown index format");
+    if (header.VertexCount == 0 || header.IndexCount == 0) return Fail(error, "empty mesh");
+    // Mesh хранит счетчики в int, индексы 32-битные
+    if (header.VertexCount > 0x7FFFFFFFull || header.IndexCount > 0x7FFFFFFFull) return Fail(error, "mesh is too large");
+    if (header.IndexCount % 3 != 0) return Fail(error, "index count is not a multiple of 3");
+
+    // Блоки выровнены при записи - невыровненное смещение значит мусор в заголовке
+    if ((header.VertexOffset | header.IndexOffset | header.SubMeshOffset) & 15) return Fail(error, "misaligned block offset");
+    if (header.VertexOffset < sizeof(Header)) return Fail(error, "vertex block overlaps the header");
+
+    const uint64_t fileSize = size;
+    if (!FitsInFile(header.VertexOffset, header.VertexCount, sizeof(Vertex), fileSize) ||
+        !FitsInFile(header.IndexOffset, header.IndexCount, sizeof(unsigned int), fileSize) ||
+        !FitsInFile(header.SubMeshOffset, header.SubMeshCount, sizeof(SubMeshRecord), fileSize)) {
+        return Fail(error, "truncated file");
+    }
+    if (header.MaterialNameBytes) {
+        const uint64_t namesOffset = AlignUp(header.SubMeshOffset + (uint64_t)header.SubMeshCount * sizeof(SubMeshRecord));
+        if (!FitsInFile(namesOffset, header.MaterialNameBytes, 1, fileSize)) return Fail(error, "truncated material names");
+    }
+
+    // Индекс за пределами VB уведет GenerateLODs / BuildOccluder (и саму отрисовку) за границы массива вершин
+    const unsigned int* indices = (const unsigned int*)(data + header.IndexOffset);
+    if (MaxIndex(indices, header.IndexCount) >= header.VertexCount) return Fail(error, "index out of range");
+
+    for (uint32_t i = 0; i < header.SubMeshCount; ++i) {
+        SubMeshRecord record;
+        memcpy(&record, data + header.SubMeshOffset + (uint64_t)i * sizeof(SubMeshRecord), sizeof(record));
+
+        if (record.IndexCount == 0 || record.StartIndex > header.IndexCount ||
+            record.IndexCount > header.IndexCount - record.StartIndex) {
+            return Fail(error, "sub-mesh range outside of the index buffer");
+        }
+        if (record.BaseVertex < 0 || (uint64_t)record.BaseVertex >= header.VertexCount ||
+            (uint64_t)MaxIndex(indices + record.StartIndex, record.IndexCount) + (uint64_t)record.BaseVertex >= header.VertexCount) {
+            return Fail(error, "sub-mesh base vertex out of range");
+        }
+    }
+    return true;
+}
+
+bool Load(const std::string& cachePath, const std::string& sourcePath, Mesh& outMesh, CacheStats* stats) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    MappedFile file;
+    if (!file.Open(cachePath)) return false;
+    if (file.GetSize() < sizeof(Header)) return false;
+
+    Header header;
+    memcpy(&header, file.GetData(), sizeof(Header));
+    if (header.Magic != kMagic || header.Version != kVersion) return false;
+
+    // Исходник поменялся - кэш устарел. Если исходника нет совсем, доверяем кэшу
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (GetSourceStamp(sourcePath, sourceSize, sourceTime)) {
+        if (sourceSize != header.SourceSize || sourceTime != header.SourceTime) return false;
+    }
+
+    // Битый кэш не грузим: вызывающий разберет исходник заново и перезапишет его
+    std::string error;
+    if (!Validate(file.GetData(), file.GetSize(), &error)) {
+        std::cerr << "[MeshCache] Corrupt cache file " << cachePath << ": " << error << std::endl;
+        return false;
+    }
+
+    // Без бэкенда сетка осталась бы пустой, а вызывающий решил бы, что кэш загружен
+    Rendeructor* renderer = outMesh.GetRenderer();
+    if (!Rendeructor::AttachBackend(renderer)) return false;
+
+    const uint64_t smBytes = (uint64_t)header.SubMeshCount * sizeof(SubMeshRecord);
+    const uint64_t namesOffset = AlignUp(header.SubMeshOffset + smBytes);
+
+    // Указатели смотрят прямо в отображение файла - данные уходят в CreateBuffer без промежуточных копий
+    const Vertex* vertices = (const Vertex*)(file.GetData() + header.VertexOffset);
+    const unsigned int* indices = (const unsigned int*)(file.GetData() + header.IndexOffset);
+
+    outMesh.CreateFromMemory(vertices, (size_t)header.VertexCount, indices, (size_t)header.IndexCount,
+        Math::float3(header.BoundsMin[0], header.BoundsMin[1], header.BoundsMin[2]),
+        Math::float3(header.BoundsMax[0], header.BoundsMax[1], header.BoundsMax[2]));
+    // Бэкенд не создал буферы: прежнее содержимое сетки уже заменено, оставляем ее пустой
+    if (!outMesh.GetVB()) {
+        outMesh.Release();
+        return false;
+    }
+
+    if (header.SubMeshCount) {
+        std::vector<SubMeshRecord> records(header.SubMeshCount);
+        memcpy(records.data(), file.GetData() + header.SubMeshOffset, (size_t)smBytes);
+
+        std::vector<SubMesh> subMeshes;
+        subMeshes.reserve(records.size());
+        for (const SubMeshRecord& record : records) {
+            subMeshes.push_back(SubMesh{ (int)record.StartIndex, (int)record.IndexCount, record.BaseVertex, (int)record.MaterialId });
+        }
+
+        std::vector<std::string> materialNames;
+        const char* name = (const char*)(file.GetData() + namesOffset);
+        const char* namesEnd = name + header.MaterialNameBytes;
+        while (name < namesEnd) {
+            const char* terminator = (const char*)memchr(name, 0, namesEnd - name);
+            if (!terminator) break;
+            materialNames.emplace_back(name, terminator);
+            name = terminator + 1;
+        }
+
+        outMesh.SetSubMeshes(subMeshes, materialNames);
+    }
+
+    if (stats) {
+        auto endTime = std::chrono::high_resolution_clock::now();
+        stats->Bytes = file.GetSize();
+        stats->Milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+        stats->NormalsFromFile = (header.Flags & Flag_NormalsFromFile) != 0;
+    }
+    return true;
+}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "RendeructorDefines.h"
+#include <cstdint>
+
+// Binary mesh cache (.rmesh).
+// Stores exactly the VB/IB bytes Mesh::Create uploads, so a cached mesh is mapped and handed to the
+// backend without any parsing or copying. The header remembers size and write time of the source
+// file; a stale or foreign cache is simply ignored.
+namespace MeshCache {
+
+    const uint32_t kMagic = 0x48534D52; // "RMSH"
+    const uint32_t kVersion = 2;
+
+    enum VertexFormat : uint32_t {
+        VertexFormat_PosNormTanBitanUV = 1 // layout of struct Vertex
+    };
+
+    enum IndexFormat : uint32_t {
+        IndexFormat_R32 = 1
+    };
+
+    struct SubMeshRecord {
+        uint32_t StartIndex;
+        uint32_t IndexCount;
+        int32_t BaseVertex;
+        uint32_t MaterialId;
+    };
+
+    struct Header {
+        uint32_t Magic;
+        uint32_t Version;
+        uint64_t SourceSize;
+        int64_t SourceTime;
+
+        uint32_t VertexFormat;
+        uint32_t VertexStride;
+        uint32_t IndexFormat;
+        uint32_t SubMeshCount;
+
+        uint64_t VertexCount;
+        uint64_t IndexCount;
+
+        // Block offsets from the start of the file, 16 byte aligned
+        uint64_t VertexOffset;
+        uint64_t IndexOffset;
+        uint64_t SubMeshOffset;
+
+        float BoundsMin[3];
+        float BoundsMax[3];
+        uint32_t Flags;
+        // Null-terminated material names, stored right after the sub-mesh block (16 byte aligned)
+        uint32_t MaterialNameBytes;
+    };
+
+    enum HeaderFlags : uint32_t {
+        Flag_NormalsFromFile = 1
+    };
+
+    struct CacheStats {
+        size_t Bytes = 0;
+        double Milliseconds = 0.0;
+        bool NormalsFromFile = false;
+    };
+
+    RENDER_API std::string GetCachePath(const std::string& sourcePath);
+
+    RENDER_API bool Write(const std::string& cachePath, const std::string& sourcePath,
+               const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+               const Math::float3& boundsMin, const Math::float3& boundsMax, bool normalsFromFile,
+               const std::vector<SubMeshRecord>& subMeshes = {}, const std::vector<std::string>& materialNames = {});
+
+    // Maps the cache and uploads it into outMesh. Fails without touching outMesh if the file is missing,
+    // corrupt, written for another vertex layout or older than the source, or when there is no backend to upload to.
+    // If the backend then fails to create the buffers, outMesh has already been replaced and is left released.
+    RENDER_API bool Load(const std::string& cachePath, const std::string& sourcePath, Mesh& outMesh, CacheStats* stats = nullptr);
+
+    // Consistency check of a whole cache file in memory (Load runs it before anything is uploaded): header, block bounds
+    // and alignment, every index below VertexCount, sub-mesh ranges inside the index buffer and their base vertex.
+    // Whether the source changed is not checked here. error receives the reason of a failure
+    RENDER_API bool Validate(const char* data, size_t size, std::string* error = nullptr);
+}
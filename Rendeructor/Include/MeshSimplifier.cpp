@@ -0,0 +1,402 @@
+﻿#include "pch.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace MeshSimplifier {
+
+namespace {
+
+    // Квадрика Гарланда-Хекберта: Q(p) = p^T A p + 2 b^T p + c, накопленная с весом площади треугольников.
+    // W - суммарный вес, чтобы ошибку можно было перевести в квадрат расстояния.
+    struct Quadric {
+        double A00 = 0, A01 = 0, A02 = 0, A11 = 0, A12 = 0, A22 = 0;
+        double B0 = 0, B1 = 0, B2 = 0;
+        double C = 0;
+        double W = 0;
+
+        void AddPlane(double nx, double ny, double nz, double d, double w) {
+            A00 += w * nx * nx; A01 += w * nx * ny; A02 += w * nx * nz;
+            A11 += w * ny * ny; A12 += w * ny * nz; A22 += w * nz * nz;
+            B0 += w * nx * d; B1 += w * ny * d; B2 += w * nz * d;
+            C += w * d * d;
+            W += w;
+        }
+
+        void Add(const Quadric& q) {
+            A00 += q.A00; A01 += q.A01; A02 += q.A02;
+            A11 += q.A11; A12 += q.A12; A22 += q.A22;
+            B0 += q.B0; B1 += q.B1; B2 += q.B2;
+            C += q.C;
+            W += q.W;
+        }
+
+        double Evaluate(const Math::float3& p) const {
+            const double x = p.x, y = p.y, z = p.z;
+            double r = A00 * x * x + A11 * y * y + A22 * z * z
+                     + 2.0 * (A01 * x * y + A02 * x * z + A12 * y * z)
+                     + 2.0 * (B0 * x + B1 * y + B2 * z)
+                     + C;
+            return r > 0.0 ? r : 0.0;
+        }
+    };
+
+    // Квадрика усредняет квадраты расстояний с весом площади и годится только для порядка схлопываний.
+    // Отклонение меряем честно: расстояние новой позиции до каждой исходной плоскости, которую позиция вобрала
+    struct Plane {
+        double NX, NY, NZ, D;
+
+        double Distance(const Math::float3& p) const {
+            return std::abs(NX * p.x + NY * p.y + NZ * p.z + D);
+        }
+    };
+
+    struct Collapse {
+        unsigned int From;
+        unsigned int To;
+        double Cost; // квадрика: средневзвешенный квадрат расстояния
+    };
+
+    struct PositionKey {
+        uint32_t X, Y, Z;
+        bool operator==(const PositionKey& o) const { return X == o.X && Y == o.Y && Z == o.Z; }
+    };
+
+    struct PositionKeyHash {
+        size_t operator()(const PositionKey& k) const {
+            return (size_t)((k.X * 73856093u) ^ (k.Y * 19349663u) ^ (k.Z * 83492791u));
+        }
+    };
+
+    PositionKey MakeKey(const Math::float3& p) {
+        PositionKey key;
+        memcpy(&key.X, &p.x, 4);
+        memcpy(&key.Y, &p.y, 4);
+        memcpy(&key.Z, &p.z, 4);
+        return key;
+    }
+
+    // Пороги, при которых совпадающие по позиции вершины еще считаются одной гладкой вершиной, а не швом
+    const float kSeamNormalDot = 0.95f;
+    const float kSeamUVEpsilon = 1e-4f;
+
+    // Вес плоскостей вдоль открытых границ относительно плоскостей треугольников
+    const double kBorderWeight = 10.0;
+
+    uint64_t EdgeKey(unsigned int a, unsigned int b) {
+        return ((uint64_t)a << 32) | b;
+    }
+}
+
+Result Simplify(const Vertex* vertices, size_t vertexCount,
+                const unsigned int* indices, size_t indexCount,
+                size_t targetIndexCount, float targetError,
+                std::vector<unsigned int>& outIndices) {
+    Result result;
+    outIndices.assign(indices, indices + indexCount);
+    result.IndexCount = outIndices.size();
+
+    if (vertexCount == 0 || indexCount < 3 || indexCount <= targetIndexCount) return result;
+
+    // 1. Сварка по позиции. Несколько вершин в одной позиции - "клинья" (wedges)
+    std::vector<unsigned int> positionId(vertexCount);
+    size_t positionCount = 0;
+    {
+        std::unordered_map<PositionKey, unsigned int, PositionKeyHash> lookup;
+        lookup.reserve(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i) {
+            auto it = lookup.emplace(MakeKey(vertices[i].Position), (unsigned int)lookup.size());
+            positionId[i] = it.first->second;
+        }
+        positionCount = lookup.size();
+    }
+
+    std::vector<unsigned int> wedgeOffsets(positionCount + 1, 0);
+    std::vector<unsigned int> wedges(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i) wedgeOffsets[positionId[i] + 1]++;
+    for (size_t p = 0; p < positionCount; ++p) wedgeOffsets[p + 1] += wedgeOffsets[p];
+    {
+        std::vector<unsigned int> cursor(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+        for (size_t i = 0; i < vertexCount; ++i) wedges[cursor[positionId[i]]++] = (unsigned int)i;
+    }
+
+    // 2. Блокировка. Шов - клинья с заметно разными нормалями или UV: такую позицию не двигаем.
+    // Клинья с практически одинаковыми атрибутами (дубли вершин на стыках патчей) схлопываются вместе.
+    std::vector<uint8_t> locked(positionCount, 0);
+    for (size_t p = 0; p < positionCount; ++p) {
+        const Vertex& first = vertices[wedges[wedgeOffsets[p]]];
+        for (unsigned int w = wedgeOffsets[p] + 1; w < wedgeOffsets[p + 1]; ++w) {
+            const Vertex& other = vertices[wedges[w]];
+            bool sameNormal = Math::dot(first.Normal, other.Normal) >= kSeamNormalDot;
+            bool sameUV = std::abs(first.UV.x - other.UV.x) <= kSeamUVEpsilon && std::abs(first.UV.y - other.UV.y) <= kSeamUVEpsilon;
+            if (!sameNormal || !sameUV) {
+                locked[p] = 1;
+                break;
+            }
+        }
+    }
+
+    // 3. Квадрики по плоскостям треугольников. Те же плоскости (без повторов) - в списки позиций для замера отклонения
+    std::vector<Quadric> quadrics(positionCount);
+    std::vector<Plane> planes;
+    std::vector<std::vector<unsigned int>> positionPlanes(positionCount);
+    auto addPlane = [&](unsigned int pa, unsigned int pb, unsigned int pc, double nx, double ny, double nz, double d) {
+        const unsigned int id = (unsigned int)planes.size();
+        planes.push_back({ nx, ny, nz, d });
+        positionPlanes[pa].push_back(id);
+        if (pb != pa) positionPlanes[pb].push_back(id);
+        if (pc != pa && pc != pb) positionPlanes[pc].push_back(id);
+    };
+    for (size_t i = 0; i < indexCount; i += 3) {
+        const Math::float3& p0 = vertices[indices[i + 0]].Position;
+        const Math::float3& p1 = vertices[indices[i + 1]].Position;
+        const Math::float3& p2 = vertices[indices[i + 2]].Position;
+
+        Math::float3 n = Math::cross(p1 - p0, p2 - p0);
+        double len = std::sqrt((double)n.x * n.x + (double)n.y * n.y + (double)n.z * n.z);
+        if (len <= 0.0) continue;
+
+        double nx = n.x / len, ny = n.y / len, nz = n.z / len;
+        double d = -(nx * p0.x + ny * p0.y + nz * p0.z);
+        double area = len * 0.5;
+
+        quadrics[positionId[indices[i + 0]]].AddPlane(nx, ny, nz, d, area);
+        quadrics[positionId[indices[i + 1]]].AddPlane(nx, ny, nz, d, area);
+        quadrics[positionId[indices[i + 2]]].AddPlane(nx, ny, nz, d, area);
+        addPlane(positionId[indices[i + 0]], positionId[indices[i + 1]], positionId[indices[i + 2]], nx, ny, nz, d);
+    }
+
+    // Открытые границы: ребро без встречного ребра у соседнего треугольника.
+    // Добавляем к квадрикам концов плоскость, перпендикулярную треугольнику вдоль ребра, - она держит силуэт границы.
+    std::unordered_set<uint64_t> edges;
+    auto buildEdges = [&](const std::vector<unsigned int>& source) {
+        edges.clear();
+        edges.reserve(source.size());
+        for (size_t i = 0; i < source.size(); i += 3) {
+            for (int e = 0; e < 3; ++e) {
+                unsigned int a = positionId[source[i + e]];
+                unsigned int b = positionId[source[i + (e + 1) % 3]];
+                if (a != b) edges.insert(EdgeKey(a, b));
+            }
+        }
+    };
+    auto isBorderEdge = [&](unsigned int pa, unsigned int pb) {
+        return edges.find(EdgeKey(pb, pa)) == edges.end();
+    };
+
+    buildEdges(outIndices);
+    for (size_t i = 0; i < indexCount; i += 3) {
+        for (int e = 0; e < 3; ++e) {
+            unsigned int va = indices[i + e], vb = indices[i + (e + 1) % 3], vc = indices[i + (e + 2) % 3];
+            unsigned int pa = positionId[va], pb = positionId[vb];
+            if (pa == pb || !isBorderEdge(pa, pb)) continue;
+
+            const Math::float3& p0 = vertices[va].Position;
+            Math::float3 edge = vertices[vb].Position - p0;
+            Math::float3 normal = Math::cross(edge, vertices[vc].Position - p0);
+            Math::float3 m = Math::cross(edge, normal);
+            double len = std::sqrt((double)Math::length_sq(m));
+            if (len <= 0.0) continue;
+
+            double mx = m.x / len, my = m.y / len, mz = m.z / len;
+            double d = -(mx * p0.x + my * p0.y + mz * p0.z);
+            double weight = (double)Math::length_sq(edge) * kBorderWeight;
+
+            quadrics[pa].AddPlane(mx, my, mz, d, weight);
+            quadrics[pb].AddPlane(mx, my, mz, d, weight);
+            // Сдвиг вдоль границы поперек ребра - тоже отклонение: силуэт уходит в сторону
+            addPlane(pa, pb, pb, mx, my, mz, d);
+        }
+    }
+    for (auto& list : positionPlanes) {
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    }
+
+    auto collapseCost = [&](unsigned int from, unsigned int to) {
+        const Quadric& qa = quadrics[positionId[from]];
+        const Quadric& qb = quadrics[positionId[to]];
+        const Math::float3& p = vertices[to].Position;
+        double w = qa.W + qb.W;
+        return w > 0.0 ? (qa.Evaluate(p) + qb.Evaluate(p)) / w : 0.0;
+    };
+
+    const size_t targetTriangles = targetIndexCount / 3;
+    double maxError = 0.0;
+
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<uint8_t> touched(positionCount);
+    std::vector<uint8_t> border(positionCount);
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<Collapse> candidates;
+    std::vector<unsigned int> filtered;
+    std::vector<unsigned int> mergedPlanes;
+
+    // 4. Проходы: в каждом проходе схлопываем независимые ребра по возрастанию стоимости
+    const int kMaxPasses = 100;
+    while (outIndices.size() / 3 > targetTriangles && result.Passes < kMaxPasses) {
+        const size_t triangleCount = outIndices.size() / 3;
+
+        // Смежность вершина -> треугольники (CSR)
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (unsigned int index : outIndices) adjacencyOffsets[index + 1]++;
+        for (size_t i = 0; i < vertexCount; ++i) adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        adjacency.resize(outIndices.size());
+        {
+            std::vector<unsigned int> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t t = 0; t < triangleCount; ++t) {
+                for (int k = 0; k < 3; ++k) adjacency[cursor[outIndices[t * 3 + k]]++] = (unsigned int)t;
+            }
+        }
+
+        // Граничные позиции на текущей топологии
+        if (result.Passes > 0) buildEdges(outIndices);
+        std::fill(border.begin(), border.end(), 0);
+        for (size_t i = 0; i < outIndices.size(); i += 3) {
+            for (int e = 0; e < 3; ++e) {
+                unsigned int pa = positionId[outIndices[i + e]];
+                unsigned int pb = positionId[outIndices[i + (e + 1) % 3]];
+                if (pa != pb && isBorderEdge(pa, pb)) border[pa] = border[pb] = 1;
+            }
+        }
+
+        // Граничную вершину можно вести только вдоль граничного ребра, иначе граница "провалится" внутрь
+        auto canCollapse = [&](unsigned int pFrom, unsigned int pTo, bool borderEdge) {
+            if (locked[pFrom]) return false;
+            if (border[pFrom] && !borderEdge) return false;
+            return true;
+        };
+
+        // Кандидаты: внутреннее ребро встречается дважды (в обе стороны) - берем один раз; граничное - единожды
+        candidates.clear();
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int e = 0; e < 3; ++e) {
+                unsigned int a = outIndices[t * 3 + e];
+                unsigned int b = outIndices[t * 3 + (e + 1) % 3];
+                unsigned int pa = positionId[a], pb = positionId[b];
+                if (pa == pb) continue;
+
+                bool borderEdge = isBorderEdge(pa, pb);
+                if (!borderEdge && pa > pb) continue;
+
+                bool canA = canCollapse(pa, pb, borderEdge);
+                bool canB = canCollapse(pb, pa, borderEdge);
+                if (!canA && !canB) continue;
+
+                double costAB = canA ? collapseCost(a, b) : std::numeric_limits<double>::max();
+                double costBA = canB ? collapseCost(b, a) : std::numeric_limits<double>::max();
+
+                if (costAB <= costBA) candidates.push_back({ a, b, costAB });
+                else candidates.push_back({ b, a, costBA });
+            }
+        }
+        if (candidates.empty()) break;
+
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& l, const Collapse& r) { return l.Cost < r.Cost; });
+
+        // Не берем в проход ребра намного дороже, чем нужно для достижения цели - они могут подешеветь позже
+        size_t needed = (triangleCount - targetTriangles) / 2 + 1;
+        const double passLimit = candidates[std::min(needed, candidates.size()) - 1].Cost * 1.5;
+
+        for (size_t i = 0; i < vertexCount; ++i) remap[i] = (unsigned int)i;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t remainingTriangles = triangleCount;
+        int collapses = 0;
+
+        for (const Collapse& c : candidates) {
+            if (c.Cost > passLimit) break;
+            const unsigned int posFrom = positionId[c.From];
+            const unsigned int posTo = positionId[c.To];
+            if (touched[posFrom] || touched[posTo]) continue;
+
+            const Math::float3& pFrom = vertices[c.From].Position;
+            const Math::float3& pTo = vertices[c.To].Position;
+
+            // Проверка переворота: ни один оставшийся треугольник веера не должен развернуться или выродиться
+            bool valid = true;
+            size_t removed = 0;
+            for (unsigned int w = wedgeOffsets[posFrom]; w < wedgeOffsets[posFrom + 1] && valid; ++w) {
+                const unsigned int from = wedges[w];
+                for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && valid; ++a) {
+                    unsigned int t = adjacency[a];
+                    int k = outIndices[t * 3 + 0] == from ? 0 : (outIndices[t * 3 + 1] == from ? 1 : 2);
+                    unsigned int v1 = remap[outIndices[t * 3 + (k + 1) % 3]];
+                    unsigned int v2 = remap[outIndices[t * 3 + (k + 2) % 3]];
+
+                    if (positionId[v1] == posTo || positionId[v2] == posTo) { removed++; continue; }
+                    if (positionId[v1] == positionId[v2]) continue;
+
+                    const Math::float3& p1 = vertices[v1].Position;
+                    const Math::float3& p2 = vertices[v2].Position;
+                    Math::float3 n0 = Math::cross(p1 - pFrom, p2 - pFrom);
+                    Math::float3 n1 = Math::cross(p1 - pTo, p2 - pTo);
+
+                    float d = Math::dot(n0, n1);
+                    float lengths = std::sqrt(Math::length_sq(n0) * Math::length_sq(n1));
+                    if (d <= 1e-2f * lengths) valid = false;
+                }
+            }
+            if (!valid) continue;
+
+            // Жесткий предел: новая позиция не дальше targetError от любой плоскости, которую вобрала исходная
+            double deviation = 0.0;
+            for (unsigned int plane : positionPlanes[posFrom]) {
+                deviation = std::max(deviation, planes[plane].Distance(pTo));
+                if (deviation > targetError) break;
+            }
+            if (deviation > targetError) continue;
+
+            // Проверка переворота верна, только пока остальные вершины веера стоят на месте: в этом проходе их не двигаем
+            for (unsigned int w = wedgeOffsets[posFrom]; w < wedgeOffsets[posFrom + 1]; ++w) {
+                const unsigned int from = wedges[w];
+                for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a) {
+                    const unsigned int t = adjacency[a];
+                    for (int k = 0; k < 3; ++k) touched[positionId[remap[outIndices[t * 3 + k]]]] = 1;
+                }
+            }
+            for (unsigned int w = wedgeOffsets[posFrom]; w < wedgeOffsets[posFrom + 1]; ++w) remap[wedges[w]] = c.To;
+            touched[posFrom] = 1;
+            touched[posTo] = 1;
+            quadrics[posTo].Add(quadrics[posFrom]);
+            mergedPlanes.clear();
+            std::set_union(positionPlanes[posTo].begin(), positionPlanes[posTo].end(),
+                           positionPlanes[posFrom].begin(), positionPlanes[posFrom].end(), std::back_inserter(mergedPlanes));
+            positionPlanes[posTo].swap(mergedPlanes);
+            std::vector<unsigned int>().swap(positionPlanes[posFrom]);
+            maxError = std::max(maxError, deviation);
+            collapses++;
+
+            remainingTriangles -= std::min(removed, remainingTriangles);
+            if (remainingTriangles <= targetTriangles) break;
+        }
+
+        if (collapses == 0) break;
+
+        // Применяем схлопывания и выбрасываем вырожденные по позиции треугольники
+        filtered.clear();
+        filtered.reserve(outIndices.size());
+        for (size_t t = 0; t < triangleCount; ++t) {
+            unsigned int i0 = remap[outIndices[t * 3 + 0]];
+            unsigned int i1 = remap[outIndices[t * 3 + 1]];
+            unsigned int i2 = remap[outIndices[t * 3 + 2]];
+            unsigned int p0 = positionId[i0], p1 = positionId[i1], p2 = positionId[i2];
+            if (p0 == p1 || p1 == p2 || p0 == p2) continue;
+            filtered.push_back(i0);
+            filtered.push_back(i1);
+            filtered.push_back(i2);
+        }
+        outIndices.swap(filtered);
+        result.Passes++;
+    }
+
+    result.IndexCount = outIndices.size();
+    result.Error = (float)maxError;
+    return result;
+}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "RendeructorDefines.h"
+
+// Quadric error metric (Garland-Heckbert) edge-collapse simplifier.
+// Works on an index buffer only: the vertex buffer is shared by all LODs, collapsed vertices just stop being referenced.
+// Vertices on attribute seams (same position, different normal/uv) are locked and vertices on open borders may only
+// slide along the border, so UV/normal discontinuities and silhouettes of open meshes survive simplification.
+namespace MeshSimplifier {
+
+    struct Result {
+        size_t IndexCount = 0;   // resulting index count (multiple of 3)
+        // Largest distance from a moved vertex to the plane of any original triangle (or open border edge) merged into it,
+        // in object-space units. A bound on how far the surface moved, not an average
+        float Error = 0.0f;
+        int Passes = 0;
+    };
+
+    // targetError - hard limit on that distance (object-space units); collapses that would exceed it are skipped
+    RENDER_API Result Simplify(const Vertex* vertices, size_t vertexCount,
+                               const unsigned int* indices, size_t indexCount,
+                               size_t targetIndexCount, float targetError,
+                               std::vector<unsigned int>& outIndices);
+}
@@ -0,0 +1,175 @@
+﻿#include "pch.h"
+#include "MeshletBuilder.h"
+
+namespace MeshletBuilder {
+
+namespace {
+
+    // Если все нормали кластера отклоняются от оси сильнее этого, конус бесполезен для отсечения
+    const float kMinConeDot = 0.1f;
+
+    void ComputeBounds(const Vertex* vertices, const unsigned int* meshletVertices, const unsigned char* triangles, Meshlet& m) {
+        // Сфера: центр AABB, радиус - до самой дальней вершины
+        Math::float3 bmin = vertices[meshletVertices[0]].Position;
+        Math::float3 bmax = bmin;
+        for (unsigned int i = 1; i < m.VertexCount; ++i) {
+            const Math::float3& p = vertices[meshletVertices[i]].Position;
+            bmin = Math::min(bmin, p);
+            bmax = Math::max(bmax, p);
+        }
+        m.Center = (bmin + bmax) * 0.5f;
+
+        float radiusSq = 0.0f;
+        for (unsigned int i = 0; i < m.VertexCount; ++i) {
+            radiusSq = std::max(radiusSq, Math::length_sq(vertices[meshletVertices[i]].Position - m.Center));
+        }
+        m.Radius = std::sqrt(radiusSq);
+
+        // Конус нормалей: ось - средняя нормаль, раствор - по самому отклоненному треугольнику
+        std::vector<Math::float3> normals;
+        normals.reserve(m.TriangleCount);
+        Math::float3 axis = { 0, 0, 0 };
+        for (unsigned int t = 0; t < m.TriangleCount; ++t) {
+            const Math::float3& p0 = vertices[meshletVertices[triangles[t * 3 + 0]]].Position;
+            const Math::float3& p1 = vertices[meshletVertices[triangles[t * 3 + 1]]].Position;
+            const Math::float3& p2 = vertices[meshletVertices[triangles[t * 3 + 2]]].Position;
+
+            Math::float3 n = Math::cross(p1 - p0, p2 - p0);
+            float len = Math::length(n);
+            if (len <= 0.0f) continue;
+
+            n = n / len;
+            normals.push_back(n);
+            axis = axis + n;
+        }
+
+        m.ConeAxis = { 0, 0, 0 };
+        m.ConeCutoff = 1.0f;
+
+        float axisLength = Math::length(axis);
+        if (normals.empty() || axisLength <= 0.0f) return;
+        axis = axis / axisLength;
+
+        float minDot = 1.0f;
+        for (const auto& n : normals) minDot = std::min(minDot, Math::dot(axis, n));
+
+        m.ConeAxis = axis;
+        if (minDot > kMinConeDot) {
+            m.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+    }
+}
+
+void Build(const Vertex* vertices, size_t vertexCount,
+           const unsigned int* indices, size_t indexCount,
+           size_t maxVertices, size_t maxTriangles,
+           std::vector<Meshlet>& outMeshlets,
+           std::vector<unsigned int>& outVertices,
+           std::vector<unsigned char>& outTriangles) {
+    outMeshlets.clear();
+    outVertices.clear();
+    outTriangles.clear();
+
+    // Локальные индексы хранятся в байте
+    maxVertices = std::min<size_t>(std::max<size_t>(maxVertices, 3), 256);
+    maxTriangles = std::max<size_t>(maxTriangles, 1);
+
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0) return;
+
+    // Смежность вершина -> треугольники (CSR)
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) adjacencyOffsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    {
+        std::vector<unsigned int> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int k = 0; k < 3; ++k) adjacency[cursor[indices[t * 3 + k]]++] = (unsigned int)t;
+        }
+    }
+
+    // Сколько еще неразобранных треугольников держит вершину - вершины, которые вот-вот "закроются", берем первыми
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int v = 0; v < vertexCount; ++v) liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+
+    std::vector<uint8_t> used(triangleCount, 0);
+    std::vector<int> localIndex(vertexCount, -1);
+
+    Meshlet current;
+    size_t seedCursor = 0;
+
+    auto flush = [&]() {
+        if (current.TriangleCount == 0) return;
+        ComputeBounds(vertices, outVertices.data() + current.VertexOffset, outTriangles.data() + current.TriangleOffset * 3, current);
+        for (unsigned int i = 0; i < current.VertexCount; ++i) localIndex[outVertices[current.VertexOffset + i]] = -1;
+        outMeshlets.push_back(current);
+
+        Meshlet next;
+        next.VertexOffset = (unsigned int)outVertices.size();
+        next.TriangleOffset = (unsigned int)(outTriangles.size() / 3);
+        current = next;
+    };
+
+    auto newVertexCount = [&](size_t t) {
+        int extra = 0;
+        for (int k = 0; k < 3; ++k) extra += localIndex[indices[t * 3 + k]] < 0 ? 1 : 0;
+        return extra;
+    };
+
+    size_t remaining = triangleCount;
+    while (remaining > 0) {
+        // Лучший соседний треугольник: минимум новых вершин, при равенстве - наименее "живые" вершины
+        size_t best = triangleCount;
+        int bestExtra = 4;
+        unsigned int bestLive = ~0u;
+
+        for (unsigned int i = 0; i < current.VertexCount; ++i) {
+            unsigned int v = outVertices[current.VertexOffset + i];
+            for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a) {
+                unsigned int t = adjacency[a];
+                if (used[t]) continue;
+
+                int extra = newVertexCount(t);
+                unsigned int live = liveTriangles[indices[t * 3 + 0]] + liveTriangles[indices[t * 3 + 1]] + liveTriangles[indices[t * 3 + 2]];
+                if (extra < bestExtra || (extra == bestExtra && live < bestLive)) {
+                    best = t;
+                    bestExtra = extra;
+                    bestLive = live;
+                }
+            }
+        }
+
+        // Соседей нет (новый кластер или остров геометрии) - берем следующий свободный по порядку
+        if (best == triangleCount) {
+            if (current.TriangleCount > 0) {
+                flush();
+                continue;
+            }
+            while (used[seedCursor]) seedCursor++;
+            best = seedCursor;
+            bestExtra = newVertexCount(best);
+        }
+
+        if (current.VertexCount + bestExtra > maxVertices || current.TriangleCount + 1 > maxTriangles) {
+            flush();
+            continue;
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = indices[best * 3 + k];
+            if (localIndex[v] < 0) {
+                localIndex[v] = (int)current.VertexCount++;
+                outVertices.push_back(v);
+            }
+            outTriangles.push_back((unsigned char)localIndex[v]);
+            liveTriangles[v]--;
+        }
+        current.TriangleCount++;
+        used[best] = 1;
+        remaining--;
+    }
+
+    flush();
+}
+}
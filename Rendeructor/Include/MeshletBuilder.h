@@ -0,0 +1,15 @@
+#pragma once
+#include "RendeructorDefines.h"
+
+// Greedy meshlet (cluster) builder.
+// Triangles are added to the current meshlet by adjacency, preferring the ones that bring in the fewest new vertices,
+// so clusters stay compact and their bounding spheres/normal cones stay tight enough for culling.
+namespace MeshletBuilder {
+
+    RENDER_API void Build(const Vertex* vertices, size_t vertexCount,
+                          const unsigned int* indices, size_t indexCount,
+                          size_t maxVertices, size_t maxTriangles,
+                          std::vector<Meshlet>& outMeshlets,
+                          std::vector<unsigned int>& outVertices,
+                          std::vector<unsigned char>& outTriangles);
+}
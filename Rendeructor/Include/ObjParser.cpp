@@ -0,0 +1,629 @@
+﻿#include "pch.h"
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+
+namespace ObjParser {
+
+namespace {
+
+    // Меньше этого размера на поток дробить файл нет смысла - накладные расходы съедят выигрыш
+    const size_t kMinChunkBytes = 1024 * 1024;
+
+    // Один угол треугольника: индексы позиции / uv / нормали (0-based, -1 = нет)
+    struct Corner {
+        int V;
+        int VT;
+        int VN;
+    };
+
+    // usemtl: с какого угла (глобальное смещение) начинается материал
+    struct MaterialSwitch {
+        size_t Corner;
+        std::string Name;
+    };
+
+    struct Chunk {
+        const char* Begin = nullptr;
+        const char* End = nullptr;
+
+        // Заполняется на проходе подсчета
+        size_t Positions = 0;
+        size_t Normals = 0;
+        size_t TexCoords = 0;
+        size_t Corners = 0;
+        size_t MaxFaceCorners = 0;
+
+        // Смещения в глобальных массивах (префиксные суммы)
+        size_t PositionBase = 0;
+        size_t NormalBase = 0;
+        size_t TexCoordBase = 0;
+        size_t CornerBase = 0;
+
+        // Заполняется на проходе разбора
+        std::vector<MaterialSwitch> Materials;
+    };
+
+    struct GlobalArrays {
+        float* Positions = nullptr;
+        float* Normals = nullptr;
+        float* TexCoords = nullptr;
+        Corner* Corners = nullptr;
+    };
+
+    const double kPow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    inline bool IsDigit(char c) { return (unsigned)(c - '0') < 10u; }
+
+    inline const char* SkipSpaces(const char* p, const char* end) {
+        while (p < end && IsSpace(*p)) ++p;
+        return p;
+    }
+
+    inline const char* LineEnd(const char* p, const char* end) {
+        const char* nl = (const char*)memchr(p, '\n', end - p);
+        return nl ? nl : end;
+    }
+
+    // Конец данных строки: '#' в любом месте начинает комментарий. Оба прохода режут строку одинаково,
+    // иначе подсчет углов граней разойдется с разбором
+    inline const char* DataEnd(const char* p, const char* lineEnd) {
+        const char* comment = (const char*)memchr(p, '#', lineEnd - p);
+        return comment ? comment : lineEnd;
+    }
+
+    // Запасной путь для экзотики (nan, inf, hex) - копия в локальный буфер и strtod
+    const char* ParseFloatSlow(const char* p, const char* end, float& out) {
+        char buffer[64];
+        size_t len = 0;
+        while (p + len < end && len < sizeof(buffer) - 1 && !IsSpace(p[len]) && p[len] != '\n') {
+            buffer[len] = p[len];
+            ++len;
+        }
+        buffer[len] = 0;
+
+        char* parsedEnd = nullptr;
+        out = (float)strtod(buffer, &parsedEnd);
+        return p + (parsedEnd - buffer);
+    }
+
+    // Быстрый разбор float: мантисса в uint64 + степень десяти из таблицы.
+    // Без локали и без strtod для типичных чисел OBJ вида -1.234567e-3
+    const char* ParseFloat(const char* p, const char* end, float& out) {
+        p = SkipSpaces(p, end);
+        const char* start = p;
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        bool anyDigits = false;
+
+        while (p < end && IsDigit(*p)) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa) ++digits;
+            }
+            else {
+                ++exponent; // Лишние цифры целой части только сдвигают порядок
+            }
+            anyDigits = true;
+            ++p;
+        }
+
+        if (p < end && *p == '.') {
+            ++p;
+            while (p < end && IsDigit(*p)) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                    if (mantissa) ++digits;
+                    --exponent;
+                }
+                anyDigits = true;
+                ++p;
+            }
+        }
+
+        if (!anyDigits) {
+            return ParseFloatSlow(start, end, out);
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            bool expNegative = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                expNegative = (*p == '-');
+                ++p;
+            }
+            int e = 0;
+            while (p < end && IsDigit(*p)) {
+                if (e < 10000) e = e * 10 + (*p - '0');
+                ++p;
+            }
+            exponent += expNegative ? -e : e;
+        }
+
+        double value = (double)mantissa;
+        if (exponent < 0) {
+            value = (-exponent <= 22) ? value / kPow10[-exponent] : value * std::pow(10.0, (double)exponent);
+        }
+        else if (exponent > 0) {
+            value = (exponent <= 22) ? value * kPow10[exponent] : value * std::pow(10.0, (double)exponent);
+        }
+
+        out = (float)(negative ? -value : value);
+        return p;
+    }
+
+    inline const char* ParseInt(const char* p, const char* end, int& out) {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            ++p;
+        }
+        int value = 0;
+        while (p < end && IsDigit(*p)) {
+            value = value * 10 + (*p - '0');
+            ++p;
+        }
+        out = negative ? -value : value;
+        return p;
+    }
+
+    // OBJ индексы: 1-based или отрицательные (относительно уже прочитанных элементов).
+    // -1 - индекса нет, -2 - отрицательный индекс указывает до начала файла
+    inline int ResolveIndex(int raw, size_t countSoFar) {
+        if (raw > 0) return raw - 1;
+        if (raw < 0 && (size_t)(-(long long)raw) > countSoFar) return -2;
+        if (raw < 0) return (int)countSoFar + raw;
+        return -1;
+    }
+
+    // Количество групп "v/vt/vn" в строке грани
+    size_t CountFaceCorners(const char* p, const char* end) {
+        size_t count = 0;
+        bool inToken = false;
+        for (; p < end; ++p) {
+            if (IsSpace(*p)) {
+                inToken = false;
+            }
+            else if (!inToken) {
+                inToken = true;
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // Проход 1: только считаем элементы, чтобы потом выделить память ровно один раз
+    void CountChunk(Chunk& chunk) {
+        const char* p = chunk.Begin;
+        const char* end = chunk.End;
+
+        while (p < end) {
+            const char* nextLine = LineEnd(p, end);
+            const char* lineEnd = DataEnd(p, nextLine);
+            const char* s = SkipSpaces(p, lineEnd);
+
+            if (lineEnd - s >= 2) {
+                if (s[0] == 'v') {
+                    if (IsSpace(s[1])) chunk.Positions++;
+                    else if (s[1] == 'n' && lineEnd - s >= 3 && IsSpace(s[2])) chunk.Normals++;
+                    else if (s[1] == 't' && lineEnd - s >= 3 && IsSpace(s[2])) chunk.TexCoords++;
+                }
+                else if (s[0] == 'f' && IsSpace(s[1])) {
+                    size_t n = CountFaceCorners(s + 2, lineEnd);
+                    if (n >= 3) {
+                        chunk.Corners += (n - 2) * 3;
+                        chunk.MaxFaceCorners = std::max(chunk.MaxFaceCorners, n);
+                    }
+                }
+            }
+
+            p = nextLine + 1;
+        }
+    }
+
+    // Проход 2: разбор прямо в глобальные массивы по смещениям чанка
+    bool ParseChunk(Chunk& chunk, const GlobalArrays& arrays) {
+        const char* p = chunk.Begin;
+        const char* end = chunk.End;
+
+        size_t positions = chunk.PositionBase;
+        size_t normals = chunk.NormalBase;
+        size_t texCoords = chunk.TexCoordBase;
+        size_t corners = chunk.CornerBase;
+
+        // Буфер под один полигон, размер известен после подсчета
+        std::vector<Corner> face(std::max<size_t>(chunk.MaxFaceCorners, 3));
+
+        while (p < end) {
+            const char* nextLine = LineEnd(p, end);
+            const char* lineEnd = DataEnd(p, nextLine);
+            const char* s = SkipSpaces(p, lineEnd);
+
+            if (lineEnd - s >= 2) {
+                if (s[0] == 'v' && IsSpace(s[1])) {
+                    float* dst = arrays.Positions + positions * 3;
+                    s = ParseFloat(s + 1, lineEnd, dst[0]);
+                    s = ParseFloat(s, lineEnd, dst[1]);
+                    ParseFloat(s, lineEnd, dst[2]);
+                    positions++;
+                }
+                else if (s[0] == 'v' && s[1] == 'n' && lineEnd - s >= 3 && IsSpace(s[2])) {
+                    float* dst = arrays.Normals + normals * 3;
+                    s = ParseFloat(s + 2, lineEnd, dst[0]);
+                    s = ParseFloat(s, lineEnd, dst[1]);
+                    ParseFloat(s, lineEnd, dst[2]);
+                    normals++;
+                }
+                else if (s[0] == 'v' && s[1] == 't' && lineEnd - s >= 3 && IsSpace(s[2])) {
+                    float* dst = arrays.TexCoords + texCoords * 2;
+                    s = ParseFloat(s + 2, lineEnd, dst[0]);
+                    s = SkipSpaces(s, lineEnd);
+                    if (s < lineEnd) ParseFloat(s, lineEnd, dst[1]);
+                    else dst[1] = 0.0f;
+                    texCoords++;
+                }
+                else if (s[0] == 'f' && IsSpace(s[1])) {
+                    size_t n = 0;
+                    s += 2;
+
+                    while (true) {
+                        s = SkipSpaces(s, lineEnd);
+                        if (s >= lineEnd) break;
+
+                        int rawV = 0, rawVT = 0, rawVN = 0;
+                        s = ParseInt(s, lineEnd, rawV);
+                        if (s < lineEnd && *s == '/') {
+                            ++s;
+                            if (s < lineEnd && *s != '/') s = ParseInt(s, lineEnd, rawVT);
+                            if (s < lineEnd && *s == '/') {
+                                ++s;
+                                s = ParseInt(s, lineEnd, rawVN);
+                            }
+                        }
+                        // Мусор внутри токена - пропускаем до пробела
+                        while (s < lineEnd && !IsSpace(*s)) ++s;
+
+                        if (n < face.size()) {
+                            Corner& c = face[n++];
+                            c.V = ResolveIndex(rawV, positions);
+                            c.VT = ResolveIndex(rawVT, texCoords);
+                            c.VN = ResolveIndex(rawVN, normals);
+                            if (c.V < 0) return false;
+                        }
+                    }
+
+                    // Веер треугольников (как triangulate в TinyObj)
+                    for (size_t i = 1; i + 1 < n; ++i) {
+                        arrays.Corners[corners++] = face[0];
+                        arrays.Corners[corners++] = face[i];
+                        arrays.Corners[corners++] = face[i + 1];
+                    }
+                }
+                else if (s[0] == 'u' && lineEnd - s >= 7 && memcmp(s, "usemtl", 6) == 0 && IsSpace(s[6])) {
+                    const char* nameBegin = SkipSpaces(s + 6, lineEnd);
+                    const char* nameEnd = lineEnd;
+                    while (nameEnd > nameBegin && IsSpace(nameEnd[-1])) --nameEnd;
+                    chunk.Materials.push_back({ corners, std::string(nameBegin, nameEnd) });
+                }
+            }
+
+            p = nextLine + 1;
+        }
+
+        return corners == chunk.CornerBase + chunk.Corners;
+    }
+
+    template <typename Func>
+    void RunParallel(std::vector<Chunk>& chunks, Func func) {
+        if (chunks.size() == 1) {
+            func(chunks[0]);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        workers.reserve(chunks.size() - 1);
+        for (size_t i = 1; i < chunks.size(); ++i) {
+            workers.emplace_back([&, i]() { func(chunks[i]); });
+        }
+        func(chunks[0]); // Первый чанк разбирает вызывающий поток
+        for (auto& w : workers) w.join();
+    }
+
+    // Хеш-таблица с открытой адресацией для склейки одинаковых (v, vt, vn).
+    // Стартовый размер - по числу атрибутов, при заполнении больше половины растет вдвое
+    struct CornerHashTable {
+        struct Slot {
+            Corner Key;
+            unsigned int Vertex;
+        };
+
+        std::vector<Slot> Slots;
+        size_t Mask = 0;
+        size_t Count = 0;
+
+        explicit CornerHashTable(size_t expected) {
+            size_t capacity = 1024;
+            while (capacity < expected * 2) capacity <<= 1;
+            Slots.assign(capacity, Slot{ { -1, -1, -1 }, 0 });
+            Mask = capacity - 1;
+        }
+
+        static size_t Hash(const Corner& c) {
+            uint32_t h = (uint32_t)c.V * 0x9E3779B1u;
+            h ^= (uint32_t)(c.VT + 1) * 0x85EBCA77u;
+            h ^= (uint32_t)(c.VN + 1) * 0xC2B2AE3Du;
+            h ^= h >> 15;
+            return h;
+        }
+
+        void Grow() {
+            std::vector<Slot> old;
+            old.swap(Slots);
+            Slots.assign(old.size() * 2, Slot{ { -1, -1, -1 }, 0 });
+            Mask = Slots.size() - 1;
+            for (const Slot& slot : old) {
+                if (slot.Key.V < 0) continue;
+                size_t i = Hash(slot.Key) & Mask;
+                while (Slots[i].Key.V >= 0) i = (i + 1) & Mask;
+                Slots[i] = slot;
+            }
+        }
+
+        // Возвращает true, если ключ уже был; иначе вставляет newVertex
+        bool FindOrInsert(const Corner& c, unsigned int newVertex, unsigned int& outVertex) {
+            if ((Count + 1) * 2 > Slots.size()) Grow();
+
+            size_t i = Hash(c) & Mask;
+            while (true) {
+                Slot& slot = Slots[i];
+                if (slot.Key.V < 0) {
+                    slot.Key = c;
+                    slot.Vertex = newVertex;
+                    outVertex = newVertex;
+                    Count++;
+                    return false;
+                }
+                if (slot.Key.V == c.V && slot.Key.VT == c.VT && slot.Key.VN == c.VN) {
+                    outVertex = slot.Vertex;
+                    return true;
+                }
+                i = (i + 1) & Mask;
+            }
+        }
+    };
+}
+
+bool Parse(const char* data, size_t size, ParsedMesh& out, ParseStats* stats, int threadCount) {
+    auto timeStart = std::chrono::high_resolution_clock::now();
+
+    out = ParsedMesh();
+    if (!data || size == 0) return false;
+
+    // --- Нарезка на чанки по границам строк ---
+    if (threadCount <= 0) threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+    size_t chunkCount = std::min<size_t>((size_t)threadCount, std::max<size_t>(1, size / kMinChunkBytes));
+
+    std::vector<Chunk> chunks;
+    chunks.reserve(chunkCount);
+
+    const char* end = data + size;
+    const char* cursor = data;
+    for (size_t i = 0; i < chunkCount && cursor < end; ++i) {
+        const char* chunkEnd = (i + 1 == chunkCount) ? end : data + size * (i + 1) / chunkCount;
+        if (chunkEnd < cursor) chunkEnd = cursor;
+        if (chunkEnd < end) {
+            const char* nl = (const char*)memchr(chunkEnd, '\n', end - chunkEnd);
+            chunkEnd = nl ? nl + 1 : end;
+        }
+
+        Chunk chunk;
+        chunk.Begin = cursor;
+        chunk.End = chunkEnd;
+        chunks.push_back(chunk);
+        cursor = chunkEnd;
+    }
+
+    // --- Проход 1: подсчет ---
+    RunParallel(chunks, [](Chunk& c) { CountChunk(c); });
+
+    size_t totalPositions = 0, totalNormals = 0, totalTexCoords = 0, totalCorners = 0;
+    for (auto& c : chunks) {
+        c.PositionBase = totalPositions; totalPositions += c.Positions;
+        c.NormalBase = totalNormals;     totalNormals += c.Normals;
+        c.TexCoordBase = totalTexCoords; totalTexCoords += c.TexCoords;
+        c.CornerBase = totalCorners;     totalCorners += c.Corners;
+    }
+
+    if (totalPositions == 0 || totalCorners == 0) return false;
+    if (totalCorners > 0xFFFFFFFFull) return false;
+
+    // --- Проход 2: разбор в заранее выделенные массивы ---
+    std::vector<float> positions(totalPositions * 3);
+    std::vector<float> normals(totalNormals * 3);
+    std::vector<float> texCoords(totalTexCoords * 2);
+    std::vector<Corner> corners(totalCorners);
+
+    GlobalArrays arrays;
+    arrays.Positions = positions.data();
+    arrays.Normals = normals.data();
+    arrays.TexCoords = texCoords.data();
+    arrays.Corners = corners.data();
+
+    std::atomic<bool> failed(false);
+    RunParallel(chunks, [&](Chunk& c) {
+        if (!ParseChunk(c, arrays)) failed = true;
+    });
+    if (failed) return false;
+
+    // --- Проверка индексов и нормали по позициям (для углов без vn) ---
+    bool needComputedNormals = false;
+    for (const Corner& c : corners) {
+        if (c.V < 0 || (size_t)c.V >= totalPositions) return false;
+        if (c.VT < -1 || c.VN < -1) return false;
+        if (c.VT >= (int)totalTexCoords) return false;
+        if (c.VN >= (int)totalNormals) return false;
+        if (c.VN < 0) needComputedNormals = true;
+    }
+
+    std::vector<Math::float3> positionNormals;
+    if (needComputedNormals) {
+        positionNormals.assign(totalPositions, Math::float3(0, 0, 0));
+        for (size_t i = 0; i < totalCorners; i += 3) {
+            const float* p0 = &positions[corners[i + 0].V * 3];
+            const float* p1 = &positions[corners[i + 1].V * 3];
+            const float* p2 = &positions[corners[i + 2].V * 3];
+
+            Math::float3 edge1(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]);
+            Math::float3 edge2(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]);
+            Math::float3 faceNormal = Math::float3::cross(edge1, edge2);
+
+            positionNormals[corners[i + 0].V] += faceNormal;
+            positionNormals[corners[i + 1].V] += faceNormal;
+            positionNormals[corners[i + 2].V] += faceNormal;
+        }
+        for (auto& n : positionNormals) {
+            n = (n.length_sq() < 1e-12f) ? Math::float3(0, 1, 0) : n.normalize();
+        }
+    }
+
+    // --- Сборка индексированных вершин (память выделяется один раз) ---
+    out.Indices.resize(totalCorners);
+    out.Vertices.reserve(totalCorners); // Верхняя граница - push_back ниже не перевыделяет
+    out.HasNormals = totalNormals > 0;
+    out.PositionCount = totalPositions;
+
+    auto emitVertex = [&](const Corner& c) {
+        const float* p = &positions[c.V * 3];
+
+        Math::float3 normal;
+        if (c.VN >= 0) normal = Math::float3(normals[c.VN * 3 + 0], normals[c.VN * 3 + 1], normals[c.VN * 3 + 2]);
+        else normal = positionNormals[c.V];
+
+        Math::float2 uv(0, 0);
+        if (c.VT >= 0) uv = Math::float2(texCoords[c.VT * 2 + 0], 1.0f - texCoords[c.VT * 2 + 1]);
+
+        out.Vertices.push_back(Vertex(Math::float3(p[0], p[1], p[2]), Math::float3(0, 0, 0), Math::float3(0, 0, 0), normal, uv));
+    };
+
+    if (totalNormals == 0 && totalTexCoords == 0) {
+        // Только позиции: вершина однозначно определяется индексом позиции, хеш не нужен
+        std::vector<unsigned int> remap(totalPositions, 0xFFFFFFFFu);
+        for (size_t i = 0; i < totalCorners; ++i) {
+            const Corner& c = corners[i];
+            if (remap[c.V] == 0xFFFFFFFFu) {
+                remap[c.V] = (unsigned int)out.Vertices.size();
+                emitVertex(c);
+            }
+            out.Indices[i] = remap[c.V];
+        }
+    }
+    else {
+        CornerHashTable table(std::max(totalPositions, std::max(totalNormals, totalTexCoords)));
+
+        for (size_t i = 0; i < totalCorners; ++i) {
+            const Corner& c = corners[i];
+            unsigned int vertexIndex;
+            if (!table.FindOrInsert(c, (unsigned int)out.Vertices.size(), vertexIndex)) {
+                emitVertex(c);
+            }
+            out.Indices[i] = vertexIndex;
+        }
+    }
+
+    // --- Группировка треугольников по материалам ---
+    std::vector<MaterialSwitch> switches;
+    for (auto& c : chunks) {
+        for (auto& m : c.Materials) switches.push_back(std::move(m));
+    }
+
+    if (!switches.empty()) {
+        // Отрезки [Begin, End) с одним материалом; грани до первого usemtl получают безымянный материал
+        struct Segment {
+            size_t Begin;
+            size_t End;
+            int Material;
+        };
+        std::vector<Segment> segments;
+
+        auto findMaterial = [&](const std::string& name) {
+            for (size_t i = 0; i < out.MaterialNames.size(); ++i) {
+                if (out.MaterialNames[i] == name) return (int)i;
+            }
+            out.MaterialNames.push_back(name);
+            return (int)out.MaterialNames.size() - 1;
+        };
+
+        if (switches[0].Corner > 0) segments.push_back({ 0, switches[0].Corner, findMaterial("") });
+        for (size_t i = 0; i < switches.size(); ++i) {
+            size_t segmentEnd = (i + 1 < switches.size()) ? switches[i + 1].Corner : totalCorners;
+            int material = findMaterial(switches[i].Name);
+            if (segmentEnd > switches[i].Corner) segments.push_back({ switches[i].Corner, segmentEnd, material });
+        }
+
+        const int materialCount = (int)out.MaterialNames.size();
+        std::vector<size_t> materialCorners(materialCount, 0);
+        for (const Segment& segment : segments) materialCorners[segment.Material] += segment.End - segment.Begin;
+
+        // Сортировка подсчетом: порядок отрезков внутри материала сохраняется
+        std::vector<size_t> materialStart(materialCount, 0);
+        for (int m = 1; m < materialCount; ++m) materialStart[m] = materialStart[m - 1] + materialCorners[m - 1];
+
+        if (segments.size() > 1) {
+            std::vector<unsigned int> grouped(totalCorners);
+            std::vector<size_t> cursor = materialStart;
+            for (const Segment& segment : segments) {
+                std::copy(out.Indices.begin() + segment.Begin, out.Indices.begin() + segment.End, grouped.begin() + cursor[segment.Material]);
+                cursor[segment.Material] += segment.End - segment.Begin;
+            }
+            out.Indices.swap(grouped);
+        }
+
+        for (int m = 0; m < materialCount; ++m) {
+            if (materialCorners[m] == 0) continue;
+            out.SubMeshes.push_back(SubMesh{ (int)materialStart[m], (int)materialCorners[m], 0, m });
+        }
+    }
+
+    if (stats) {
+        auto timeEnd = std::chrono::high_resolution_clock::now();
+        stats->Bytes = size;
+        stats->Threads = (int)chunks.size();
+        stats->Milliseconds = std::chrono::duration<double, std::milli>(timeEnd - timeStart).count();
+    }
+
+    return true;
+}
+
+bool ParseFile(const std::string& path, ParsedMesh& out, ParseStats* stats, int threadCount) {
+    MappedFile file;
+    if (!file.Open(path)) return false;
+
+    auto timeStart = std::chrono::high_resolution_clock::now();
+    bool result = Parse(file.GetData(), file.GetSize(), out, stats, threadCount);
+
+    // В статистику входит и время отображения файла
+    if (result && stats) {
+        auto timeEnd = std::chrono::high_resolution_clock::now();
+        stats->Milliseconds = std::chrono::duration<double, std::milli>(timeEnd - timeStart).count();
+    }
+    return result;
+}
+
+}
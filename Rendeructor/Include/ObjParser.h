@@ -0,0 +1,34 @@
+#pragma once
+#include "RendeructorDefines.h"
+
+// Multithreaded Wavefront OBJ parser.
+// The file is memory mapped, split at line boundaries and every chunk is parsed on its own thread
+// straight into preallocated global arrays (a counting pass sizes everything up front).
+namespace ObjParser {
+
+    struct ParsedMesh {
+        std::vector<Vertex> Vertices;
+        std::vector<unsigned int> Indices;
+        bool HasNormals = false;
+        size_t PositionCount = 0;
+
+        // One range per usemtl material (triangles are regrouped so every material is contiguous),
+        // MaterialId indexes MaterialNames in order of first use. Empty when the file has no usemtl.
+        std::vector<SubMesh> SubMeshes;
+        std::vector<std::string> MaterialNames;
+    };
+
+    struct ParseStats {
+        size_t Bytes = 0;
+        int Threads = 0;
+        double Milliseconds = 0.0;
+
+        double MegabytesPerSecond() const {
+            return Milliseconds > 0.0 ? ((double)Bytes / (1024.0 * 1024.0)) / (Milliseconds / 1000.0) : 0.0;
+        }
+    };
+
+    // threadCount <= 0 - use all hardware threads
+    RENDER_API bool Parse(const char* data, size_t size, ParsedMesh& out, ParseStats* stats = nullptr, int threadCount = 0);
+    RENDER_API bool ParseFile(const std::string& path, ParsedMesh& out, ParseStats* stats = nullptr, int threadCount = 0);
+}
@@ -0,0 +1,205 @@
+﻿#include "pch.h"
+#include "OcclusionCuller.h"
+#include <immintrin.h>
+#include <chrono>
+#include <cfloat>
+
+namespace {
+    // Вершины ближе этого (по w) не проецируются: такие треугольники окклюдеров пропускаем,
+    // а такие боксы считаем видимыми
+    const float kMinW = 1e-4f;
+
+    inline Math::float4 TransformPoint(const Math::float3& p, const Math::float4x4& m) {
+        return m.row0() * p.x + m.row1() * p.y + m.row2() * p.z + m.row3();
+    }
+}
+
+void OcclusionCuller::Begin(const Math::float4x4& viewProjection, int width, int height) {
+    m_viewProjection = viewProjection;
+    m_width = std::max(kTileSize, (width + kTileSize - 1) / kTileSize * kTileSize);
+    m_height = std::max(kTileSize, (height + kTileSize - 1) / kTileSize * kTileSize);
+    m_tilesX = m_width / kTileSize;
+    m_tilesY = m_height / kTileSize;
+
+    m_depth.assign((size_t)m_width * m_height, 1.0f);
+    m_tileMaxDepth.assign((size_t)m_tilesX * m_tilesY, 1.0f);
+    m_stats = OcclusionCullStats();
+}
+
+void OcclusionCuller::RenderOccluder(const Mesh& mesh, const Math::float4x4& world) {
+    const auto& positions = mesh.GetOccluderPositions();
+    const auto& indices = mesh.GetOccluderIndices();
+    if (positions.empty() || indices.empty()) return;
+    RenderOccluder(positions.data(), (int)positions.size(), indices.data(), (int)indices.size(), world);
+}
+
+void OcclusionCuller::RenderOccluder(const Math::float3* positions, int positionCount, const unsigned int* indices, int indexCount,
+                                     const Math::float4x4& world) {
+    if (m_depth.empty() || !positions || !indices) return;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    const Math::float4x4 worldViewProjection = world * m_viewProjection;
+
+    // Все вершины переводим сразу в экранные координаты (w < kMinW помечаем)
+    m_clip.resize(positionCount);
+    for (int i = 0; i < positionCount; ++i) {
+        Math::float4 c = TransformPoint(positions[i], worldViewProjection);
+        if (c.w < kMinW) {
+            m_clip[i] = Math::float4(0, 0, 0, -1);
+            continue;
+        }
+        float invW = 1.0f / c.w;
+        m_clip[i] = Math::float4(
+            (c.x * invW * 0.5f + 0.5f) * m_width,
+            (0.5f - c.y * invW * 0.5f) * m_height,
+            std::max(c.z * invW, 0.0f),
+            1.0f);
+    }
+
+    for (int i = 0; i + 2 < indexCount; i += 3) {
+        const Math::float4& a = m_clip[indices[i]];
+        const Math::float4& b = m_clip[indices[i + 1]];
+        const Math::float4& c = m_clip[indices[i + 2]];
+        if (a.w < 0.0f || b.w < 0.0f || c.w < 0.0f) continue;
+        RasterizeTriangle(a.xyz(), b.xyz(), c.xyz());
+    }
+
+    m_stats.Occluders++;
+    auto endTime = std::chrono::high_resolution_clock::now();
+    m_stats.RasterMilliseconds += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+void OcclusionCuller::RasterizeTriangle(const Math::float3& p0, const Math::float3& p1, const Math::float3& p2) {
+    Math::float3 v0 = p0, v1 = p1, v2 = p2;
+
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (std::abs(area) < 1e-6f) return;
+    // Окклюдеры двусторонние: приводим обход к одному направлению
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    int minX = std::max(0, (int)std::floor(std::min(v0.x, std::min(v1.x, v2.x))));
+    int maxX = std::min(m_width - 1, (int)std::ceil(std::max(v0.x, std::max(v1.x, v2.x))));
+    int minY = std::max(0, (int)std::floor(std::min(v0.y, std::min(v1.y, v2.y))));
+    int maxY = std::min(m_height - 1, (int)std::ceil(std::max(v0.y, std::max(v1.y, v2.y))));
+    if (minX > maxX || minY > maxY) return;
+    minX &= ~3;
+
+    m_stats.Triangles++;
+
+    // Функции ребер e(x, y) = A*x + B*y + C, внутри треугольника все три >= 0
+    const float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v1.y * v2.x;
+    const float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v2.y * v0.x;
+    const float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v0.y * v1.x;
+
+    // Глубина линейна в экранном пространстве: z = z0 + (e1 * (z1 - z0) + e2 * (z2 - z0)) / area
+    const float invArea = 1.0f / area;
+    const float za = (a1 * (v1.z - v0.z) + a2 * (v2.z - v0.z)) * invArea;
+    const float zb = (b1 * (v1.z - v0.z) + b2 * (v2.z - v0.z)) * invArea;
+    const float zc = v0.z + (c1 * (v1.z - v0.z) + c2 * (v2.z - v0.z)) * invArea;
+
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 va0 = _mm_set1_ps(a0), va1 = _mm_set1_ps(a1), va2 = _mm_set1_ps(a2), vza = _mm_set1_ps(za);
+    const __m128 step0 = _mm_set1_ps(a0 * 4.0f), step1 = _mm_set1_ps(a1 * 4.0f);
+    const __m128 step2 = _mm_set1_ps(a2 * 4.0f), stepZ = _mm_set1_ps(za * 4.0f);
+
+    for (int y = minY; y <= maxY; ++y) {
+        const float py = y + 0.5f;
+        const __m128 px = _mm_add_ps(_mm_set1_ps((float)minX), offsets);
+
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(va0, px), _mm_set1_ps(b0 * py + c0));
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(va1, px), _mm_set1_ps(b1 * py + c1));
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(va2, px), _mm_set1_ps(b2 * py + c2));
+        __m128 z = _mm_add_ps(_mm_mul_ps(vza, px), _mm_set1_ps(zb * py + zc));
+
+        float* row = m_depth.data() + (size_t)y * m_width;
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside)) {
+                __m128 depth = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(depth, _mm_max_ps(z, zero));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, depth)));
+            }
+            e0 = _mm_add_ps(e0, step0);
+            e1 = _mm_add_ps(e1, step1);
+            e2 = _mm_add_ps(e2, step2);
+            z = _mm_add_ps(z, stepZ);
+        }
+    }
+}
+
+void OcclusionCuller::End() {
+    // Для каждого тайла - самая дальняя глубина: бокс за ней перекрыт во всем тайле
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        for (int tx = 0; tx < m_tilesX; ++tx) {
+            __m128 farthest = _mm_setzero_ps();
+            for (int y = 0; y < kTileSize; ++y) {
+                const float* row = m_depth.data() + (size_t)(ty * kTileSize + y) * m_width + tx * kTileSize;
+                farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+            }
+            farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+            farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+            m_tileMaxDepth[(size_t)ty * m_tilesX + tx] = _mm_cvtss_f32(farthest);
+        }
+    }
+}
+
+bool OcclusionCuller::IsVisible(const Math::float3& boundsMin, const Math::float3& boundsMax) const {
+    if (m_tileMaxDepth.empty()) return true;
+
+    // Углы бокса: min + комбинации трех ребер, уже в clip space
+    const Math::float4 base = TransformPoint(boundsMin, m_viewProjection);
+    const Math::float3 size = boundsMax - boundsMin;
+    const Math::float4 ex = m_viewProjection.row0() * size.x;
+    const Math::float4 ey = m_viewProjection.row1() * size.y;
+    const Math::float4 ez = m_viewProjection.row2() * size.z;
+
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+    for (int i = 0; i < 8; ++i) {
+        Math::float4 c = base;
+        if (i & 1) c = c + ex;
+        if (i & 2) c = c + ey;
+        if (i & 4) c = c + ez;
+
+        // Бокс пересекает ближнюю плоскость - проверить нечем
+        if (c.w < kMinW) return true;
+
+        float invW = 1.0f / c.w;
+        float sx = (c.x * invW * 0.5f + 0.5f) * m_width;
+        float sy = (0.5f - c.y * invW * 0.5f) * m_height;
+        minX = std::min(minX, sx); maxX = std::max(maxX, sx);
+        minY = std::min(minY, sy); maxY = std::max(maxY, sy);
+        minZ = std::min(minZ, c.z * invW);
+    }
+
+    // Вне экрана - это решает отсечение по фрустуму
+    if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_width || minY >= (float)m_height) return true;
+
+    int tx0 = std::max(0, (int)minX / kTileSize);
+    int ty0 = std::max(0, (int)minY / kTileSize);
+    int tx1 = std::min(m_tilesX - 1, (int)maxX / kTileSize);
+    int ty1 = std::min(m_tilesY - 1, (int)maxY / kTileSize);
+
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        const float* tiles = m_tileMaxDepth.data() + (size_t)ty * m_tilesX;
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            if (tiles[tx] >= minZ) return true;
+        }
+    }
+    return false;
+}
+
+bool OcclusionCuller::IsVisible(const Mesh& mesh, const Math::float4x4& world) const {
+    // Мировой AABB из локального (Arvo)
+    const Math::float3 center = world.transform_point(mesh.GetBoundsCenter());
+    const Math::float3 extent = (mesh.GetBoundsMax() - mesh.GetBoundsMin()) * 0.5f;
+    const Math::float4 r0 = world.row0(), r1 = world.row1(), r2 = world.row2();
+    const Math::float3 e(
+        std::abs(r0.x) * extent.x + std::abs(r1.x) * extent.y + std::abs(r2.x) * extent.z,
+        std::abs(r0.y) * extent.x + std::abs(r1.y) * extent.y + std::abs(r2.y) * extent.z,
+        std::abs(r0.z) * extent.x + std::abs(r1.z) * extent.y + std::abs(r2.z) * extent.z);
+    return IsVisible(center - e, center + e);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "RendeructorDefines.h"
+
+struct OcclusionCullStats {
+    int Occluders = 0;
+    int Triangles = 0; // occluder triangles that reached the rasterizer
+    double RasterMilliseconds = 0.0;
+};
+
+// Software occlusion culling.
+// A few occluder meshes are rasterized on the CPU (SSE, 4 pixels at a time) into a small depth buffer,
+// which is reduced to a grid of 8x8 tiles holding their farthest depth. A box is occluded when its nearest
+// projected depth lies behind every tile its screen rectangle touches.
+// Depth follows the engine's projection convention: 0 - near, 1 - far.
+class RENDER_API OcclusionCuller {
+public:
+    static constexpr int kTileSize = 8;
+
+    OcclusionCuller() = default;
+
+    // Starts a new view; width/height are rounded up to whole tiles
+    void Begin(const Math::float4x4& viewProjection, int width = 256, int height = 128);
+
+    // Triangle list in object space. Only occluders that are solid from every side should be used.
+    void RenderOccluder(const Math::float3* positions, int positionCount, const unsigned int* indices, int indexCount,
+                        const Math::float4x4& world);
+    // Uses the coarse copy made by Mesh::BuildOccluder
+    void RenderOccluder(const Mesh& mesh, const Math::float4x4& world);
+
+    // Builds the tile level; call after the last occluder and before testing
+    void End();
+
+    // World-space AABB. Const and thread-safe once End() was called.
+    bool IsVisible(const Math::float3& boundsMin, const Math::float3& boundsMax) const;
+    bool IsVisible(const Mesh& mesh, const Math::float4x4& world) const;
+
+    const OcclusionCullStats& GetStats() const { return m_stats; }
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    // Per-pixel depth of the occluders (1 where nothing was drawn), row-major, top row first
+    const std::vector<float>& GetDepth() const { return m_depth; }
+
+private:
+    void RasterizeTriangle(const Math::float3& p0, const Math::float3& p1, const Math::float3& p2);
+
+    Math::float4x4 m_viewProjection;
+    int m_width = 0;
+    int m_height = 0;
+    int m_tilesX = 0;
+    int m_tilesY = 0;
+
+    std::vector<float> m_depth;
+    std::vector<float> m_tileMaxDepth;
+    std::vector<Math::float4> m_clip; // scratch for occluder vertices
+
+    OcclusionCullStats m_stats;
+};
@@ -0,0 +1,391 @@
+﻿#include "pch.h"
+#include "Profiler.h"
+#include "BackendInterface.h"
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+namespace {
+
+    struct CPUEvent {
+        const char* Name;
+        long long StartNs;
+        long long EndNs;
+        int Depth;
+    };
+
+    // Слот кольца. Sequence = номер записи * 2 + 2, когда слот опубликован, и нечетный, пока он переписывается.
+    // Поля атомарные (relaxed - на x86 обычные mov), чтобы чтение переписываемого слота не было гонкой данных
+    struct EventSlot {
+        std::atomic<unsigned long long> Sequence{ 0 };
+        std::atomic<const char*> Name{ nullptr };
+        std::atomic<long long> StartNs{ 0 };
+        std::atomic<long long> EndNs{ 0 };
+        std::atomic<int> Depth{ 0 };
+    };
+
+    // Кольцо одного потока. Пишет только поток-владелец: слот, затем счетчик Written (release).
+    // Читатель (поток рендера в EndFrame, экспорт) сверяет номер записи в слоте до и после копирования:
+    // если писатель обогнал его на целое кольцо, событие не читается, а считается потерянным
+    struct ThreadBuffer {
+        std::atomic<unsigned long long> Written{ 0 };
+        unsigned long long ReadCursor = 0; // для сводки кадра, трогает только поток рендера
+        int TraceId = 0;
+        std::unique_ptr<EventSlot[]> Events;
+    };
+
+    std::mutex g_registryMutex; // регистрация потоков, передача колец и обход списка, не запись событий
+    std::vector<std::unique_ptr<ThreadBuffer>> g_threadBuffers;
+    std::vector<ThreadBuffer*> g_freeBuffers; // кольца завершившихся потоков
+    std::atomic<bool> g_enabled{ true }; // общий для всех экземпляров, как и кольца (Profiler::SetCPUScopesEnabled)
+
+    // Стек открытых scope потока. Вложенность считается и для пропущенных (профайлер выключен) scope, бит Recorded -
+    // был ли scope записан: End закрывает ровно то, что открыл Begin, даже если профайлер переключили между ними
+    struct ThreadState {
+        ThreadBuffer* Buffer = nullptr;
+        int Depth = 0;
+        unsigned int Recorded = 0;
+        const char* StackName[Profiler::kMaxDepth];
+        long long StackStart[Profiler::kMaxDepth];
+
+        ~ThreadState() {
+            if (!Buffer) return;
+            // Кольцо с непрочитанными событиями остается в списке, следующий новый поток продолжит писать в него
+            std::lock_guard<std::mutex> lock(g_registryMutex);
+            g_freeBuffers.push_back(Buffer);
+        }
+    };
+    static_assert(Profiler::kMaxDepth <= 32, "ThreadState::Recorded holds one bit per depth");
+    thread_local ThreadState t_state;
+
+    ThreadBuffer* GetThreadBuffer() {
+        if (!t_state.Buffer) {
+            std::lock_guard<std::mutex> lock(g_registryMutex);
+            if (!g_freeBuffers.empty()) {
+                t_state.Buffer = g_freeBuffers.back();
+                g_freeBuffers.pop_back();
+            }
+            else {
+                auto buffer = std::make_unique<ThreadBuffer>();
+                buffer->Events.reset(new EventSlot[Profiler::kThreadEvents]);
+                buffer->TraceId = (int)g_threadBuffers.size() + 1; // 0 - дорожка GPU
+                t_state.Buffer = buffer.get();
+                g_threadBuffers.push_back(std::move(buffer));
+            }
+        }
+        return t_state.Buffer;
+    }
+
+    bool ReadEvent(const ThreadBuffer& buffer, unsigned long long index, CPUEvent& out) {
+        const EventSlot& slot = buffer.Events[index % Profiler::kThreadEvents];
+        const unsigned long long published = index * 2 + 2;
+        if (slot.Sequence.load(std::memory_order_acquire) != published) return false;
+        out.Name = slot.Name.load(std::memory_order_relaxed);
+        out.StartNs = slot.StartNs.load(std::memory_order_relaxed);
+        out.EndNs = slot.EndNs.load(std::memory_order_relaxed);
+        out.Depth = slot.Depth.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.Sequence.load(std::memory_order_relaxed) == published;
+    }
+
+    long long NowNs() {
+        static const auto origin = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void WriteJsonString(std::ofstream& file, const char* text) {
+        file << '"';
+        for (const char* c = text ? text : ""; *c; ++c) {
+            if (*c == '"' || *c == '\\') file << '\\' << *c;
+            else if ((unsigned char)*c < 0x20) file << ' ';
+            else file << *c;
+        }
+        file << '"';
+    }
+
+    void WriteTraceEvent(std::ofstream& file, bool& first, const char* name, const char* category, int tid,
+                         long long startNs, long long durationNs, int depth) {
+        file << (first ? "\n" : ",\n");
+        first = false;
+        file << "{\"name\":";
+        WriteJsonString(file, name);
+        file << ",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+             << ",\"ts\":" << startNs / 1000.0 << ",\"dur\":" << durationNs / 1000.0
+             << ",\"args\":{\"depth\":" << depth << "}}";
+    }
+}
+
+Profiler::~Profiler() {
+    Shutdown();
+}
+
+void Profiler::Initialize(BackendInterface* backend) {
+    Shutdown();
+    m_backend = backend;
+    m_renderThread = std::this_thread::get_id();
+    m_frameStartNs = NowNs();
+    SetCPUScopesEnabled(m_enabled);
+
+    // Пул таймеров создается сразу: создание запросов посреди кадра дает лишние провалы
+    if (m_backend) {
+        for (int i = 0; i < kMaxGPUScopes; ++i) {
+            GPUScope scope;
+            scope.Handle = m_backend->CreateGPUTimer();
+            if (!scope.Handle) break;
+            m_gpuScopes.push_back(scope);
+            m_freeGPUScopes.push_back(i);
+        }
+    }
+    m_gpuEvents.resize(m_gpuScopes.empty() ? 0 : kMaxGPUEvents);
+
+    // События, записанные до инициализации, в сводку первого кадра не попадают
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    for (auto& buffer : g_threadBuffers) buffer->ReadCursor = buffer->Written.load(std::memory_order_acquire);
+}
+
+void Profiler::Shutdown() {
+    if (m_backend) {
+        for (GPUScope& scope : m_gpuScopes) m_backend->ReleaseGPUTimer(scope.Handle);
+    }
+    m_gpuScopes.clear();
+    m_freeGPUScopes.clear();
+    m_pendingGPUScopes.clear();
+    m_gpuStack.clear();
+    m_gpuEvents.clear();
+    m_gpuEventCount = 0;
+    m_pendingFrames.clear();
+    m_backend = nullptr;
+}
+
+void Profiler::BeginCPUScope(const char* name) {
+    ThreadState& state = t_state;
+    const int depth = state.Depth++;
+    if (depth >= kMaxDepth) return; // слишком глубоко - scope не пишется, но баланс Begin/End сохраняется
+    if (!g_enabled.load(std::memory_order_relaxed)) {
+        state.Recorded &= ~(1u << depth);
+        return;
+    }
+    GetThreadBuffer();
+    state.Recorded |= 1u << depth;
+    state.StackName[depth] = name;
+    state.StackStart[depth] = NowNs();
+}
+
+void Profiler::EndCPUScope() {
+    ThreadState& state = t_state;
+    if (state.Depth == 0) return;
+    const int depth = --state.Depth;
+    if (depth >= kMaxDepth || !(state.Recorded & (1u << depth))) return;
+
+    ThreadBuffer* buffer = state.Buffer;
+    const unsigned long long index = buffer->Written.load(std::memory_order_relaxed);
+    EventSlot& slot = buffer->Events[index % kThreadEvents];
+    slot.Sequence.store(index * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.Name.store(state.StackName[depth] ? state.StackName[depth] : "", std::memory_order_relaxed);
+    slot.StartNs.store(state.StackStart[depth], std::memory_order_relaxed);
+    slot.EndNs.store(NowNs(), std::memory_order_relaxed);
+    slot.Depth.store(depth, std::memory_order_relaxed);
+    slot.Sequence.store(index * 2 + 2, std::memory_order_release);
+    buffer->Written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::SetCPUScopesEnabled(bool enabled) {
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Profiler::AreCPUScopesEnabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+int Profiler::GetThreadBufferCount() {
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    return (int)g_threadBuffers.size();
+}
+
+void Profiler::BeginScope(const char* name, bool gpu) {
+    if (!m_enabled) return;
+    if (!name) name = "";
+    BeginCPUScope(name);
+
+    if (std::this_thread::get_id() != m_renderThread) return;
+    int slot = -1;
+    if (gpu && !m_freeGPUScopes.empty()) {
+        slot = m_freeGPUScopes.back();
+        m_freeGPUScopes.pop_back();
+        GPUScope& scope = m_gpuScopes[slot];
+        scope.Name = name;
+        scope.Depth = t_state.Depth - 1;
+        scope.Frame = m_frame;
+        scope.StartNs = NowNs();
+        m_backend->BeginGPUTimer(scope.Handle);
+    }
+    m_gpuStack.push_back(slot);
+}
+
+void Profiler::EndScope() {
+    if (!m_enabled) return;
+
+    if (std::this_thread::get_id() == m_renderThread && !m_gpuStack.empty()) {
+        int slot = m_gpuStack.back();
+        m_gpuStack.pop_back();
+        if (slot >= 0) {
+            m_backend->EndGPUTimer(m_gpuScopes[slot].Handle);
+            m_pendingGPUScopes.push_back(slot);
+        }
+    }
+    EndCPUScope();
+}
+
+void Profiler::AddToSummary(ProfileFrameSummary& summary, const char* name, int depth, double cpuMs, double gpuMs) {
+    ProfileScopeStats* stats = nullptr;
+    for (ProfileScopeStats& s : summary.Scopes) {
+        if (s.Depth == depth && s.Name == name) {
+            stats = &s;
+            break;
+        }
+    }
+    if (!stats) {
+        summary.Scopes.push_back(ProfileScopeStats());
+        stats = &summary.Scopes.back();
+        stats->Name = name;
+        stats->Depth = depth;
+    }
+    if (cpuMs >= 0.0) {
+        stats->Calls++;
+        stats->CpuMilliseconds += cpuMs;
+    }
+    if (gpuMs >= 0.0) stats->GpuMilliseconds = std::max(stats->GpuMilliseconds, 0.0) + gpuMs;
+}
+
+void Profiler::CollectCPUEvents(ProfileFrameSummary& summary) {
+    std::vector<CPUEvent> events;
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    for (auto& buffer : g_threadBuffers) {
+        unsigned long long written = buffer->Written.load(std::memory_order_acquire);
+        unsigned long long first = std::max(buffer->ReadCursor, written > (unsigned long long)kThreadEvents ? written - kThreadEvents : 0ull);
+        summary.DroppedEvents += first - buffer->ReadCursor;
+        events.clear();
+        for (unsigned long long i = first; i < written; ++i) {
+            CPUEvent e;
+            if (ReadEvent(*buffer, i, e)) events.push_back(e);
+            else summary.DroppedEvents++;
+        }
+        buffer->ReadCursor = written;
+
+        // События пишутся по закрытию (вложенные раньше внешних), в сводке нужен порядок открытия
+        std::sort(events.begin(), events.end(), [](const CPUEvent& a, const CPUEvent& b) { return a.StartNs < b.StartNs; });
+        for (const CPUEvent& e : events) AddToSummary(summary, e.Name, e.Depth, (e.EndNs - e.StartNs) / 1e6, -1.0);
+    }
+}
+
+void Profiler::CollectGPUResults() {
+    for (size_t i = 0; i < m_pendingGPUScopes.size();) {
+        int slot = m_pendingGPUScopes[i];
+        GPUScope& scope = m_gpuScopes[slot];
+        double ms = 0.0;
+        if (!m_backend->GetGPUTimerResult(scope.Handle, ms)) {
+            ++i;
+            continue;
+        }
+
+        if (ms >= 0.0) {
+            m_gpuEvents[m_gpuEventCount % m_gpuEvents.size()] = { scope.Name, scope.Depth, scope.StartNs, (long long)(ms * 1e6) };
+            m_gpuEventCount++;
+            for (ProfileFrameSummary& frame : m_pendingFrames) {
+                if (frame.Frame == scope.Frame) {
+                    AddToSummary(frame, scope.Name, scope.Depth, -1.0, ms);
+                    break;
+                }
+            }
+        }
+        m_freeGPUScopes.push_back(slot);
+        m_pendingGPUScopes[i] = m_pendingGPUScopes.back();
+        m_pendingGPUScopes.pop_back();
+    }
+}
+
+void Profiler::PublishFrames(bool force) {
+    while (!m_pendingFrames.empty()) {
+        const unsigned long long frame = m_pendingFrames.front().Frame;
+        bool waiting = false;
+        for (int slot : m_pendingGPUScopes) waiting = waiting || m_gpuScopes[slot].Frame <= frame;
+        for (int slot : m_gpuStack) waiting = waiting || (slot >= 0 && m_gpuScopes[slot].Frame <= frame);
+        // GPU может так и не ответить (потеря устройства, scope без EndScope) - сводку все равно публикуем
+        if (waiting && !force && m_frame - frame < (unsigned long long)kMaxFrameLatency) break;
+
+        m_lastFrame = std::move(m_pendingFrames.front());
+        m_pendingFrames.pop_front();
+    }
+}
+
+void Profiler::EndFrame() {
+    long long now = NowNs();
+    // Переключение только между кадрами, чтобы не разорвать пары BeginScope/EndScope. Общий переключатель CPU
+    // трогаем только при изменении - иначе каждый кадр затирали бы то, что выставили через SetCPUScopesEnabled
+    if (m_enabled != m_enabledRequest) {
+        m_enabled = m_enabledRequest;
+        SetCPUScopesEnabled(m_enabled);
+    }
+
+    ProfileFrameSummary summary;
+    summary.Frame = m_frame;
+    summary.CpuMilliseconds = (now - m_frameStartNs) / 1e6;
+    CollectCPUEvents(summary);
+    m_pendingFrames.push_back(std::move(summary));
+
+    if (m_backend) CollectGPUResults();
+    PublishFrames(false);
+
+    m_frame++;
+    m_frameStartNs = now;
+}
+
+bool Profiler::ExportChromeTrace(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        std::cerr << "[Profiler] Can't write trace: " << path << std::endl;
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        for (const auto& buffer : g_threadBuffers) {
+            file << (first ? "\n" : ",\n");
+            first = false;
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->TraceId
+                 << ",\"args\":{\"name\":\"CPU " << buffer->TraceId << "\"}}";
+
+            unsigned long long written = buffer->Written.load(std::memory_order_acquire);
+            unsigned long long begin = written > (unsigned long long)kThreadEvents ? written - kThreadEvents : 0ull;
+            for (unsigned long long i = begin; i < written; ++i) {
+                CPUEvent e;
+                if (!ReadEvent(*buffer, i, e)) continue;
+                WriteTraceEvent(file, first, e.Name, "cpu", buffer->TraceId, e.StartNs, e.EndNs - e.StartNs, e.Depth);
+            }
+        }
+    }
+
+    // Длительность GPU точная, начало привязано к CPU-времени открытия scope (часы GPU с CPU не синхронизированы)
+    if (!m_gpuEvents.empty()) {
+        file << (first ? "\n" : ",\n");
+        first = false;
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+        size_t count = std::min(m_gpuEventCount, m_gpuEvents.size());
+        for (size_t i = m_gpuEventCount - count; i < m_gpuEventCount; ++i) {
+            const GPUEvent& e = m_gpuEvents[i % m_gpuEvents.size()];
+            WriteTraceEvent(file, first, e.Name, "gpu", 0, e.StartNs, e.DurationNs, e.Depth);
+        }
+    }
+
+    file << "\n]}\n";
+    std::cout << "[Profiler] Trace written: " << path << std::endl;
+    return (bool)file;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "RendeructorAPI.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+
+// Define as 0 before including Rendeructor.h to compile RENDER_PROFILE_SCOPE / RENDER_PROFILE_CPU_SCOPE out of the
+// client code. The library itself is built the same way either way.
+#ifndef RENDERUCTOR_PROFILING
+#define RENDERUCTOR_PROFILING 1
+#endif
+
+class BackendInterface;
+
+struct ProfileScopeStats {
+    std::string Name;
+    int Depth = 0;
+    int Calls = 0;
+    double CpuMilliseconds = 0.0;  // sum over all calls on all threads
+    double GpuMilliseconds = -1.0; // -1: scope was not timed on the GPU
+};
+
+struct ProfileFrameSummary {
+    unsigned long long Frame = 0;
+    double CpuMilliseconds = 0.0;          // Present to Present
+    std::vector<ProfileScopeStats> Scopes; // in order of first start
+    unsigned long long DroppedEvents = 0;  // overwritten in a thread's ring before they were read
+};
+
+// Hierarchical scope profiler.
+// Every thread records CPU scopes into its own fixed-size ring buffer without locks; the render thread additionally
+// brackets its scopes with GPU timestamp queries when the backend has them. Once per frame (Present) the new events
+// are folded into a per-frame summary, GPU results follow a few frames later. The buffers can be exported as a
+// Chrome trace (chrome://tracing, Perfetto).
+// Ring slots carry sequence numbers, so events overwritten while being read are dropped and counted, not misread.
+// A ring is allocated on the first recorded scope of a thread and handed to the next new thread when it exits.
+// Scope names must outlive the profiler (string literals): only the pointer is stored.
+// The thread rings and the CPU recording switch are process-wide, not per instance: one profiler (the render
+// thread's) is expected to collect them.
+class RENDER_API Profiler {
+public:
+    static const int kMaxDepth = 32;
+    static const int kThreadEvents = 1 << 14;  // per thread, older events are overwritten
+    static const int kMaxGPUScopes = 128;      // GPU-timed scopes in flight
+    static const int kMaxGPUEvents = 1 << 14;  // GPU events kept for the trace
+    static const int kMaxFrameLatency = 8;     // frames to wait for GPU results before a summary is published
+
+    Profiler() = default;
+    ~Profiler();
+
+    // Called by Rendeructor: the calling thread becomes the render thread
+    void Initialize(BackendInterface* backend);
+    void Shutdown();
+
+    // Takes effect at the end of the frame so that open scopes stay balanced. A change is also applied to the
+    // process-wide CPU switch below, so it affects CPU scopes on every thread.
+    void SetEnabled(bool enabled) { m_enabledRequest = enabled; }
+    bool IsEnabled() const { return m_enabled; }
+
+    // Scope with GPU timing when called on the render thread (and the backend supports timestamps)
+    void BeginScope(const char* name, bool gpu = true);
+    void EndScope();
+    void EndFrame();
+
+    // CPU-only scopes, usable from any thread and from inside the library without a Profiler instance.
+    // Nothing is recorded (and no ring allocated) while CPU scopes are disabled
+    static void BeginCPUScope(const char* name);
+    static void EndCPUScope();
+    // Process-wide CPU recording switch, set by Initialize and by SetEnabled changes. A scope open while it flips
+    // still ends balanced: it is recorded only if it was recorded when it began.
+    static void SetCPUScopesEnabled(bool enabled);
+    static bool AreCPUScopesEnabled();
+    // Rings allocated so far; stays at the peak number of threads that recorded scopes at the same time
+    static int GetThreadBufferCount();
+
+    // Latest frame whose GPU timings are complete
+    const ProfileFrameSummary& GetFrameSummary() const { return m_lastFrame; }
+    bool ExportChromeTrace(const std::string& path) const;
+
+private:
+    struct GPUScope {
+        void* Handle = nullptr;
+        const char* Name = nullptr;
+        int Depth = 0;
+        unsigned long long Frame = 0;
+        long long StartNs = 0;
+    };
+    struct GPUEvent {
+        const char* Name;
+        int Depth;
+        long long StartNs;
+        long long DurationNs;
+    };
+
+    void CollectCPUEvents(ProfileFrameSummary& summary);
+    void CollectGPUResults();
+    void PublishFrames(bool force);
+    static void AddToSummary(ProfileFrameSummary& summary, const char* name, int depth, double cpuMs, double gpuMs);
+
+    BackendInterface* m_backend = nullptr;
+    std::thread::id m_renderThread;
+    bool m_enabled = true;
+    bool m_enabledRequest = true;
+    unsigned long long m_frame = 0;
+    long long m_frameStartNs = 0;
+
+    std::vector<GPUScope> m_gpuScopes;
+    std::vector<int> m_freeGPUScopes;
+    std::vector<int> m_pendingGPUScopes;
+    std::vector<int> m_gpuStack;        // scope slot per open render-thread scope, -1 without GPU timing
+    std::vector<GPUEvent> m_gpuEvents;  // ring
+    size_t m_gpuEventCount = 0;
+
+    std::deque<ProfileFrameSummary> m_pendingFrames; // waiting for GPU results
+    ProfileFrameSummary m_lastFrame;
+};
+
+class ProfileCPUScope {
+public:
+    explicit ProfileCPUScope(const char* name) { Profiler::BeginCPUScope(name); }
+    ~ProfileCPUScope() { Profiler::EndCPUScope(); }
+    ProfileCPUScope(const ProfileCPUScope&) = delete;
+    ProfileCPUScope& operator=(const ProfileCPUScope&) = delete;
+};
+
+#define RENDER_PROFILE_CONCAT_(a, b) a##b
+#define RENDER_PROFILE_CONCAT(a, b) RENDER_PROFILE_CONCAT_(a, b)
+#if RENDERUCTOR_PROFILING
+#define RENDER_PROFILE_CPU_SCOPE(name) ProfileCPUScope RENDER_PROFILE_CONCAT(profileCPUScope_, __LINE__)(name)
+#else
+#define RENDER_PROFILE_CPU_SCOPE(name) ((void)0)
+#endif
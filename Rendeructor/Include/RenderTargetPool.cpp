@@ -0,0 +1,138 @@
+﻿#include "pch.h"
+#include "RenderTargetPool.h"
+
+RenderTargetPool::~RenderTargetPool() {
+    Shutdown();
+}
+
+void RenderTargetPool::Initialize(CreateFunc create, DestroyFunc destroy, size_t budgetBytes, int maxUnusedFrames) {
+    Shutdown();
+    m_create = std::move(create);
+    m_destroy = std::move(destroy);
+    m_budget = budgetBytes;
+    SetMaxUnusedFrames(maxUnusedFrames);
+    m_frame = 0;
+    m_stats = RenderTargetPoolStats();
+}
+
+void RenderTargetPool::Shutdown() {
+    while (!m_entries.empty()) DestroyEntry(m_entries.size() - 1);
+}
+
+size_t RenderTargetPool::GetTargetBytes(const RenderTargetDesc& desc) {
+    size_t bytesPerPixel = 4;
+    switch (desc.Format) {
+    case TextureFormat::R8: bytesPerPixel = 1; break;
+    case TextureFormat::R16F: bytesPerPixel = 2; break;
+    case TextureFormat::RGBA16F: bytesPerPixel = 8; break;
+    case TextureFormat::RGBA32F: bytesPerPixel = 16; break;
+    default: bytesPerPixel = 4; break;
+    }
+    return (size_t)std::max(desc.Width, 0) * (size_t)std::max(desc.Height, 0) * bytesPerPixel;
+}
+
+void* RenderTargetPool::Acquire(const RenderTargetDesc& desc) {
+    m_stats.Acquires++;
+
+    // Из подходящих свободных берем самый свежий - он скорее всего еще в кэше драйвера,
+    // а старые быстрее доживут до вытеснения
+    Entry* best = nullptr;
+    for (auto& entry : m_entries) {
+        if (entry.InUse || !(entry.Desc == desc)) continue;
+        if (!best || entry.LastUsedFrame > best->LastUsedFrame) best = &entry;
+    }
+
+    if (!best) {
+        if (!m_create) return nullptr;
+        const size_t bytes = GetTargetBytes(desc);
+        MakeRoom(bytes);
+
+        void* handle = m_create(desc);
+        if (!handle) return nullptr;
+
+        Entry entry;
+        entry.Desc = desc;
+        entry.Handle = handle;
+        entry.Bytes = bytes;
+        m_entries.push_back(entry);
+        best = &m_entries.back();
+
+        m_stats.Allocations++;
+        m_stats.Targets++;
+        m_stats.BytesAllocated += bytes;
+        m_stats.PeakBytes = std::max(m_stats.PeakBytes, m_stats.BytesAllocated);
+        if (m_stats.BytesAllocated > m_budget) m_stats.OverBudgetAllocations++;
+    }
+
+    best->InUse = true;
+    best->LastUsedFrame = m_frame;
+    m_stats.TargetsInUse++;
+    m_stats.BytesInUse += best->Bytes;
+    return best->Handle;
+}
+
+bool RenderTargetPool::Release(void* handle) {
+    if (!handle) return false;
+    for (auto& entry : m_entries) {
+        if (entry.Handle != handle) continue;
+        if (!entry.InUse) return false;
+        entry.InUse = false;
+        entry.LastUsedFrame = m_frame;
+        m_stats.TargetsInUse--;
+        m_stats.BytesInUse -= entry.Bytes;
+        return true;
+    }
+    return false;
+}
+
+void RenderTargetPool::EndFrame() {
+    m_frame++;
+    // Цели старого размера (после ресайза окна) и цели выключенных эффектов уходят сами
+    for (size_t i = m_entries.size(); i-- > 0;) {
+        const Entry& entry = m_entries[i];
+        if (!entry.InUse && m_frame - entry.LastUsedFrame > (unsigned long long)m_maxUnusedFrames) {
+            DestroyEntry(i);
+            m_stats.Evictions++;
+        }
+    }
+}
+
+void RenderTargetPool::Trim() {
+    for (size_t i = m_entries.size(); i-- > 0;) {
+        if (!m_entries[i].InUse) {
+            DestroyEntry(i);
+            m_stats.Evictions++;
+        }
+    }
+}
+
+void RenderTargetPool::SetBudget(size_t bytes) {
+    m_budget = bytes;
+    MakeRoom(0);
+}
+
+void RenderTargetPool::MakeRoom(size_t bytes) {
+    while (m_stats.BytesAllocated + bytes > m_budget) {
+        size_t oldest = m_entries.size();
+        for (size_t i = 0; i < m_entries.size(); ++i) {
+            if (m_entries[i].InUse) continue;
+            if (oldest == m_entries.size() || m_entries[i].LastUsedFrame < m_entries[oldest].LastUsedFrame) oldest = i;
+        }
+        // Все оставшиеся заняты - бюджет будет превышен, но отказать в цели посреди кадра хуже
+        if (oldest == m_entries.size()) break;
+        DestroyEntry(oldest);
+        m_stats.Evictions++;
+    }
+}
+
+void RenderTargetPool::DestroyEntry(size_t index) {
+    Entry& entry = m_entries[index];
+    if (m_destroy && entry.Handle) m_destroy(entry.Handle);
+    if (entry.InUse) {
+        m_stats.TargetsInUse--;
+        m_stats.BytesInUse -= entry.Bytes;
+    }
+    m_stats.Targets--;
+    m_stats.BytesAllocated -= entry.Bytes;
+    m_entries.erase(m_entries.begin() + index);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "RendeructorDefines.h"
+#include <functional>
+
+// Writable by compute shaders as well (Texture::CreateStorage)
+constexpr unsigned int RenderTargetFlagStorage = 1u;
+
+struct RenderTargetDesc {
+    int Width = 0;
+    int Height = 0;
+    TextureFormat Format = TextureFormat::RGBA8;
+    unsigned int Flags = 0; // RenderTargetFlag* creation flags, part of the key
+
+    bool operator==(const RenderTargetDesc& other) const {
+        return Width == other.Width && Height == other.Height && Format == other.Format && Flags == other.Flags;
+    }
+};
+
+struct RenderTargetPoolStats {
+    int Targets = 0;          // allocated, in use or free
+    int TargetsInUse = 0;
+    size_t BytesAllocated = 0;
+    size_t BytesInUse = 0;
+    size_t PeakBytes = 0;
+    // Totals since Initialize
+    unsigned long long Acquires = 0;
+    unsigned long long Allocations = 0;    // acquires that had to create a target
+    unsigned long long Evictions = 0;
+    unsigned long long OverBudgetAllocations = 0;
+};
+
+// Recycles temporary render targets across passes and frames.
+// Targets are matched by descriptor; a released target is handed out again to the next Acquire with the same
+// descriptor. Free targets are destroyed when unused for MaxUnusedFrames or, least recently used first, when a new
+// allocation would exceed the memory budget. Targets in use are never destroyed, so the budget can be overrun by them.
+// The pool only keeps handles: creation and destruction go through the callbacks, which keeps the policy GPU free.
+class RENDER_API RenderTargetPool {
+public:
+    using CreateFunc = std::function<void*(const RenderTargetDesc&)>;
+    using DestroyFunc = std::function<void(void*)>;
+
+    RenderTargetPool() = default;
+    ~RenderTargetPool();
+    RenderTargetPool(const RenderTargetPool&) = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+    void Initialize(CreateFunc create, DestroyFunc destroy, size_t budgetBytes, int maxUnusedFrames = 60);
+    // Destroys all targets, including the ones still in use
+    void Shutdown();
+
+    // nullptr when the target could not be created
+    void* Acquire(const RenderTargetDesc& desc);
+    // false for handles that are not acquired from this pool
+    bool Release(void* handle);
+    // Advances the frame counter and destroys targets that stayed free for too long
+    void EndFrame();
+    // Destroys all free targets
+    void Trim();
+
+    void SetBudget(size_t bytes);
+    size_t GetBudget() const { return m_budget; }
+    void SetMaxUnusedFrames(int frames) { m_maxUnusedFrames = frames < 0 ? 0 : frames; }
+    int GetMaxUnusedFrames() const { return m_maxUnusedFrames; }
+
+    const RenderTargetPoolStats& GetStats() const { return m_stats; }
+
+    static size_t GetTargetBytes(const RenderTargetDesc& desc);
+
+private:
+    struct Entry {
+        RenderTargetDesc Desc;
+        void* Handle = nullptr;
+        size_t Bytes = 0;
+        bool InUse = false;
+        unsigned long long LastUsedFrame = 0;
+    };
+
+    // Destroys free targets, least recently used first, until 'bytes' more fit the budget
+    void MakeRoom(size_t bytes);
+    void DestroyEntry(size_t index);
+
+    CreateFunc m_create;
+    DestroyFunc m_destroy;
+    std::vector<Entry> m_entries;
+    size_t m_budget = 0;
+    int m_maxUnusedFrames = 60;
+    unsigned long long m_frame = 0;
+    RenderTargetPoolStats m_stats;
+};
@@ -1,48 +1,182 @@
+// Keep this file ASCII (English comments): it has no BOM, and MSVC reads it in the system code page (C4819)
 #include "pch.h"
 #include "Rendeructor.h"
 #include "BackendDX11.h"
+#include <iostream>
 
-Rendeructor* Rendeructor::s_instance = nullptr;
+std::atomic<Rendeructor*> Rendeructor::s_instance = nullptr;
 
 Rendeructor::Rendeructor() {
     s_instance = this;
+    // Budget callbacks usually release resources, which only the render thread may do
+    m_memoryTracker.SetBudgetNotifier([this](const MemoryBudgetEvent& event) {
+        RunOnRenderThread([this, event] { m_memoryTracker.NotifyBudgetCallbacks(event); });
+    });
 }
 
 Rendeructor::~Rendeructor() {
     Destroy();
-    if (s_instance == this) s_instance = nullptr;
+    Rendeructor* self = this;
+    s_instance.compare_exchange_strong(self, nullptr);
 }
 
 Rendeructor* Rendeructor::GetCurrent() {
-    return s_instance;
+    return s_instance.load();
+}
+
+BackendInterface* Rendeructor::AttachBackend(Rendeructor*& renderer) {
+    if (!renderer) renderer = GetCurrent();
+    return renderer ? renderer->m_backend : nullptr;
 }
 
 bool Rendeructor::Create(const BackendConfig& config) {
-    m_currentConfig = config;
+    if (config.API != RenderAPI::DirectX11) return false;
+    const bool created = Create(config, new BackendDX11());
+    // Ours even when it failed to initialize: Destroy() deletes it
+    m_ownsBackend = true;
+    return created;
+}
 
-    if (config.API == RenderAPI::DirectX11) {
-        m_backend = new BackendDX11();
-    }
+bool Rendeructor::Create(const BackendConfig& config, BackendInterface* backend) {
+    m_currentConfig = config;
+    m_renderThread = std::this_thread::get_id();
+    m_backend = backend;
+    m_ownsBackend = false;
 
     if (!m_backend) return false;
 
-    return m_backend->Initialize(config);
+    m_memoryTracker.SetBudget(config.MemoryBudgetBytes);
+    m_backend->SetMemoryTracker(&m_memoryTracker);
+    if (!m_backend->Initialize(config)) return false;
+    m_profiler.Initialize(m_backend);
+    if (!config.FrameOutputPattern.empty()) SetFrameOutput(config.FrameOutputPattern);
+    m_transientPool.Initialize(
+        [this](const RenderTargetDesc& desc) -> void* {
+            if (!m_backend) return nullptr;
+            if (desc.Flags & RenderTargetFlagStorage) return m_backend->CreateStorageTextureResource(desc.Width, desc.Height, (int)desc.Format, nullptr);
+            return m_backend->CreateTextureResource(desc.Width, desc.Height, (int)desc.Format, nullptr);
+        },
+        [this](void* handle) { if (m_backend) m_backend->ReleaseTexture(handle); },
+        config.TransientPoolBudgetBytes);
+    if (config.UseGeometryArena) {
+        m_geometryArena.Initialize(m_backend, config.GeometryArenaPageVertices, config.GeometryArenaPageIndices);
+    }
+    return true;
 }
 
 void Rendeructor::Destroy() {
+    // Releases queued by other threads still need the backend, the pool and the arena
+    RunRenderThreadTasks();
+    // Finish pending readbacks while the backend is still alive:
+    // callers wait for their callbacks and frames for their disk writes
+    FlushReadbacks();
+    m_frameWriter.Stop();
+    m_frameOutputPattern.clear();
+    m_frameOutputSource = nullptr;
+    m_profiler.Shutdown();
+    m_transientPool.Shutdown();
+    m_geometryArena.Shutdown();
+    if (m_backend && m_autoInstanceBuffer) m_backend->ReleaseBuffer(m_autoInstanceBuffer);
+    m_autoInstanceBuffer = nullptr;
+    m_autoInstanceBufferSize = 0;
+    m_autoInstanceActive = false;
+    m_autoInstanceConstant.clear();
+    m_autoInstanceConstantPending = false;
     if (m_backend) {
         m_backend->Shutdown();
-        delete m_backend;
+        if (m_ownsBackend) delete m_backend;
         m_backend = nullptr;
     }
+    m_mapCalls = 0;
+}
+
+void Rendeructor::RunOnRenderThread(std::function<void()> task) {
+    if (IsRenderThread()) {
+        task();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_renderTasksMutex);
+    m_renderTasks.push_back(std::move(task));
+}
+
+int Rendeructor::GetPendingRenderThreadTasks() const {
+    std::lock_guard<std::mutex> lock(m_renderTasksMutex);
+    return (int)m_renderTasks.size();
+}
+
+void Rendeructor::RunRenderThreadTasks() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(m_renderTasksMutex);
+        tasks.swap(m_renderTasks);
+    }
+    // Outside the lock: tasks may queue more work (a budget callback releasing resources runs them right away)
+    for (auto& task : tasks) task();
+}
+
+void Rendeructor::ReleaseTexture(void* handle) {
+    if (!handle) return;
+    RunOnRenderThread([this, handle] { if (m_backend) m_backend->ReleaseTexture(handle); });
+}
+
+void Rendeructor::ReleaseBuffer(void* handle) {
+    if (!handle) return;
+    RunOnRenderThread([this, handle] { if (m_backend) m_backend->ReleaseBuffer(handle); });
+}
+
+void Rendeructor::UpdateBuffer(void* handle, const void* data, size_t size, size_t offset) {
+    if (!handle || !data || size == 0) return;
+    if (IsRenderThread()) {
+        if (m_backend) m_backend->UpdateBuffer(handle, data, size, offset);
+        CountMapCall();
+        return;
+    }
+    std::vector<unsigned char> copy((const unsigned char*)data, (const unsigned char*)data + size);
+    RunOnRenderThread([this, handle, offset, copy = std::move(copy)] {
+        if (m_backend) m_backend->UpdateBuffer(handle, copy.data(), copy.size(), offset);
+        CountMapCall();
+    });
 }
 
 void Rendeructor::Restart(const BackendConfig& config) {
+    BackendInterface* injected = m_ownsBackend ? nullptr : m_backend;
     Destroy();
-    Create(config);
+    if (injected) Create(config, injected);
+    else Create(config);
+}
+
+void Rendeructor::CountPipelineState(const PipelineState& state) {
+    if (state.Cull != m_currentState.Cull || state.Blend != m_currentState.Blend || state.DepthFunc != m_currentState.DepthFunc ||
+        state.DepthWrite != m_currentState.DepthWrite || state.ScissorTest != m_currentState.ScissorTest) {
+        m_frameStats.PipelineStateChanges++;
+    }
+}
+
+void Rendeructor::CountRenderTargets(void* t1, void* t2, void* t3, void* t4, void* depth) {
+    void* targets[4] = { t1, t2, t3, t4 };
+    bool changed = depth != m_boundDepth;
+    m_boundDepth = depth;
+    for (int i = 0; i < 4; ++i) {
+        changed = changed || targets[i] != m_boundTargets[i];
+        m_boundTargets[i] = targets[i];
+    }
+    if (changed) m_frameStats.RenderTargetSwitches++;
+}
+
+FrameStats Rendeructor::GetFrameStats() const {
+    FrameStats stats = m_frameStats;
+    stats.MapCalls += m_mapCalls.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void Rendeructor::SetFrameStatsHistorySize(int frames) {
+    m_frameStatsHistorySize = std::max(frames, 1);
+    while ((int)m_frameStatsHistory.size() > m_frameStatsHistorySize) m_frameStatsHistory.pop_front();
 }
 
 void Rendeructor::SetPipelineState(const PipelineState& state) {
+    FlushAutoInstancing();
+    CountPipelineState(state);
     m_currentState = state;
     if (m_backend) {
         m_backend->SetPipelineState(state);
@@ -50,27 +184,34 @@ void Rendeructor::SetPipelineState(const PipelineState& state) {
 }
 
 void Rendeructor::ResetPipelineStateCache() {
+    FlushAutoInstancing();
     if (m_backend) {
         m_backend->ResetPipelineStateCache();
     }
 }
 
 void Rendeructor::SetCullMode(CullMode mode) {
+    FlushAutoInstancing();
     if (m_currentState.Cull != mode) {
+        m_frameStats.PipelineStateChanges++;
         m_currentState.Cull = mode;
         if (m_backend) m_backend->SetPipelineState(m_currentState);
     }
 }
 
 void Rendeructor::SetBlendMode(BlendMode mode) {
+    FlushAutoInstancing();
     if (m_currentState.Blend != mode) {
+        m_frameStats.PipelineStateChanges++;
         m_currentState.Blend = mode;
         if (m_backend) m_backend->SetPipelineState(m_currentState);
     }
 }
 
 void Rendeructor::SetDepthState(CompareFunc func, bool writeEnabled) {
+    FlushAutoInstancing();
     if (m_currentState.DepthFunc != func || m_currentState.DepthWrite != writeEnabled) {
+        m_frameStats.PipelineStateChanges++;
         m_currentState.DepthFunc = func;
         m_currentState.DepthWrite = writeEnabled;
         if (m_backend) m_backend->SetPipelineState(m_currentState);
@@ -78,20 +219,39 @@ void Rendeructor::SetDepthState(CompareFunc func, bool writeEnabled) {
 }
 
 void Rendeructor::SetScissorEnabled(bool enabled) {
+    FlushAutoInstancing();
     if (m_currentState.ScissorTest != enabled) {
+        m_frameStats.PipelineStateChanges++;
         m_currentState.ScissorTest = enabled;
         if (m_backend) m_backend->SetPipelineState(m_currentState);
     }
 }
 
 void Rendeructor::SetScissor(int x, int y, int width, int height) {
+    FlushAutoInstancing();
     if (m_backend) m_backend->SetScissorRect(x, y, width, height);
 }
 
 void Rendeructor::SetShaderPass(ShaderPass& pass) {
+    FlushAutoInstancing();
     if (m_backend) {
         m_backend->PrepareShaderPass(pass);
         m_backend->SetShaderPass(pass);
+
+        // The previous pass's constant values already went to the backend; a new pass starts capturing again
+        if (!pass.IsCompute()) {
+            m_autoInstanceActive = m_autoInstancing && pass.HasInstancedVariant();
+            m_autoInstanceConstantName = pass.InstancedConstant;
+            m_autoInstanceConstant.clear();
+        }
+
+        // Compute and graphics passes are bound independently
+        const ShaderPass*& bound = pass.IsCompute() ? m_boundComputePass : m_boundPass;
+        if (bound != &pass) m_frameStats.ShaderSwitches++;
+        bound = &pass;
+        m_frameStats.TextureBinds += (int)(pass.GetTextures().size() + pass.GetTextures3D().size() + pass.GetTexturesCube().size() +
+                                           pass.GetDepthTextures().size() + pass.GetStorageTextures().size());
+        m_frameStats.SamplerBinds += (int)pass.GetSamplers().size();
     }
 }
 
@@ -100,12 +260,18 @@ void Rendeructor::CompilePass(ShaderPass& pass) {
 }
 
 void Rendeructor::SetCustomConstant(const std::string& bufferName, const void* data, size_t size) {
-    if (m_backend) m_backend->UpdateConstantRaw(bufferName, data, size);
+    FlushAutoInstancing();
+    if (m_backend) {
+        m_backend->UpdateConstantRaw(bufferName, data, size);
+        m_frameStats.ConstantBytes += size;
+    }
 }
 
 void Rendeructor::SetRenderTarget(const Texture& target1, const Texture& target2,
     const Texture& target3, const Texture& target4) {
+    FlushAutoInstancing();
     if (m_backend) {
+        CountRenderTargets(target1.GetHandle(), target2.GetHandle(), target3.GetHandle(), target4.GetHandle());
         m_backend->SetRenderTarget(
             target1.GetHandle(),
             target2.GetHandle(),
@@ -115,71 +281,605 @@ void Rendeructor::SetRenderTarget(const Texture& target1, const Texture& target2
     }
 }
 
+void Rendeructor::SetRenderTarget(DepthBinding depth, const Texture& target1, const Texture& target2,
+    const Texture& target3, const Texture& target4) {
+    FlushAutoInstancing();
+    if (m_backend) {
+        CountRenderTargets(target1.GetHandle(), target2.GetHandle(), target3.GetHandle(), target4.GetHandle());
+        m_backend->SetRenderTargetWithDepth(target1.GetHandle(), target2.GetHandle(), target3.GetHandle(), target4.GetHandle(),
+                                            nullptr, depth == DepthBinding::Auto);
+    }
+}
+
+void Rendeructor::SetRenderTarget(const DepthTexture& depth, const Texture& target1, const Texture& target2,
+    const Texture& target3, const Texture& target4) {
+    FlushAutoInstancing();
+    if (m_backend) {
+        CountRenderTargets(target1.GetHandle(), target2.GetHandle(), target3.GetHandle(), target4.GetHandle(), depth.GetHandle());
+        m_backend->SetRenderTargetWithDepth(target1.GetHandle(), target2.GetHandle(), target3.GetHandle(), target4.GetHandle(),
+                                            depth.GetHandle(), false);
+    }
+}
+
+void Rendeructor::SetAutoDepthBudget(size_t bytes) {
+    m_currentConfig.AutoDepthBudgetBytes = bytes;
+    if (m_backend) m_backend->SetAutoDepthBudget(bytes);
+}
+
+void Rendeructor::SetTransientPoolBudget(size_t bytes) {
+    m_currentConfig.TransientPoolBudgetBytes = bytes;
+    m_transientPool.SetBudget(bytes);
+}
+
+size_t Rendeructor::GetAutoDepthMemory() const {
+    return m_backend ? m_backend->GetAutoDepthMemory() : 0;
+}
+
 void Rendeructor::RenderPassToTexture(const Texture& target) {
+    FlushAutoInstancing();
     if (m_backend) {
+        CountRenderTargets(target.GetHandle(), nullptr, nullptr, nullptr);
         m_backend->SetRenderTarget(target.GetHandle());
         m_backend->DrawFullScreenQuad();
+        m_frameStats.DrawCalls++;
+        m_frameStats.Instances++;
+        m_frameStats.Indices += 6;
     }
 }
 
 void Rendeructor::RenderPassToScreen() {
+    FlushAutoInstancing();
     if (m_backend) {
+        CountRenderTargets(nullptr, nullptr, nullptr, nullptr);
         m_backend->SetRenderTarget(nullptr, nullptr, nullptr, nullptr);
     }
 }
 
 void Rendeructor::Clear(float r, float g, float b, float a) {
-    if (m_backend) m_backend->Clear(r, g, b, a);
+    FlushAutoInstancing();
+    if (m_backend) {
+        m_backend->Clear(r, g, b, a);
+        m_frameStats.Clears++;
+    }
 }
 
 void Rendeructor::Clear(const Texture& target, float r, float g, float b, float a) {
-    if (m_backend) m_backend->ClearTexture(target.GetHandle(), r, g, b, a);
+    FlushAutoInstancing();
+    if (m_backend) {
+        m_backend->ClearTexture(target.GetHandle(), r, g, b, a);
+        m_frameStats.Clears++;
+    }
 }
 
 void Rendeructor::Clear(const Texture& t1, const Texture& t2, float r, float g, float b, float a) {
+    FlushAutoInstancing();
     if (m_backend) {
         m_backend->ClearTexture(t1.GetHandle(), r, g, b, a);
         m_backend->ClearTexture(t2.GetHandle(), r, g, b, a);
+        m_frameStats.Clears += 2;
     }
 }
 
 void Rendeructor::Clear(const Texture& t1, const Texture& t2, const Texture& t3, float r, float g, float b, float a) {
+    FlushAutoInstancing();
     if (m_backend) {
         m_backend->ClearTexture(t1.GetHandle(), r, g, b, a);
         m_backend->ClearTexture(t2.GetHandle(), r, g, b, a);
         m_backend->ClearTexture(t3.GetHandle(), r, g, b, a);
+        m_frameStats.Clears += 3;
     }
 }
 
 void Rendeructor::ClearDepth(float depth, int stencil) {
-    if (m_backend) m_backend->ClearDepth(depth, stencil);
+    FlushAutoInstancing();
+    if (m_backend) {
+        m_backend->ClearDepth(depth, stencil);
+        m_frameStats.Clears++;
+    }
+}
+
+void Rendeructor::Dispatch(int groupsX, int groupsY, int groupsZ) {
+    FlushAutoInstancing();
+    if (m_backend) {
+        m_backend->Dispatch(groupsX, groupsY, groupsZ);
+        m_frameStats.Dispatches++;
+    }
+}
+
+void Rendeructor::DispatchIndirect(const ComputeBuffer& args, unsigned int byteOffset) {
+    FlushAutoInstancing();
+    if (m_backend && args.GetType() == ComputeBufferType::IndirectArgs) {
+        m_backend->DispatchIndirect(args.GetHandle(), byteOffset);
+        m_frameStats.Dispatches++;
+    }
 }
 
 void Rendeructor::DrawMesh(const Mesh& mesh) {
     if (m_backend) {
-        m_backend->DrawMesh(mesh.GetVB(), mesh.GetIB(), mesh.GetIndexCount());
+        const int startIndex = mesh.GetStartIndex();
+        const int baseVertex = mesh.GetBaseVertex();
+        if (QueueAutoInstance(mesh.GetVB(), mesh.GetIB(), mesh.GetIndexCount(), startIndex, baseVertex)) return;
+        m_backend->DrawMesh(mesh.GetVB(), mesh.GetIB(), mesh.GetIndexCount(), startIndex, baseVertex);
+        m_frameStats.DrawCalls++;
+        m_frameStats.Instances++;
+        m_frameStats.Indices += mesh.GetIndexCount();
     }
 }
 
-void Rendeructor::DrawMeshInstanced(const Mesh& mesh, const InstanceBuffer& instances) {
+void Rendeructor::DrawMesh(const Mesh& mesh, const Math::float4x4& world) {
     if (m_backend) {
-        m_backend->DrawMeshInstanced(
-            mesh.GetVB(),
-            mesh.GetIB(),
-            mesh.GetIndexCount(),
-            instances.GetHandle(),
-            instances.GetCount(),
-            instances.GetStride()
-        );
+        MeshLOD lod = mesh.GetLOD(mesh.SelectLOD(m_lodCamera, world));
+        const int baseVertex = mesh.GetBaseVertex();
+        if (QueueAutoInstance(mesh.GetVB(), lod.IBHandle, lod.IndexCount, lod.StartIndex, baseVertex)) return;
+        m_backend->DrawMesh(mesh.GetVB(), lod.IBHandle, lod.IndexCount, lod.StartIndex, baseVertex);
+        m_frameStats.DrawCalls++;
+        m_frameStats.Instances++;
+        m_frameStats.Indices += lod.IndexCount;
+    }
+}
+
+void Rendeructor::DrawSubMesh(const Mesh& mesh, int subMesh) {
+    if (!m_backend) return;
+    SubMesh range = mesh.GetSubMesh(subMesh);
+    if (range.IndexCount <= 0) return;
+    range.StartIndex += mesh.GetStartIndex();
+    range.BaseVertex += mesh.GetBaseVertex();
+
+    if (QueueAutoInstance(mesh.GetVB(), mesh.GetIB(), range.IndexCount, range.StartIndex, range.BaseVertex)) return;
+    m_backend->DrawMesh(mesh.GetVB(), mesh.GetIB(), range.IndexCount, range.StartIndex, range.BaseVertex);
+    m_frameStats.DrawCalls++;
+    m_frameStats.Instances++;
+    m_frameStats.Indices += range.IndexCount;
+}
+
+void Rendeructor::DrawSubMeshInstanced(const Mesh& mesh, int subMesh, const InstanceBuffer& instances, int startInstance, int instanceCount) {
+    FlushAutoInstancing();
+    if (!m_backend) return;
+    SubMesh range = mesh.GetSubMesh(subMesh);
+
+    startInstance = std::max(startInstance, 0);
+    const int available = instances.GetCount() - startInstance;
+    instanceCount = instanceCount < 0 ? available : std::min(instanceCount, available);
+    if (range.IndexCount <= 0 || instanceCount <= 0) return;
+    range.StartIndex += mesh.GetStartIndex();
+    range.BaseVertex += mesh.GetBaseVertex();
+
+    m_backend->DrawMeshInstanced(mesh.GetVB(), mesh.GetIB(), range.IndexCount, instances.GetHandle(), instanceCount, instances.GetStride(),
+        range.StartIndex, range.BaseVertex, startInstance);
+    m_frameStats.DrawCalls++;
+    m_frameStats.Instances += instanceCount;
+    m_frameStats.Indices += (long long)range.IndexCount * instanceCount;
+}
+
+void Rendeructor::SetAutoInstancing(bool enabled) {
+    FlushAutoInstancing();
+    m_autoInstancing = enabled;
+    if (!enabled) m_autoInstanceActive = false;
+    else if (m_boundPass) m_autoInstanceActive = m_boundPass->HasInstancedVariant();
+}
+
+void Rendeructor::FlushAutoInstancing() {
+    if (!m_autoInstanceData.empty()) DrawAutoInstances();
+    SyncInstanceConstant();
+}
+
+bool Rendeructor::CaptureInstanceConstant(const std::string& name, const void* data, size_t size) {
+    // Any other constant changes every deferred draw, so flush them first
+    if (name != m_autoInstanceConstantName) {
+        FlushAutoInstancing();
+        return false;
+    }
+    if (!m_autoInstanceData.empty() && size != m_autoInstanceConstant.size()) DrawAutoInstances();
+
+    m_autoInstanceConstant.assign((const unsigned char*)data, (const unsigned char*)data + size);
+    m_autoInstanceConstantPending = true;
+    m_frameStats.ConstantBytes += size;
+    return true;
+}
+
+bool Rendeructor::QueueAutoInstance(void* vb, void* ib, int indexCount, int startIndex, int baseVertex) {
+    // Until the constant is set through SetConstant only the backend knows its value, so draw as is
+    if (!m_autoInstanceActive || m_autoInstanceConstant.empty() || !vb || !ib) return false;
+
+    if (!m_autoInstanceData.empty() &&
+        (vb != m_autoInstanceVB || ib != m_autoInstanceIB || indexCount != m_autoInstanceIndexCount ||
+         startIndex != m_autoInstanceStartIndex || baseVertex != m_autoInstanceBaseVertex)) {
+        DrawAutoInstances();
     }
+
+    m_autoInstanceVB = vb;
+    m_autoInstanceIB = ib;
+    m_autoInstanceIndexCount = indexCount;
+    m_autoInstanceStartIndex = startIndex;
+    m_autoInstanceBaseVertex = baseVertex;
+    m_autoInstanceData.insert(m_autoInstanceData.end(), m_autoInstanceConstant.begin(), m_autoInstanceConstant.end());
+    return true;
+}
+
+void Rendeructor::DrawAutoInstances() {
+    const size_t stride = m_autoInstanceConstant.size();
+    const int count = stride ? (int)(m_autoInstanceData.size() / stride) : 0;
+    if (!m_backend || count == 0) {
+        m_autoInstanceData.clear();
+        return;
+    }
+
+    bool instanced = false;
+    if (count > 1) {
+        // The buffer grows with headroom and never shrinks: batch sizes are usually the same from frame to frame
+        const size_t bytes = m_autoInstanceData.size();
+        if (bytes > m_autoInstanceBufferSize) {
+            if (m_autoInstanceBuffer) m_backend->ReleaseBuffer(m_autoInstanceBuffer);
+            m_autoInstanceBufferSize = std::max(bytes, m_autoInstanceBufferSize * 2);
+            m_autoInstanceBuffer = m_backend->CreateDynamicInstanceBuffer(nullptr, m_autoInstanceBufferSize, (int)stride);
+            if (!m_autoInstanceBuffer) m_autoInstanceBufferSize = 0;
+        }
+        if (m_autoInstanceBuffer) {
+            m_backend->UpdateBuffer(m_autoInstanceBuffer, m_autoInstanceData.data(), bytes, 0);
+            CountMapCall();
+            instanced = m_backend->DrawMeshInstancedVariant(m_autoInstanceVB, m_autoInstanceIB, m_autoInstanceIndexCount,
+                                                            m_autoInstanceBuffer, count, (int)stride,
+                                                            m_autoInstanceStartIndex, m_autoInstanceBaseVertex, 0);
+        }
+    }
+
+    if (instanced) {
+        m_frameStats.DrawCalls++;
+        m_frameStats.AutoInstancedDraws += count;
+    }
+    else {
+        // The variant did not compile (or there is a single draw): issue one call per draw
+        for (int i = 0; i < count; ++i) {
+            m_backend->UpdateConstantRaw(m_autoInstanceConstantName, m_autoInstanceData.data() + i * stride, stride);
+            m_backend->DrawMesh(m_autoInstanceVB, m_autoInstanceIB, m_autoInstanceIndexCount,
+                                m_autoInstanceStartIndex, m_autoInstanceBaseVertex);
+        }
+        m_frameStats.DrawCalls += count;
+        m_autoInstanceConstantPending = true;
+    }
+    m_frameStats.Instances += count;
+    m_frameStats.Indices += (long long)m_autoInstanceIndexCount * count;
+    m_autoInstanceData.clear();
+}
+
+void Rendeructor::SyncInstanceConstant() {
+    // The last value set must reach the backend before the first non-batched draw
+    if (!m_autoInstanceConstantPending || !m_backend) return;
+    m_backend->UpdateConstantRaw(m_autoInstanceConstantName, m_autoInstanceConstant.data(), m_autoInstanceConstant.size());
+    m_autoInstanceConstantPending = false;
+}
+
+void Rendeructor::DrawMeshInstanced(const Mesh& mesh, const InstanceBuffer& instances) {
+    FlushAutoInstancing();
+    if (!m_backend || instances.GetCount() <= 0) return;
+
+    // Already grouped by LOD (e.g. by InstanceCuller): one draw per level, each from its own range of the buffer
+    if (mesh.GetLODCount() > 1 && instances.GetLODRangeMesh() == &mesh && (int)instances.GetLODRanges().size() == mesh.GetLODCount()) {
+        int startInstance = 0;
+        for (int level = 0; level < mesh.GetLODCount(); ++level) {
+            const int count = instances.GetLODRanges()[level];
+            if (count == 0) continue;
+            MeshLOD lod = mesh.GetLOD(level);
+            m_backend->DrawMeshInstanced(mesh.GetVB(), lod.IBHandle, lod.IndexCount,
+                instances.GetHandle(), count, instances.GetStride(), lod.StartIndex, mesh.GetBaseVertex(), startInstance);
+            startInstance += count;
+            m_frameStats.DrawCalls++;
+            m_frameStats.Instances += count;
+            m_frameStats.Indices += (long long)lod.IndexCount * count;
+        }
+        return;
+    }
+
+    // One draw per LOD with the instances regrouped by the level they need
+    if (mesh.GetLODCount() > 1 && m_lodCamera.Enabled && instances.GetTransformOffset() >= 0) {
+        const auto& batches = instances.BuildLODBatches(mesh, m_lodCamera);
+        if (!batches.empty()) {
+            for (int level = 0; level < (int)batches.size(); ++level) {
+                if (batches[level].Count == 0) continue;
+                MeshLOD lod = mesh.GetLOD(level);
+                m_backend->DrawMeshInstanced(mesh.GetVB(), lod.IBHandle, lod.IndexCount,
+                    batches[level].Handle, batches[level].Count, instances.GetStride(), lod.StartIndex, mesh.GetBaseVertex(), 0);
+                m_frameStats.DrawCalls++;
+                m_frameStats.Instances += batches[level].Count;
+                m_frameStats.Indices += (long long)lod.IndexCount * batches[level].Count;
+            }
+            return;
+        }
+    }
+
+    m_backend->DrawMeshInstanced(
+        mesh.GetVB(),
+        mesh.GetIB(),
+        mesh.GetIndexCount(),
+        instances.GetHandle(),
+        instances.GetCount(),
+        instances.GetStride(),
+        mesh.GetStartIndex(), mesh.GetBaseVertex(), 0
+    );
+    m_frameStats.DrawCalls++;
+    m_frameStats.Instances += instances.GetCount();
+    m_frameStats.Indices += (long long)mesh.GetIndexCount() * instances.GetCount();
+}
+
+namespace {
+    // Records that run past the end of the buffer are dropped by the backend; they must not be counted either
+    int ClampIndirectDrawCount(const ComputeBuffer& args, unsigned int byteOffset, int drawCount, unsigned int argsStride) {
+        const size_t recordSize = sizeof(DrawIndexedIndirectArgs);
+        const size_t size = args.GetSize();
+        if ((size_t)byteOffset + recordSize > size) return 0;
+        const size_t fit = (size - byteOffset - recordSize) / argsStride + 1;
+        return (int)std::min((size_t)drawCount, fit);
+    }
+}
+
+void Rendeructor::DrawMeshIndirect(const Mesh& mesh, const ComputeBuffer& args, unsigned int byteOffset,
+                                   int drawCount, unsigned int argsStride) {
+    FlushAutoInstancing();
+    if (!m_backend || drawCount <= 0 || args.GetType() != ComputeBufferType::IndirectArgs) return;
+    if (!argsStride) argsStride = (unsigned int)sizeof(DrawIndexedIndirectArgs);
+    drawCount = ClampIndirectDrawCount(args, byteOffset, drawCount, argsStride);
+    if (drawCount <= 0) return;
+
+    m_backend->DrawMeshIndirect(mesh.GetVB(), mesh.GetIB(), nullptr, 0, args.GetHandle(), byteOffset, drawCount, argsStride);
+    m_frameStats.DrawCalls += drawCount;
+    m_frameStats.IndirectDrawCalls += drawCount;
+}
+
+void Rendeructor::DrawMeshInstancedIndirect(const Mesh& mesh, const InstanceBuffer& instances, const ComputeBuffer& args,
+                                            unsigned int byteOffset, int drawCount, unsigned int argsStride) {
+    FlushAutoInstancing();
+    if (!m_backend || drawCount <= 0 || args.GetType() != ComputeBufferType::IndirectArgs) return;
+    if (!argsStride) argsStride = (unsigned int)sizeof(DrawIndexedIndirectArgs);
+    drawCount = ClampIndirectDrawCount(args, byteOffset, drawCount, argsStride);
+    if (drawCount <= 0) return;
+
+    m_backend->DrawMeshIndirect(mesh.GetVB(), mesh.GetIB(), instances.GetHandle(), instances.GetStride(),
+        args.GetHandle(), byteOffset, drawCount, argsStride);
+    m_frameStats.DrawCalls += drawCount;
+    m_frameStats.IndirectDrawCalls += drawCount;
+}
+
+MeshletCullStats Rendeructor::DrawMeshCulled(const Mesh& mesh, const Math::float4x4& world, const Math::float4x4& viewProjection,
+                                             const Math::float3& cameraPosition) {
+    FlushAutoInstancing();
+    MeshletCullStats stats;
+    if (!m_backend) return stats;
+
+    // No meshlets - nothing to cull against, draw the whole mesh
+    if (mesh.GetMeshlets().empty()) {
+        DrawMesh(mesh);
+        return stats;
+    }
+
+    stats = mesh.CullMeshlets(Frustum::FromViewProjection(viewProjection), cameraPosition, world, m_cullIndices);
+    if (m_cullIndices.empty()) return stats;
+
+    void* ib = mesh.UploadCulledIndices(m_cullIndices);
+    if (ib) {
+        m_backend->DrawMesh(mesh.GetVB(), ib, (int)m_cullIndices.size(), 0, mesh.GetBaseVertex());
+        m_frameStats.DrawCalls++;
+        m_frameStats.Instances++;
+        m_frameStats.Indices += (long long)m_cullIndices.size();
+    }
+    return stats;
+}
+
+void Rendeructor::SetLODCamera(const Math::float3& position, float verticalFov, int viewportHeight, float pixelError) {
+    LODCamera camera;
+    camera.Position = position;
+    camera.PixelsPerUnit = (float)viewportHeight / (2.0f * std::tan(verticalFov * 0.5f));
+    camera.PixelError = pixelError;
+    camera.Enabled = true;
+
+    // Instance buffers keep the camera their LOD split was made for and only redo it once the camera moved far enough
+    m_lodCamera = camera;
+}
+
+void Rendeructor::DisableLOD() {
+    m_lodCamera.Enabled = false;
 }
 
 void Rendeructor::DrawFullScreenQuad() {
-    if (m_backend) m_backend->DrawFullScreenQuad();
+    FlushAutoInstancing();
+    if (m_backend) {
+        m_backend->DrawFullScreenQuad();
+        m_frameStats.DrawCalls++;
+        m_frameStats.Instances++;
+        m_frameStats.Indices += 6;
+    }
+}
+
+bool Rendeructor::RequestReadback(const Texture& texture, TextureReadbackCallback callback) {
+    if (!callback) return false;
+    return RequestReadback(texture.GetHandle(), texture.GetWidth(), texture.GetHeight(), texture.GetFormat(), std::move(callback), "");
+}
+
+bool Rendeructor::RequestReadback(void* handle, int width, int height, TextureFormat format, TextureReadbackCallback callback,
+                                  const std::string& outputPath) {
+    FlushAutoInstancing();
+    if (!m_backend || !handle) return false;
+
+    void* ticket = m_backend->RequestTextureReadback(handle);
+    if (!ticket) return false;
+
+    PendingReadback readback;
+    readback.Ticket = ticket;
+    readback.Width = width;
+    readback.Height = height;
+    readback.Format = format;
+    readback.RowPitch = (size_t)width * Texture::GetBytesPerPixel(format);
+    readback.Callback = std::move(callback);
+    readback.OutputPath = outputPath;
+    m_readbacks.push_back(std::move(readback));
+    return true;
+}
+
+bool Rendeructor::SetFrameOutput(const std::string& pattern, const Texture* source, int firstFrame) {
+    // The pattern comes from the caller and is never used as a printf format, but reject it up front so a typo
+    // does not silently drop every frame
+    std::string firstPath;
+    if (!pattern.empty() && !FrameWriter::FormatFramePath(pattern, firstFrame, firstPath)) {
+        std::cerr << "[Rendeructor] Frame output: the pattern needs exactly one %d conversion: " << pattern << std::endl;
+        return false;
+    }
+
+    m_frameOutputPattern = pattern;
+    m_frameOutputSource = source;
+    m_frameOutputIndex = firstFrame;
+    m_currentConfig.FrameOutputPattern = pattern;
+    if (!pattern.empty() && !m_frameWriter.IsRunning()) m_frameWriter.Start();
+    return true;
+}
+
+void Rendeructor::FlushFrameOutput() {
+    ResolveReadbacks(true);
+    m_frameWriter.Flush();
+}
+
+void Rendeructor::QueueFrameOutput() {
+    void* handle = nullptr;
+    int width = m_currentConfig.Width;
+    int height = m_currentConfig.Height;
+    TextureFormat format = TextureFormat::RGBA8; // The frame buffer is always RGBA8
+    if (m_frameOutputSource) {
+        handle = m_frameOutputSource->GetHandle();
+        width = m_frameOutputSource->GetWidth();
+        height = m_frameOutputSource->GetHeight();
+        format = m_frameOutputSource->GetFormat();
+    }
+    else if (m_backend) {
+        handle = m_backend->GetBackBufferHandle();
+    }
+    if (!handle) return;
+
+    std::string path;
+    FrameWriter::FormatFramePath(m_frameOutputPattern, m_frameOutputIndex, path);
+    m_frameOutputIndex++;
+
+    // All staging slots are in flight: collect the finished ones first and wait only if the GPU is a whole ring behind,
+    // since frames of a sequence must not be skipped
+    if (RequestReadback(handle, width, height, format, nullptr, path)) return;
+    ResolveReadbacks(false);
+    if (RequestReadback(handle, width, height, format, nullptr, path)) return;
+    ResolveReadbacks(true);
+    if (!RequestReadback(handle, width, height, format, nullptr, path)) {
+        std::cerr << "[Rendeructor] Frame output: readback failed for " << path << std::endl;
+    }
+}
+
+void Rendeructor::FlushReadbacks() {
+    FlushAutoInstancing();
+    ResolveReadbacks(true);
+}
+
+void Rendeructor::ResolveReadbacks(bool wait) {
+    if (m_readbacks.empty()) return;
+
+    // Take finished readbacks out of the list before calling back: a callback may request the next readback right away
+    std::vector<PendingReadback> finished;
+    for (size_t i = 0; i < m_readbacks.size();) {
+        PendingReadback& readback = m_readbacks[i];
+        int result = -1;
+        if (m_backend) {
+            readback.Pixels.resize(readback.RowPitch * readback.Height);
+            result = m_backend->ResolveTextureReadback(readback.Ticket, readback.Pixels.data(), readback.RowPitch, wait);
+        }
+        if (result == 0) {
+            ++i;
+            continue;
+        }
+        if (result == 1) CountMapCall();
+        readback.Failed = (result != 1);
+        finished.push_back(std::move(readback));
+        m_readbacks.erase(m_readbacks.begin() + i);
+    }
+
+    for (auto& readback : finished) {
+        if (!readback.OutputPath.empty()) {
+            // Conversion and encoding run on worker threads; pixels are handed over without a copy
+            if (!readback.Failed) m_frameWriter.Submit(readback.OutputPath, readback.Width, readback.Height, readback.Format, std::move(readback.Pixels));
+            else std::cerr << "[Rendeructor] Frame output: readback failed for " << readback.OutputPath << std::endl;
+            continue;
+        }
+        readback.Callback(readback.Failed ? nullptr : readback.Pixels.data(), readback.Width, readback.Height);
+    }
+}
+
+void Rendeructor::BeginScope(const char* name, bool gpu) {
+    // Deferred draws belong to the render thread; a worker's scope only records CPU time
+    if (IsRenderThread()) FlushAutoInstancing();
+    m_profiler.BeginScope(name, gpu);
+}
+
+void Rendeructor::EndScope() {
+    if (IsRenderThread()) FlushAutoInstancing();
+    m_profiler.EndScope();
 }
 
 void Rendeructor::Present() {
+    RunRenderThreadTasks();
+    FlushAutoInstancing();
+    ResolveReadbacks(false);
+    // Before EndFrame: the swap chain contents are undefined after Present
+    if (!m_frameOutputPattern.empty()) QueueFrameOutput();
     if (m_backend) {
+        BeginScope("Present", false);
         m_backend->EndFrame();
+        EndScope();
+    }
+    m_profiler.EndFrame();
+    m_transientPool.EndFrame();
+
+    m_frameStats.MapCalls += m_mapCalls.exchange(0);
+    m_frameStatsHistory.push_back(m_frameStats);
+    while ((int)m_frameStatsHistory.size() > m_frameStatsHistorySize) m_frameStatsHistory.pop_front();
+    unsigned long long frame = m_frameStats.Frame;
+    m_frameStats = FrameStats();
+    m_frameStats.Frame = frame + 1;
+}
+
+bool GPUTimer::Create() {
+    if (BackendInterface* backend = Rendeructor::AttachBackend(m_renderer)) {
+        m_backendHandle = backend->CreateGPUTimer();
+    }
+    m_pending = false;
+    return m_backendHandle != nullptr;
+}
+
+void GPUTimer::Release() {
+    if (m_backendHandle && m_renderer) {
+        Rendeructor* renderer = m_renderer;
+        void* handle = m_backendHandle;
+        renderer->RunOnRenderThread([renderer, handle] {
+            if (renderer->GetBackendAPI()) renderer->GetBackendAPI()->ReleaseGPUTimer(handle);
+        });
+    }
+    m_backendHandle = nullptr;
+    m_pending = false;
+}
+
+void GPUTimer::Begin() {
+    // Queries go through the immediate context
+    if (m_backendHandle && m_renderer && m_renderer->GetBackendAPI() && m_renderer->IsRenderThread()) {
+        m_renderer->FlushAutoInstancing();
+        m_renderer->GetBackendAPI()->BeginGPUTimer(m_backendHandle);
     }
 }
+
+void GPUTimer::End() {
+    if (m_backendHandle && m_renderer && m_renderer->GetBackendAPI() && m_renderer->IsRenderThread()) {
+        m_renderer->FlushAutoInstancing();
+        m_renderer->GetBackendAPI()->EndGPUTimer(m_backendHandle);
+        m_pending = true;
+    }
+}
+
+bool GPUTimer::GetResult(double& milliseconds) {
+    if (!m_pending || !m_renderer || !m_renderer->GetBackendAPI() || !m_renderer->IsRenderThread()) return false;
+    double ms = 0.0;
+    if (!m_renderer->GetBackendAPI()->GetGPUTimerResult(m_backendHandle, ms)) return false;
+    m_pending = false;
+    if (ms < 0.0) return false; // disjoint
+    milliseconds = ms;
+    return true;
+}
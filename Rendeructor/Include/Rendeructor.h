@@ -1,6 +1,17 @@
 #pragma once
 #include "RendeructorDefines.h"
 #include "BackendInterface.h"
+#include "InstanceCuller.h"
+#include "TileBudget.h"
+#include "Profiler.h"
+#include "RenderTargetPool.h"
+#include "GeometryArena.h"
+#include "MemoryTracker.h"
+#include "FrameWriter.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 class RENDER_API Rendeructor {
 public:
@@ -8,6 +19,9 @@ public:
     ~Rendeructor();
 
     bool Create(const BackendConfig& config);
+    // Runs on a backend supplied by the caller instead of one made from config.API (a CPU backend in tests, a port to
+    // another API). The renderer does not take ownership: the backend must outlive Destroy()
+    bool Create(const BackendConfig& config, BackendInterface* backend);
     void Restart(const BackendConfig& config);
     void Destroy();
 
@@ -19,6 +33,7 @@ public:
 
     PipelineState GetPipelineState() const { return m_currentState; }
     void SetPipelineState(const PipelineState& state);
+    // Call after changing context state directly (GetContext): drops the cached pipeline state, shader and geometry bindings
     void ResetPipelineStateCache();
     void SetCullMode(CullMode mode);
     void SetBlendMode(BlendMode mode);
@@ -28,7 +43,11 @@ public:
 
     template<typename T>
     void SetConstant(const std::string& name, const T& value) {
-        if (m_backend) m_backend->UpdateConstantRaw(name, &value, sizeof(T));
+        if (m_backend) {
+            if (m_autoInstanceActive && CaptureInstanceConstant(name, &value, sizeof(T))) return;
+            m_backend->UpdateConstantRaw(name, &value, sizeof(T));
+            m_frameStats.ConstantBytes += sizeof(T);
+        }
     }
     void SetCustomConstant(const std::string& bufferName, const void* data, size_t size);
     template <typename T>
@@ -40,6 +59,35 @@ public:
                          const Texture& target2 = Texture(),
                          const Texture& target3 = Texture(),
                          const Texture& target4 = Texture());
+    // DepthBinding::None renders the color targets without any depth buffer
+    void SetRenderTarget(DepthBinding depth,
+                         const Texture& target1 = Texture(),
+                         const Texture& target2 = Texture(),
+                         const Texture& target3 = Texture(),
+                         const Texture& target4 = Texture());
+    // Explicit depth buffer; without color targets this is a depth-only pass (viewport = depth size)
+    void SetRenderTarget(const DepthTexture& depth,
+                         const Texture& target1 = Texture(),
+                         const Texture& target2 = Texture(),
+                         const Texture& target3 = Texture(),
+                         const Texture& target4 = Texture());
+    // Automatic depth buffers of off-screen sizes are cached; past the budget the least recently used are released
+    void SetAutoDepthBudget(size_t bytes);
+    size_t GetAutoDepthMemory() const;
+    // Pool behind Texture::AcquireTransient
+    RenderTargetPool& GetTransientPool() { return m_transientPool; }
+    const RenderTargetPoolStats& GetTransientPoolStats() const { return m_transientPool.GetStats(); }
+    void SetTransientPoolBudget(size_t bytes);
+    // Every backend allocation by category (colour textures also by format and type), with totals and high-water marks.
+    // Budget callbacks run when an allocation takes the total over the budget (0: no budget)
+    MemoryStats GetMemoryStats() const { return m_memoryTracker.GetStats(); }
+    void SetMemoryBudget(size_t bytes) { m_memoryTracker.SetBudget(bytes); }
+    int AddMemoryBudgetCallback(MemoryBudgetCallback callback) { return m_memoryTracker.AddBudgetCallback(std::move(callback)); }
+    void RemoveMemoryBudgetCallback(int id) { m_memoryTracker.RemoveBudgetCallback(id); }
+    MemoryTracker& GetMemoryTracker() { return m_memoryTracker; }
+    // Shared mesh buffers, active with BackendConfig::UseGeometryArena. Defragment() after releasing many meshes
+    GeometryArena& GetGeometryArena() { return m_geometryArena; }
+    GeometryArenaStats GetGeometryArenaStats() const { return m_geometryArena.GetStats(); }
     void RenderPassToTexture(const Texture& target);
     void RenderPassToScreen();
     void Clear(float r, float g, float b, float a = 1.0f);
@@ -49,16 +97,184 @@ public:
     void ClearDepth(float depth = 1.0f, int stencil = 0);
 
     void DrawFullScreenQuad();
+    // Compute: runs the compute pass last bound with SetShaderPass (the graphics pass stays bound)
+    void Dispatch(int groupsX, int groupsY = 1, int groupsZ = 1);
+    // Group counts come from three uints at byteOffset of an IndirectArgs buffer, e.g. written by an earlier dispatch
+    void DispatchIndirect(const ComputeBuffer& args, unsigned int byteOffset = 0);
+    // Groups needed to cover 'threads' with groups of 'groupSize'
+    static int GetGroupCount(int threads, int groupSize) { return (threads + groupSize - 1) / groupSize; }
+    // With a pass that has an instanced variant (ShaderPass::InstancedVertexShaderEntryPoint) the draw may be deferred
+    // and merged with the following DrawMesh calls of the same mesh
     void DrawMesh(const Mesh& mesh);
+    // Picks the mesh LOD from the projected size of its bounds under 'world' (the World constant is still set by the caller)
+    void DrawMesh(const Mesh& mesh, const Math::float4x4& world);
     void DrawMeshInstanced(const Mesh& mesh, const InstanceBuffer& instances);
+    // One range of mesh.GetSubMeshes() (LOD 0). Like DrawMesh it may be merged by auto-instancing
+    void DrawSubMesh(const Mesh& mesh, int subMesh);
+    // instanceCount < 0: all instances from startInstance on
+    void DrawSubMeshInstanced(const Mesh& mesh, int subMesh, const InstanceBuffer& instances, int startInstance = 0, int instanceCount = -1);
+    // Counts and offsets come from DrawIndexedIndirectArgs records in an IndirectArgs buffer (e.g. filled by a culling
+    // dispatch), so the CPU never reads them back. drawCount consecutive records are drawn with the mesh bound once;
+    // argsStride 0 means tightly packed, records past the end of args are skipped (and not counted in FrameStats).
+    // Indices are those of LOD 0, LOD selection is up to whoever writes the records.
+    // For meshes in the GeometryArena the records must include mesh.GetStartIndex() and mesh.GetBaseVertex()
+    void DrawMeshIndirect(const Mesh& mesh, const ComputeBuffer& args, unsigned int byteOffset = 0,
+                          int drawCount = 1, unsigned int argsStride = 0);
+    void DrawMeshInstancedIndirect(const Mesh& mesh, const InstanceBuffer& instances, const ComputeBuffer& args,
+                                   unsigned int byteOffset = 0, int drawCount = 1, unsigned int argsStride = 0);
+    // Draws only the meshlets that survive frustum and normal-cone culling (mesh.BuildMeshlets must have been called)
+    MeshletCullStats DrawMeshCulled(const Mesh& mesh, const Math::float4x4& world, const Math::float4x4& viewProjection,
+                                    const Math::float3& cameraPosition);
+
+    // Screen-space LOD selection for DrawMesh(mesh, world) and DrawMeshInstanced
+    void SetLODCamera(const Math::float3& position, float verticalFov, int viewportHeight, float pixelError = 1.0f);
+    void DisableLOD();
+
+    // Automatic instancing of DrawMesh runs (on by default, only affects passes with an instanced variant).
+    // Deferred draws are issued by any other renderer call; call FlushAutoInstancing after changing resources
+    // used by the pass (texture or buffer contents) between such draws
+    void SetAutoInstancing(bool enabled);
+    bool IsAutoInstancingEnabled() const { return m_autoInstancing; }
+    void FlushAutoInstancing();
+    const LODCamera& GetLODCamera() const { return m_lodCamera; }
     void Present();
 
+    // Profiling scopes: CPU time on any thread, GPU time as well on the render thread. Names must be string literals.
+    // RENDER_PROFILE_SCOPE compiles them out of the client when RENDERUCTOR_PROFILING is 0
+    void BeginScope(const char* name, bool gpu = true);
+    void EndScope();
+    Profiler& GetProfiler() { return m_profiler; }
+    // Latest frame with complete GPU timings (GPU results arrive a few frames late)
+    const ProfileFrameSummary& GetProfileSummary() const { return m_profiler.GetFrameSummary(); }
+    bool ExportProfileTrace(const std::string& path) const { return m_profiler.ExportChromeTrace(path); }
+
+    // Counters of the frame in progress; Present() moves them to the history
+    FrameStats GetFrameStats() const;
+    // Last presented frames, oldest first
+    const std::deque<FrameStats>& GetFrameStatsHistory() const { return m_frameStatsHistory; }
+    void SetFrameStatsHistorySize(int frames);
+    // Asynchronous texture readback (Texture::ReadbackAsync). Finished readbacks are delivered from Present()
+    bool RequestReadback(const Texture& texture, TextureReadbackCallback callback);
+    // Waits for all queued readbacks and runs their callbacks
+    void FlushReadbacks();
+    int GetPendingReadbackCount() const { return (int)m_readbacks.size(); }
+
+    // Offline output: every Present() writes the back buffer (or 'source') to the printf pattern with the frame number,
+    // e.g. "frames/frame_%04d.png". Readback, conversion and encoding are pipelined, files land a few frames later.
+    // An empty pattern stops the output. The pattern must hold exactly one integer conversion (see
+    // FrameWriter::FormatFramePath); false, with the output left as it was, otherwise
+    bool SetFrameOutput(const std::string& pattern, const Texture* source = nullptr, int firstFrame = 0);
+    // Waits until every frame presented so far is on disk
+    void FlushFrameOutput();
+    FrameWriterStats GetFrameOutputStats() const { return m_frameWriter.GetStats(); }
+
+    // For resource classes that map backend resources on their own; callable from any thread
+    void CountMapCall() { m_mapCalls.fetch_add(1, std::memory_order_relaxed); }
+
+    // Resources (Texture, Mesh, buffers, Sampler, GPUTimer) constructed with a renderer work with that one. Resources
+    // constructed without one attach to this default - the most recently constructed renderer - on their first Create,
+    // which is all a single-renderer application needs.
     static Rendeructor* GetCurrent();
+    // For the resource classes: attaches a resource without a renderer to GetCurrent() and returns the backend
+    static BackendInterface* AttachBackend(Rendeructor*& renderer);
     BackendInterface* GetBackendAPI() { return m_backend; }
+    // The thread that called Create
+    bool IsRenderThread() const { return std::this_thread::get_id() == m_renderThread; }
+
+    // Creating and loading resources is safe from any thread. Work on the immediate context, the transient pool and
+    // the GeometryArena is not: on the render thread it runs right away, from other threads it is queued and runs at
+    // the start of the next Present() (or in Destroy()), in the order it was queued.
+    void RunOnRenderThread(std::function<void()> task);
+    int GetPendingRenderThreadTasks() const;
+    // Resource releases and buffer updates through RunOnRenderThread; deferred updates copy the data
+    void ReleaseTexture(void* handle);
+    void ReleaseBuffer(void* handle);
+    void UpdateBuffer(void* handle, const void* data, size_t size, size_t offset = 0);
 
 private:
+    void CountRenderTargets(void* t1, void* t2, void* t3, void* t4, void* depth = nullptr);
+    void CountPipelineState(const PipelineState& state);
+    // Auto-instancing: the per-draw constant is held back while draws are being merged
+    bool CaptureInstanceConstant(const std::string& name, const void* data, size_t size);
+    bool QueueAutoInstance(void* vb, void* ib, int indexCount, int startIndex, int baseVertex);
+    void DrawAutoInstances();
+    void SyncInstanceConstant();
+    bool RequestReadback(void* handle, int width, int height, TextureFormat format, TextureReadbackCallback callback,
+                         const std::string& outputPath);
+    void ResolveReadbacks(bool wait);
+    void QueueFrameOutput();
+    void RunRenderThreadTasks();
+
+    struct PendingReadback {
+        void* Ticket = nullptr;
+        int Width = 0;
+        int Height = 0;
+        size_t RowPitch = 0;
+        TextureFormat Format = TextureFormat::RGBA8;
+        std::vector<unsigned char> Pixels;
+        bool Failed = false;
+        TextureReadbackCallback Callback;
+        std::string OutputPath; // Frame output: pixels go to the FrameWriter instead of a callback
+    };
+
     BackendInterface* m_backend = nullptr;
+    bool m_ownsBackend = true;
+    std::thread::id m_renderThread;
+    mutable std::mutex m_renderTasksMutex;
+    std::vector<std::function<void()>> m_renderTasks;
+    std::atomic<int> m_mapCalls = 0; // MapCalls of the frame in progress, counted from any thread
+    MemoryTracker m_memoryTracker;
     PipelineState m_currentState;
     BackendConfig m_currentConfig;
-    static Rendeructor* s_instance;
+    LODCamera m_lodCamera;
+    Profiler m_profiler;
+    RenderTargetPool m_transientPool;
+    GeometryArena m_geometryArena;
+    FrameStats m_frameStats;
+    std::deque<FrameStats> m_frameStatsHistory;
+    int m_frameStatsHistorySize = 120;
+    const ShaderPass* m_boundPass = nullptr;
+    const ShaderPass* m_boundComputePass = nullptr;
+    void* m_boundTargets[4] = {};
+    void* m_boundDepth = nullptr;
+    std::vector<unsigned int> m_cullIndices;
+    std::vector<PendingReadback> m_readbacks;
+    FrameWriter m_frameWriter;
+    std::string m_frameOutputPattern;
+    const Texture* m_frameOutputSource = nullptr;
+    int m_frameOutputIndex = 0;
+
+    bool m_autoInstancing = true;
+    bool m_autoInstanceActive = false;              // bound pass has an instanced variant
+    std::string m_autoInstanceConstantName;
+    std::vector<unsigned char> m_autoInstanceConstant;
+    bool m_autoInstanceConstantPending = false;     // captured value not yet passed to the backend
+    std::vector<unsigned char> m_autoInstanceData;  // one captured constant per deferred draw
+    void* m_autoInstanceVB = nullptr;
+    void* m_autoInstanceIB = nullptr;
+    int m_autoInstanceIndexCount = 0;
+    int m_autoInstanceStartIndex = 0;
+    int m_autoInstanceBaseVertex = 0;
+    void* m_autoInstanceBuffer = nullptr;
+    size_t m_autoInstanceBufferSize = 0;
+    static std::atomic<Rendeructor*> s_instance;
 };
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name, bool gpu = true) : ProfileScope(Rendeructor::GetCurrent(), name, gpu) {}
+    ProfileScope(Rendeructor* renderer, const char* name, bool gpu = true) : m_renderer(renderer) {
+        if (m_renderer) m_renderer->BeginScope(name, gpu);
+    }
+    ~ProfileScope() { if (m_renderer) m_renderer->EndScope(); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+    Rendeructor* m_renderer;
+};
+
+#if RENDERUCTOR_PROFILING
+#define RENDER_PROFILE_SCOPE(name) ProfileScope RENDER_PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#else
+#define RENDER_PROFILE_SCOPE(name) ((void)0)
+#endif
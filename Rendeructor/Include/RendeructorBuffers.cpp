@@ -1,11 +1,253 @@
 #include "pch.h"
 #include "Rendeructor.h"
 #include "BackendDX11.h"
+#include <cfloat>
+
+namespace {
+
+    // Share of an instance's distance the camera may move before its projected LOD error drifts by ~10%
+    const float kLODMoveTolerance = 0.1f;
+
+    // How far the camera may move before the LOD of this instance has to be picked again. Closer than the distance
+    // where LOD 1 becomes acceptable the instance stays at LOD 0, so that distance bounds the limit from below.
+    float LODMoveLimit(const Mesh& mesh, const LODCamera& camera, const Math::float4x4& world) {
+        if (camera.Orthographic) return FLT_MAX;
+
+        Math::float3 scale = world.get_scale();
+        float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+        Math::float3 center = world.transform_point(mesh.GetBoundsCenter());
+        float distance = Math::length(center - camera.Position) - mesh.GetBoundingRadius() * maxScale;
+        float lod1Distance = camera.PixelError > 0.0f ? mesh.GetLOD(1).Error * camera.PixelsPerUnit * maxScale / camera.PixelError : 0.0f;
+        return kLODMoveTolerance * std::max(distance, lod1Distance);
+    }
+}
 
 void InstanceBuffer::Create(const void* data, int count, int stride) {
+    Allocate(data, count, stride, false);
+}
+
+void InstanceBuffer::CreateDynamic(const void* data, int count, int stride) {
+    Allocate(data, count, stride, true);
+}
+
+void InstanceBuffer::Allocate(const void* data, int count, int stride, bool dynamic) {
+    auto* backend = Rendeructor::AttachBackend(m_renderer);
+
+    // Recreation must not leak the previous GPU buffers; the GPU may still read them, so off the render thread
+    // they are released from the next Present()
+    if (backend) {
+        m_renderer->ReleaseBuffer(m_backendHandle);
+        for (auto& batch : m_lodBatches) m_renderer->ReleaseBuffer(batch.Handle);
+    }
+    m_backendHandle = nullptr;
+    m_lodBatches.clear();
+    m_lodRangeMesh = nullptr;
+    m_lodRanges.clear();
+
+    m_count = count;
+    m_stride = stride;
+    m_capacity = count;
+    m_dynamic = dynamic;
+
+    // CPU copy only on request: InstanceCuller::Build and per-LOD batches read it
+    const unsigned char* bytes = (const unsigned char*)data;
+    if (!m_keepCPUData) m_cpuData.clear();
+    else if (bytes) m_cpuData.assign(bytes, bytes + (size_t)count * stride);
+    else m_cpuData.assign((size_t)count * stride, 0);
+    m_dataVersion++;
+
+    if (backend) {
+        m_backendHandle = dynamic ? backend->CreateDynamicInstanceBuffer(data, (size_t)count * stride, stride)
+                                  : backend->CreateInstanceBuffer(data, (size_t)count * stride, stride);
+    }
+}
+
+void InstanceBuffer::Update(const void* data, int count) {
+    if (count > m_capacity || m_stride <= 0) {
+        Allocate(data, count, m_stride, m_dynamic);
+        return;
+    }
+
+    if (data && count > 0) Update(data, count, 0);
+    m_count = count;
+    m_dataVersion++;
+    m_lodRangeMesh = nullptr;
+    m_lodRanges.clear();
+}
+
+void InstanceBuffer::Update(const void* data, int count, int firstInstance) {
+    if (!data || count <= 0 || firstInstance < 0 || m_stride <= 0) return;
+
+    if (firstInstance + count > m_capacity) {
+        // Grow keeping what is already there
+        if (m_keepCPUData || !m_backendHandle) {
+            std::vector<unsigned char> merged((size_t)(firstInstance + count) * m_stride, 0);
+            if (!m_cpuData.empty()) memcpy(merged.data(), m_cpuData.data(), (size_t)m_count * m_stride);
+            memcpy(merged.data() + (size_t)firstInstance * m_stride, data, (size_t)count * m_stride);
+            Allocate(merged.data(), firstInstance + count, m_stride, m_dynamic);
+            return;
+        }
+        Grow(firstInstance + count);
+    }
+
+    const size_t offset = (size_t)firstInstance * m_stride;
+    const size_t size = (size_t)count * m_stride;
+    if (!m_cpuData.empty()) memcpy(m_cpuData.data() + offset, data, size);
+    m_count = std::max(m_count, firstInstance + count);
+    m_dataVersion++;
+    m_lodRangeMesh = nullptr;
+    m_lodRanges.clear();
+
+    if (m_backendHandle && m_renderer) m_renderer->UpdateBuffer(m_backendHandle, data, size, offset);
+}
+
+void InstanceBuffer::Grow(int capacity) {
+    auto* backend = m_renderer->GetBackendAPI();
+    void* previous = m_backendHandle;
+    m_backendHandle = m_dynamic ? backend->CreateDynamicInstanceBuffer(nullptr, (size_t)capacity * m_stride, m_stride)
+                                : backend->CreateInstanceBuffer(nullptr, (size_t)capacity * m_stride, m_stride);
+
+    // Without a CPU copy the instances already written move over on the GPU, queued before the old buffer's release
+    const size_t keptBytes = (size_t)m_count * m_stride;
+    if (m_backendHandle && keptBytes > 0) {
+        Rendeructor* renderer = m_renderer;
+        void* handle = m_backendHandle;
+        renderer->RunOnRenderThread([renderer, handle, previous, keptBytes] {
+            if (auto* api = renderer->GetBackendAPI()) api->CopyBufferRegion(handle, 0, previous, 0, keptBytes);
+        });
+    }
+    m_renderer->ReleaseBuffer(previous);
+    for (auto& batch : m_lodBatches) m_renderer->ReleaseBuffer(batch.Handle);
+    m_lodBatches.clear();
+    m_capacity = capacity;
+}
+
+void InstanceBuffer::SetLODRanges(const Mesh* mesh, const std::vector<int>& counts) {
+    m_lodRangeMesh = mesh;
+    m_lodRanges = counts;
+}
+
+const std::vector<InstanceBuffer::LODBatch>& InstanceBuffer::BuildLODBatches(const Mesh& mesh, const LODCamera& camera) const {
+    const int lodCount = mesh.GetLODCount();
+
+    // A moving camera only invalidates the split once the LOD choice could actually have changed
+    if (m_lodBatchMesh == &mesh && m_lodBatchDataVersion == m_dataVersion && (int)m_lodBatches.size() == lodCount &&
+        m_lodBatchCamera.PixelsPerUnit == camera.PixelsPerUnit && m_lodBatchCamera.PixelError == camera.PixelError &&
+        m_lodBatchCamera.Orthographic == camera.Orthographic &&
+        Math::length(camera.Position - m_lodBatchCamera.Position) <= m_lodBatchMoveLimit) {
+        return m_lodBatches;
+    }
+
+    // Drawing happens on the render thread, so the batch buffers are written directly
+    auto* backend = m_renderer ? m_renderer->GetBackendAPI() : nullptr;
+    if (!backend || m_cpuData.empty() || m_transformOffset < 0 || m_transformOffset + (int)sizeof(Math::float4x4) > m_stride) {
+        m_lodBatches.clear();
+        return m_lodBatches;
+    }
+
+    if ((int)m_lodBatches.size() != lodCount) m_lodBatches.resize(lodCount);
+
+    // Pick a level per instance, then counting-sort the instances so every level is one contiguous range
+    std::vector<int> levels(m_count);
+    std::vector<int> offsets(lodCount + 1, 0);
+    float moveLimit = FLT_MAX;
+    for (int i = 0; i < m_count; ++i) {
+        Math::float4x4 world;
+        memcpy(&world, m_cpuData.data() + (size_t)i * m_stride + m_transformOffset, sizeof(Math::float4x4));
+        levels[i] = mesh.SelectLOD(camera, world);
+        offsets[levels[i] + 1]++;
+        moveLimit = std::min(moveLimit, LODMoveLimit(mesh, camera, world));
+    }
+    for (int l = 0; l < lodCount; ++l) offsets[l + 1] += offsets[l];
+
+    std::vector<unsigned char> sorted((size_t)m_count * m_stride);
+    std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < m_count; ++i) {
+        memcpy(sorted.data() + (size_t)cursor[levels[i]]++ * m_stride, m_cpuData.data() + (size_t)i * m_stride, m_stride);
+    }
+
+    for (int l = 0; l < lodCount; ++l) {
+        LODBatch& batch = m_lodBatches[l];
+        batch.Count = offsets[l + 1] - offsets[l];
+        if (batch.Count == 0) continue;
+
+        // Batch buffers are sized for the whole capacity once, so any split fits without reallocating.
+        // They are rewritten whenever the camera moves far enough, hence dynamic.
+        if (!batch.Handle) batch.Handle = backend->CreateDynamicInstanceBuffer(nullptr, (size_t)m_capacity * m_stride, m_stride);
+        if (!batch.Handle) {
+            batch.Count = 0;
+            continue;
+        }
+        backend->UpdateBuffer(batch.Handle, sorted.data() + (size_t)offsets[l] * m_stride, (size_t)batch.Count * m_stride);
+        m_renderer->CountMapCall();
+    }
+
+    m_lodBatchMesh = &mesh;
+    m_lodBatchCamera = camera;
+    m_lodBatchMoveLimit = moveLimit;
+    m_lodBatchDataVersion = m_dataVersion;
+    return m_lodBatches;
+}
+
+void ComputeBuffer::Create(int count, int stride, ComputeBufferType type, const void* data) {
+    Release();
+
+    // Raw and argument buffers are addressed in 32-bit words
+    if (type != ComputeBufferType::Structured) stride = 4;
+    m_count = count;
+    m_stride = stride;
+    m_type = type;
+
+    BackendInterface* backend = Rendeructor::AttachBackend(m_renderer);
+    if (count > 0 && stride > 0 && backend) {
+        m_backendHandle = backend->CreateComputeBuffer(data, (size_t)count, stride, (int)type);
+    }
+}
+
+void ComputeBuffer::Update(const void* data, int count, int firstElement) {
+    if (!m_backendHandle || !data || count <= 0 || firstElement < 0 || firstElement + count > m_count) return;
+
+    if (m_renderer) m_renderer->UpdateBuffer(m_backendHandle, data, (size_t)count * m_stride, (size_t)firstElement * m_stride);
+}
+
+bool ComputeBuffer::Read(void* data) const {
+    if (!m_backendHandle || !data || !m_renderer || !m_renderer->GetBackendAPI()) return false;
+    // Reads map through the immediate context
+    if (!m_renderer->IsRenderThread()) return false;
+    m_renderer->CountMapCall();
+    return m_renderer->GetBackendAPI()->ReadBuffer(m_backendHandle, data, GetSize());
+}
+
+void ComputeBuffer::Release() {
+    if (m_backendHandle && m_renderer) m_renderer->ReleaseBuffer(m_backendHandle);
+    m_backendHandle = nullptr;
+    m_count = 0;
+    m_stride = 0;
+}
+
+void StructuredBuffer::Create(const void* data, int count, int stride, bool dynamic) {
+    Release();
     m_count = count;
     m_stride = stride;
-    if (Rendeructor::GetCurrent() && Rendeructor::GetCurrent()->GetBackendAPI()) {
-        m_backendHandle = Rendeructor::GetCurrent()->GetBackendAPI()->CreateInstanceBuffer(data, count * stride, stride);
+    m_dynamic = dynamic;
+
+    BackendInterface* backend = Rendeructor::AttachBackend(m_renderer);
+    if (count > 0 && stride > 0 && backend) {
+        m_backendHandle = backend->CreateStructuredBuffer(data, (size_t)count, stride, dynamic);
     }
 }
+
+bool StructuredBuffer::Update(const void* data, int count, int firstElement) {
+    if (!m_backendHandle || !data || count <= 0 || firstElement < 0 || firstElement + count > m_count) return false;
+    if (!m_renderer || !m_renderer->GetBackendAPI()) return false;
+
+    m_renderer->UpdateBuffer(m_backendHandle, data, (size_t)count * m_stride, (size_t)firstElement * m_stride);
+    return true;
+}
+
+void StructuredBuffer::Release() {
+    if (m_backendHandle && m_renderer) m_renderer->ReleaseBuffer(m_backendHandle);
+    m_backendHandle = nullptr;
+    m_count = 0;
+    m_stride = 0;
+}
@@ -4,11 +4,21 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <span>
+#include <functional>
 #include <MathAPI/MathAPI.h>
 
+class Rendeructor;
+
 enum class ScreenMode { Windowed, Fullscreen, Borderless };
 enum class RenderAPI { DirectX11, DirectX12, OpenGL, Vulkan };
 enum class TextureFormat { R8, RGBA8, RGBA16F, RGBA32F, R16F, R32F };
+enum class DepthFormat { D24S8, D32F };
+// Depth buffer bound by SetRenderTarget when no DepthTexture is given
+enum class DepthBinding {
+    Auto, // cached buffer of the target size (the window's own for screen-sized targets)
+    None
+};
 
 enum class CullMode {
     None,
@@ -48,12 +58,50 @@ enum class TextureType {
     TexCube,
 };
 
+enum class ComputeBufferType {
+    Structured,  // (RW)StructuredBuffer<T>, stride = sizeof(T)
+    Raw,         // (RW)ByteAddressBuffer, stride is 4
+    IndirectArgs // arguments of DispatchIndirect / DrawMeshIndirect, written by shaders as RWByteAddressBuffer
+};
+
+// Layouts of the records in an IndirectArgs buffer (match D3D11/GL/Vulkan)
+struct DrawIndexedIndirectArgs {
+    unsigned int IndexCount;
+    unsigned int InstanceCount;
+    unsigned int StartIndex;
+    int BaseVertex;
+    unsigned int StartInstance;
+};
+
+struct DispatchIndirectArgs {
+    unsigned int GroupsX;
+    unsigned int GroupsY;
+    unsigned int GroupsZ;
+};
+
 struct RENDER_API BackendConfig {
     int Width = 1920;
     int Height = 1080;
     ScreenMode ScreenMode = ScreenMode::Windowed;
     RenderAPI API = RenderAPI::DirectX11;
     void* WindowHandle = nullptr;
+    // Memory for automatic depth buffers of off-screen targets; least recently used ones are released beyond it
+    size_t AutoDepthBudgetBytes = 256ull << 20;
+    // Memory for pooled transient render targets (Texture::AcquireTransient)
+    size_t TransientPoolBudgetBytes = 256ull << 20;
+    // All backend allocations together, see Rendeructor::AddMemoryBudgetCallback. 0: no budget
+    size_t MemoryBudgetBytes = 0;
+    // No window and no swap chain: the back buffer is an off-screen RGBA8 texture (batch rendering on servers)
+    bool Headless = false;
+    // Present() writes every frame to this printf pattern with the frame number ("frames/frame_%04d.png"); the format
+    // follows the extension (.png, .exr, .pfm). Empty: no output. See Rendeructor::SetFrameOutput
+    std::string FrameOutputPattern;
+    // Meshes are suballocated from shared vertex/index buffers (GeometryArena) instead of getting a buffer pair each.
+    // Page sizes are in vertices and indices; larger meshes get a page of their own.
+    // Meshes created off the render thread always get their own buffers
+    bool UseGeometryArena = false;
+    int GeometryArenaPageVertices = 256 * 1024;
+    int GeometryArenaPageIndices = 1024 * 1024;
 };
 
 struct Vertex {
@@ -84,86 +132,388 @@ struct RENDER_API PipelineState {
     bool ScissorTest = false;
 };
 
+// Pixels of a finished readback, rows tightly packed (width * bytes per pixel); nullptr when the readback failed
+using TextureReadbackCallback = std::function<void(const void* pixels, int width, int height)>;
+
+// Resources work with the renderer they are constructed with; default-constructed ones attach to
+// Rendeructor::GetCurrent() when first created. Create and load from any thread: releases, updates and copies made off
+// the render thread are queued to it (Rendeructor::RunOnRenderThread), reads and transient targets fail there
 class RENDER_API Texture {
 public:
     Texture() = default;
+    explicit Texture(Rendeructor& renderer) : m_renderer(&renderer) {}
 
     void Create(int width, int height, TextureFormat format, const void* data = nullptr);
+    // Render target that compute shaders can also write (RWTexture2D, see ShaderPass::AddStorageTexture)
+    void CreateStorage(int width, int height, TextureFormat format, const void* data = nullptr);
+    // Render target from the renderer's transient pool; Release() hands it back for reuse in later passes and frames
+    static Texture AcquireTransient(int width, int height, TextureFormat format, bool storage = false);
+    static Texture AcquireTransient(Rendeructor& renderer, int width, int height, TextureFormat format, bool storage = false);
     bool LoadFromDisk(const std::string& path);
     void Copy(const Texture& source);
+    // Reads the texture back into data (width * height pixels, tightly packed). Stalls until the GPU is done with it
+    bool ReadPixels(void* data) const;
+    // Queues a copy without waiting for the GPU; the callback runs from Present() (or Rendeructor::FlushReadbacks) once
+    // the copy has finished, usually a frame or two later. false when every staging slot is still in flight
+    bool ReadbackAsync(TextureReadbackCallback callback) const;
+    int GetBytesPerPixel() const;
+    static int GetBytesPerPixel(TextureFormat format);
+    void Release();
 
     void* GetHandle() const { return m_backendHandle; }
     int GetWidth() const { return m_width; }
     int GetHeight() const { return m_height; }
     TextureFormat GetFormat() const { return m_format; }
+    bool IsTransient() const { return m_transient; }
+    bool IsStorage() const { return m_storage; }
+    Rendeructor* GetRenderer() const { return m_renderer; }
 
 private:
+    Rendeructor* m_renderer = nullptr;
     void* m_backendHandle = nullptr;
     int m_width = 0;
     int m_height = 0;
     TextureFormat m_format = TextureFormat::RGBA8;
+    bool m_transient = false;
+    bool m_storage = false;
+};
+
+// Depth(-stencil) target bound explicitly with SetRenderTarget(depth, ...). When shader readable it can be added to a
+// ShaderPass like a texture; the depth is in the red channel
+class RENDER_API DepthTexture {
+public:
+    DepthTexture() = default;
+    explicit DepthTexture(Rendeructor& renderer) : m_renderer(&renderer) {}
+
+    void Create(int width, int height, DepthFormat format = DepthFormat::D32F, bool shaderReadable = true);
+    void Release();
+
+    void* GetHandle() const { return m_backendHandle; }
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    DepthFormat GetFormat() const { return m_format; }
+    Rendeructor* GetRenderer() const { return m_renderer; }
+
+private:
+    Rendeructor* m_renderer = nullptr;
+    void* m_backendHandle = nullptr;
+    int m_width = 0;
+    int m_height = 0;
+    DepthFormat m_format = DepthFormat::D32F;
 };
 
 class RENDER_API Texture3D {
 public:
     Texture3D() = default;
+    explicit Texture3D(Rendeructor& renderer) : m_renderer(&renderer) {}
     void Create(int width, int height, int depth, const void* data);
     void* GetHandle() const { return m_backendHandle; }
+    Rendeructor* GetRenderer() const { return m_renderer; }
 private:
+    Rendeructor* m_renderer = nullptr;
     void* m_backendHandle = nullptr;
 };
 
 class RENDER_API TextureCube {
 public:
     TextureCube() = default;
+    explicit TextureCube(Rendeructor& renderer) : m_renderer(&renderer) {}
 
     // +X (Right), -X (Left), +Y (Top), -Y (Bottom), +Z (Front), -Z (Back)
     bool LoadFromFiles(const std::vector<std::string>& filepaths);
 
     void* GetHandle() const { return m_backendHandle; }
+    Rendeructor* GetRenderer() const { return m_renderer; }
 
 private:
+    Rendeructor* m_renderer = nullptr;
     void* m_backendHandle = nullptr;
 };
 
 class RENDER_API Sampler {
 public:
+    Sampler() = default;
+    explicit Sampler(Rendeructor& renderer) : m_renderer(&renderer) {}
     void Create(const std::string& filterName = "Linear");
     void* GetHandle() const { return m_backendHandle; }
+    Rendeructor* GetRenderer() const { return m_renderer; }
+private:
+    Rendeructor* m_renderer = nullptr;
+    void* m_backendHandle = nullptr;
+};
+
+// GPU time of the commands between Begin() and End(). The result arrives a few frames later, so keep several
+// timers in flight to measure every frame. Begin/End are render-thread only and do nothing elsewhere
+class RENDER_API GPUTimer {
+public:
+    GPUTimer() = default;
+    explicit GPUTimer(Rendeructor& renderer) : m_renderer(&renderer) {}
+    // false when the backend has no timestamp queries
+    bool Create();
+    void Release();
+    void Begin();
+    void End();
+    // true once the measurement is available; the timer can then be reused
+    bool GetResult(double& milliseconds);
+
+    bool IsValid() const { return m_backendHandle != nullptr; }
+    bool IsPending() const { return m_pending; }
+    Rendeructor* GetRenderer() const { return m_renderer; }
+private:
+    Rendeructor* m_renderer = nullptr;
+    void* m_backendHandle = nullptr;
+    bool m_pending = false;
+};
+
+// GPU buffer read and written by shaders: structured or raw, bound by name through ShaderPass
+class RENDER_API ComputeBuffer {
+public:
+    ComputeBuffer() = default;
+    explicit ComputeBuffer(Rendeructor& renderer) : m_renderer(&renderer) {}
+
+    // count elements of stride bytes (Raw / IndirectArgs: count 32-bit words, stride ignored)
+    void Create(int count, int stride, ComputeBufferType type = ComputeBufferType::Structured, const void* data = nullptr);
+    // Overwrites count elements starting at firstElement
+    void Update(const void* data, int count, int firstElement = 0);
+    // Copies the whole buffer back to CPU memory; stalls until the GPU is done with it
+    bool Read(void* data) const;
+    void Release();
+
+    void* GetHandle() const { return m_backendHandle; }
+    int GetCount() const { return m_count; }
+    int GetStride() const { return m_stride; }
+    size_t GetSize() const { return (size_t)m_count * m_stride; }
+    ComputeBufferType GetType() const { return m_type; }
+    Rendeructor* GetRenderer() const { return m_renderer; }
+
+private:
+    Rendeructor* m_renderer = nullptr;
+    void* m_backendHandle = nullptr;
+    int m_count = 0;
+    int m_stride = 0;
+    ComputeBufferType m_type = ComputeBufferType::Structured;
+};
+
+// Read-only array for shaders (StructuredBuffer<T>), written from the CPU. Unlike a constant buffer array it has no
+// 64 KB limit, and updates upload only the changed range
+class RENDER_API StructuredBuffer {
+public:
+    StructuredBuffer() = default;
+    explicit StructuredBuffer(Rendeructor& renderer) : m_renderer(&renderer) {}
+
+    // dynamic: for data rewritten every frame, updates stream through an upload ring instead of UpdateSubresource
+    void Create(const void* data, int count, int stride, bool dynamic = false);
+    template<typename T>
+    void Create(std::span<const T> elements, bool dynamic = false) {
+        static_assert(std::is_trivially_copyable_v<T>, "Buffer elements must be trivially copyable");
+        Create(elements.data(), (int)elements.size(), (int)sizeof(T), dynamic);
+    }
+
+    // Overwrites count elements starting at firstElement; ranges past the capacity are rejected
+    bool Update(const void* data, int count, int firstElement = 0);
+    template<typename T>
+    bool Update(std::span<const T> elements, int firstElement = 0) {
+        static_assert(std::is_trivially_copyable_v<T>, "Buffer elements must be trivially copyable");
+        if (sizeof(T) != (size_t)m_stride) return false;
+        return Update(elements.data(), (int)elements.size(), firstElement);
+    }
+    void Release();
+
+    void* GetHandle() const { return m_backendHandle; }
+    int GetCount() const { return m_count; }
+    int GetStride() const { return m_stride; }
+    bool IsDynamic() const { return m_dynamic; }
+    Rendeructor* GetRenderer() const { return m_renderer; }
+
 private:
+    Rendeructor* m_renderer = nullptr;
     void* m_backendHandle = nullptr;
+    int m_count = 0;
+    int m_stride = 0;
+    bool m_dynamic = false;
 };
 
+// Graphics pass (vertex + pixel shader) or, when ComputeShaderPath is set, a compute pass run with Rendeructor::Dispatch.
+// Resources are matched to shader registers by name through reflection
 class RENDER_API ShaderPass {
 public:
     std::string PixelShaderPath;
     std::string PixelShaderEntryPoint = "main";
     std::string VertexShaderPath;
     std::string VertexShaderEntryPoint = "main";
+    std::string ComputeShaderPath;
+    std::string ComputeShaderEntryPoint = "main";
+    // Auto-instancing opt-in: a vertex shader in VertexShaderPath that reads InstancedConstant from INSTANCE_ semantics
+    // (a float4x4 World as four float4 INSTANCE_WORLD0..3) instead of the constant buffer. Runs of DrawMesh calls that
+    // differ only in that constant are merged into one instanced draw. Vertex shader textures and buffers are bound to
+    // the slots of the regular vertex shader, so both should use explicit registers
+    std::string InstancedVertexShaderEntryPoint;
+    std::string InstancedConstant = "World";
+
+    bool IsCompute() const { return !ComputeShaderPath.empty(); }
+    bool HasInstancedVariant() const { return !IsCompute() && !InstancedVertexShaderEntryPoint.empty(); }
 
     void AddTexture(const std::string& name, const Texture& texture);
     void AddTexture(const std::string& name, const Texture3D& texture);
     void AddTexture(const std::string& name, const TextureCube& texture);
+    void AddTexture(const std::string& name, const DepthTexture& texture);
     void AddSampler(const std::string& name, const Sampler& sampler);
+    // Read-only buffer (StructuredBuffer / ByteAddressBuffer)
+    void AddBuffer(const std::string& name, const ComputeBuffer& buffer);
+    void AddBuffer(const std::string& name, const StructuredBuffer& buffer);
+    // Compute passes only: RWTexture2D (created with Texture::CreateStorage) and RWStructuredBuffer / RWByteAddressBuffer
+    void AddStorageTexture(const std::string& name, const Texture& texture);
+    void AddStorageBuffer(const std::string& name, const ComputeBuffer& buffer);
 
     const std::map<std::string, const Texture*>& GetTextures() const { return m_textures; }
     const std::map<std::string, const Texture3D*>& GetTextures3D() const { return m_textures3D; }
     const std::map<std::string, const TextureCube*>& GetTexturesCube() const { return m_texturesCube; }
+    const std::map<std::string, const DepthTexture*>& GetDepthTextures() const { return m_depthTextures; }
     const std::map<std::string, const Sampler*>& GetSamplers() const { return m_samplers; }
+    const std::map<std::string, const ComputeBuffer*>& GetBuffers() const { return m_buffers; }
+    const std::map<std::string, const StructuredBuffer*>& GetStructuredBuffers() const { return m_structuredBuffers; }
+    const std::map<std::string, const Texture*>& GetStorageTextures() const { return m_storageTextures; }
+    const std::map<std::string, const ComputeBuffer*>& GetStorageBuffers() const { return m_storageBuffers; }
 
 private:
     std::map<std::string, const Texture*> m_textures;
     std::map<std::string, const Texture3D*> m_textures3D;
     std::map<std::string, const TextureCube*> m_texturesCube;
+    std::map<std::string, const DepthTexture*> m_depthTextures;
     std::map<std::string, const Sampler*> m_samplers;
+    std::map<std::string, const ComputeBuffer*> m_buffers;
+    std::map<std::string, const StructuredBuffer*> m_structuredBuffers;
+    std::map<std::string, const Texture*> m_storageTextures;
+    std::map<std::string, const ComputeBuffer*> m_storageBuffers;
+};
+
+// Index range of a mesh drawn on its own: one material of an OBJ, or one of several meshes packed into shared buffers
+// (each with indices relative to its BaseVertex)
+struct SubMesh {
+    int StartIndex = 0;
+    int IndexCount = 0;
+    int BaseVertex = 0;
+    int MaterialId = 0; // into Mesh::GetMaterialNames(), if the mesh has names
+};
+
+struct MeshLOD {
+    void* IBHandle = nullptr;
+    int IndexCount = 0;
+    int StartIndex = 0;  // first index in IBHandle (LOD 0 of a mesh in the GeometryArena)
+    float Error = 0.0f; // bound on the object-space deviation from LOD 0 (MeshSimplifier errors of all levels summed)
+};
+
+// Six normalized planes (xyz - normal pointing inside, w - distance), extracted from a row-vector view-projection
+struct RENDER_API Frustum {
+    Math::float4 Planes[6];
+
+    static Frustum FromViewProjection(const Math::float4x4& viewProjection);
+    bool IntersectsSphere(const Math::float3& center, float radius) const;
+};
+
+// Cluster of up to 64 vertices / 124 triangles with culling bounds (object space)
+struct Meshlet {
+    unsigned int VertexOffset = 0;   // into Mesh::GetMeshletVertices()
+    unsigned int TriangleOffset = 0; // into Mesh::GetMeshletTriangles(), 3 local indices per triangle
+    unsigned int VertexCount = 0;
+    unsigned int TriangleCount = 0;
+
+    Math::float3 Center = { 0, 0, 0 };
+    float Radius = 0.0f;
+    Math::float3 ConeAxis = { 0, 0, 0 };
+    float ConeCutoff = 1.0f; // sin of the cone half-angle; 1 - cone is too wide, never backface culled
+};
+
+struct MeshletCullStats {
+    int Total = 0;
+    int FrustumCulled = 0;
+    int BackfaceCulled = 0;
+    int Visible = 0;
+    size_t IndexCount = 0;
+};
+
+// Camera parameters for screen-space LOD selection
+struct RENDER_API LODCamera {
+    Math::float3 Position = { 0, 0, 0 };
+    float PixelsPerUnit = 0.0f; // viewportHeight / (2 * tan(fovY / 2)) - pixels covered by 1 unit at distance 1
+    float PixelError = 1.0f;    // largest simplification error allowed on screen, in pixels
+    bool Orthographic = false;  // PixelsPerUnit is then the same at any distance (e.g. shadow map size / covered extent)
+    bool Enabled = false;
+};
+
+// Work submitted during one frame, counted by Rendeructor at the API level so every backend reports the same numbers
+struct FrameStats {
+    unsigned long long Frame = 0;
+    int DrawCalls = 0;
+    int IndirectDrawCalls = 0;      // also in DrawCalls; their instances and indices are on the GPU and not counted
+    int AutoInstancedDraws = 0;     // DrawMesh calls merged into instanced draws (the merged draws are in DrawCalls)
+    long long Instances = 0;        // 1 per non-instanced draw
+    long long Indices = 0;          // index count times instance count
+    int ShaderSwitches = 0;         // SetShaderPass with a different pass than the bound one
+    int PipelineStateChanges = 0;   // state changes that differ from the current state
+    int TextureBinds = 0;           // textures bound by SetShaderPass (all kinds)
+    int SamplerBinds = 0;
+    size_t ConstantBytes = 0;       // bytes passed to SetConstant / SetCustomConstant
+    int MapCalls = 0;               // buffer updates and texture readbacks
+    int RenderTargetSwitches = 0;
+    int Clears = 0;                 // colour targets and depth clears
+    int Dispatches = 0;             // compute dispatches, direct and indirect
 };
 
 class RENDER_API Mesh {
 public:
     Mesh() = default;
+    explicit Mesh(Rendeructor& renderer) : m_renderer(&renderer) {}
     void Create(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
-
-    bool LoadFromOBJ(const std::string& filepath);
+    // Uploads already prepared VB/IB bytes (e.g. straight from a mapped .rmesh file) without copying
+    void CreateFromMemory(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                          const Math::float3& boundsMin, const Math::float3& boundsMax);
+
+    // useCache - read/write a binary "<file>.rmesh" next to the source so later launches skip text parsing.
+    // Faces are grouped by usemtl into one sub-mesh per material
+    bool LoadFromOBJ(const std::string& filepath, bool useCache = true);
+
+    // Ranges for Rendeructor::DrawSubMesh. Create/CreateFromMemory reset them to one range covering the whole mesh.
+    // LODs and meshlets are built for the whole index buffer
+    void SetSubMeshes(const std::vector<SubMesh>& subMeshes, const std::vector<std::string>& materialNames = {});
+    const std::vector<SubMesh>& GetSubMeshes() const { return m_subMeshes; }
+    int GetSubMeshCount() const { return (int)m_subMeshes.size(); }
+    SubMesh GetSubMesh(int index) const;
+    const std::vector<std::string>& GetMaterialNames() const { return m_materialNames; }
+
+    // Frees the vertex/index buffers (or the GeometryArena allocation) and the LOD and culling buffers
+    void Release();
+
+    // Keeps a CPU copy of the uploaded vertices/indices (required by GenerateLODs). Set before Create/LoadFromOBJ.
+    void SetKeepCPUData(bool keep) { m_keepCPUData = keep; }
+    void ReleaseCPUData();
+
+    // Builds up to maxLevels-1 simplified index buffers that share this mesh's vertex buffer.
+    // reduction - triangle ratio between neighbouring levels, maxError - deviation limit relative to the bounding radius.
+    // Returns the resulting number of levels (including LOD 0).
+    int GenerateLODs(int maxLevels = 4, float reduction = 0.5f, float maxError = 0.05f);
+    int GetLODCount() const { return (int)m_lods.size() + 1; }
+    MeshLOD GetLOD(int level) const;
+    int SelectLOD(const LODCamera& camera, const Math::float4x4& world) const;
+
+    // Splits LOD 0 into meshlets (needs CPU data, see SetKeepCPUData). Returns the meshlet count.
+    int BuildMeshlets(int maxVertices = 64, int maxTriangles = 124);
+    const std::vector<Meshlet>& GetMeshlets() const { return m_meshlets; }
+    const std::vector<unsigned int>& GetMeshletVertices() const { return m_meshletVertices; }
+    const std::vector<unsigned char>& GetMeshletTriangles() const { return m_meshletTriangles; }
+
+    // Rejects meshlets outside the frustum or facing away from the camera and writes the indices of the rest.
+    // Under non-uniform scale in world only the frustum test is done; cameraPosition is in world space.
+    MeshletCullStats CullMeshlets(const Frustum& frustum, const Math::float3& cameraPosition, const Math::float4x4& world,
+                                  std::vector<unsigned int>& outIndices) const;
+    // Writes culled indices into a per-mesh index buffer (sized for the full mesh) and returns its handle
+    void* UploadCulledIndices(const std::vector<unsigned int>& indices) const;
+
+    // Keeps a coarse CPU-side copy of the mesh (positions + triangles) for the software occlusion culler.
+    // Needs CPU data, see SetKeepCPUData. Returns the triangle count.
+    int BuildOccluder(int maxTriangles = 256);
+    const std::vector<Math::float3>& GetOccluderPositions() const { return m_occluderPositions; }
+    const std::vector<unsigned int>& GetOccluderIndices() const { return m_occluderIndices; }
 
     static void GenerateCube(Mesh& outMesh, float size = 1.0f);
     static void GeneratePlane(Mesh& outMesh, float width = 10.0f, float depth = 10.0f);
@@ -173,28 +523,131 @@ public:
     static void GenerateDisc(Mesh& outMesh, float radius = 1.0f, int segments = 32);
     static void GenerateTriangle(Mesh& outMesh, float size = 1.0f);
 
-    void* GetVB() const { return m_vbHandle; }
-    void* GetIB() const { return m_ibHandle; }
+    void* GetVB() const;
+    void* GetIB() const;
+    // Position of the mesh in shared GeometryArena buffers, to be added to draw ranges; 0 for meshes with own buffers.
+    // Looked up on every call, the arena moves meshes when it defragments
+    int GetBaseVertex() const;
+    int GetStartIndex() const;
+    bool IsInGeometryArena() const { return m_arenaId >= 0; }
     int GetIndexCount() const { return m_indexCount; }
+    int GetVertexCount() const { return m_vertexCount; }
+
+    const Math::float3& GetBoundsMin() const { return m_boundsMin; }
+    const Math::float3& GetBoundsMax() const { return m_boundsMax; }
+    Math::float3 GetBoundsCenter() const { return (m_boundsMin + m_boundsMax) * 0.5f; }
+    float GetBoundingRadius() const { return Math::length(m_boundsMax - m_boundsMin) * 0.5f; }
+    Rendeructor* GetRenderer() const { return m_renderer; }
 
 private:
+    void ReleaseLODs();
+
+    Rendeructor* m_renderer = nullptr;
     void* m_vbHandle = nullptr;
     void* m_ibHandle = nullptr;
+    int m_arenaId = -1;
     int m_indexCount = 0;
+    int m_vertexCount = 0;
+
+    Math::float3 m_boundsMin = { 0, 0, 0 };
+    Math::float3 m_boundsMax = { 0, 0, 0 };
+
+    bool m_keepCPUData = false;
+    std::vector<Vertex> m_cpuVertices;
+    std::vector<unsigned int> m_cpuIndices;
+
+    std::vector<MeshLOD> m_lods; // LOD 1..N, LOD 0 is m_ibHandle
+    std::vector<SubMesh> m_subMeshes;
+    std::vector<std::string> m_materialNames;
+
+    std::vector<Meshlet> m_meshlets;
+    std::vector<unsigned int> m_meshletVertices;
+    std::vector<unsigned char> m_meshletTriangles;
+    mutable void* m_culledIBHandle = nullptr;
+
+    std::vector<Math::float3> m_occluderPositions;
+    std::vector<unsigned int> m_occluderIndices;
 };
 
 class RENDER_API InstanceBuffer {
 public:
     InstanceBuffer() = default;
+    explicit InstanceBuffer(Rendeructor& renderer) : m_renderer(&renderer) {}
 
     void Create(const void* data, int count, int stride);
+    // For instances rewritten every frame: updates are streamed through a ring of CPU-writable memory
+    // (no-overwrite appends, discard on wrap) instead of stalling on the buffer the GPU is reading
+    void CreateDynamic(const void* data, int count, int stride);
+
+    // Replaces the instances in place; the GPU buffer is only recreated when count exceeds the capacity
+    void Update(const void* data, int count);
+    // Overwrites count instances starting at firstInstance, only that range is uploaded.
+    // Writing past the current count grows it; past the capacity the buffer is recreated and the instances already
+    // there are kept (copied on the GPU when there is no CPU copy).
+    void Update(const void* data, int count, int firstInstance);
+    template<typename T>
+    void Update(std::span<const T> instances, int firstInstance) {
+        static_assert(std::is_trivially_copyable_v<T>, "Instance data must be trivially copyable");
+        if (sizeof(T) != (size_t)m_stride) return;
+        Update(instances.data(), (int)instances.size(), firstInstance);
+    }
+
+    // Keeps a CPU copy of the instances, required by InstanceCuller::Build and by per-LOD batches (BuildLODBatches).
+    // Off by default; set before Create/CreateDynamic.
+    void SetKeepCPUData(bool keep) { m_keepCPUData = keep; }
+
+    // Byte offset of the float4x4 world matrix inside an instance (-1 - none).
+    // When set and the mesh has LODs, DrawMeshInstanced splits the instances into per-LOD batches
+    // (from the CPU copy, or from the ranges set by SetLODRanges).
+    void SetTransformOffset(int offset) { m_transformOffset = offset; }
+    int GetTransformOffset() const { return m_transformOffset; }
+
+    struct LODBatch {
+        void* Handle = nullptr;
+        int Count = 0;
+    };
+    // Regroups instances by the LOD they need. Cached until the mesh, the data or the camera parameters change, or the
+    // camera moves far enough (relative to the nearest instance) to shift the projected errors by more than ~10%.
+    const std::vector<LODBatch>& BuildLODBatches(const Mesh& mesh, const LODCamera& camera) const;
+
+    // Marks the instances as already grouped by LOD of mesh: counts[level] consecutive instances per level
+    // (InstanceCuller writes them this way). DrawMeshInstanced then draws the ranges straight from this buffer.
+    // Cleared by any update of the instances.
+    void SetLODRanges(const Mesh* mesh, const std::vector<int>& counts);
+    const Mesh* GetLODRangeMesh() const { return m_lodRangeMesh; }
+    const std::vector<int>& GetLODRanges() const { return m_lodRanges; }
 
     void* GetHandle() const { return m_backendHandle; }
     int GetCount() const { return m_count; }
     int GetStride() const { return m_stride; }
+    int GetCapacity() const { return m_capacity; }
+    bool IsDynamic() const { return m_dynamic; }
+    const unsigned char* GetCPUData() const { return m_cpuData.empty() ? nullptr : m_cpuData.data(); }
+    Rendeructor* GetRenderer() const { return m_renderer; }
 
 private:
+    void Allocate(const void* data, int count, int stride, bool dynamic);
+    // Recreates the GPU buffer with a larger capacity, keeping the first m_count instances
+    void Grow(int capacity);
+
+    Rendeructor* m_renderer = nullptr;
     void* m_backendHandle = nullptr;
     int m_count = 0;
     int m_stride = 0;
+    int m_capacity = 0;
+    bool m_dynamic = false;
+
+    int m_transformOffset = -1;
+    bool m_keepCPUData = false;
+    std::vector<unsigned char> m_cpuData;
+    unsigned int m_dataVersion = 0;
+
+    const Mesh* m_lodRangeMesh = nullptr;
+    std::vector<int> m_lodRanges;
+
+    mutable std::vector<LODBatch> m_lodBatches;
+    mutable const Mesh* m_lodBatchMesh = nullptr;
+    mutable LODCamera m_lodBatchCamera;
+    mutable float m_lodBatchMoveLimit = 0.0f; // camera distance from m_lodBatchCamera that forces a rebuild
+    mutable unsigned int m_lodBatchDataVersion = 0;
 };
@@ -1,29 +1,385 @@
 #include "pch.h"
 #include "Rendeructor.h"
 #include "BackendDX11.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <TinyObjLoader/TinyObjLoader.h>
 
 void Mesh::Create(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
-    if (Rendeructor::GetCurrent() && Rendeructor::GetCurrent()->GetBackendAPI()) {
+    Math::float3 boundsMin = { 0, 0, 0 };
+    Math::float3 boundsMax = { 0, 0, 0 };
+
+    if (!vertices.empty()) {
+        boundsMin = boundsMax = vertices[0].Position;
+        for (const auto& v : vertices) {
+            boundsMin.x = std::min(boundsMin.x, v.Position.x);
+            boundsMin.y = std::min(boundsMin.y, v.Position.y);
+            boundsMin.z = std::min(boundsMin.z, v.Position.z);
+            boundsMax.x = std::max(boundsMax.x, v.Position.x);
+            boundsMax.y = std::max(boundsMax.y, v.Position.y);
+            boundsMax.z = std::max(boundsMax.z, v.Position.z);
+        }
+    }
+
+    CreateFromMemory(vertices.data(), vertices.size(), indices.data(), indices.size(), boundsMin, boundsMax);
+}
+
+void Mesh::CreateFromMemory(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                            const Math::float3& boundsMin, const Math::float3& boundsMax) {
+    //  VB/IB,  ,       (    
+    // )     
+    Release();
+    m_boundsMin = boundsMin;
+    m_boundsMax = boundsMax;
+    m_meshlets.clear();
+    m_meshletVertices.clear();
+    m_meshletTriangles.clear();
+    m_subMeshes.assign(1, SubMesh{ 0, (int)indexCount, 0, 0 });
+    m_materialNames.clear();
+
+    if (m_keepCPUData) {
+        m_cpuVertices.assign(vertices, vertices + vertexCount);
+        m_cpuIndices.assign(indices, indices + indexCount);
+    }
+
+    if (Rendeructor::AttachBackend(m_renderer)) {
+        Rendeructor* renderer = m_renderer;
+        //         -       
+        const bool renderThread = renderer->IsRenderThread();
+        GeometryArena& arena = renderer->GetGeometryArena();
+
+        //        ;     -  ,  
+        if (arena.IsInitialized() && renderThread) {
+            m_arenaId = arena.Allocate(vertices, vertexCount, indices, indexCount);
+        }
+
+        if (m_arenaId < 0) {
+            m_vbHandle = renderer->GetBackendAPI()->CreateVertexBuffer(
+                vertices,
+                vertexCount * sizeof(Vertex),
+                sizeof(Vertex)
+            );
+
+            m_ibHandle = renderer->GetBackendAPI()->CreateIndexBuffer(
+                indices,
+                indexCount * sizeof(unsigned int)
+            );
+        }
 
-        m_vbHandle = Rendeructor::GetCurrent()->GetBackendAPI()->CreateVertexBuffer(
-            vertices.data(),
-            vertices.size() * sizeof(Vertex),
-            sizeof(Vertex)
-        );
+        m_indexCount = (int)indexCount;
+        m_vertexCount = (int)vertexCount;
+    }
+}
 
-        m_ibHandle = Rendeructor::GetCurrent()->GetBackendAPI()->CreateIndexBuffer(
-            indices.data(),
-            indices.size() * sizeof(unsigned int)
-        );
+void Mesh::SetSubMeshes(const std::vector<SubMesh>& subMeshes, const std::vector<std::string>& materialNames) {
+    m_subMeshes.clear();
+    for (const SubMesh& subMesh : subMeshes) {
+        //    IB  ,       
+        if (subMesh.StartIndex < 0 || subMesh.IndexCount <= 0 ||
+            (long long)subMesh.StartIndex + subMesh.IndexCount > m_indexCount) {
+            std::cerr << "[Mesh] SetSubMeshes: range " << subMesh.StartIndex << "+" << subMesh.IndexCount
+                << " is outside of " << m_indexCount << " indices, skipped" << std::endl;
+            continue;
+        }
+        m_subMeshes.push_back(subMesh);
+    }
+    m_materialNames = materialNames;
+}
 
-        m_indexCount = (int)indices.size();
+void Mesh::Release() {
+    Rendeructor* renderer = m_renderer;
+    if (renderer) {
+        //            Present()
+        if (m_arenaId >= 0) {
+            const int arenaId = m_arenaId;
+            renderer->RunOnRenderThread([renderer, arenaId] { renderer->GetGeometryArena().Free(arenaId); });
+        }
+        renderer->ReleaseBuffer(m_vbHandle);
+        renderer->ReleaseBuffer(m_ibHandle);
+        renderer->ReleaseBuffer(m_culledIBHandle);
     }
+
+    m_arenaId = -1;
+    m_vbHandle = nullptr;
+    m_ibHandle = nullptr;
+    m_culledIBHandle = nullptr;
+    m_indexCount = 0;
+    m_vertexCount = 0;
+    ReleaseLODs();
+    m_subMeshes.clear();
+    m_materialNames.clear();
+}
+
+void* Mesh::GetVB() const {
+    if (m_arenaId >= 0 && m_renderer) return m_renderer->GetGeometryArena().GetRange(m_arenaId).VB;
+    return m_vbHandle;
+}
+
+void* Mesh::GetIB() const {
+    if (m_arenaId >= 0 && m_renderer) return m_renderer->GetGeometryArena().GetRange(m_arenaId).IB;
+    return m_ibHandle;
+}
+
+int Mesh::GetBaseVertex() const {
+    if (m_arenaId >= 0 && m_renderer) return m_renderer->GetGeometryArena().GetRange(m_arenaId).BaseVertex;
+    return 0;
 }
 
-bool Mesh::LoadFromOBJ(const std::string& filepath) {
+int Mesh::GetStartIndex() const {
+    if (m_arenaId >= 0 && m_renderer) return m_renderer->GetGeometryArena().GetRange(m_arenaId).StartIndex;
+    return 0;
+}
+
+SubMesh Mesh::GetSubMesh(int index) const {
+    if (index < 0 || index >= (int)m_subMeshes.size()) return SubMesh();
+    return m_subMeshes[index];
+}
+
+void Mesh::ReleaseCPUData() {
+    std::vector<Vertex>().swap(m_cpuVertices);
+    std::vector<unsigned int>().swap(m_cpuIndices);
+}
+
+int Mesh::GenerateLODs(int maxLevels, float reduction, float maxError) {
+    if (m_cpuVertices.empty() || m_cpuIndices.empty()) {
+        std::cerr << "[Mesh] GenerateLODs: no CPU data, call SetKeepCPUData(true) before creating the mesh" << std::endl;
+        return GetLODCount();
+    }
+
+    auto* backend = Rendeructor::AttachBackend(m_renderer);
+    if (!backend) return GetLODCount();
+
+    ReleaseLODs();
+
+    const float radius = GetBoundingRadius();
+    const float errorLimit = maxError * radius;
+    reduction = std::clamp(reduction, 0.05f, 0.95f);
+
+    //      -  ,   
+    std::vector<unsigned int> source = m_cpuIndices;
+    std::vector<unsigned int> simplified;
+    float accumulatedError = 0.0f;
+
+    for (int level = 1; level < maxLevels; ++level) {
+        size_t target = (size_t)(source.size() / 3 * reduction) * 3;
+        if (target < 3) break;
+
+        MeshSimplifier::Result r = MeshSimplifier::Simplify(m_cpuVertices.data(), m_cpuVertices.size(),
+            source.data(), source.size(), target, errorLimit - accumulatedError, simplified);
+
+        //       -   
+        if (simplified.empty() || simplified.size() * 100 > source.size() * 95) break;
+
+        accumulatedError += r.Error;
+
+        MeshLOD lod;
+        lod.IBHandle = backend->CreateIndexBuffer(simplified.data(), simplified.size() * sizeof(unsigned int));
+        lod.IndexCount = (int)simplified.size();
+        lod.Error = accumulatedError;
+        if (!lod.IBHandle) break;
+        m_lods.push_back(lod);
+
+        std::cout << "[Mesh] LOD " << level << ": " << simplified.size() / 3 << " triangles ("
+            << (100.0f * simplified.size() / m_cpuIndices.size()) << "%), error " << accumulatedError
+            << " (" << (radius > 0.0f ? accumulatedError / radius : 0.0f) << " of radius), passes " << r.Passes
+            << std::endl;
+
+        source.swap(simplified);
+        if (accumulatedError >= errorLimit) break;
+    }
+
+    return GetLODCount();
+}
+
+void Mesh::ReleaseLODs() {
+    if (m_renderer) {
+        for (const MeshLOD& lod : m_lods) m_renderer->ReleaseBuffer(lod.IBHandle);
+    }
+    m_lods.clear();
+}
+
+MeshLOD Mesh::GetLOD(int level) const {
+    if (level <= 0 || m_lods.empty()) {
+        MeshLOD base;
+        base.IBHandle = GetIB();
+        base.IndexCount = m_indexCount;
+        base.StartIndex = GetStartIndex();
+        return base;
+    }
+    return m_lods[std::min(level, (int)m_lods.size()) - 1];
+}
+
+int Mesh::SelectLOD(const LODCamera& camera, const Math::float4x4& world) const {
+    if (m_lods.empty() || !camera.Enabled) return 0;
+
+    Math::float3 scale = world.get_scale();
+    float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+
+    //      ;       
+    float errorToPixels = camera.PixelsPerUnit * maxScale;
+    if (!camera.Orthographic) {
+        //      ;   -   
+        Math::float3 center = world.transform_point(GetBoundsCenter());
+        float distance = Math::length(center - camera.Position) - GetBoundingRadius() * maxScale;
+        if (distance <= 0.0f) return 0;
+        errorToPixels /= distance;
+    }
+
+    for (int level = (int)m_lods.size(); level >= 1; --level) {
+        if (m_lods[level - 1].Error * errorToPixels <= camera.PixelError) return level;
+    }
+    return 0;
+}
+
+Frustum Frustum::FromViewProjection(const Math::float4x4& viewProjection) {
+    // clip = p * M:      ( 0..1,   D3D)
+    const Math::float4 c0 = viewProjection.col0();
+    const Math::float4 c1 = viewProjection.col1();
+    const Math::float4 c2 = viewProjection.col2();
+    const Math::float4 c3 = viewProjection.col3();
+
+    Frustum f;
+    f.Planes[0] = c3 + c0; // left
+    f.Planes[1] = c3 - c0; // right
+    f.Planes[2] = c3 + c1; // bottom
+    f.Planes[3] = c3 - c1; // top
+    f.Planes[4] = c2;      // near
+    f.Planes[5] = c3 - c2; // far
+
+    for (auto& plane : f.Planes) {
+        float len = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (len > 0.0f) plane = plane * (1.0f / len);
+    }
+    return f;
+}
+
+bool Frustum::IntersectsSphere(const Math::float3& center, float radius) const {
+    for (const auto& plane : Planes) {
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) return false;
+    }
+    return true;
+}
+
+int Mesh::BuildMeshlets(int maxVertices, int maxTriangles) {
+    if (m_cpuVertices.empty() || m_cpuIndices.empty()) {
+        std::cerr << "[Mesh] BuildMeshlets: no CPU data, call SetKeepCPUData(true) before creating the mesh" << std::endl;
+        return 0;
+    }
+
+    MeshletBuilder::Build(m_cpuVertices.data(), m_cpuVertices.size(), m_cpuIndices.data(), m_cpuIndices.size(),
+        (size_t)maxVertices, (size_t)maxTriangles, m_meshlets, m_meshletVertices, m_meshletTriangles);
+
+    int cones = 0;
+    for (const auto& m : m_meshlets) cones += m.ConeCutoff < 1.0f ? 1 : 0;
+
+    std::cout << "[Mesh] Meshlets: " << m_meshlets.size()
+        << " (avg " << (m_meshlets.empty() ? 0.0f : (float)m_meshletVertices.size() / m_meshlets.size()) << " verts, "
+        << (m_meshlets.empty() ? 0.0f : (float)(m_meshletTriangles.size() / 3) / m_meshlets.size()) << " tris, "
+        << cones << " with usable normal cone)" << std::endl;
+
+    return (int)m_meshlets.size();
+}
+
+int Mesh::BuildOccluder(int maxTriangles) {
+    if (m_cpuVertices.empty() || m_cpuIndices.empty()) {
+        std::cerr << "[Mesh] BuildOccluder: no CPU data, call SetKeepCPUData(true) before creating the mesh" << std::endl;
+        return 0;
+    }
+
+    //    CPU -    ,   
+    std::vector<unsigned int> simplified;
+    size_t target = (size_t)std::max(maxTriangles, 1) * 3;
+    if (m_cpuIndices.size() > target) {
+        MeshSimplifier::Simplify(m_cpuVertices.data(), m_cpuVertices.size(), m_cpuIndices.data(), m_cpuIndices.size(),
+            target, GetBoundingRadius(), simplified);
+    }
+    if (simplified.empty()) simplified = m_cpuIndices;
+
+    //       
+    std::vector<int> remap(m_cpuVertices.size(), -1);
+    m_occluderPositions.clear();
+    m_occluderIndices.resize(simplified.size());
+    for (size_t i = 0; i < simplified.size(); ++i) {
+        int& slot = remap[simplified[i]];
+        if (slot < 0) {
+            slot = (int)m_occluderPositions.size();
+            m_occluderPositions.push_back(m_cpuVertices[simplified[i]].Position);
+        }
+        m_occluderIndices[i] = (unsigned int)slot;
+    }
+
+    std::cout << "[Mesh] Occluder: " << m_occluderIndices.size() / 3 << " triangles, "
+        << m_occluderPositions.size() << " vertices" << std::endl;
+
+    return (int)(m_occluderIndices.size() / 3);
+}
+
+MeshletCullStats Mesh::CullMeshlets(const Frustum& frustum, const Math::float3& cameraPosition, const Math::float4x4& world,
+                                    std::vector<unsigned int>& outIndices) const {
+    MeshletCullStats stats;
+    stats.Total = (int)m_meshlets.size();
+    outIndices.clear();
+
+    Math::float3 scale = world.get_scale();
+    float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+    float minScale = std::min(scale.x, std::min(scale.y, scale.z));
+
+    //     ;      
+    // -       -    ,     
+    const bool uniformScale = maxScale - minScale <= maxScale * 1e-3f;
+
+    for (const Meshlet& m : m_meshlets) {
+        Math::float3 center = world.transform_point(m.Center);
+        float radius = m.Radius * maxScale;
+
+        if (!frustum.IntersectsSphere(center, radius)) {
+            stats.FrustumCulled++;
+            continue;
+        }
+
+        //      ,          
+        if (m.ConeCutoff < 1.0f && uniformScale) {
+            Math::float3 axis = Math::normalize(world.transform_vector(m.ConeAxis));
+            Math::float3 toCluster = center - cameraPosition;
+            if (Math::dot(toCluster, axis) >= m.ConeCutoff * Math::length(toCluster) + radius) {
+                stats.BackfaceCulled++;
+                continue;
+            }
+        }
+
+        const unsigned int* vertices = m_meshletVertices.data() + m.VertexOffset;
+        const unsigned char* triangles = m_meshletTriangles.data() + (size_t)m.TriangleOffset * 3;
+        for (unsigned int i = 0; i < m.TriangleCount * 3; ++i) {
+            outIndices.push_back(vertices[triangles[i]]);
+        }
+        stats.Visible++;
+    }
+
+    stats.IndexCount = outIndices.size();
+    return stats;
+}
+
+void* Mesh::UploadCulledIndices(const std::vector<unsigned int>& indices) const {
+    auto* backend = m_renderer ? m_renderer->GetBackendAPI() : nullptr;
+    if (!backend || indices.empty()) return nullptr;
+
+    //    ,       
+    if (!m_culledIBHandle) {
+        m_culledIBHandle = backend->CreateIndexBuffer(nullptr, (size_t)m_indexCount * sizeof(unsigned int));
+    }
+    if (m_culledIBHandle) {
+        backend->UpdateBuffer(m_culledIBHandle, indices.data(), std::min(indices.size(), (size_t)m_indexCount) * sizeof(unsigned int));
+        m_renderer->CountMapCall();
+    }
+    return m_culledIBHandle;
+}
+
+//     TinyObj - ,       
+static bool LoadOBJWithTinyObj(const std::string& filepath, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, bool& hasNormalsOut) {
     tinyobj::ObjReaderConfig reader_config;
     reader_config.mtl_search_path = "";
     reader_config.triangulate = true;
@@ -46,9 +402,6 @@ bool Mesh::LoadFromOBJ(const std::string& filepath) {
     std::vector<Math::float3> positionNormals(attrib.vertices.size() / 3, { 0, 0, 0 });
     std::vector<int> positionFaceCount(attrib.vertices.size() / 3, 0);
 
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-
     //  :       
     for (size_t s = 0; s < shapes.size(); s++) {
         size_t index_offset = 0;
@@ -157,15 +510,77 @@ bool Mesh::LoadFromOBJ(const std::string& filepath) {
         }
     }
 
-    //  
-    Create(vertices, indices);
-
-    std::cout << "[Mesh] Loaded: " << filepath
+    std::cout << "[Mesh] Loaded (TinyObj): " << filepath
         << "\n  Vertices: " << vertices.size()
         << "\n  Indices: " << indices.size()
         << "\n  Normals: " << (hasNormals ? "from file" : "computed from " + std::to_string(positionNormals.size()) + " unique positions")
         << std::endl;
 
+    hasNormalsOut = hasNormals;
+    return true;
+}
+
+bool Mesh::LoadFromOBJ(const std::string& filepath, bool useCache) {
+    const std::string cachePath = MeshCache::GetCachePath(filepath);
+
+    if (useCache) {
+        MeshCache::CacheStats cacheStats;
+        if (MeshCache::Load(cachePath, filepath, *this, &cacheStats)) {
+            std::cout << "[Mesh] Loaded (cache): " << cachePath
+                << "\n  Vertices: " << m_vertexCount
+                << "\n  Indices: " << m_indexCount
+                << "\n  Normals: " << (cacheStats.NormalsFromFile ? "from file" : "computed")
+                << "\n  Map + upload: " << cacheStats.Milliseconds << " ms (" << cacheStats.Bytes << " bytes)"
+                << std::endl;
+            return true;
+        }
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    bool normalsFromFile = false;
+    std::vector<SubMesh> subMeshes;
+    std::vector<std::string> materialNames;
+
+    ObjParser::ParsedMesh parsed;
+    ObjParser::ParseStats stats;
+
+    if (ObjParser::ParseFile(filepath, parsed, &stats)) {
+        std::cout << "[Mesh] Loaded: " << filepath
+            << "\n  Vertices: " << parsed.Vertices.size()
+            << "\n  Indices: " << parsed.Indices.size()
+            << "\n  Normals: " << (parsed.HasNormals ? "from file" : "computed from " + std::to_string(parsed.PositionCount) + " unique positions")
+            << "\n  Parse: " << stats.Milliseconds << " ms, " << stats.MegabytesPerSecond() << " MB/s ("
+            << stats.Threads << " threads, " << stats.Bytes << " bytes)"
+            << "\n  Sub-meshes: " << std::max<size_t>(parsed.SubMeshes.size(), 1)
+            << std::endl;
+
+        vertices.swap(parsed.Vertices);
+        indices.swap(parsed.Indices);
+        normalsFromFile = parsed.HasNormals;
+        subMeshes.swap(parsed.SubMeshes);
+        materialNames.swap(parsed.MaterialNames);
+    }
+    else {
+        std::cerr << "[Mesh] Fast OBJ parser failed, falling back to TinyObj: " << filepath << std::endl;
+        if (!LoadOBJWithTinyObj(filepath, vertices, indices, normalsFromFile)) return false;
+    }
+
+    //  
+    Create(vertices, indices);
+    if (!subMeshes.empty()) SetSubMeshes(subMeshes, materialNames);
+
+    std::vector<MeshCache::SubMeshRecord> records;
+    for (const SubMesh& subMesh : m_subMeshes) {
+        records.push_back({ (uint32_t)subMesh.StartIndex, (uint32_t)subMesh.IndexCount, subMesh.BaseVertex, (uint32_t)subMesh.MaterialId });
+    }
+
+    //     -       
+    if (useCache && !MeshCache::Write(cachePath, filepath, vertices, indices, m_boundsMin, m_boundsMax, normalsFromFile,
+                                      records, m_materialNames)) {
+        std::cerr << "[Mesh] Failed to write mesh cache: " << cachePath << std::endl;
+    }
+
     return true;
 }
 
@@ -23,12 +23,35 @@ void ShaderPass::AddTexture(const std::string& name, const TextureCube& texture)
     }
 }
 
+void ShaderPass::AddTexture(const std::string& name, const DepthTexture& texture) {
+    auto it = m_depthTextures.find(name);
+    if (it == m_depthTextures.end() || it->second != &texture) {
+        m_depthTextures[name] = &texture;
+    }
+}
+
 void ShaderPass::AddSampler(const std::string& name, const Sampler& sampler) {
     m_samplers[name] = &sampler;
 }
 
+void ShaderPass::AddBuffer(const std::string& name, const ComputeBuffer& buffer) {
+    m_buffers[name] = &buffer;
+}
+
+void ShaderPass::AddBuffer(const std::string& name, const StructuredBuffer& buffer) {
+    m_structuredBuffers[name] = &buffer;
+}
+
+void ShaderPass::AddStorageTexture(const std::string& name, const Texture& texture) {
+    m_storageTextures[name] = &texture;
+}
+
+void ShaderPass::AddStorageBuffer(const std::string& name, const ComputeBuffer& buffer) {
+    m_storageBuffers[name] = &buffer;
+}
+
 void Sampler::Create(const std::string& filterName) {
-    if (Rendeructor::GetCurrent() && Rendeructor::GetCurrent()->GetBackendAPI()) {
-        m_backendHandle = Rendeructor::GetCurrent()->GetBackendAPI()->CreateSamplerResource(filterName);
+    if (BackendInterface* backend = Rendeructor::AttachBackend(m_renderer)) {
+        m_backendHandle = backend->CreateSamplerResource(filterName);
     }
 }
\ No newline at end of file
@@ -9,8 +9,18 @@ void Texture::Create(int width, int height, TextureFormat format, const void* da
     m_width = width;
     m_height = height;
     m_format = format;
-    if (Rendeructor::GetCurrent() && Rendeructor::GetCurrent()->GetBackendAPI()) {
-        m_backendHandle = Rendeructor::GetCurrent()->GetBackendAPI()->CreateTextureResource(width, height, (int)format, data);
+    if (BackendInterface* backend = Rendeructor::AttachBackend(m_renderer)) {
+        m_backendHandle = backend->CreateTextureResource(width, height, (int)format, data);
+    }
+}
+
+void Texture::CreateStorage(int width, int height, TextureFormat format, const void* data) {
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    m_storage = true;
+    if (BackendInterface* backend = Rendeructor::AttachBackend(m_renderer)) {
+        m_backendHandle = backend->CreateStorageTextureResource(width, height, (int)format, data);
     }
 }
 
@@ -26,8 +36,8 @@ bool Texture::LoadFromDisk(const std::string& path) {
     m_height = h;
     m_format = TextureFormat::RGBA8;
 
-    if (Rendeructor::GetCurrent() && Rendeructor::GetCurrent()->GetBackendAPI()) {
-        m_backendHandle = Rendeructor::GetCurrent()->GetBackendAPI()->CreateTextureResource(w, h, (int)m_format, data);
+    if (BackendInterface* backend = Rendeructor::AttachBackend(m_renderer)) {
+        m_backendHandle = backend->CreateTextureResource(w, h, (int)m_format, data);
     }
 
     stbi_image_free(data);
@@ -35,14 +45,107 @@ bool Texture::LoadFromDisk(const std::string& path) {
 }
 
 void Texture::Copy(const Texture& source) {
-    if (Rendeructor::GetCurrent() && Rendeructor::GetCurrent()->GetBackendAPI()) {
-        Rendeructor::GetCurrent()->GetBackendAPI()->CopyTexture(m_backendHandle, source.GetHandle());
+    if (!m_backendHandle || !source.GetHandle() || !m_renderer) return;
+    Rendeructor* renderer = m_renderer;
+    void* destination = m_backendHandle;
+    void* sourceHandle = source.GetHandle();
+    renderer->RunOnRenderThread([renderer, destination, sourceHandle] {
+        if (renderer->GetBackendAPI()) renderer->GetBackendAPI()->CopyTexture(destination, sourceHandle);
+    });
+}
+
+bool Texture::ReadPixels(void* data) const {
+    if (!m_backendHandle || !m_renderer || !m_renderer->GetBackendAPI()) return false;
+    //    immediate context -    
+    if (!m_renderer->IsRenderThread()) return false;
+    m_renderer->CountMapCall();
+    return m_renderer->GetBackendAPI()->ReadTexture(m_backendHandle, data, (size_t)m_width * GetBytesPerPixel());
+}
+
+Texture Texture::AcquireTransient(int width, int height, TextureFormat format, bool storage) {
+    if (!Rendeructor::GetCurrent()) return Texture();
+    return AcquireTransient(*Rendeructor::GetCurrent(), width, height, format, storage);
+}
+
+Texture Texture::AcquireTransient(Rendeructor& renderer, int width, int height, TextureFormat format, bool storage) {
+    Texture texture(renderer);
+    //   :     
+    if (renderer.IsRenderThread()) {
+        RenderTargetDesc desc;
+        desc.Width = width;
+        desc.Height = height;
+        desc.Format = format;
+        desc.Flags = storage ? RenderTargetFlagStorage : 0;
+        texture.m_backendHandle = renderer.GetTransientPool().Acquire(desc);
+    }
+    if (texture.m_backendHandle) {
+        texture.m_width = width;
+        texture.m_height = height;
+        texture.m_format = format;
+        texture.m_transient = true;
+        texture.m_storage = storage;
+    }
+    return texture;
+}
+
+void Texture::Release() {
+    if (m_backendHandle && m_renderer) {
+        //     - ,   
+        if (m_transient) {
+            Rendeructor* renderer = m_renderer;
+            void* handle = m_backendHandle;
+            renderer->RunOnRenderThread([renderer, handle] { renderer->GetTransientPool().Release(handle); });
+        }
+        else {
+            m_renderer->ReleaseTexture(m_backendHandle);
+        }
+    }
+    m_backendHandle = nullptr;
+    m_width = 0;
+    m_height = 0;
+    m_transient = false;
+    m_storage = false;
+}
+
+void DepthTexture::Create(int width, int height, DepthFormat format, bool shaderReadable) {
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    if (BackendInterface* backend = Rendeructor::AttachBackend(m_renderer)) {
+        m_backendHandle = backend->CreateDepthTextureResource(width, height, (int)format, shaderReadable);
+    }
+}
+
+void DepthTexture::Release() {
+    if (m_backendHandle && m_renderer) m_renderer->ReleaseTexture(m_backendHandle);
+    m_backendHandle = nullptr;
+    m_width = 0;
+    m_height = 0;
+}
+
+bool Texture::ReadbackAsync(TextureReadbackCallback callback) const {
+    if (!m_backendHandle || !m_renderer || !m_renderer->IsRenderThread()) return false;
+    return m_renderer->RequestReadback(*this, std::move(callback));
+}
+
+int Texture::GetBytesPerPixel() const {
+    return GetBytesPerPixel(m_format);
+}
+
+int Texture::GetBytesPerPixel(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::R8: return 1;
+    case TextureFormat::R16F: return 2;
+    case TextureFormat::R32F: return 4;
+    case TextureFormat::RGBA16F: return 8;
+    case TextureFormat::RGBA32F: return 16;
+    default: return 4;
     }
 }
 
 void Texture3D::Create(int width, int height, int depth, const void* data) {
-    if (Rendeructor::GetCurrent() && Rendeructor::GetCurrent()->GetBackendAPI()) {
-        m_backendHandle = Rendeructor::GetCurrent()->GetBackendAPI()->CreateTexture3DResource(width, height, depth, 0, data);
+    if (BackendInterface* backend = Rendeructor::AttachBackend(m_renderer)) {
+        m_backendHandle = backend->CreateTexture3DResource(width, height, depth, 0, data);
     }
 }
 
@@ -82,9 +185,10 @@ bool TextureCube::LoadFromFiles(const std::vector<std::string>& paths) {
         pixelData[i] = data;
     }
 
-    if (success && Rendeructor::GetCurrent() && Rendeructor::GetCurrent()->GetBackendAPI()) {
+    BackendInterface* backend = success ? Rendeructor::AttachBackend(m_renderer) : nullptr;
+    if (backend) {
         //   
-        m_backendHandle = Rendeructor::GetCurrent()->GetBackendAPI()->CreateTextureCubeResource(width, height, (int)TextureFormat::RGBA8, pixelData.data());
+        m_backendHandle = backend->CreateTextureCubeResource(width, height, (int)TextureFormat::RGBA8, pixelData.data());
     }
 
     //   STB
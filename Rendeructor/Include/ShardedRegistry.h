@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+// Set of live objects that several threads add to and remove from at once (the backend's texture and sampler lists).
+// Objects are spread over independent shards by address, each with its own lock, so loader threads creating resources
+// in parallel rarely wait on each other, and removal is a hash lookup instead of a search through one shared vector.
+template <typename T, int ShardCount = 16>
+class ShardedRegistry {
+public:
+    static_assert(ShardCount > 0 && (ShardCount & (ShardCount - 1)) == 0, "ShardCount must be a power of two");
+
+    void Insert(T* object) {
+        Shard& shard = GetShard(object);
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        shard.Objects.insert(object);
+    }
+
+    // false for objects that are not registered
+    bool Erase(T* object) {
+        Shard& shard = GetShard(object);
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        return shard.Objects.erase(object) > 0;
+    }
+
+    bool Contains(T* object) const {
+        const Shard& shard = GetShard(object);
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        return shard.Objects.count(object) > 0;
+    }
+
+    size_t Size() const {
+        size_t size = 0;
+        for (const Shard& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            size += shard.Objects.size();
+        }
+        return size;
+    }
+
+    // Empties the registry and returns what it held, e.g. to delete everything on shutdown
+    std::vector<T*> TakeAll() {
+        std::vector<T*> objects;
+        for (Shard& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            objects.insert(objects.end(), shard.Objects.begin(), shard.Objects.end());
+            shard.Objects.clear();
+        }
+        return objects;
+    }
+
+private:
+    // A cache line per shard, so threads working on different shards do not share one
+    struct alignas(64) Shard {
+        mutable std::mutex Mutex;
+        std::unordered_set<T*> Objects;
+    };
+
+    static size_t GetShardIndex(const T* object) {
+        // Heap addresses are aligned: the low bits carry no information
+        const uintptr_t address = (uintptr_t)object;
+        return (size_t)((address >> 4) ^ (address >> 12)) & (ShardCount - 1);
+    }
+    Shard& GetShard(const T* object) { return m_shards[GetShardIndex(object)]; }
+    const Shard& GetShard(const T* object) const { return m_shards[GetShardIndex(object)]; }
+
+    std::array<Shard, ShardCount> m_shards;
+};
@@ -0,0 +1,228 @@
+﻿#include "pch.h"
+#include "TileBudget.h"
+#include <algorithm>
+#include <cmath>
+
+TileBudgetController::TileBudgetController(const TileBudgetSettings& settings, int initialTileSize) {
+    Reset(settings, initialTileSize);
+}
+
+void TileBudgetController::Reset(const TileBudgetSettings& settings, int initialTileSize) {
+    SetSettings(settings);
+    m_tileSize = std::clamp(initialTileSize, m_settings.MinTileSize, m_settings.MaxTileSize);
+    m_tilesPerFrame = m_settings.MinTilesPerFrame;
+    m_sumW = m_sumX = m_sumY = m_sumXX = m_sumXY = 0.0;
+    m_overhead = 0.0;
+    m_perPixel = 0.0;
+    m_regression = false;
+    m_lastMilliseconds = 0.0;
+    m_measurements = 0;
+}
+
+void TileBudgetController::SetSettings(const TileBudgetSettings& settings) {
+    m_settings = settings;
+    m_settings.MinTileSize = std::max(m_settings.MinTileSize, 1);
+    m_settings.MaxTileSize = std::max(m_settings.MaxTileSize, m_settings.MinTileSize);
+    m_settings.MinTilesPerFrame = std::max(m_settings.MinTilesPerFrame, 1);
+    m_settings.MaxTilesPerFrame = std::max(m_settings.MaxTilesPerFrame, m_settings.MinTilesPerFrame);
+    m_settings.History = std::clamp(m_settings.History, 0.0, 0.999);
+    m_tileSize = std::clamp(m_tileSize, m_settings.MinTileSize, m_settings.MaxTileSize);
+    m_tilesPerFrame = std::clamp(m_tilesPerFrame, m_settings.MinTilesPerFrame, m_settings.MaxTilesPerFrame);
+    if (m_measurements > 0) Update();
+}
+
+void TileBudgetController::SetTileSize(int tileSize) {
+    tileSize = std::clamp(tileSize, m_settings.MinTileSize, m_settings.MaxTileSize);
+    if (tileSize == m_tileSize) return;
+    // Пересчитываем число тайлов при том же объеме работы за кадр
+    const double pixels = (double)m_tilesPerFrame * m_tileSize * m_tileSize;
+    m_tileSize = tileSize;
+    m_tilesPerFrame = std::clamp((int)(pixels / ((double)tileSize * tileSize)), m_settings.MinTilesPerFrame, m_settings.MaxTilesPerFrame);
+    if (m_measurements > 0) Update();
+}
+
+void TileBudgetController::AddMeasurement(int tiles, int tileSize, double milliseconds) {
+    if (tiles <= 0 || tileSize <= 0 || !(milliseconds >= 0.0)) return;
+
+    const double x = (double)tiles * tileSize * tileSize;
+    const double y = milliseconds;
+
+    // Старые замеры затухают, чтобы модель следила за сменой нагрузки (другой вид, больше проходов на пиксель).
+    // Сильный промах прогноза означает, что нагрузка сменилась скачком - история тогда сбрасывается целиком,
+    // оценка накладных расходов остается. Прогноз без регрессии - лишь догадка, его промах ничего не говорит
+    double h = m_settings.History;
+    if (m_measurements > 0 && m_regression) {
+        const double predicted = PredictMilliseconds(tiles, tileSize);
+        if (std::abs(y - predicted) > 0.5 * predicted + 0.5) h = 0.0;
+    }
+    m_sumW = m_sumW * h + 1.0;
+    m_sumX = m_sumX * h + x;
+    m_sumY = m_sumY * h + y;
+    m_sumXX = m_sumXX * h + x * x;
+    m_sumXY = m_sumXY * h + x * y;
+    m_lastMilliseconds = y;
+    m_measurements++;
+
+    Fit();
+    Update();
+}
+
+void TileBudgetController::Fit() {
+    const double meanX = m_sumX / m_sumW;
+    const double meanY = m_sumY / m_sumW;
+    const double varX = m_sumXX / m_sumW - meanX * meanX;
+
+    // Регрессия возможна только если замеры покрывают разные объемы работы,
+    // иначе накладные расходы не отделить от стоимости пикселей - оставляем прежнюю оценку накладных
+    m_regression = m_measurements >= 2 && varX > 1e-2 * meanX * meanX;
+    if (m_regression) {
+        const double covXY = m_sumXY / m_sumW - meanX * meanY;
+        m_perPixel = covXY / varX;
+        m_overhead = meanY - m_perPixel * meanX;
+    }
+    else {
+        m_overhead = std::min(m_overhead, meanY);
+        m_perPixel = meanX > 0.0 ? (meanY - m_overhead) / meanX : 0.0;
+    }
+
+    // Шум замеров может дать отрицательные коэффициенты - сводим к физически осмысленной модели
+    if (m_overhead < 0.0) {
+        m_overhead = 0.0;
+        m_perPixel = m_sumXX > 0.0 ? m_sumXY / m_sumXX : 0.0;
+    }
+    if (m_perPixel < 0.0) {
+        m_perPixel = 0.0;
+        m_overhead = meanY;
+    }
+}
+
+double TileBudgetController::BudgetTiles(int tileSize) const {
+    const double pixels = (double)tileSize * tileSize;
+    const double available = m_settings.TargetMilliseconds - m_overhead;
+    if (m_perPixel <= 0.0) return available > 0.0 ? (double)m_settings.MaxTilesPerFrame * 4.0 : 0.0;
+    return std::max(available, 0.0) / (m_perPixel * pixels);
+}
+
+void TileBudgetController::Update() {
+    const double previousPixels = (double)m_tilesPerFrame * m_tileSize * m_tileSize;
+
+    if (m_settings.AdaptTileSize) {
+        // Даже один тайл не влезает в бюджет - дробим сразу, перебор времени кадра заметнее недобора
+        while (m_tileSize > m_settings.MinTileSize && BudgetTiles(m_tileSize) < m_settings.MinTilesPerFrame) {
+            m_tileSize = std::max(m_tileSize / 2, m_settings.MinTileSize);
+        }
+        // Слишком много мелких вызовов - укрупняем по одному шагу за кадр
+        if (m_tileSize * 2 <= m_settings.MaxTileSize && BudgetTiles(m_tileSize) > m_settings.MaxTilesPerFrame) {
+            m_tileSize *= 2;
+        }
+    }
+
+    const double pixels = (double)m_tileSize * m_tileSize;
+    int tiles = (int)std::floor(BudgetTiles(m_tileSize));
+    // Без регрессии вся стоимость считается попиксельной, и при больших накладных модель навсегда застревает
+    // на минимуме (8 мс накладных при бюджете 12 - "влезает" один тайл). Пока запас по бюджету заметный,
+    // берем пакет в полтора раза больше: следующий замер на другом объеме работы дает регрессии вторую точку
+    if (!m_regression && m_lastMilliseconds <= 0.75 * m_settings.TargetMilliseconds) {
+        tiles = std::max(tiles, (int)std::ceil(previousPixels * 1.5 / pixels));
+    }
+    // Рост не больше чем вдвое по объему работы: модель, построенная на малых пакетах, может ошибаться на больших
+    tiles = std::min(tiles, std::max(1, (int)std::floor(previousPixels * 2.0 / pixels)));
+    m_tilesPerFrame = std::clamp(tiles, m_settings.MinTilesPerFrame, m_settings.MaxTilesPerFrame);
+}
+
+int TileBudgetController::RecommendTileSize() const {
+    if (m_measurements == 0) return m_tileSize;
+    int size = m_settings.MaxTileSize;
+    while (size > m_settings.MinTileSize && BudgetTiles(size) < m_settings.MinTilesPerFrame) {
+        size = std::max(size / 2, m_settings.MinTileSize);
+    }
+    return size;
+}
+
+double TileBudgetController::PredictMilliseconds(int tiles, int tileSize) const {
+    return m_overhead + m_perPixel * (double)tiles * tileSize * tileSize;
+}
+
+bool TileBatchTimer::Create(int latency) {
+    Release();
+    m_slotCount = std::clamp(latency, 1, kMaxLatency);
+
+    m_useGPU = true;
+    for (int i = 0; i < m_slotCount; ++i) {
+        if (!m_slots[i].Timer.Create()) {
+            m_useGPU = false;
+            break;
+        }
+    }
+    if (!m_useGPU) {
+        for (int i = 0; i < m_slotCount; ++i) m_slots[i].Timer.Release();
+    }
+    return m_useGPU;
+}
+
+void TileBatchTimer::Release() {
+    for (int i = 0; i < kMaxLatency; ++i) {
+        m_slots[i].Timer.Release();
+        m_slots[i].Tiles = 0;
+        m_slots[i].TileSize = 0;
+    }
+    m_slotCount = 0;
+    m_current = -1;
+    m_useGPU = false;
+    m_hasFrameStart = false;
+    m_frameTiles = 0;
+    m_frameTileSize = 0;
+}
+
+void TileBatchTimer::BeginBatch() {
+    m_current = -1;
+    if (!m_useGPU) return;
+
+    // Все слоты ждут результатов - пакет просто не замеряется, ждать GPU ради статистики нельзя
+    for (int i = 0; i < m_slotCount; ++i) {
+        if (!m_slots[i].Timer.IsPending()) {
+            m_current = i;
+            break;
+        }
+    }
+    if (m_current >= 0) m_slots[m_current].Timer.Begin();
+}
+
+void TileBatchTimer::EndBatch(int tiles, int tileSize) {
+    if (!m_useGPU) {
+        m_frameTiles += tiles;
+        m_frameTileSize = tileSize;
+        return;
+    }
+    if (m_current < 0) return;
+
+    Slot& slot = m_slots[m_current];
+    slot.Timer.End();
+    slot.Tiles = tiles;
+    slot.TileSize = tileSize;
+    m_current = -1;
+}
+
+void TileBatchTimer::Collect(TileBudgetController& controller) {
+    if (m_useGPU) {
+        for (int i = 0; i < m_slotCount; ++i) {
+            Slot& slot = m_slots[i];
+            if (!slot.Timer.IsPending()) continue;
+            double ms = 0.0;
+            if (slot.Timer.GetResult(ms)) {
+                controller.AddMeasurement(slot.Tiles, slot.TileSize, ms);
+                m_lastMilliseconds = ms;
+            }
+        }
+        return;
+    }
+
+    auto now = std::chrono::high_resolution_clock::now();
+    if (m_hasFrameStart && m_frameTiles > 0) {
+        m_lastMilliseconds = std::chrono::duration<double, std::milli>(now - m_frameStart).count();
+        controller.AddMeasurement(m_frameTiles, m_frameTileSize, m_lastMilliseconds);
+    }
+    m_frameStart = now;
+    m_hasFrameStart = true;
+    m_frameTiles = 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "RendeructorDefines.h"
+#include <chrono>
+
+struct RENDER_API TileBudgetSettings {
+    double TargetMilliseconds = 12.0; // time the tile batch (or the whole frame with CPU timing) may take
+    int MinTileSize = 16;
+    int MaxTileSize = 256;
+    int MinTilesPerFrame = 1;
+    int MaxTilesPerFrame = 64;        // more draws than this: prefer bigger tiles
+    bool AdaptTileSize = true;
+    double History = 0.9;             // weight of older measurements in the cost fit (0..1)
+};
+
+// Decides how many tiles of which size to render per frame so that a frame stays within a time budget.
+// The cost of a batch is modelled as Overhead + PerPixel * (tiles * tileSize^2) and fitted by exponentially weighted
+// least squares over the measured batches. Until the batches differ enough in size to separate the two terms, the
+// controller steps the batch up while it is well under budget. Pure CPU logic: it can be driven by any timer or a
+// simulated cost model.
+class RENDER_API TileBudgetController {
+public:
+    TileBudgetController(const TileBudgetSettings& settings = TileBudgetSettings(), int initialTileSize = 64);
+
+    void Reset(const TileBudgetSettings& settings, int initialTileSize);
+    void SetSettings(const TileBudgetSettings& settings);
+    const TileBudgetSettings& GetSettings() const { return m_settings; }
+
+    // Measured cost of one batch
+    void AddMeasurement(int tiles, int tileSize, double milliseconds);
+
+    int GetTilesPerFrame() const { return m_tilesPerFrame; }
+    int GetTileSize() const { return m_tileSize; }
+    // For callers that fix the tile size themselves (AdaptTileSize = false); keeps the learned cost model
+    void SetTileSize(int tileSize);
+    // Largest tile that still fits the budget at least MinTilesPerFrame times (ignores AdaptTileSize)
+    int RecommendTileSize() const;
+
+    double PredictMilliseconds(int tiles, int tileSize) const;
+    double GetOverheadMilliseconds() const { return m_overhead; }
+    double GetMillisecondsPerMegapixel() const { return m_perPixel * 1e6; }
+    int GetMeasurementCount() const { return m_measurements; }
+
+private:
+    void Fit();
+    void Update();
+    // Tiles of the given size the budget has room for, before clamping
+    double BudgetTiles(int tileSize) const;
+
+    TileBudgetSettings m_settings;
+    int m_tileSize = 64;
+    int m_tilesPerFrame = 1;
+
+    // Weighted sums for the linear fit ms = overhead + perPixel * pixels
+    double m_sumW = 0.0, m_sumX = 0.0, m_sumY = 0.0, m_sumXX = 0.0, m_sumXY = 0.0;
+    double m_overhead = 0.0;
+    double m_perPixel = 0.0;
+    bool m_regression = false; // the last fit separated overhead and per-pixel cost
+    double m_lastMilliseconds = 0.0;
+    int m_measurements = 0;
+};
+
+// Times tile batches for a TileBudgetController: GPU timestamps when the backend has them, otherwise the CPU time
+// of the whole frame (Present waits for the GPU, so frame time follows GPU load and fixed costs land in the overhead)
+class RENDER_API TileBatchTimer {
+public:
+    static constexpr int kMaxLatency = 8;
+
+    // Returns true when GPU timing is available
+    bool Create(int latency = 4);
+    void Release();
+
+    void BeginBatch();
+    void EndBatch(int tiles, int tileSize);
+    // Feeds finished measurements to the controller. Call once per frame
+    void Collect(TileBudgetController& controller);
+
+    bool UsesGPU() const { return m_useGPU; }
+    double GetLastMilliseconds() const { return m_lastMilliseconds; }
+
+private:
+    struct Slot {
+        GPUTimer Timer;
+        int Tiles = 0;
+        int TileSize = 0;
+    };
+    Slot m_slots[kMaxLatency];
+    int m_slotCount = 0;
+    int m_current = -1;
+    bool m_useGPU = false;
+
+    // CPU fallback: tiles issued since the last Collect()
+    std::chrono::high_resolution_clock::time_point m_frameStart;
+    bool m_hasFrameStart = false;
+    int m_frameTiles = 0;
+    int m_frameTileSize = 0;
+    double m_lastMilliseconds = 0.0;
+};
@@ -0,0 +1,925 @@
+﻿// CPU референсный path tracer для SDF сцены из ShaderPathTracer.
+// Построчный порт PathTracer.hlsl (тот же WangHash RNG, SDF примитивы, GGX/Lambert материал),
+// чтобы получать эталонные картинки без GPU и сравнивать с ними результат шейдера.
+//
+// Не зависит ни от Rendeructor, ни от MathAPI - собирается где угодно:
+//   Linux:   g++ -O2 -std=c++20 -pthread CPUPathTracer.cpp -o CPUPathTracer
+//   Windows: проект CPUPathTracer.vcxproj (консольное приложение)
+//
+// Использование:
+//   CPUPathTracer [-w 1280] [-h 720] [-spp 64] [-threads N] [-tile 16] [-o golden.pfm] [-preview golden.ppm] [-exposure 1]
+//   CPUPathTracer -error 0.02 [-uniform | -adaptive | -benchmark] [-maxspp 16000] [-reference ref.pfm]
+//
+// Результат - линейный HDR в PFM (эталон для сравнения) и опционально тонмапленный PPM для просмотра.
+// С -error тайлы сэмплируются до достижения порога ошибки (AdaptiveSampler.h); -benchmark сравнивает время
+// до этого качества при равномерном и адаптивном распределении проходов.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <string>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+// CPUPT_NO_SIMD - принудительно скалярные пакеты (для сравнения скорости)
+#if !defined(CPUPT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CPUPT_SSE 1
+#endif
+
+#include "../ShaderPathTracer/DemoScene.h"
+#include "../ShaderPathTracer/AdaptiveSampler.h"
+
+// =========================================================
+// CONSTANTS (как в PathTracer.hlsl)
+// =========================================================
+static const int MAX_MARCH_STEPS = 256;
+static const float MAX_DIST = 512.0f;
+static const float SURF_DIST = 0.001f;
+static const float PI = 3.14159265359f;
+static const int MAX_BOUNCES = 16;
+static const int SAMPLES = 16;          // сэмплов за один проход шейдера
+static const float MAX_RADIANCE = 10.0f;
+
+// =========================================================
+// VECTOR MATH
+// =========================================================
+struct Vec3 {
+    float x = 0, y = 0, z = 0;
+    Vec3() = default;
+    Vec3(float v) : x(v), y(v), z(v) {}
+    Vec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+    Vec3 operator+(const Vec3& o) const { return Vec3(x + o.x, y + o.y, z + o.z); }
+    Vec3 operator-(const Vec3& o) const { return Vec3(x - o.x, y - o.y, z - o.z); }
+    Vec3 operator*(const Vec3& o) const { return Vec3(x * o.x, y * o.y, z * o.z); }
+    Vec3 operator/(const Vec3& o) const { return Vec3(x / o.x, y / o.y, z / o.z); }
+    Vec3 operator*(float s) const { return Vec3(x * s, y * s, z * s); }
+    Vec3 operator/(float s) const { return Vec3(x / s, y / s, z / s); }
+    Vec3 operator-() const { return Vec3(-x, -y, -z); }
+    Vec3& operator+=(const Vec3& o) { x += o.x; y += o.y; z += o.z; return *this; }
+    Vec3& operator*=(const Vec3& o) { x *= o.x; y *= o.y; z *= o.z; return *this; }
+    Vec3& operator/=(float s) { x /= s; y /= s; z /= s; return *this; }
+};
+
+static inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline Vec3 Cross(const Vec3& a, const Vec3& b) {
+    return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+static inline Vec3 Normalize(const Vec3& v) { return v / std::sqrt(Dot(v, v)); }
+static inline float Saturate(float v) { return std::min(std::max(v, 0.0f), 1.0f); }
+static inline float MaxComponent(const Vec3& v) { return std::max(v.x, std::max(v.y, v.z)); }
+static inline Vec3 Reflect(const Vec3& i, const Vec3& n) { return i - n * (2.0f * Dot(n, i)); }
+
+// =========================================================
+// 4-WIDE SIMD (пакет из 4 лучей)
+// =========================================================
+#ifdef CPUPT_SSE
+struct F4 {
+    __m128 v;
+    F4() = default;
+    F4(__m128 x) : v(x) {}
+    F4(float s) : v(_mm_set1_ps(s)) {}
+
+    static F4 Load(const float* p) { return _mm_loadu_ps(p); }
+    void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+    friend F4 operator+(F4 a, F4 b) { return _mm_add_ps(a.v, b.v); }
+    friend F4 operator-(F4 a, F4 b) { return _mm_sub_ps(a.v, b.v); }
+    friend F4 operator*(F4 a, F4 b) { return _mm_mul_ps(a.v, b.v); }
+    friend F4 operator<(F4 a, F4 b) { return _mm_cmplt_ps(a.v, b.v); }
+    friend F4 operator>(F4 a, F4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+    friend F4 operator&(F4 a, F4 b) { return _mm_and_ps(a.v, b.v); }
+    friend F4 operator|(F4 a, F4 b) { return _mm_or_ps(a.v, b.v); }
+    friend F4 AndNot(F4 mask, F4 b) { return _mm_andnot_ps(mask.v, b.v); } // ~mask & b
+    friend F4 Min(F4 a, F4 b) { return _mm_min_ps(a.v, b.v); }
+    friend F4 Max(F4 a, F4 b) { return _mm_max_ps(a.v, b.v); }
+    friend F4 Sqrt(F4 a) { return _mm_sqrt_ps(a.v); }
+    friend F4 Abs(F4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+    // mask ? a : b
+    friend F4 Select(F4 mask, F4 a, F4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+    friend int MoveMask(F4 mask) { return _mm_movemask_ps(mask.v); }
+
+    static F4 MaskFromBits(int bits) {
+        return _mm_castsi128_ps(_mm_set_epi32(bits & 8 ? -1 : 0, bits & 4 ? -1 : 0, bits & 2 ? -1 : 0, bits & 1 ? -1 : 0));
+    }
+};
+#else
+// Скалярный запасной вариант: те же операции по 4 элементам (компилятор обычно векторизует сам)
+struct F4 {
+    float v[4];
+    F4() = default;
+    F4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+
+    static F4 Load(const float* p) { F4 r; for (int i = 0; i < 4; ++i) r.v[i] = p[i]; return r; }
+    void Store(float* p) const { for (int i = 0; i < 4; ++i) p[i] = v[i]; }
+
+    template <typename Op> static F4 Apply(F4 a, F4 b, Op op) { F4 r; for (int i = 0; i < 4; ++i) r.v[i] = op(a.v[i], b.v[i]); return r; }
+    static float Bits(bool b) { uint32_t u = b ? 0xFFFFFFFFu : 0u; float f; std::memcpy(&f, &u, 4); return f; }
+    static uint32_t U(float f) { uint32_t u; std::memcpy(&u, &f, 4); return u; }
+    static float F(uint32_t u) { float f; std::memcpy(&f, &u, 4); return f; }
+
+    friend F4 operator+(F4 a, F4 b) { return Apply(a, b, [](float x, float y) { return x + y; }); }
+    friend F4 operator-(F4 a, F4 b) { return Apply(a, b, [](float x, float y) { return x - y; }); }
+    friend F4 operator*(F4 a, F4 b) { return Apply(a, b, [](float x, float y) { return x * y; }); }
+    friend F4 operator<(F4 a, F4 b) { return Apply(a, b, [](float x, float y) { return Bits(x < y); }); }
+    friend F4 operator>(F4 a, F4 b) { return Apply(a, b, [](float x, float y) { return Bits(x > y); }); }
+    friend F4 operator&(F4 a, F4 b) { return Apply(a, b, [](float x, float y) { return F(U(x) & U(y)); }); }
+    friend F4 operator|(F4 a, F4 b) { return Apply(a, b, [](float x, float y) { return F(U(x) | U(y)); }); }
+    friend F4 AndNot(F4 mask, F4 b) { return Apply(mask, b, [](float x, float y) { return F(~U(x) & U(y)); }); }
+    friend F4 Min(F4 a, F4 b) { return Apply(a, b, [](float x, float y) { return y < x ? y : x; }); }
+    friend F4 Max(F4 a, F4 b) { return Apply(a, b, [](float x, float y) { return y > x ? y : x; }); }
+    friend F4 Sqrt(F4 a) { F4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::sqrt(a.v[i]); return r; }
+    friend F4 Abs(F4 a) { F4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::fabs(a.v[i]); return r; }
+    friend F4 Select(F4 mask, F4 a, F4 b) { return (mask & a) | AndNot(mask, b); }
+    friend int MoveMask(F4 mask) { int m = 0; for (int i = 0; i < 4; ++i) m |= (U(mask.v[i]) >> 31) << i; return m; }
+
+    static F4 MaskFromBits(int bits) { F4 r; for (int i = 0; i < 4; ++i) r.v[i] = Bits((bits >> i) & 1); return r; }
+};
+#endif
+
+struct Vec3x4 {
+    F4 x, y, z;
+    Vec3x4() = default;
+    Vec3x4(F4 x_, F4 y_, F4 z_) : x(x_), y(y_), z(z_) {}
+    Vec3x4 operator+(const Vec3x4& o) const { return Vec3x4(x + o.x, y + o.y, z + o.z); }
+    Vec3x4 operator-(const Vec3x4& o) const { return Vec3x4(x - o.x, y - o.y, z - o.z); }
+    Vec3x4 operator*(F4 s) const { return Vec3x4(x * s, y * s, z * s); }
+
+    static Vec3x4 FromLanes(const Vec3* v) {
+        float a[4] = { v[0].x, v[1].x, v[2].x, v[3].x };
+        float b[4] = { v[0].y, v[1].y, v[2].y, v[3].y };
+        float c[4] = { v[0].z, v[1].z, v[2].z, v[3].z };
+        return Vec3x4(F4::Load(a), F4::Load(b), F4::Load(c));
+    }
+    void ToLanes(Vec3* v) const {
+        float a[4], b[4], c[4];
+        x.Store(a); y.Store(b); z.Store(c);
+        for (int l = 0; l < 4; ++l) v[l] = Vec3(a[l], b[l], c[l]);
+    }
+};
+
+// =========================================================
+// RNG (как в шейдере)
+// =========================================================
+static inline uint32_t WangHash(uint32_t& seed) {
+    seed = (seed ^ 61u) ^ (seed >> 16u); seed *= 9u;
+    seed = seed ^ (seed >> 4u); seed *= 0x27d4eb2du; seed = seed ^ (seed >> 15u);
+    return seed;
+}
+static inline float Rnd1(uint32_t& seed) { return (float)WangHash(seed) / 4294967295.0f; }
+
+static inline uint32_t GetSeed(int x, int y, float seedOffset) {
+    return ((uint32_t)x * 1973u + (uint32_t)y * 9277u + (uint32_t)(seedOffset * 1234.0f)) | 1u;
+}
+
+// =========================================================
+// SCENE
+// =========================================================
+struct SDFObject {
+    PrimitiveType Type = PrimitiveType::Sphere;
+    Vec3 Position;
+    Vec3 Size;
+    Vec3 Color;
+    float Roughness = 0.5f;
+    float Metalness = 0.0f;
+    float Emission = 0.0f;
+    // RotatePoint(p, -rot) из шейдера как матрица: local = Axis[0] * p.x + Axis[1] * p.y + Axis[2] * p.z
+    bool Rotated = false;
+    Vec3 Axis[3];
+};
+
+// Поворот точки как в RotatePoint() шейдера
+static Vec3 RotatePoint(Vec3 p, const Vec3& rot) {
+    float s, c;
+    if (std::fabs(rot.x) > 1e-4f) { s = std::sin(rot.x); c = std::cos(rot.x); p = Vec3(p.x, c * p.y + s * p.z, -s * p.y + c * p.z); }
+    if (std::fabs(rot.y) > 1e-4f) { s = std::sin(rot.y); c = std::cos(rot.y); p = Vec3(c * p.x - s * p.z, p.y, s * p.x + c * p.z); }
+    if (std::fabs(rot.z) > 1e-4f) { s = std::sin(rot.z); c = std::cos(rot.z); p = Vec3(c * p.x + s * p.y, -s * p.x + c * p.y, p.z); }
+    return p;
+}
+
+// Тот же интерфейс, что и GeometryPrimitive в ShaderPathTracer - DemoScene.h строит обе сцены одним кодом
+class Primitive {
+public:
+    explicit Primitive(PrimitiveType type) : m_type(type) {}
+    void SetPosition(float x, float y, float z) { m_position = Vec3(x, y, z); }
+    void SetRotation(float x, float y, float z) { m_rotationDeg = Vec3(x, y, z); }
+    void SetScale(float s) { m_scale = Vec3(s); }
+    void SetScale(float x, float y, float z) { m_scale = Vec3(x, y, z); }
+    void SetColor(float r, float g, float b) { m_color = Vec3(r, g, b); }
+    void SetRoughness(float r) { m_roughness = r; }
+    void SetMetalness(float m) { m_metalness = m; }
+    void SetEmission(float e) { m_emission = e; }
+
+    SDFObject Compile() const {
+        SDFObject o;
+        o.Type = m_type;
+        o.Position = m_position;
+        o.Size = m_scale;
+        o.Color = m_color;
+        o.Roughness = m_roughness;
+        o.Metalness = m_metalness;
+        o.Emission = m_emission;
+
+        Vec3 rot = m_rotationDeg * (3.14159f / 180.0f);
+        o.Rotated = Dot(rot, rot) > 1e-4f;
+        if (o.Rotated) {
+            o.Axis[0] = RotatePoint(Vec3(1, 0, 0), -rot);
+            o.Axis[1] = RotatePoint(Vec3(0, 1, 0), -rot);
+            o.Axis[2] = RotatePoint(Vec3(0, 0, 1), -rot);
+        }
+        return o;
+    }
+private:
+    PrimitiveType m_type;
+    Vec3 m_position = Vec3(0.0f);
+    Vec3 m_rotationDeg = Vec3(0.0f);
+    Vec3 m_scale = Vec3(1.0f);
+    Vec3 m_color = Vec3(1.0f);
+    float m_roughness = 0.5f;
+    float m_metalness = 0.0f;
+    float m_emission = 0.0f;
+};
+
+class Scene {
+public:
+    Primitive* CreatePrimitive(PrimitiveType type) {
+        m_primitives.push_back(std::make_unique<Primitive>(type));
+        return m_primitives.back().get();
+    }
+
+    std::vector<SDFObject> Compile() const {
+        std::vector<SDFObject> objects;
+        objects.reserve(m_primitives.size());
+        for (const auto& p : m_primitives) objects.push_back(p->Compile());
+        return objects;
+    }
+private:
+    std::vector<std::unique_ptr<Primitive>> m_primitives;
+};
+
+struct Camera {
+    Vec3 Position, Dir, Right, Up;
+
+    // Как CalculateCameraData() в ShaderPathTracer
+    static Camera LookAt(const Vec3& pos, const Vec3& target, int width, int height) {
+        Vec3 fwd = Normalize(target - pos);
+        Vec3 rgt = Normalize(Cross(Vec3(0, 1, 0), fwd));
+        Vec3 up = Normalize(Cross(fwd, rgt));
+        float ar = (float)width / height;
+        float thf = std::tan(3.14159f / 3.0f * 0.5f);
+
+        Camera c;
+        c.Position = pos;
+        c.Dir = fwd;
+        c.Right = rgt * (thf * ar);
+        c.Up = up * thf;
+        return c;
+    }
+};
+
+// =========================================================
+// TRACER
+// =========================================================
+class PathTracer {
+public:
+    PathTracer(std::vector<SDFObject> objects, const Camera& camera, int width, int height)
+        : m_objects(std::move(objects)), m_camera(camera), m_width(width), m_height(height) {}
+
+    // Рендер прямоугольника пикселей: passes проходов по SAMPLES сэмплов (как тайл в шейдере), начиная с прохода firstPass.
+    // accum - накопление всего изображения, на пиксель 4 float: сумма RGB проходов и сумма квадратов их яркости
+    void RenderTile(int x0, int y0, int x1, int y1, int firstPass, int passes, float* accum) const {
+        for (int y = y0; y < y1; ++y) {
+            // Пакет - 4 соседних пикселя строки, у каждого своя цепочка сэмплов
+            for (int x = x0; x < x1; x += 4) {
+                int lanes = std::min(4, x1 - x);
+                for (int pass = firstPass; pass < firstPass + passes; ++pass) {
+                    float seedOffset = 1.0f + 1.61803f * (pass + 1);
+                    Vec3 color[4];
+                    RenderPacket(x, y, lanes, seedOffset, color);
+                    for (int l = 0; l < lanes; ++l) {
+                        float* dst = accum + ((size_t)y * m_width + x + l) * 4;
+                        float luma = AdaptiveSampling::Luminance(color[l].x, color[l].y, color[l].z);
+                        dst[0] += color[l].x; dst[1] += color[l].y; dst[2] += color[l].z; dst[3] += luma * luma;
+                    }
+                }
+            }
+        }
+    }
+
+    // Средняя ошибка пикселей тайла после passes проходов (как TileError.hlsl)
+    float TileError(int x0, int y0, int x1, int y1, int passes, const float* accum) const {
+        if (passes < 2) return FLT_MAX;
+        float sum = 0.0f;
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                const float* a = accum + ((size_t)y * m_width + x) * 4;
+                sum += AdaptiveSampling::PixelError(AdaptiveSampling::Luminance(a[0], a[1], a[2]), a[3], (float)passes);
+            }
+        }
+        return sum / ((x1 - x0) * (y1 - y0));
+    }
+
+private:
+    std::vector<SDFObject> m_objects;
+    Camera m_camera;
+    int m_width, m_height;
+
+    struct Path {
+        Vec3 Ro, Rd;
+        Vec3 Col, Thr;
+        uint32_t Seed = 0;
+        bool Alive = false;
+    };
+
+    // Один проход шейдера (SAMPLES сэмплов) для пакета из lanes пикселей
+    void RenderPacket(int x, int y, int lanes, float seedOffset, Vec3* result) const {
+        uint32_t seeds[4];
+        for (int l = 0; l < lanes; ++l) seeds[l] = GetSeed(x + l, y, seedOffset);
+
+        for (int s = 0; s < SAMPLES; ++s) {
+            Path paths[4];
+            for (int l = 0; l < lanes; ++l) {
+                uint32_t& seed = seeds[l];
+                seed += s * 1123;
+                float jx = Rnd1(seed) - 0.5f;
+                float jy = Rnd1(seed) - 0.5f;
+                float u = ((x + l) + 0.5f) / m_width + jx / m_width;
+                float v = (y + 0.5f) / m_height + jy / m_height;
+                float ndcX = u * 2.0f - 1.0f;
+                float ndcY = -(v * 2.0f - 1.0f);
+
+                Path& p = paths[l];
+                p.Ro = m_camera.Position;
+                p.Rd = Normalize(m_camera.Dir + m_camera.Right * ndcX + m_camera.Up * ndcY);
+                p.Col = Vec3(0.0f);
+                p.Thr = Vec3(1.0f);
+                p.Seed = seed;
+                p.Alive = true;
+            }
+
+            TracePaths(paths, lanes);
+
+            for (int l = 0; l < lanes; ++l) {
+                seeds[l] = paths[l].Seed;
+                Vec3 c = paths[l].Col;
+                // Защита от NaN/Inf и firefly clamping, как в шейдере
+                if (!std::isfinite(c.x) || !std::isfinite(c.y) || !std::isfinite(c.z)) c = Vec3(0.0f);
+                c = Vec3(std::min(c.x, MAX_RADIANCE), std::min(c.y, MAX_RADIANCE), std::min(c.z, MAX_RADIANCE));
+                result[l] += c;
+            }
+        }
+        for (int l = 0; l < lanes; ++l) result[l] = result[l] / (float)SAMPLES;
+    }
+
+    // Map() для 4 точек сразу: перебор всех объектов, дистанция и индекс ближайшего
+    void Map(const Vec3x4& p, F4& outDist, F4& outIndex) const {
+        F4 minDist(MAX_DIST);
+        F4 hitIndex(-1.0f);
+
+        for (size_t i = 0; i < m_objects.size(); ++i) {
+            const SDFObject& o = m_objects[i];
+            F4 lx = p.x - F4(o.Position.x);
+            F4 ly = p.y - F4(o.Position.y);
+            F4 lz = p.z - F4(o.Position.z);
+            if (o.Rotated) {
+                F4 rx = lx * F4(o.Axis[0].x) + ly * F4(o.Axis[1].x) + lz * F4(o.Axis[2].x);
+                F4 ry = lx * F4(o.Axis[0].y) + ly * F4(o.Axis[1].y) + lz * F4(o.Axis[2].y);
+                F4 rz = lx * F4(o.Axis[0].z) + ly * F4(o.Axis[1].z) + lz * F4(o.Axis[2].z);
+                lx = rx; ly = ry; lz = rz;
+            }
+
+            F4 d;
+            switch (o.Type) {
+            case PrimitiveType::Sphere:
+                d = Sqrt(lx * lx + ly * ly + lz * lz) - F4(o.Size.x);
+                break;
+            case PrimitiveType::Box: {
+                F4 qx = Abs(lx) - F4(o.Size.x);
+                F4 qy = Abs(ly) - F4(o.Size.y);
+                F4 qz = Abs(lz) - F4(o.Size.z);
+                F4 ox = Max(qx, F4(0.0f)), oy = Max(qy, F4(0.0f)), oz = Max(qz, F4(0.0f));
+                d = Sqrt(ox * ox + oy * oy + oz * oz) + Min(Max(qx, Max(qy, qz)), F4(0.0f));
+                break;
+            }
+            case PrimitiveType::Plane:
+                d = ly;
+                break;
+            default:
+                d = F4(MAX_DIST);
+                break;
+            }
+
+            F4 closer = d < minDist;
+            minDist = Select(closer, d, minDist);
+            hitIndex = Select(closer, F4((float)i), hitIndex);
+        }
+        outDist = minDist;
+        outIndex = hitIndex;
+    }
+
+    F4 MapDist(const Vec3x4& p) const {
+        F4 d, id;
+        Map(p, d, id);
+        return d;
+    }
+
+    // CastRay() для пакета; неактивные лучи сразу считаются завершенными
+    F4 CastRay(const Vec3x4& ro, const Vec3x4& rd, int activeMask) const {
+        F4 t(0.0f);
+        F4 result(MAX_DIST);
+        F4 done = AndNot(F4::MaskFromBits(activeMask), F4::MaskFromBits(0xF));
+
+        for (int i = 0; i < MAX_MARCH_STEPS; i++) {
+            F4 h = MapDist(ro + rd * t);
+            F4 hit = AndNot(done, Abs(h) < F4(SURF_DIST));
+            result = Select(hit, t, result);
+            done = done | hit;
+
+            t = Select(done, t, t + h);
+            done = done | (t > F4(MAX_DIST));
+            if (MoveMask(done) == 0xF) break;
+        }
+        return result;
+    }
+
+    Vec3x4 CalcNormal(const Vec3x4& p) const {
+        const F4 e(0.0001f);
+        F4 d = MapDist(p);
+        F4 nx = d - MapDist(Vec3x4(p.x - e, p.y, p.z));
+        F4 ny = d - MapDist(Vec3x4(p.x, p.y - e, p.z));
+        F4 nz = d - MapDist(Vec3x4(p.x, p.y, p.z - e));
+        return Vec3x4(nx, ny, nz);
+    }
+
+    // TracePath() для 4 путей: марш и нормали пакетом, шейдинг по каждому лучу отдельно
+    void TracePaths(Path* paths, int lanes) const {
+        for (int b = 0; b < MAX_BOUNCES; b++) {
+            int active = 0;
+            Vec3 ro[4], rd[4];
+            for (int l = 0; l < 4; ++l) {
+                if (l < lanes && paths[l].Alive) {
+                    active |= 1 << l;
+                    ro[l] = paths[l].Ro;
+                    rd[l] = paths[l].Rd;
+                }
+                else {
+                    ro[l] = Vec3(0.0f);
+                    rd[l] = Vec3(0, 0, 1);
+                }
+            }
+            if (!active) break;
+
+            Vec3x4 ro4 = Vec3x4::FromLanes(ro), rd4 = Vec3x4::FromLanes(rd);
+            F4 t4 = CastRay(ro4, rd4, active);
+            Vec3x4 p4 = ro4 + rd4 * t4;
+            Vec3x4 n4 = CalcNormal(p4);
+            F4 dist4, id4;
+            Map(p4, dist4, id4);
+
+            Vec3 p[4], n[4];
+            p4.ToLanes(p);
+            n4.ToLanes(n);
+            float t[4], id[4];
+            t4.Store(t);
+            id4.Store(id);
+
+            for (int l = 0; l < lanes; ++l) {
+                if (!(active & (1 << l))) continue;
+                Path& path = paths[l];
+                if (t[l] > MAX_DIST - 10.0f) {
+                    Vec3 sky(0.01f, 0.01f, 0.015f); // Ambient sky
+                    path.Col += sky * path.Thr;
+                    path.Alive = false;
+                    continue;
+                }
+                path.Alive = Shade(path, b, p[l], Normalize(n[l]), m_objects[(int)id[l]]);
+            }
+        }
+    }
+
+    static Vec3 FSchlick(float cosT, const Vec3& F0) {
+        return F0 + (Vec3(1.0f) - F0) * std::pow(std::max(1.0f - cosT, 0.0f), 5.0f);
+    }
+    static float DGGX(float NdotH, float r) {
+        float a = r * r; float a2 = a * a; float d = (NdotH * NdotH * (a2 - 1.0f) + 1.0f);
+        return a2 / (PI * d * d);
+    }
+    static float GSmith(float NoV, float NoL, float r) {
+        float k = ((r + 1) * (r + 1)) / 8.0f;
+        return (NoV / (NoV * (1 - k) + k)) * (NoL / (NoL * (1 - k) + k));
+    }
+    // mul(H, GetTangentSpace(N))
+    static Vec3 ToWorld(const Vec3& h, const Vec3& N) {
+        Vec3 up = std::fabs(N.x) > 0.99f ? Vec3(0, 0, 1) : Vec3(1, 0, 0);
+        Vec3 T = Normalize(Cross(N, up)); Vec3 B = Cross(N, T);
+        return T * h.x + B * h.y + N * h.z;
+    }
+    static Vec3 SampleGGX(const Vec3& N, float r, uint32_t& s) {
+        float r1 = Rnd1(s), r2 = Rnd1(s); float a = r * r;
+        float phi = 2 * PI * r1; float ct = std::sqrt((1 - r2) / (1 + (a * a - 1) * r2)); float st = std::sqrt(1 - ct * ct);
+        return ToWorld(Vec3(std::cos(phi) * st, std::sin(phi) * st, ct), N);
+    }
+    static Vec3 SampleCosine(const Vec3& N, uint32_t& s) {
+        float r1 = Rnd1(s), r2 = Rnd1(s); float phi = 2 * PI * r1; float st = std::sqrt(r2); float ct = std::sqrt(1 - r2);
+        return ToWorld(Vec3(std::cos(phi) * st, std::sin(phi) * st, ct), N);
+    }
+
+    // Тело цикла TracePath() после попадания. false - путь завершен
+    static bool Shade(Path& path, int b, const Vec3& p, const Vec3& n, const SDFObject& o) {
+        uint32_t& seed = path.Seed;
+        Vec3 v = -path.Rd;
+        Vec3 alb = o.Color; float emit = o.Emission;
+        float r = std::max(o.Roughness, 0.04f); float met = o.Metalness; // Min roughness clamp
+
+        path.Col += alb * path.Thr * emit;
+        if (b > 1) {
+            float prob = MaxComponent(path.Thr);
+            if (Rnd1(seed) > prob) return false;
+            path.Thr /= prob;
+        }
+
+        Vec3 F0 = Vec3(0.04f) + (alb - Vec3(0.04f)) * met;
+        float cosT = Saturate(Dot(n, v));
+        float fg = FSchlick(cosT, F0).y;
+        float specC = std::min(std::max(fg + (1.0f - fg) * met, 0.05f), 0.95f);
+
+        Vec3 nextD, bsdf; float pdf;
+
+        if (Rnd1(seed) < specC) { // Specular
+            Vec3 H = SampleGGX(n, r, seed); Vec3 L = Reflect(-v, H);
+            float NoL = Saturate(Dot(n, L)); float NoV = Saturate(Dot(n, v));
+            float NoH = Saturate(Dot(n, H)); float VoH = Saturate(Dot(v, H));
+            if (NoL > 0) {
+                float D = DGGX(NoH, r); float G = GSmith(NoV, NoL, r); Vec3 F = FSchlick(VoH, F0);
+                bsdf = F * (D * G) * NoL / (4.0f * NoV * NoL + 1e-5f);
+                pdf = (D * NoH) / (4.0f * VoH + 1e-5f) * specC; nextD = L;
+            }
+            else return false;
+        }
+        else { // Diffuse
+            nextD = SampleCosine(n, seed); float NoL = Saturate(Dot(n, nextD));
+            Vec3 F = FSchlick(Saturate(Dot(v, Normalize(v + nextD))), F0);
+            bsdf = (Vec3(1.0f) - F) * (1.0f - met) * (alb / PI) * NoL;
+            pdf = (NoL / PI) * (1.0f - specC);
+        }
+        if (pdf < 1e-6f) return false;
+        path.Thr *= bsdf / pdf;
+        path.Ro = p + n * (SURF_DIST * 2.0f); path.Rd = nextD;
+        return true;
+    }
+};
+
+// =========================================================
+// TILE SCHEDULER (work stealing)
+// =========================================================
+// У каждого потока своя очередь тайлов (непрерывный кусок изображения - лучше для кэша).
+// Владелец берет тайлы с конца своей очереди, закончившиеся потоки воруют с начала чужих.
+class TileScheduler {
+public:
+    TileScheduler(int tileCount, int workers) {
+        for (int w = 0; w < workers; ++w) m_queues.push_back(std::make_unique<Queue>());
+        for (int w = 0; w < workers; ++w) {
+            int first = (int)((long long)tileCount * w / workers);
+            int last = (int)((long long)tileCount * (w + 1) / workers);
+            for (int t = last - 1; t >= first; --t) m_queues[w]->Tiles.push_back(t);
+        }
+    }
+
+    bool Next(int worker, int& tile) {
+        {
+            Queue& own = *m_queues[worker];
+            std::lock_guard<std::mutex> lock(own.Mutex);
+            if (!own.Tiles.empty()) {
+                tile = own.Tiles.back();
+                own.Tiles.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < m_queues.size(); ++i) {
+            Queue& victim = *m_queues[(worker + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.Mutex);
+            if (!victim.Tiles.empty()) {
+                tile = victim.Tiles.front();
+                victim.Tiles.pop_front();
+                m_steals++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int GetSteals() const { return m_steals; }
+
+private:
+    struct Queue {
+        std::mutex Mutex;
+        std::deque<int> Tiles;
+    };
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::atomic<int> m_steals{ 0 };
+};
+
+// =========================================================
+// OUTPUT
+// =========================================================
+// PFM: линейный float RGB, строки снизу вверх
+static bool WritePFM(const std::string& path, const std::vector<float>& rgb, int width, int height) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    std::fprintf(f, "PF\n%d %d\n-1.0\n", width, height);
+    for (int y = height - 1; y >= 0; --y)
+        std::fwrite(&rgb[(size_t)y * width * 3], sizeof(float), (size_t)width * 3, f);
+    std::fclose(f);
+    return true;
+}
+
+// ACES + sRGB как в FinalOutput.hlsl
+static float ACESFilm(float x) {
+    const float a = 2.51f, b = 0.03f, c = 2.43f, d = 0.59f, e = 0.14f;
+    return Saturate((x * (a * x + b)) / (x * (c * x + d) + e));
+}
+static float LinearToSRGB(float x) {
+    return x < 0.0031308f ? 12.92f * x : 1.055f * std::pow(std::fabs(x), 1.0f / 2.4f) - 0.055f;
+}
+
+static bool WritePPM(const std::string& path, const std::vector<float>& rgb, int width, int height, float exposure) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    std::fprintf(f, "P6\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> row((size_t)width * 3);
+    for (int y = 0; y < height; ++y) {
+        for (int i = 0; i < width * 3; ++i) {
+            float c = LinearToSRGB(ACESFilm(rgb[(size_t)y * width * 3 + i] * exposure));
+            row[i] = (unsigned char)(Saturate(c) * 255.0f + 0.5f);
+        }
+        std::fwrite(row.data(), 1, row.size(), f);
+    }
+    std::fclose(f);
+    return true;
+}
+
+
+static bool ReadPFM(const std::string& path, std::vector<float>& rgb, int width, int height) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    int w = 0, h = 0;
+    float scale = 0.0f;
+    bool ok = std::fscanf(f, "PF %d %d %f", &w, &h, &scale) == 3 && w == width && h == height && scale < 0.0f;
+    if (ok) {
+        std::fgetc(f); // перевод строки после заголовка
+        rgb.resize((size_t)w * h * 3);
+        for (int y = h - 1; y >= 0 && ok; --y)
+            ok = std::fread(&rgb[(size_t)y * w * 3], sizeof(float), (size_t)w * 3, f) == (size_t)w * 3;
+    }
+    std::fclose(f);
+    return ok;
+}
+
+// =========================================================
+// RENDER LOOP
+// =========================================================
+struct RenderResult {
+    double Seconds = 0.0;
+    double Samples = 0.0; // сэмплов на все пиксели
+    AdaptiveSampling::Stats Sampling;
+    int Steals = 0;
+    bool ErrorMode = false; // с -error: раунды идут до порога ошибки
+};
+
+// Раунды AdaptiveSampling::Scheduler: тайлы раунда рендерятся параллельно, после раунда обновляется их ошибка.
+// image получает средний цвет пикселей (RGB). Без errorMode (фиксированное число сэмплов) раунды и ошибка
+// не имеют смысла для пользователя - прогресс выводится в spp
+static RenderResult Render(const PathTracer& tracer, int width, int height, int tileSize, int threads,
+                           const AdaptiveSampling::Settings& settings, bool errorMode, std::vector<float>& image) {
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+    std::vector<float> accum((size_t)width * height * 4, 0.0f);
+
+    AdaptiveSampling::Scheduler sampler;
+    sampler.Reset(tilesX * tilesY, settings);
+
+    RenderResult result;
+    result.ErrorMode = errorMode;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    auto lastReport = startTime;
+
+    while (!sampler.IsFinished()) {
+        const std::vector<AdaptiveSampling::TileWork>& round = sampler.BeginRound();
+        if (round.empty()) break;
+
+        std::vector<float> errors(round.size());
+        TileScheduler scheduler((int)round.size(), threads);
+        std::vector<std::thread> workers;
+        for (int w = 0; w < threads; ++w) {
+            workers.emplace_back([&, w]() {
+                int job;
+                while (scheduler.Next(w, job)) {
+                    const AdaptiveSampling::TileWork& work = round[job];
+                    int x0 = (work.Tile % tilesX) * tileSize, y0 = (work.Tile / tilesX) * tileSize;
+                    int x1 = std::min(x0 + tileSize, width), y1 = std::min(y0 + tileSize, height);
+                    int firstPass = sampler.GetTilePasses(work.Tile);
+                    tracer.RenderTile(x0, y0, x1, y1, firstPass, work.Passes, accum.data());
+                    errors[job] = tracer.TileError(x0, y0, x1, y1, firstPass + work.Passes, accum.data());
+                }
+            });
+        }
+        for (auto& t : workers) t.join();
+        result.Steals += scheduler.GetSteals();
+
+        for (size_t j = 0; j < round.size(); ++j) {
+            const AdaptiveSampling::TileWork& work = round[j];
+            int x0 = (work.Tile % tilesX) * tileSize, y0 = (work.Tile / tilesX) * tileSize;
+            int pixels = (std::min(x0 + tileSize, width) - x0) * (std::min(y0 + tileSize, height) - y0);
+            result.Samples += (double)pixels * work.Passes * SAMPLES;
+            sampler.SetError(work.Tile, errors[j]);
+        }
+        sampler.EndRound();
+
+        auto now = std::chrono::high_resolution_clock::now();
+        if (now - lastReport > std::chrono::seconds(1)) {
+            lastReport = now;
+            const AdaptiveSampling::Stats& stats = sampler.GetStats();
+            if (errorMode) {
+                std::printf("  round %d: %d tiles active, max error %.4f\n", stats.Rounds, stats.ActiveTiles, stats.MaxError);
+            }
+            else {
+                std::printf("  %.1f spp, %.1f s\n", result.Samples / ((double)width * height),
+                            std::chrono::duration<double>(now - startTime).count());
+            }
+            std::fflush(stdout);
+        }
+    }
+
+    result.Seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+    result.Sampling = sampler.GetStats();
+
+    image.assign((size_t)width * height * 3, 0.0f);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float passes = (float)std::max(sampler.GetTilePasses((y / tileSize) * tilesX + x / tileSize), 1);
+            const float* a = &accum[((size_t)y * width + x) * 4];
+            float* dst = &image[((size_t)y * width + x) * 3];
+            dst[0] = a[0] / passes; dst[1] = a[1] / passes; dst[2] = a[2] / passes;
+        }
+    }
+    return result;
+}
+
+static void PrintResult(const char* name, const RenderResult& r, int threads, int width, int height) {
+    if (!r.ErrorMode) {
+        std::printf("%s: %.0f spp in %.2f s, %.3f Msamples/s (%.3f per thread)\n", name, r.Samples / ((double)width * height),
+            r.Seconds, r.Samples / r.Seconds * 1e-6, r.Samples / r.Seconds * 1e-6 / threads);
+        return;
+    }
+    std::printf("%s: %.2f s, %.3f Msamples/s (%.3f per thread), %d rounds, %lld tile passes, %d tiles stolen\n",
+        name, r.Seconds, r.Samples / r.Seconds * 1e-6, r.Samples / r.Seconds * 1e-6 / threads, r.Sampling.Rounds,
+        r.Sampling.TotalPasses, r.Steals);
+    if (r.Sampling.MaxError < FLT_MAX) std::printf("  max tile error %.4f\n", r.Sampling.MaxError);
+}
+
+// Относительная RMSE к эталону (по яркости)
+static double RelativeRMSE(const std::vector<float>& image, const std::vector<float>& reference) {
+    double sum = 0.0;
+    size_t pixels = image.size() / 3;
+    for (size_t i = 0; i < pixels; ++i) {
+        float a = AdaptiveSampling::Luminance(image[i * 3], image[i * 3 + 1], image[i * 3 + 2]);
+        float b = AdaptiveSampling::Luminance(reference[i * 3], reference[i * 3 + 1], reference[i * 3 + 2]);
+        double rel = (a - b) / (b + AdaptiveSampling::kErrorEpsilon);
+        sum += rel * rel;
+    }
+    return std::sqrt(sum / pixels);
+}
+
+// =========================================================
+// MAIN
+// =========================================================
+int main(int argc, char** argv) {
+    int width = 1280, height = 720;
+    int spp = 64;
+    int threads = (int)std::thread::hardware_concurrency();
+    int tileSize = 16;
+    float exposure = 1.0f;
+    std::string output = "golden.pfm";
+    std::string preview;
+    std::string reference;
+
+    // Без -error: фиксированное число сэмплов на пиксель. С -error: до достижения ошибки в каждом тайле
+    enum class Mode { Fixed, Uniform, Adaptive, Benchmark } mode = Mode::Fixed;
+    float errorThreshold = 0.02f;
+    int maxSpp = 16000;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-w" && hasValue) width = std::atoi(argv[++i]);
+        else if (arg == "-h" && hasValue) height = std::atoi(argv[++i]);
+        else if (arg == "-spp" && hasValue) spp = std::atoi(argv[++i]);
+        else if (arg == "-threads" && hasValue) threads = std::atoi(argv[++i]);
+        else if (arg == "-tile" && hasValue) tileSize = std::atoi(argv[++i]);
+        else if (arg == "-o" && hasValue) output = argv[++i];
+        else if (arg == "-preview" && hasValue) preview = argv[++i];
+        else if (arg == "-exposure" && hasValue) exposure = (float)std::atof(argv[++i]);
+        else if (arg == "-error" && hasValue) { errorThreshold = (float)std::atof(argv[++i]); if (mode == Mode::Fixed) mode = Mode::Adaptive; }
+        else if (arg == "-maxspp" && hasValue) maxSpp = std::atoi(argv[++i]);
+        else if (arg == "-uniform") mode = Mode::Uniform;
+        else if (arg == "-adaptive") mode = Mode::Adaptive;
+        else if (arg == "-benchmark") mode = Mode::Benchmark;
+        else if (arg == "-reference" && hasValue) reference = argv[++i];
+        else {
+            std::printf("Usage: %s [-w W] [-h H] [-spp N] [-threads N] [-tile N] [-o out.pfm] [-preview out.ppm] [-exposure E]\n"
+                        "       [-error E [-uniform | -adaptive | -benchmark] [-maxspp N]] [-reference ref.pfm]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || tileSize <= 0 || errorThreshold <= 0.0f) {
+        std::fprintf(stderr, "Invalid resolution, tile size or error threshold\n");
+        return 1;
+    }
+    threads = std::max(threads, 1);
+    // Один проход шейдера - SAMPLES сэмплов, поэтому spp округляется вверх до кратного
+    int passes = std::max((spp + SAMPLES - 1) / SAMPLES, 1);
+    spp = passes * SAMPLES;
+
+    Scene scene;
+    BuildDemoScene(scene);
+    Camera camera = Camera::LookAt(
+        Vec3(DemoCameraPos[0], DemoCameraPos[1], DemoCameraPos[2]),
+        Vec3(DemoCameraTarget[0], DemoCameraTarget[1], DemoCameraTarget[2]), width, height);
+    std::vector<SDFObject> objects = scene.Compile();
+    PathTracer tracer(objects, camera, width, height);
+
+    std::vector<float> referenceImage;
+    if (!reference.empty() && !ReadPFM(reference, referenceImage, width, height)) {
+        std::fprintf(stderr, "Failed to read %s (must be a %dx%d PFM)\n", reference.c_str(), width, height);
+        return 1;
+    }
+
+    std::printf("Rendering %dx%d, %d objects, %d threads, tiles of %d px (%s)\n",
+        width, height, (int)objects.size(), threads, tileSize,
+#ifdef CPUPT_SSE
+        "SSE packets"
+#else
+        "scalar packets"
+#endif
+    );
+
+    AdaptiveSampling::Settings settings;
+    settings.ErrorThreshold = errorThreshold;
+    settings.MaxPasses = std::max(maxSpp / SAMPLES, 2);
+
+    std::vector<float> image;
+    auto run = [&](const char* name, bool adaptive) {
+        settings.Adaptive = adaptive;
+        RenderResult r = Render(tracer, width, height, tileSize, threads, settings, mode != Mode::Fixed, image);
+        PrintResult(name, r, threads, width, height);
+        if (!referenceImage.empty()) std::printf("  relative RMSE to reference: %.4f\n", RelativeRMSE(image, referenceImage));
+        return r;
+    };
+
+    if (mode == Mode::Fixed) {
+        std::printf("Fixed %d spp\n", spp);
+        settings.Adaptive = false;
+        settings.MinPasses = settings.MaxPasses = passes;
+        run("Fixed", false);
+    }
+    else if (mode == Mode::Uniform) {
+        std::printf("Uniform sampling to error %.4f\n", errorThreshold);
+        run("Uniform", false);
+    }
+    else if (mode == Mode::Adaptive) {
+        std::printf("Adaptive sampling to error %.4f\n", errorThreshold);
+        run("Adaptive", true);
+    }
+    else {
+        // Время до целевого качества: равномерно по всем тайлам против адаптивного распределения
+        std::printf("Benchmark: time to error %.4f\n", errorThreshold);
+        RenderResult uniform = run("Uniform", false);
+        RenderResult adaptive = run("Adaptive", true);
+        std::printf("Speedup: %.2fx time, %.2fx samples\n", uniform.Seconds / adaptive.Seconds, uniform.Samples / adaptive.Samples);
+    }
+
+    if (!WritePFM(output, image, width, height)) {
+        std::fprintf(stderr, "Failed to write %s\n", output.c_str());
+        return 1;
+    }
+    std::printf("Saved %s\n", output.c_str());
+
+    if (!preview.empty()) {
+        if (!WritePPM(preview, image, width, height, exposure)) {
+            std::fprintf(stderr, "Failed to write %s\n", preview.c_str());
+            return 1;
+        }
+        std::printf("Saved %s\n", preview.c_str());
+    }
+    return 0;
+}
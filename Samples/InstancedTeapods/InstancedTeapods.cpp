@@ -6,6 +6,7 @@
 #include <iostream>
 #include <chrono>
 #include <cmath>
+#include <algorithm>
 
 #pragma comment( lib, "winmm.lib")  
 
@@ -48,7 +49,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
     // --- РЕСУРСЫ ---
     Mesh objectMesh;
+    objectMesh.SetKeepCPUData(true);
     if (!objectMesh.LoadFromOBJ("teapot.obj")) Mesh::GenerateSphere(objectMesh, 1.0f, 24, 16);
+    objectMesh.GenerateLODs(5, 0.5f, 0.05f);
+    objectMesh.BuildOccluder(256); // грубая копия для программного теста перекрытия
+    objectMesh.ReleaseCPUData();
     Mesh floorMesh; Mesh::GeneratePlane(floorMesh, 1000.0f, 1000.0f);
 
     // --- ГЕНЕРАЦИЯ ИНСТАНСОВ ---
@@ -63,13 +68,29 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         }
     }
     InstanceBuffer instanceBuffer;
+    instanceBuffer.SetKeepCPUData(true); // исходные записи для InstanceCuller::Build
     instanceBuffer.Create(instancesData.data(), (int)instancesData.size(), sizeof(Math::float4x4));
+    instanceBuffer.SetTransformOffset(0); // инстанс = матрица World, по ней выбирается LOD
+
+    // Отсечение по фрустуму: у каждого вида (тень, камера) свой буфер только с видимыми инстансами
+    InstanceCuller instanceCuller;
+    instanceCuller.Build(instanceBuffer, objectMesh);
+    InstanceBuffer shadowVisible, mainVisible;
+
+    // Перекрытие: ближайшие к камере чайники рисуются на CPU в маленький буфер глубины, спрятанные за ними не рисуются
+    OcclusionCuller occlusionCuller;
+    const int occluderCount = 24;
+    std::vector<std::pair<float, int>> occluderCandidates;
+    shadowVisible.SetTransformOffset(0);
+    mainVisible.SetTransformOffset(0);
 
     // --- ТЕКСТУРЫ И ШЕЙДЕРЫ ---
     // (Инициализация такая же, как в оригинале - сокращено для краткости чтения, ресурсы те же)
-    Texture rtAlbedo, rtPos, rtNorm, rtSSAORaw, rtSSAODenoised, rtShadow;
+    Texture rtAlbedo, rtPos, rtNorm;
+    Texture rtSSAORaw, rtSSAODenoised; // Временные цели из пула, берутся на время кадра
+    DepthTexture shadowDepth; // Карта теней - сам depth buffer, отдельный R32F цвет не нужен
     rtAlbedo.Create(W, H, TextureFormat::RGBA8); rtPos.Create(W, H, TextureFormat::RGBA16F); rtNorm.Create(W, H, TextureFormat::RGBA16F);
-    rtSSAORaw.Create(W / 2, H / 2, TextureFormat::RGBA8); rtSSAODenoised.Create(W, H, TextureFormat::RGBA8); rtShadow.Create(4096, 4096, TextureFormat::R32F);
+    shadowDepth.Create(4096, 4096, DepthFormat::D32F);
 
     Texture noiseTexture; // Заполнение шумом...
     std::vector<float4> noiseData(16); for (int i = 0; i < 16; i++) noiseData[i] = float4(RandomFloat() * 2 - 1, RandomFloat() * 2 - 1, 0, 0);
@@ -86,18 +107,19 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
     // FILL PASSES DATA (As in original code)
     shadowInstPass.VertexShaderPath = "Shader.hlsl"; shadowInstPass.VertexShaderEntryPoint = "VS_ShadowInstanced"; shadowInstPass.PixelShaderPath = "Shader.hlsl"; shadowInstPass.PixelShaderEntryPoint = "PS_Shadow"; renderer.CompilePass(shadowInstPass);
-    shadowStaticPass.VertexShaderPath = "Shader.hlsl"; shadowStaticPass.VertexShaderEntryPoint = "VS_Shadow"; shadowStaticPass.PixelShaderPath = "Shader.hlsl"; shadowStaticPass.PixelShaderEntryPoint = "PS_Shadow"; renderer.CompilePass(shadowStaticPass);
+    shadowStaticPass.VertexShaderPath = "Shader.hlsl"; shadowStaticPass.VertexShaderEntryPoint = "VS_Shadow"; shadowStaticPass.PixelShaderPath = "Shader.hlsl"; shadowStaticPass.PixelShaderEntryPoint = "PS_Shadow"; shadowStaticPass.InstancedVertexShaderEntryPoint = "VS_ShadowInstanced"; renderer.CompilePass(shadowStaticPass);
     gbufInstPass.VertexShaderPath = "Shader.hlsl"; gbufInstPass.VertexShaderEntryPoint = "VS_MeshInstanced"; gbufInstPass.PixelShaderPath = "Shader.hlsl"; gbufInstPass.PixelShaderEntryPoint = "PS_GBuffer"; renderer.CompilePass(gbufInstPass);
-    gbufStaticPass.VertexShaderPath = "Shader.hlsl"; gbufStaticPass.VertexShaderEntryPoint = "VS_Mesh"; gbufStaticPass.PixelShaderPath = "Shader.hlsl"; gbufStaticPass.PixelShaderEntryPoint = "PS_GBuffer"; renderer.CompilePass(gbufStaticPass);
+    gbufStaticPass.VertexShaderPath = "Shader.hlsl"; gbufStaticPass.VertexShaderEntryPoint = "VS_Mesh"; gbufStaticPass.PixelShaderPath = "Shader.hlsl"; gbufStaticPass.PixelShaderEntryPoint = "PS_GBuffer"; gbufStaticPass.InstancedVertexShaderEntryPoint = "VS_MeshInstanced"; renderer.CompilePass(gbufStaticPass);
 
     ssaoPass.VertexShaderPath = "Shader.hlsl"; ssaoPass.VertexShaderEntryPoint = "VS_Quad"; ssaoPass.PixelShaderPath = "Shader.hlsl"; ssaoPass.PixelShaderEntryPoint = "PS_SSAO_Raw";
     ssaoPass.AddTexture("TexPosition", rtPos); ssaoPass.AddTexture("TexNormal", rtNorm); ssaoPass.AddTexture("TexNoise", noiseTexture); ssaoPass.AddSampler("SamplerClamp", smpLin); ssaoPass.AddSampler("SamplerPoint", smpPt); renderer.CompilePass(ssaoPass);
 
-    denoisePass.VertexShaderPath = "Shader.hlsl"; denoisePass.VertexShaderEntryPoint = "VS_Quad"; denoisePass.PixelShaderPath = "Shader.hlsl"; denoisePass.PixelShaderEntryPoint = "PS_Denoise";
-    denoisePass.AddTexture("TexSSAO_Raw", rtSSAORaw); denoisePass.AddSampler("SamplerClamp", smpLin); renderer.CompilePass(denoisePass);
+    // Denoise - compute проход: тайл сырого SSAO грузится в groupshared память один раз на группу
+    denoisePass.ComputeShaderPath = "Shader.hlsl"; denoisePass.ComputeShaderEntryPoint = "CS_Denoise";
+    denoisePass.AddTexture("TexSSAO_Raw", rtSSAORaw); denoisePass.AddStorageTexture("DenoiseOutput", rtSSAODenoised); renderer.CompilePass(denoisePass);
 
     combinePass.VertexShaderPath = "Shader.hlsl"; combinePass.VertexShaderEntryPoint = "VS_Quad"; combinePass.PixelShaderPath = "Shader.hlsl"; combinePass.PixelShaderEntryPoint = "PS_Combine";
-    combinePass.AddTexture("TexAlbedo", rtAlbedo); combinePass.AddTexture("TexSSAO", rtSSAODenoised); combinePass.AddTexture("TexPosWorld", rtPos); combinePass.AddTexture("TexNormalWorld", rtNorm); combinePass.AddTexture("TexShadow", rtShadow); combinePass.AddSampler("SamplerClamp", smpLin); renderer.CompilePass(combinePass);
+    combinePass.AddTexture("TexAlbedo", rtAlbedo); combinePass.AddTexture("TexSSAO", rtSSAODenoised); combinePass.AddTexture("TexPosWorld", rtPos); combinePass.AddTexture("TexNormalWorld", rtNorm); combinePass.AddTexture("TexShadow", shadowDepth); combinePass.AddSampler("SamplerClamp", smpLin); renderer.CompilePass(combinePass);
 
 
     SSAOConfig ssaoConfig;
@@ -106,6 +128,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
     Math::float3 lightPos = { 100.0f, 200.0f, -100.0f };
     Math::float4x4 lightVP = Math::float4x4::look_at_lh(lightPos, { 0,0,0 }, { 0,1,0 }) * Math::float4x4::orthographic_lh_zo(250.0f, 250.0f, 10.0f, 500.0f);
+    // LOD для карты теней - по размеру ее текселя, а не по расстоянию до основной камеры
+    LODCamera shadowLOD;
+    shadowLOD.Position = lightPos;
+    shadowLOD.PixelsPerUnit = shadowDepth.GetWidth() / 250.0f;
+    shadowLOD.Orthographic = true;
+    shadowLOD.Enabled = true;
     Math::float4x4 proj = Math::float4x4::perspective_lh_zo(3.14159f / 4.0f, (float)W / H, 0.5f, 500.0f);
 
 
@@ -131,6 +159,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
     MSG msg = {};
     float time = 0;
+    int frame = 0;
     while (msg.message != WM_QUIT) {
         if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) { TranslateMessage(&msg); DispatchMessage(&msg); }
         else {
@@ -138,27 +167,78 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
             Math::float3 camPos = { sin(time * 0.5f) * 50.0f, 5.0f, cos(time * 0.5f) * 50.0f };
             Math::float4x4 view = Math::float4x4::look_at_lh(camPos, { 0,0,0 }, { 0,1,0 });
             ssaoConfig.View = view; ssaoConfig.Projection = proj; ssaoConfig.CameraPosition = Math::float4(camPos.x, camPos.y, camPos.z, 1);
+            renderer.SetLODCamera(camPos, 3.14159f / 4.0f, H);
+
+            Frustum mainFrustum = Frustum::FromViewProjection(view * proj);
+
+            renderer.BeginScope("Culling", false);
+            occluderCandidates.clear();
+            for (int i = 0; i < (int)instancesData.size(); ++i) {
+                Math::float3 center = instancesData[i].transform_point(objectMesh.GetBoundsCenter());
+                if (mainFrustum.IntersectsSphere(center, objectMesh.GetBoundingRadius())) {
+                    occluderCandidates.push_back({ Math::length_sq(center - camPos), i });
+                }
+            }
+            int occluders = std::min(occluderCount, (int)occluderCandidates.size());
+            std::nth_element(occluderCandidates.begin(), occluderCandidates.begin() + occluders, occluderCandidates.end());
+
+            occlusionCuller.Begin(view * proj);
+            for (int i = 0; i < occluders; ++i) occlusionCuller.RenderOccluder(objectMesh, instancesData[occluderCandidates[i].second]);
+            occlusionCuller.End();
+
+            // Видимые сразу раскладываются по LOD - DrawMeshInstanced рисует уровни прямо из этих буферов
+            InstanceCullStats shadowCull = instanceCuller.Cull(Frustum::FromViewProjection(lightVP), shadowLOD, shadowVisible);
+            InstanceCullStats mainCull = instanceCuller.Cull(mainFrustum, occlusionCuller, renderer.GetLODCamera(), mainVisible);
+            renderer.EndScope();
+
+            if (++frame % 60 == 0) {
+                // GPU-время проходов верхнего уровня из профайлера
+                std::string passes;
+                for (const ProfileScopeStats& scope : renderer.GetProfileSummary().Scopes) {
+                    if (scope.Depth != 0 || scope.GpuMilliseconds < 0.0) continue;
+                    char entry[64];
+                    sprintf_s(entry, " %s %.2f", scope.Name.c_str(), scope.GpuMilliseconds);
+                    passes += entry;
+                }
+
+                FrameStats stats;
+                if (!renderer.GetFrameStatsHistory().empty()) stats = renderer.GetFrameStatsHistory().back();
+
+                char title[512];
+                const RenderTargetPoolStats& pool = renderer.GetTransientPoolStats();
+                const MemoryStats memory = renderer.GetMemoryStats();
+
+                sprintf_s(title, "Massive Instancing Demo - visible %d/%d, occluded %d (%.2f ms raster), shadow %d, culling %.0f instances/ms%s | %d draws, %d binds, %d pooled RTs %.1f MB | GPU mem %.1f MB (textures %.1f) | GPU ms:%s (F2 - trace)",
+                    mainCull.Visible, mainCull.Total, mainCull.Occluded, occlusionCuller.GetStats().RasterMilliseconds, shadowCull.Visible,
+                    mainCull.InstancesPerMillisecond(), mainCull.AVX2 ? " AVX2" : " SSE", stats.DrawCalls, stats.TextureBinds + stats.SamplerBinds,
+                    pool.Targets, pool.BytesAllocated / (1024.0 * 1024.0), memory.TotalBytes / (1024.0 * 1024.0),
+                    memory.Get(MemoryCategory::Texture).Bytes / (1024.0 * 1024.0), passes.c_str());
+                SetWindowText(hwnd, title);
+            }
+            if (GetAsyncKeyState(VK_F2) & 1) renderer.ExportProfileTrace("profile.json");
 
             // =========================
             // 1. SHADOW PASS (INSTANCED)
             // =========================
-            renderer.SetRenderTarget(rtShadow);
-            renderer.Clear(rtShadow, 1, 1, 1, 1);
+            renderer.BeginScope("Shadow");
+            renderer.SetRenderTarget(shadowDepth);
             renderer.ClearDepth(1.0f);
 
             renderer.SetPipelineState(stateScene);
 
             renderer.SetConstant("ViewProjection", lightVP);
             renderer.SetShaderPass(shadowInstPass);
-            renderer.DrawMeshInstanced(objectMesh, instanceBuffer);
+            renderer.DrawMeshInstanced(objectMesh, shadowVisible);
 
             renderer.SetShaderPass(shadowStaticPass);
             renderer.SetConstant("World", Math::float4x4::identity());
             renderer.DrawMesh(floorMesh);
+            renderer.EndScope();
 
             // =========================
             // 2. G-BUFFER (INSTANCED)
             // =========================
+            renderer.BeginScope("GBuffer");
             renderer.SetRenderTarget(rtAlbedo, rtPos, rtNorm);
             renderer.Clear(0, 0, 0, 1);
             renderer.ClearDepth();
@@ -169,11 +249,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
             renderer.SetConstant("ViewProjection", view * proj);
 
             renderer.SetShaderPass(gbufInstPass);
-            renderer.DrawMeshInstanced(objectMesh, instanceBuffer);
+            renderer.DrawMeshInstanced(objectMesh, mainVisible);
 
             renderer.SetShaderPass(gbufStaticPass);
             renderer.SetConstant("World", Math::float4x4::identity());
             renderer.DrawMesh(floorMesh);
+            renderer.EndScope();
 
             // =========================
             // 3. SSAO & POST PROCESS
@@ -183,19 +264,27 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
             renderer.SetPipelineState(statePostProcess);
 
             // -- Raw SSAO --
-            renderer.SetRenderTarget(rtSSAORaw);
+            renderer.BeginScope("SSAO");
+            rtSSAORaw = Texture::AcquireTransient(W / 2, H / 2, TextureFormat::RGBA8);
+            // Полноэкранным проходам глубина не нужна - не заводим лишний буфер половинного размера
+            renderer.SetRenderTarget(DepthBinding::None, rtSSAORaw);
             renderer.Clear(1, 1, 1, 1);
             renderer.SetShaderPass(ssaoPass);
             renderer.SetCustomConstant("SSAOConfigBuffer", ssaoConfig);
             renderer.DrawFullScreenQuad();
+            renderer.EndScope();
 
             // -- Denoise --
-            renderer.SetRenderTarget(rtSSAODenoised);
-            // State все тот же, не меняем
+            renderer.BeginScope("Denoise");
+            rtSSAODenoised = Texture::AcquireTransient(W, H, TextureFormat::RGBA8, true);
+            // Без цели рендера и квада: результат пишется через UAV
             renderer.SetShaderPass(denoisePass);
-            renderer.DrawFullScreenQuad();
+            renderer.Dispatch(Rendeructor::GetGroupCount(W, 16), Rendeructor::GetGroupCount(H, 16));
+            rtSSAORaw.Release(); // Сырой SSAO больше не нужен - цель свободна для следующих проходов
+            renderer.EndScope();
 
             // -- Combine to Screen --
+            renderer.BeginScope("Combine");
             renderer.RenderPassToScreen();
             renderer.Clear(0.2f, 0.2f, 0.2f, 1);
 
@@ -207,6 +296,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
             renderer.SetConstant("LightViewProjection", lightVP);
             renderer.SetCustomConstant("SSAOConfigBuffer", ssaoConfig);
             renderer.DrawFullScreenQuad();
+            rtSSAODenoised.Release();
+            renderer.EndScope();
 
             renderer.Present();
         }
@@ -227,21 +227,54 @@ float4 PS_SSAO_Raw(PS_INPUT_QUAD input) : SV_Target{
 }
 
 // =================================================================================
-// PIXEL SHADER: DENOISE (Pass 3)
+// COMPUTE SHADER: DENOISE (Pass 3)
 // =================================================================================
 
+//  16x16      8x8   SSAO ( )
+//   2    .    groupshared  ,  16    
+//    ,    
+#define DENOISE_GROUP 16
+#define DENOISE_CACHE 12
+
 Texture2D TexSSAO_Raw : register(t0);
+RWTexture2D<float4> DenoiseOutput : register(u0);
+
+groupshared float ssaoCache[DENOISE_CACHE * DENOISE_CACHE];
+
+float CachedSSAO(int2 p) {
+    return ssaoCache[p.y * DENOISE_CACHE + p.x];
+}
+
+[numthreads(DENOISE_GROUP, DENOISE_GROUP, 1)]
+void CS_Denoise(uint3 groupId : SV_GroupID, uint3 pixel : SV_DispatchThreadID, uint threadIndex : SV_GroupIndex) {
+    uint rawWidth, rawHeight;
+    TexSSAO_Raw.GetDimensions(rawWidth, rawHeight);
+    float2 scale = float2(rawWidth, rawHeight) / Resolution.xy;
+    int2 cacheOrigin = int2(floor(float2(groupId.xy * DENOISE_GROUP) * scale)) - 2;
+
+    // 144   256    ;    ,   SamplerClamp
+    if (threadIndex < DENOISE_CACHE * DENOISE_CACHE) {
+        int2 p = cacheOrigin + int2(threadIndex % DENOISE_CACHE, threadIndex / DENOISE_CACHE);
+        p = clamp(p, int2(0, 0), int2(rawWidth, rawHeight) - 1);
+        ssaoCache[threadIndex] = TexSSAO_Raw.Load(int3(p, 0)).r;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (pixel.x >= (uint)Resolution.x || pixel.y >= (uint)Resolution.y) return;
 
-float4 PS_Denoise(PS_INPUT_QUAD input) : SV_Target{
-    float2 texelSize = 1.0 / Resolution.xy;
+    // Box blur 4x4   ,     
     float result = 0.0;
-    // Box blur 4x4
     for (int x = -2; x < 2; ++x) {
         for (int y = -2; y < 2; ++y) {
-            result += TexSSAO_Raw.Sample(SamplerClamp, input.UV + float2(x,y) * texelSize).r;
+            float2 texel = (float2(pixel.xy) + 0.5 + float2(x, y)) * scale - 0.5 - float2(cacheOrigin);
+            int2 base = int2(floor(texel));
+            float2 t = texel - float2(base);
+            float top = lerp(CachedSSAO(base), CachedSSAO(base + int2(1, 0)), t.x);
+            float bottom = lerp(CachedSSAO(base + int2(0, 1)), CachedSSAO(base + int2(1, 1)), t.x);
+            result += lerp(top, bottom, t.y);
         }
     }
-    return result / 16.0;
+    DenoiseOutput[pixel.xy] = result / 16.0;
 }
 
 // =================================================================================
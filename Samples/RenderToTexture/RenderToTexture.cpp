@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <cstring>
 
 // Подключение движка
 #include <Rendeructor.h>
@@ -21,7 +22,11 @@ struct SceneData {
     Math::float4   Params;          // .x = Время
 };
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR cmdLine, int) {
+    // "-headless": без окна, кадры пишутся в frames/frame_0000.png ... (офлайн рендер, CI)
+    const bool headless = cmdLine && strstr(cmdLine, "-headless") != nullptr;
+    const int headlessFrames = 120;
+
     // 1. Создание окна
     WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_HREDRAW | CS_VREDRAW,
         [](HWND h, UINT m, WPARAM w, LPARAM l) -> LRESULT {
@@ -30,7 +35,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     RegisterClassEx(&wc);
 
     int W = 1280, H = 720;
-    HWND hwnd = CreateWindowEx(0, "RaymarchSample", "Rendeructor: Raymarching & PostProcess", WS_OVERLAPPEDWINDOW | WS_VISIBLE, 100, 100, W, H, nullptr, nullptr, hInstance, nullptr);
+    HWND hwnd = headless ? nullptr :
+        CreateWindowEx(0, "RaymarchSample", "Rendeructor: Raymarching & PostProcess", WS_OVERLAPPEDWINDOW | WS_VISIBLE, 100, 100, W, H, nullptr, nullptr, hInstance, nullptr);
 
     // 2. Инициализация движка
     Rendeructor renderer;
@@ -39,6 +45,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     config.Height = H;
     config.WindowHandle = hwnd;
     config.API = RenderAPI::DirectX11;
+    config.Headless = headless;
+    if (headless) config.FrameOutputPattern = "frames/frame_%04d.png";
 
     if (!renderer.Create(config)) return 0;
 
@@ -92,10 +100,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
     MSG msg = {};
     float time = 0.0f;
+    int frame = 0;
 
     while (msg.message != WM_QUIT) {
-        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) { TranslateMessage(&msg); DispatchMessage(&msg); }
+        if (headless && frame >= headlessFrames) break;
+        if (!headless && PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) { TranslateMessage(&msg); DispatchMessage(&msg); }
         else {
+            frame++;
             time += 0.01f;
             sceneCB.Params.x = time; // Обновляем время
 
@@ -133,6 +144,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         }
     }
 
+    // Дожидаемся, пока последние кадры будут закодированы и записаны
+    if (headless) renderer.FlushFrameOutput();
+
     renderer.Destroy();
     return 0;
 }
@@ -0,0 +1,131 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+// Variance-driven distribution of path tracing passes over screen tiles.
+// Every pixel accumulates the sum of its pass results and the sum of squared luminances, which gives the standard
+// error of the pixel mean. The per-tile average of that error (relative to the pixel brightness) decides how many
+// more passes the tile gets; tiles whose error drops below the threshold are retired.
+// Shared by the GPU sample (error reduced in TileError.hlsl) and the CPU reference tracer.
+namespace AdaptiveSampling {
+
+    // Keep in sync with TileError.hlsl
+    const float kLumaR = 0.2126f, kLumaG = 0.7152f, kLumaB = 0.0722f;
+    const float kErrorEpsilon = 0.1f; // dark pixels are judged by absolute rather than relative error
+
+    inline float Luminance(float r, float g, float b) { return r * kLumaR + g * kLumaG + b * kLumaB; }
+
+    // Relative standard error of a pixel mean from n passes: sum of luminances and sum of squared luminances
+    inline float PixelError(float sumLuma, float sumLumaSq, float n) {
+        if (n < 2.0f) return FLT_MAX;
+        float mean = sumLuma / n;
+        float variance = std::max(sumLumaSq / n - mean * mean, 0.0f) * n / (n - 1.0f);
+        return std::sqrt(variance / n) / (mean + kErrorEpsilon);
+    }
+
+    struct Settings {
+        float ErrorThreshold = 0.02f;
+        int MinPasses = 4;        // passes before the error estimate is trusted
+        int MaxPasses = 1000;     // hard limit per tile
+        int MaxPassesPerRound = 16;
+        bool Adaptive = true;     // false: every tile gets one pass per round until all of them converge
+    };
+
+    struct TileWork {
+        int Tile;
+        int Passes;
+    };
+
+    struct Stats {
+        int Rounds = 0;
+        int ActiveTiles = 0;
+        long long TotalPasses = 0; // tile passes rendered so far
+        float MaxError = FLT_MAX;  // worst tile error from the last estimate
+    };
+
+    class Scheduler {
+    public:
+        void Reset(int tileCount, const Settings& settings) {
+            m_settings = settings;
+            m_settings.MinPasses = std::max(m_settings.MinPasses, 1);
+            m_settings.MaxPasses = std::max(m_settings.MaxPasses, m_settings.MinPasses);
+            m_tiles.assign(tileCount, Tile());
+            m_stats = Stats();
+            m_stats.ActiveTiles = tileCount;
+        }
+
+        // Work for the next round. The caller renders it, then reports the new error of every listed tile via
+        // SetError() and calls EndRound()
+        const std::vector<TileWork>& BeginRound() {
+            m_round.clear();
+            for (int i = 0; i < (int)m_tiles.size(); ++i) {
+                const Tile& t = m_tiles[i];
+                if (t.Converged) continue;
+
+                int passes = 1;
+                if (t.Passes < m_settings.MinPasses) {
+                    passes = m_settings.MinPasses - t.Passes;
+                }
+                else if (m_settings.Adaptive && t.Error < FLT_MAX) {
+                    // Error falls as 1/sqrt(n): passes still missing to reach the threshold,
+                    // limited to doubling the count so a noisy estimate cannot overshoot much
+                    float ratio = t.Error / m_settings.ErrorThreshold;
+                    float needed = std::ceil(t.Passes * (ratio * ratio - 1.0f));
+                    passes = (int)std::min(needed, (float)std::min(t.Passes, m_settings.MaxPassesPerRound));
+                    passes = std::max(passes, 1);
+                }
+                passes = std::min(passes, m_settings.MaxPasses - t.Passes);
+                if (passes > 0) m_round.push_back({ i, passes });
+            }
+            return m_round;
+        }
+
+        void SetError(int tile, float error) {
+            if (tile >= 0 && tile < (int)m_tiles.size()) m_tiles[tile].Error = error;
+        }
+
+        void EndRound() {
+            for (const TileWork& w : m_round) m_tiles[w.Tile].Passes += w.Passes;
+            for (const TileWork& w : m_round) m_stats.TotalPasses += w.Passes;
+
+            m_stats.Rounds++;
+            m_stats.MaxError = 0.0f;
+            bool allBelow = true;
+            for (const Tile& t : m_tiles) {
+                m_stats.MaxError = std::max(m_stats.MaxError, t.Error);
+                if (t.Passes < m_settings.MinPasses || t.Error > m_settings.ErrorThreshold) allBelow = false;
+            }
+
+            m_stats.ActiveTiles = 0;
+            for (Tile& t : m_tiles) {
+                bool done = t.Passes >= m_settings.MaxPasses;
+                if (m_settings.Adaptive) done = done || (t.Passes >= m_settings.MinPasses && t.Error <= m_settings.ErrorThreshold);
+                else done = done || allBelow;
+                t.Converged = done;
+                if (!done) m_stats.ActiveTiles++;
+            }
+        }
+
+        // Work handed out by the last BeginRound()
+        const std::vector<TileWork>& GetRoundWork() const { return m_round; }
+        bool IsFinished() const { return m_stats.ActiveTiles == 0; }
+        const Stats& GetStats() const { return m_stats; }
+        const Settings& GetSettings() const { return m_settings; }
+        int GetTilePasses(int tile) const { return m_tiles[tile].Passes; }
+        bool IsTileConverged(int tile) const { return m_tiles[tile].Converged; }
+
+    private:
+        struct Tile {
+            int Passes = 0;
+            float Error = FLT_MAX;
+            bool Converged = false;
+        };
+
+        Settings m_settings;
+        std::vector<Tile> m_tiles;
+        std::vector<TileWork> m_round;
+        Stats m_stats;
+    };
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <algorithm>
+
+// Scene shared by the GPU path tracer and the CPU reference renderer (Samples/CPUPathTracer).
+// Only the scene content lives here; each renderer provides its own Scene type with CreatePrimitive() returning
+// an object with SetPosition/SetRotation (degrees)/SetScale/SetColor/SetRoughness/SetMetalness/SetEmission.
+
+enum class PrimitiveType { Sphere = 0, Box = 1, Plane = 2 };
+
+// Camera the scene is framed for (vertical FOV 60 degrees)
+const float DemoCameraPos[3] = { 9.0f, 15.0f, -6.0f };
+const float DemoCameraTarget[3] = { 9.0f, 0.0f, 9.0f };
+
+template <typename SceneT>
+void BuildDemoScene(SceneT& scene) {
+    auto floor = scene.CreatePrimitive(PrimitiveType::Plane);
+    floor->SetPosition(0, 0, 0); floor->SetColor(0.05f, 0.05f, 0.05f); floor->SetRoughness(1.0f);
+
+    auto light = scene.CreatePrimitive(PrimitiveType::Box);
+    light->SetPosition(8.0f, 10.0f, 8.0f); light->SetScale(3.0f, 0.1f, 3.0f);
+    light->SetColor(1.0f, 0.9f, 0.8f); light->SetEmission(5.0f);
+
+    int rows = 8, cols = 8; float sp = 2.5f;
+    for (int z = 0; z < rows; z++) for (int x = 0; x < cols; x++) {
+        auto s = scene.CreatePrimitive(PrimitiveType::Sphere);
+        s->SetPosition(x * sp, 1.0f, z * sp); s->SetScale(0.9f);
+        s->SetRoughness(std::max((float)x / (cols - 1), 0.04f)); s->SetMetalness((float)z / (rows - 1));
+        s->SetColor(0.9f, 0.1f, 0.1f);
+    }
+}
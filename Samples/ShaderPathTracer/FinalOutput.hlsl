@@ -34,8 +34,9 @@ float3 LinearToSRGB(float3 x) {
 }
 
 float4 PS_ToneMap(VS_OUTPUT input) : SV_Target{
-    // 1.   HDR 
-    float3 color = TexHDR.Sample(Smp, input.UV).rgb;
+    // 1.   HDR :    ,    
+    float4 accum = TexHDR.Sample(Smp, input.UV);
+    float3 color = accum.rgb / max(accum.a, 1.0);
 
     // 2.   (Exposure)
     //   "ISO"  ""  .
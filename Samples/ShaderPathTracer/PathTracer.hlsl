@@ -8,7 +8,7 @@ cbuffer SceneBuffer : register(b0) {
     float4 CameraRight;
     float4 CameraUp;
     float4 Resolution;
-    float4 Params; // x = Seed, y = Unused, z = FrameIndex (accumulator)
+    float4 Params; // x = Seed, y, z = Unused
 };
 
 struct SDFObject {
@@ -18,15 +18,27 @@ struct SDFObject {
     float4 ColorAndEmit;
 };
 
-static const int MAX_OBJECTS = 128;
+//       
+StructuredBuffer<SDFObject> Objects : register(t0);
 
-cbuffer ObjectBuffer : register(b1) {
-    SDFObject Objects[MAX_OBJECTS];
-    int ObjectCount;
-    float3 ObjPadding;
+// BVH   (  CPU).      :      .
+//    ()    Objects   .
+struct BVHNode {
+    float4 MinAndIndex; // xyz = min, w = :   , :  
+    float4 MaxAndCount; // xyz = max, w =     (0 -  )
 };
 
-Texture2D TexHistory : register(t0);
+//  BVH    (SceneBVH),   
+static const int BVH_STACK_SIZE = 32;
+
+StructuredBuffer<BVHNode> Nodes : register(t1);
+
+cbuffer SceneCounts : register(b1) {
+    int ObjectCount;
+    int NodeCount;
+    int UnboundedCount;
+    int CountsPadding;
+};
 
 static const int MAX_MARCH_STEPS = 256;
 static const float MAX_DIST = 512.0;
@@ -70,25 +82,69 @@ float SdBox(float3 p, float3 b) {
 }
 float SdPlane(float3 p) { return dot(p, float3(0, 1, 0)); }
 
+void EvalObject(int i, float3 p, inout float minDist, inout float hitIndex) {
+    SDFObject o = Objects[i];
+    float3 pos = o.PositionAndType.xyz;
+    float3 size = o.SizeAndRough.xyz;
+    float3 rot = o.RotationAndMetal.xyz;
+    int type = (int)o.PositionAndType.w;
+
+    float3 lp = p - pos;
+    if (dot(rot, rot) > 1e-4) lp = RotatePoint(lp, -rot);
+
+    float d = MAX_DIST;
+    if (type == 0) d = SdSphere(lp, size.x);
+    else if (type == 1) d = SdBox(lp, size);
+    else if (type == 2) d = SdPlane(lp);
+
+    if (d < minDist) { minDist = d; hitIndex = (float)i; }
+}
+
+//   AABB -       
+float BoxDistance(float3 p, BVHNode node) {
+    float3 q = max(max(node.MinAndIndex.xyz - p, p - node.MaxAndCount.xyz), 0.0);
+    return length(q);
+}
+
 float2 Map(float3 p) {
     float minDist = MAX_DIST;
     float hitIndex = -1.0;
-    for (int i = 0; i < ObjectCount; ++i) {
-        SDFObject o = Objects[i];
-        float3 pos = o.PositionAndType.xyz;
-        float3 size = o.SizeAndRough.xyz;
-        float3 rot = o.RotationAndMetal.xyz;
-        int type = (int)o.PositionAndType.w;
-
-        float3 lp = p - pos;
-        if (dot(rot, rot) > 1e-4) lp = RotatePoint(lp, -rot);
-
-        float d = MAX_DIST;
-        if (type == 0) d = SdSphere(lp, size.x);
-        else if (type == 1) d = SdBox(lp, size);
-        else if (type == 2) d = SdPlane(lp);
-
-        if (d < minDist) { minDist = d; hitIndex = (float)i; }
+
+    for (int u = 0; u < UnboundedCount; ++u) EvalObject(u, p, minDist, hitIndex);
+    if (NodeCount == 0) return float2(minDist, hitIndex);
+
+    // ,     , .
+    //    (   0)  ,    .
+    int stack[BVH_STACK_SIZE];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    [loop]
+    while (sp > 0) {
+        int n = stack[--sp];
+        BVHNode node = Nodes[n];
+
+        float nodeDist = BoxDistance(p, node);
+        if (nodeDist > 0.0 && nodeDist >= minDist) continue;
+
+        int count = (int)node.MaxAndCount.w;
+        if (count > 0) {
+            int first = (int)node.MinAndIndex.w;
+            for (int k = 0; k < count; ++k) EvalObject(first + k, p, minDist, hitIndex);
+        }
+        else {
+            //     -       
+            int left = n + 1;
+            int right = (int)node.MinAndIndex.w;
+            float dl = BoxDistance(p, Nodes[left]);
+            float dr = BoxDistance(p, Nodes[right]);
+            int nearChild = dl <= dr ? left : right;
+            int farChild = dl <= dr ? right : left;
+            float nearDist = min(dl, dr), farDist = max(dl, dr);
+
+            if (sp < BVH_STACK_SIZE && (farDist < minDist || farDist == 0.0)) stack[sp++] = farChild;
+            if (sp < BVH_STACK_SIZE && (nearDist < minDist || nearDist == 0.0)) stack[sp++] = nearChild;
+        }
     }
     return float2(minDist, hitIndex);
 }
@@ -190,8 +246,10 @@ struct VS_OUTPUT {
     float4 Pos : SV_POSITION;
     float2 UV  : TEXCOORD0;
 };
+//      -       
 struct PS_OUTPUT {
-    float4 Color : SV_Target0;
+    float4 Color : SV_Target0;   // rgb =  , a = 1 ( )
+    float4 Moments : SV_Target1; // r =   (  )
 };
 
 VS_OUTPUT VS_Quad(float3 Pos : POSITION, float2 UV : TEXCOORD0) {
@@ -233,21 +291,11 @@ PS_OUTPUT PS_PathTrace(VS_OUTPUT input) {
     }
     newColor /= float(SAMPLES);
 
-    // 2.   
-    // Load       1  1,  Sample
-    float3 prevColor = TexHistory.Load(int3(input.Pos.xy, 0)).rgb;
-
-    // 3.  (Moving Average)
-    float currentFrame = Params.z; //   C++, 0   
-
-    // : NewAverage = Lerp(OldAverage, NewSample, 1.0 / (N + 1))
-    //   0,   1.0 (   ,   )
-    float weight = 1.0 / (currentFrame + 1.0);
-
-    //   NaN ( frameIndex  C++ )
-    if (currentFrame < 0.5) weight = 1.0;
-
-    output.Color = float4(lerp(prevColor, newColor, weight), 1.0);
+    // :       ,    .
+    //        (TileError.hlsl)
+    float luma = dot(newColor, float3(0.2126, 0.7152, 0.0722));
+    output.Color = float4(newColor, 1.0);
+    output.Moments = float4(luma * luma, 0, 0, 0);
 
     return output;
 }
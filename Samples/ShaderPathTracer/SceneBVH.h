@@ -0,0 +1,176 @@
+#pragma once
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cfloat>
+#include <MathAPI/MathAPI.h>
+
+// Binned SAH bounding volume hierarchy over the bounds of SDF objects.
+// Nodes are stored depth-first: the left child of an inner node is the next node, the node keeps the index of its
+// right child. Leaves reference a contiguous range of objects, so the object array is reordered to BVH order.
+namespace SceneBVH {
+
+    struct AABB {
+        Math::float3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+        Math::float3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        void Grow(const AABB& b) { Min = Math::min(Min, b.Min); Max = Math::max(Max, b.Max); }
+        void Grow(const Math::float3& p) { Min = Math::min(Min, p); Max = Math::max(Max, p); }
+        bool IsEmpty() const { return Min.x > Max.x; }
+        Math::float3 Center() const { return (Min + Max) * 0.5f; }
+        float Area() const {
+            if (IsEmpty()) return 0.0f;
+            Math::float3 e = Max - Min;
+            return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+    };
+
+    struct Node {
+        AABB Bounds;
+        int RightOrFirst = 0; // inner: index of the right child, leaf: first object
+        int Count = 0;        // 0 - inner node
+    };
+
+    struct BuildStats {
+        int Nodes = 0;
+        int Leaves = 0;
+        int MaxDepth = 0;
+        float SAHCost = 0.0f; // expected cost of a query relative to a single object test (lower is better)
+        double Milliseconds = 0.0;
+    };
+
+    // Relative costs used by the SAH: one node box test vs one object evaluation
+    const float kTraversalCost = 1.0f;
+    const float kObjectCost = 1.0f;
+    const int kBinCount = 12;
+    // Traversal in the shader uses a fixed-size stack
+    const int kMaxDepth = 30;
+
+    namespace Detail {
+        struct Builder {
+            const std::vector<AABB>& Bounds;
+            std::vector<Math::float3> Centers;
+            std::vector<int>& Order;
+            std::vector<Node>& Nodes;
+            int MaxLeafSize;
+            int MaxDepth = 0;
+
+            int Build(int first, int count, int depth) {
+                int index = (int)Nodes.size();
+                Nodes.push_back(Node());
+                MaxDepth = std::max(MaxDepth, depth);
+
+                AABB bounds, centroidBounds;
+                for (int i = first; i < first + count; ++i) {
+                    bounds.Grow(Bounds[Order[i]]);
+                    centroidBounds.Grow(Centers[Order[i]]);
+                }
+                Nodes[index].Bounds = bounds;
+
+                int bestAxis = -1;
+                int bestSplit = 0;
+                float bestCost = FLT_MAX;
+                const float leafCost = kObjectCost * count;
+
+                if (count > 1 && depth < kMaxDepth) {
+                    for (int axis = 0; axis < 3; ++axis) {
+                        float cmin = centroidBounds.Min[axis], cmax = centroidBounds.Max[axis];
+                        if (cmax - cmin < 1e-6f) continue;
+
+                        AABB bins[kBinCount];
+                        int counts[kBinCount] = {};
+                        const float scale = kBinCount / (cmax - cmin);
+                        for (int i = first; i < first + count; ++i) {
+                            int b = std::min(kBinCount - 1, (int)((Centers[Order[i]][axis] - cmin) * scale));
+                            bins[b].Grow(Bounds[Order[i]]);
+                            counts[b]++;
+                        }
+
+                        // Areas and counts to the left of each split plane, then sweep from the right
+                        float leftArea[kBinCount - 1];
+                        int leftCount[kBinCount - 1];
+                        AABB acc;
+                        int n = 0;
+                        for (int b = 0; b < kBinCount - 1; ++b) {
+                            acc.Grow(bins[b]); n += counts[b];
+                            leftArea[b] = acc.Area(); leftCount[b] = n;
+                        }
+                        acc = AABB(); n = 0;
+                        for (int b = kBinCount - 1; b > 0; --b) {
+                            acc.Grow(bins[b]); n += counts[b];
+                            if (leftCount[b - 1] == 0 || n == 0) continue;
+                            float cost = kTraversalCost +
+                                kObjectCost * (leftArea[b - 1] * leftCount[b - 1] + acc.Area() * n) / std::max(bounds.Area(), 1e-12f);
+                            if (cost < bestCost) {
+                                bestCost = cost;
+                                bestAxis = axis;
+                                bestSplit = b;
+                            }
+                        }
+                    }
+                }
+
+                // Leaf when splitting does not pay off (or nothing can be split)
+                if (bestAxis < 0 || (count <= MaxLeafSize && bestCost >= leafCost)) {
+                    Nodes[index].RightOrFirst = first;
+                    Nodes[index].Count = count;
+                    return index;
+                }
+
+                const float cmin = centroidBounds.Min[bestAxis];
+                const float scale = kBinCount / (centroidBounds.Max[bestAxis] - cmin);
+                auto middle = std::partition(Order.begin() + first, Order.begin() + first + count, [&](int o) {
+                    return std::min(kBinCount - 1, (int)((Centers[o][bestAxis] - cmin) * scale)) < bestSplit;
+                });
+                int leftCount = (int)(middle - (Order.begin() + first));
+
+                Build(first, leftCount, depth + 1);
+                int right = Build(first + leftCount, count - leftCount, depth + 1);
+                Nodes[index].RightOrFirst = right;
+                Nodes[index].Count = 0;
+                return index;
+            }
+        };
+    }
+
+    // order receives the object index for every leaf slot (leaves address order[first .. first + count))
+    inline void Build(const std::vector<AABB>& bounds, std::vector<Node>& outNodes, std::vector<int>& order,
+                      BuildStats* stats = nullptr, int maxLeafSize = 2) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        outNodes.clear();
+        order.resize(bounds.size());
+        for (size_t i = 0; i < bounds.size(); ++i) order[i] = (int)i;
+        if (bounds.empty()) {
+            if (stats) *stats = BuildStats();
+            return;
+        }
+        outNodes.reserve(bounds.size() * 2);
+
+        Detail::Builder builder{ bounds, {}, order, outNodes, std::max(maxLeafSize, 1) };
+        builder.Centers.resize(bounds.size());
+        for (size_t i = 0; i < bounds.size(); ++i) builder.Centers[i] = bounds[i].Center();
+        builder.Build(0, (int)bounds.size(), 0);
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+
+        if (stats) {
+            stats->Nodes = (int)outNodes.size();
+            stats->Leaves = 0;
+            stats->MaxDepth = builder.MaxDepth;
+            stats->SAHCost = 0.0f;
+            const float rootArea = std::max(outNodes[0].Bounds.Area(), 1e-12f);
+            for (const Node& n : outNodes) {
+                float p = n.Bounds.Area() / rootArea;
+                if (n.Count > 0) {
+                    stats->Leaves++;
+                    stats->SAHCost += p * kObjectCost * n.Count;
+                }
+                else {
+                    stats->SAHCost += p * kTraversalCost;
+                }
+            }
+            stats->Milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+        }
+    }
+}
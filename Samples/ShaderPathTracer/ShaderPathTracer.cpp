@@ -13,6 +13,12 @@
 #include <Imgui/backends/imgui_impl_win32.h>
 
 #include <Rendeructor.h>
+#include <random>
+#include <chrono>
+
+#include "SceneBVH.h"
+#include "DemoScene.h"
+#include "AdaptiveSampler.h"
 
 #pragma comment(lib, "winmm.lib")  
 #pragma comment(lib, "Rendeructor.lib") 
@@ -24,12 +30,9 @@ extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg
 
 using namespace Math;
 
-const int MAX_OBJECTS = 128;
 const int TILE_SIZE = 64;
 const int SSAA_FACTOR = 1;
 
-enum class PrimitiveType { Sphere = 0, Box = 1, Plane = 2 };
-
 // =========================================================
 // GPU STRUCTS
 // =========================================================
@@ -38,6 +41,13 @@ struct PostProcessData {
     Math::float3 Padding;
 };
 
+struct TileErrorCB {
+    float TileSize;
+    float ImageWidth;
+    float ImageHeight;
+    float Padding;
+};
+
 struct HighlightCB {
     float TileIndex;
     float TilesStride;
@@ -52,10 +62,17 @@ struct SDFObjectGPU {
     Math::float4 ColorAndEmit;
 };
 
-struct SceneObjectsBuffer {
-    SDFObjectGPU Objects[MAX_OBJECTS];
-    int          ObjectCount;
-    Math::float3 Padding;
+struct BVHNodeGPU {
+    Math::float4 MinAndIndex; // w = right child (inner) / first object (leaf)
+    Math::float4 MaxAndCount; // w = object count, 0 for inner nodes
+};
+
+// Объекты и узлы лежат в StructuredBuffer, в константах только их число
+struct SceneCountsCB {
+    int ObjectCount;
+    int NodeCount;
+    int UnboundedCount;
+    int Padding;
 };
 
 struct PTSceneData {
@@ -64,7 +81,7 @@ struct PTSceneData {
     Math::float4 CameraRight;
     Math::float4 CameraUp;
     Math::float4 Resolution;
-    Math::float4 Params; // x=Seed, z=FrameIdx
+    Math::float4 Params; // x=Seed
 };
 
 // =========================================================
@@ -115,23 +132,81 @@ private:
 class Scene {
 public:
     GeometryPrimitive* CreatePrimitive(PrimitiveType type) {
-        if (m_primitives.size() >= MAX_OBJECTS) return nullptr;
         int newID = (int)m_primitives.size();
         auto newPrim = std::make_unique<GeometryPrimitive>(newID, type);
         GeometryPrimitive* ptr = newPrim.get();
         m_primitives.push_back(std::move(newPrim));
         return ptr;
     }
-    SceneObjectsBuffer GenerateGPUBuffer() const {
-        SceneObjectsBuffer buffer;
-        buffer.ObjectCount = (int)m_primitives.size();
-        for (int i = 0; i < buffer.ObjectCount; i++) buffer.Objects[i] = m_primitives[i]->GetGPUData();
+    std::vector<SDFObjectGPU> GenerateGPUBuffer() const {
+        std::vector<SDFObjectGPU> buffer(m_primitives.size());
+        for (size_t i = 0; i < m_primitives.size(); i++) buffer[i] = m_primitives[i]->GetGPUData();
         return buffer;
     }
+    int GetPrimitiveCount() const { return (int)m_primitives.size(); }
 private:
     std::vector<std::unique_ptr<GeometryPrimitive>> m_primitives;
 };
 
+// =========================================================
+// BVH
+// =========================================================
+// Границы SDF объекта в мировом пространстве. false - объект бесконечный (плоскость)
+bool GetObjectBounds(const SDFObjectGPU& o, SceneBVH::AABB& out) {
+    PrimitiveType type = (PrimitiveType)(int)o.PositionAndType.w;
+    float3 pos = o.PositionAndType.xyz();
+    float3 size = o.SizeAndRough.xyz();
+
+    float3 extent;
+    if (type == PrimitiveType::Sphere) {
+        extent = float3(size.x, size.x, size.x);
+    }
+    else if (type == PrimitiveType::Box) {
+        // Повернутый бокс накрываем описанной сферой
+        float3 rot = o.RotationAndMetal.xyz();
+        if (rot.dot(rot) > 1e-4f) { float r = size.length(); extent = float3(r, r, r); }
+        else extent = size;
+    }
+    else {
+        return false;
+    }
+
+    out.Min = pos - extent;
+    out.Max = pos + extent;
+    return true;
+}
+
+// Переставляет объекты в порядок BVH (бесконечные - в начало) и заполняет буфер узлов для шейдера
+void BuildSceneBVH(std::vector<SDFObjectGPU>& objects, std::vector<BVHNodeGPU>& outNodes, SceneCountsCB& counts, SceneBVH::BuildStats* stats) {
+    std::vector<SDFObjectGPU> unbounded, bounded;
+    std::vector<SceneBVH::AABB> bounds;
+    for (const auto& o : objects) {
+        SceneBVH::AABB b;
+        if (GetObjectBounds(o, b)) { bounded.push_back(o); bounds.push_back(b); }
+        else unbounded.push_back(o);
+    }
+
+    std::vector<SceneBVH::Node> nodes;
+    std::vector<int> order;
+    SceneBVH::Build(bounds, nodes, order, stats);
+
+    int count = 0;
+    for (const auto& o : unbounded) objects[count++] = o;
+    for (int index : order) objects[count++] = bounded[index];
+
+    const int base = (int)unbounded.size();
+    counts.ObjectCount = count;
+    counts.NodeCount = (int)nodes.size();
+    counts.UnboundedCount = base;
+    outNodes.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const SceneBVH::Node& n = nodes[i];
+        float index = (float)(n.Count > 0 ? n.RightOrFirst + base : n.RightOrFirst);
+        outNodes[i].MinAndIndex = float4(n.Bounds.Min.x, n.Bounds.Min.y, n.Bounds.Min.z, index);
+        outNodes[i].MaxAndCount = float4(n.Bounds.Max.x, n.Bounds.Max.y, n.Bounds.Max.z, (float)n.Count);
+    }
+}
+
 // =========================================================
 // APPLICATION CLASS
 // =========================================================
@@ -151,6 +226,9 @@ public:
         ImGui_ImplDX11_Shutdown();
         ImGui_ImplWin32_Shutdown();
         ImGui::DestroyContext();
+        m_batchTimer.Release();
+        m_objectBuffer.Release();
+        m_nodeBuffer.Release();
         m_renderer.Destroy();
     }
 
@@ -187,21 +265,34 @@ private:
 
     // --- Resources ---
     Sampler m_linearSampler;
-    Texture m_rtHistory[2];
-    ShaderPass m_ptPass, m_displayPass, m_highlightPass;
+    Texture m_rtAccum;      // сумма проходов (rgb) и их число (a)
+    Texture m_rtMoments;    // сумма квадратов яркости проходов
+    Texture m_rtTileError;  // пиксель на тайл, размер зависит от размера тайла
+    ShaderPass m_ptPass, m_displayPass, m_highlightPass, m_tileErrorPass;
     PipelineState m_stateTileRender, m_stateFullScreen, m_stateUI;
 
     // --- Scene ---
     Scene m_scene;
-    SceneObjectsBuffer m_gpuBuffer;
+    std::vector<SDFObjectGPU> m_gpuObjects;
+    std::vector<BVHNodeGPU> m_bvhNodes;
+    SceneCountsCB m_sceneCounts = {};
+    StructuredBuffer m_objectBuffer; // загружается один раз при смене сцены, не на каждый тайл
+    StructuredBuffer m_nodeBuffer;
+    SceneBVH::BuildStats m_bvhStats;
+    std::vector<std::pair<int, SceneBVH::BuildStats>> m_bvhBenchmark;
 
     // --- State & Config ---
     AppState m_state = AppState::Config;
 
     // Параметры рендера (изменяемые из GUI)
     int m_tileSize = 64;           // Размер плитки
-    int m_tilesPerFrame = 8;       // Скорость (сколько плиток за кадр UI)
-    int m_maxIterations = 1000;    // Лимит итераций (сэмплов)
+    int m_tilesPerFrame = 8;       // Скорость (сколько плиток за кадр UI), если бюджет кадра выключен
+    bool m_frameBudget = true;     // Число плиток за кадр подбирается под бюджет времени
+    float m_frameBudgetMs = 12.0f;
+    bool m_autoTileSize = false;   // Размер плитки по модели стоимости (при старте рендера)
+    int m_maxIterations = 1000;    // Лимит проходов на тайл
+    bool m_adaptive = true;        // Больше проходов шумным тайлам, сошедшиеся тайлы выключаются
+    float m_errorThreshold = 0.02f;
 
     // Логика
     bool m_isPaused = false;
@@ -209,14 +300,32 @@ private:
     float m_currentExposure = 1.0f;
 
     // Внутренние счетчики
-    int m_currentTileIndex = 0;
-    int m_frameIndex = 0;       // Текущий sample count
-    int m_activeBuffer = 0;     // Куда пишем (0 или 1)
-    int m_displayBuffer = 0;    // Что показываем (0 или 1)
+    AdaptiveSampling::Scheduler m_sampler;
+    std::vector<int> m_roundQueue;  // Тайлы текущего раунда в порядке отрисовки
+    int m_roundPos = 0;
+    int m_currentTileIndex = -1;
+    int m_tilesX = 0, m_tilesY = 0;
+    std::vector<float> m_tileErrors;
+
+    // Бюджет кадра: модель стоимости плиток и ее замеры (GPU timestamps или время кадра)
+    TileBudgetController m_budget;
+    TileBatchTimer m_batchTimer;
+    int m_lastBatchTiles = 0;
+
+    // Время до целевого качества (все тайлы ниже порога ошибки)
+    struct QualityResult {
+        bool Adaptive;
+        bool Converged;
+        double Seconds;
+        long long TilePasses;
+    };
+    std::chrono::high_resolution_clock::time_point m_renderStart;
+    std::vector<QualityResult> m_qualityResults;
+    std::vector<bool> m_benchmarkQueue; // режимы, которые осталось прогнать (true - адаптивный)
 
     // Камера
-    Math::float3 m_camPos = { 9.0f, 15.0f, -6.0f };
-    Math::float3 m_camTarget = { 9.0f, 0.0f, 9.0f };
+    Math::float3 m_camPos = { DemoCameraPos[0], DemoCameraPos[1], DemoCameraPos[2] };
+    Math::float3 m_camTarget = { DemoCameraTarget[0], DemoCameraTarget[1], DemoCameraTarget[2] };
 
 private:
     bool InitWindow(HINSTANCE hInstance) {
@@ -273,20 +382,21 @@ private:
     }
 
     void SetupResources() {
-        m_rtHistory[0].Create(m_renderW, m_renderH, TextureFormat::RGBA32F);
-        m_rtHistory[1].Create(m_renderW, m_renderH, TextureFormat::RGBA32F);
-        m_renderer.Clear(m_rtHistory[0], 0, 0, 0, 0);
-        m_renderer.Clear(m_rtHistory[1], 0, 0, 0, 0);
+        m_rtAccum.Create(m_renderW, m_renderH, TextureFormat::RGBA32F);
+        m_rtMoments.Create(m_renderW, m_renderH, TextureFormat::R32F);
+        m_renderer.Clear(m_rtAccum, m_rtMoments, 0, 0, 0, 0);
 
         m_linearSampler.Create("Linear");
+        m_batchTimer.Create();
 
         m_stateTileRender.ScissorTest = true;
-        m_stateTileRender.Blend = BlendMode::Opaque;
+        m_stateTileRender.Blend = BlendMode::Additive; // проходы накапливаются в m_rtAccum / m_rtMoments
         m_stateTileRender.DepthWrite = false;
         m_stateTileRender.DepthFunc = CompareFunc::Always;
 
         m_stateFullScreen = m_stateTileRender;
         m_stateFullScreen.ScissorTest = false;
+        m_stateFullScreen.Blend = BlendMode::Opaque;
 
         m_stateUI = m_stateTileRender;
         m_stateUI.ScissorTest = false;
@@ -294,6 +404,8 @@ private:
 
         m_ptPass.VertexShaderPath = "PathTracer.hlsl";      m_ptPass.VertexShaderEntryPoint = "VS_Quad";
         m_ptPass.PixelShaderPath = "PathTracer.hlsl";       m_ptPass.PixelShaderEntryPoint = "PS_PathTrace";
+        m_ptPass.AddBuffer("Objects", m_objectBuffer);
+        m_ptPass.AddBuffer("Nodes", m_nodeBuffer);
         m_renderer.CompilePass(m_ptPass);
 
         m_displayPass.VertexShaderPath = "FinalOutput.hlsl"; m_displayPass.VertexShaderEntryPoint = "VS_Quad";
@@ -304,35 +416,118 @@ private:
         m_highlightPass.VertexShaderPath = "highlight.hlsl"; m_highlightPass.VertexShaderEntryPoint = "VS_Main";
         m_highlightPass.PixelShaderPath = "highlight.hlsl";  m_highlightPass.PixelShaderEntryPoint = "PS_Main";
         m_renderer.CompilePass(m_highlightPass);
+
+        m_tileErrorPass.VertexShaderPath = "TileError.hlsl"; m_tileErrorPass.VertexShaderEntryPoint = "VS_Quad";
+        m_tileErrorPass.PixelShaderPath = "TileError.hlsl";  m_tileErrorPass.PixelShaderEntryPoint = "PS_TileError";
+        m_renderer.CompilePass(m_tileErrorPass);
     }
 
     void SetupScene() {
-        auto floor = m_scene.CreatePrimitive(PrimitiveType::Plane);
-        floor->SetPosition(0, 0, 0); floor->SetColor(0.05f, 0.05f, 0.05f); floor->SetRoughness(1.0f);
+        BuildDemoScene(m_scene);
+        UploadScene();
+    }
+
+    // Пересобирает BVH и заново заливает буферы сцены. Размер не ограничен - буферы пересоздаются под сцену
+    void UploadScene() {
+        m_gpuObjects = m_scene.GenerateGPUBuffer();
+        BuildSceneBVH(m_gpuObjects, m_bvhNodes, m_sceneCounts, &m_bvhStats);
 
-        auto light = m_scene.CreatePrimitive(PrimitiveType::Box);
-        light->SetPosition(8.0f, 10.0f, 8.0f); light->SetScale(3.0f, 0.1f, 3.0f);
-        light->SetColor(1.0f, 0.9f, 0.8f); light->SetEmission(5.0f);
+        m_objectBuffer.Create(std::span<const SDFObjectGPU>(m_gpuObjects));
+        m_nodeBuffer.Create(std::span<const BVHNodeGPU>(m_bvhNodes));
+    }
+
+    // Нагрузочная проверка: случайные сферы над полом
+    void AddRandomSpheres(int count) {
+        std::mt19937 rng((unsigned int)m_scene.GetPrimitiveCount());
+        std::uniform_real_distribution<float> pos(-40.0f, 60.0f), height(0.2f, 6.0f), radius(0.1f, 0.4f), unit(0.0f, 1.0f);
 
-        int rows = 8, cols = 8; float sp = 2.5f;
-        for (int z = 0; z < rows; z++) for (int x = 0; x < cols; x++) {
+        for (int i = 0; i < count; ++i) {
             auto s = m_scene.CreatePrimitive(PrimitiveType::Sphere);
-            s->SetPosition(x * sp, 1.0f, z * sp); s->SetScale(0.9f);
-            s->SetRoughness(std::max((float)x / (cols - 1), 0.04f)); s->SetMetalness((float)z / (rows - 1));
-            s->SetColor(0.9f, 0.1f, 0.1f);
+            float r = radius(rng);
+            s->SetPosition(pos(rng), height(rng), pos(rng)); s->SetScale(r);
+            s->SetColor(unit(rng), unit(rng), unit(rng)); s->SetRoughness(unit(rng)); s->SetMetalness(unit(rng) > 0.7f ? 1.0f : 0.0f);
+        }
+        UploadScene();
+    }
+
+    // Скорость построения и качество (SAH стоимость) на случайных наборах сфер разного размера
+    void RunBVHBenchmark() {
+        m_bvhBenchmark.clear();
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> pos(0.0f, 100.0f), radius(0.2f, 1.5f);
+
+        for (int count : { 128, 1000, 10000, 100000 }) {
+            std::vector<SceneBVH::AABB> bounds(count);
+            for (auto& b : bounds) {
+                float3 c(pos(rng), pos(rng) * 0.2f, pos(rng));
+                float r = radius(rng);
+                b.Min = c - float3(r, r, r);
+                b.Max = c + float3(r, r, r);
+            }
+            std::vector<SceneBVH::Node> nodes;
+            std::vector<int> order;
+            SceneBVH::BuildStats stats;
+            SceneBVH::Build(bounds, nodes, order, &stats);
+            m_bvhBenchmark.push_back({ count, stats });
         }
-        m_gpuBuffer = m_scene.GenerateGPUBuffer();
     }
 
     void ResetSimulation() {
-        m_currentTileIndex = 0;
-        m_frameIndex = 0;
+        m_currentTileIndex = -1;
         m_globalSeedTime = 1.0f;
-        m_activeBuffer = 0;
-        m_displayBuffer = 0;
-        // Чистим историю, чтобы начать с нуля
-        m_renderer.Clear(m_rtHistory[0], 0, 0, 0, 0);
-        m_renderer.Clear(m_rtHistory[1], 0, 0, 0, 0);
+        m_roundQueue.clear();
+        m_roundPos = 0;
+
+        m_tilesX = (m_renderW + m_tileSize - 1) / m_tileSize;
+        m_tilesY = (m_renderH + m_tileSize - 1) / m_tileSize;
+        if (m_rtTileError.GetWidth() != m_tilesX || m_rtTileError.GetHeight() != m_tilesY) {
+            m_rtTileError.Create(m_tilesX, m_tilesY, TextureFormat::R32F);
+        }
+        m_tileErrors.resize(m_tilesX * m_tilesY);
+
+        AdaptiveSampling::Settings settings;
+        settings.ErrorThreshold = m_errorThreshold;
+        settings.MaxPasses = m_maxIterations;
+        settings.Adaptive = m_adaptive;
+        m_sampler.Reset(m_tilesX * m_tilesY, settings);
+        m_renderStart = std::chrono::high_resolution_clock::now();
+
+        // Чистим накопление, чтобы начать с нуля
+        m_renderer.Clear(m_rtAccum, m_rtMoments, 0, 0, 0, 0);
+    }
+
+    void UpdateBudgetSettings() {
+        TileBudgetSettings settings;
+        settings.TargetMilliseconds = m_frameBudgetMs;
+        settings.MaxTilesPerFrame = 256;
+        settings.AdaptTileSize = false; // сетка плиток фиксирована на время рендера (ошибка и проходы хранятся по плиткам)
+        m_budget.SetSettings(settings);
+    }
+
+    void StartRendering(bool adaptive) {
+        UpdateBudgetSettings();
+        if (m_autoTileSize) m_tileSize = m_budget.RecommendTileSize();
+        m_budget.SetTileSize(m_tileSize);
+
+        m_adaptive = adaptive;
+        m_state = AppState::Rendering;
+        m_isPaused = false;
+        ResetSimulation();
+    }
+
+    // Рендер закончен: все тайлы сошлись или уперлись в лимит проходов
+    void OnRenderFinished() {
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_renderStart).count();
+        const AdaptiveSampling::Stats& stats = m_sampler.GetStats();
+        m_qualityResults.push_back({ m_adaptive, stats.MaxError <= m_errorThreshold, seconds, stats.TotalPasses });
+
+        if (!m_benchmarkQueue.empty()) {
+            bool next = m_benchmarkQueue.front();
+            m_benchmarkQueue.erase(m_benchmarkQueue.begin());
+            StartRendering(next);
+            return;
+        }
+        StopRendering();
     }
 
     void OnResize(int w, int h) {
@@ -364,7 +559,7 @@ private:
     void DrawConfigUI() {
         // Окно настроек всегда по центру
         ImGui::SetNextWindowPos(ImVec2(m_windowW * 0.5f, m_windowH * 0.5f), ImGuiCond_Once, ImVec2(0.5f, 0.5f));
-        ImGui::SetNextWindowSize(ImVec2(400, 300));
+        ImGui::SetNextWindowSize(ImVec2(400, 620));
 
         ImGui::Begin("Render Settings", nullptr, ImGuiWindowFlags_NoResize);
 
@@ -375,7 +570,11 @@ private:
         ImGui::Text("Resolution: %dx%d", m_renderW, m_renderH);
 
         // Target Iterations
-        ImGui::DragInt("Target Samples", &m_maxIterations, 1, 1, 100000);
+        ImGui::DragInt("Max Passes / Tile", &m_maxIterations, 1, 1, 100000);
+
+        // Adaptive sampling
+        ImGui::Checkbox("Adaptive Sampling", &m_adaptive);
+        ImGui::SliderFloat("Error Threshold", &m_errorThreshold, 0.002f, 0.2f, "%.3f", ImGuiSliderFlags_Logarithmic);
 
         // Tile Size (16, 32, 64...)
         if (ImGui::BeginCombo("Tile Size", std::to_string(m_tileSize).c_str())) {
@@ -388,21 +587,55 @@ private:
             ImGui::EndCombo();
         }
 
+        ImGui::Checkbox("Auto Tile Size", &m_autoTileSize);
+
         // Speed settings
-        ImGui::SliderInt("Batch Size", &m_tilesPerFrame, 1, 64, "%d tiles/frame");
+        if (ImGui::Checkbox("Frame Budget", &m_frameBudget)) UpdateBudgetSettings();
+        if (m_frameBudget) {
+            if (ImGui::SliderFloat("Budget", &m_frameBudgetMs, 2.0f, 50.0f, "%.1f ms/frame")) UpdateBudgetSettings();
+            if (m_budget.GetMeasurementCount() > 0) {
+                ImGui::Text("Tile cost: %.2f ms + %.2f ms/Mpx (%s)", m_budget.GetOverheadMilliseconds(),
+                    m_budget.GetMillisecondsPerMegapixel(), m_batchTimer.UsesGPU() ? "GPU" : "CPU");
+            }
+        }
+        else {
+            ImGui::SliderInt("Batch Size", &m_tilesPerFrame, 1, 64, "%d tiles/frame");
+        }
 
         // Post Process (можно менять и в превью)
         ImGui::SliderFloat("Exposure", &m_currentExposure, 0.0f, 10.0f);
 
         ImGui::Spacing(); ImGui::Separator(); ImGui::Spacing();
 
+        ImGui::Text("BVH: %d objects, %d nodes, depth %d, SAH %.2f, %.3f ms",
+            m_sceneCounts.ObjectCount - m_sceneCounts.UnboundedCount, m_bvhStats.Nodes, m_bvhStats.MaxDepth, m_bvhStats.SAHCost, m_bvhStats.Milliseconds);
+        if (ImGui::Button("Benchmark BVH build")) RunBVHBenchmark();
+        ImGui::SameLine();
+        if (ImGui::Button("+10000 spheres")) AddRandomSpheres(10000);
+        for (const auto& entry : m_bvhBenchmark) {
+            ImGui::Text("%6d objects: %7.2f ms, SAH %.1f, depth %d", entry.first, entry.second.Milliseconds, entry.second.SAHCost, entry.second.MaxDepth);
+        }
+
+        ImGui::Spacing(); ImGui::Separator(); ImGui::Spacing();
+
+        // Время до целевого качества: одна и та же сцена равномерно и адаптивно
+        if (ImGui::Button("Benchmark time-to-quality")) {
+            m_benchmarkQueue = { true };
+            StartRendering(false);
+        }
+        for (const auto& r : m_qualityResults) {
+            ImGui::Text("%-8s %7.2f s, %lld tile passes%s", r.Adaptive ? "Adaptive" : "Uniform", r.Seconds, r.TilePasses,
+                r.Converged ? "" : " (pass limit)");
+        }
+
+        ImGui::Spacing(); ImGui::Separator(); ImGui::Spacing();
+
         // Кнопка Старта
         // Центрируем кнопку
         float availW = ImGui::GetContentRegionAvail().x;
         ImGui::SetCursorPosX(ImGui::GetCursorPosX() + (availW - 120) * 0.5f);
         if (ImGui::Button("START RENDER", ImVec2(120, 40))) {
-            m_state = AppState::Rendering;
-            ResetSimulation();
+            StartRendering(m_adaptive);
         }
 
         ImGui::End();
@@ -410,17 +643,25 @@ private:
 
     void DrawStatusUI() {
         ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
-        ImGui::SetNextWindowSize(ImVec2(300, 160));
+        ImGui::SetNextWindowSize(ImVec2(300, 220));
 
         // Флаг NoTitleBar убрали, чтобы окно можно было таскать, но можно вернуть
         ImGui::Begin("Rendering Progress", nullptr, ImGuiWindowFlags_NoResize);
 
         // Инфо
-        ImGui::Text("Progress: %d / %d samples", m_frameIndex, m_maxIterations);
-        float progress = (float)m_frameIndex / (float)m_maxIterations;
+        const AdaptiveSampling::Stats& stats = m_sampler.GetStats();
+        int totalTiles = m_tilesX * m_tilesY;
+        ImGui::Text("%s: %d / %d tiles active", m_adaptive ? "Adaptive" : "Uniform", stats.ActiveTiles, totalTiles);
+        float progress = 1.0f - (float)stats.ActiveTiles / (float)std::max(totalTiles, 1);
         ImGui::ProgressBar(progress, ImVec2(-1.0f, 0.0f));
 
+        if (stats.MaxError < FLT_MAX) ImGui::Text("Max tile error: %.4f / %.4f", stats.MaxError, m_errorThreshold);
+        else ImGui::Text("Max tile error: -");
+        ImGui::Text("Round %d, %lld tile passes, %.1f s", stats.Rounds, stats.TotalPasses,
+            std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_renderStart).count());
         ImGui::Text("Tile Index: %d", m_currentTileIndex);
+        ImGui::Text("Batch: %d x %dpx, %.2f ms (%s)", m_lastBatchTiles, m_tileSize, m_batchTimer.GetLastMilliseconds(),
+            m_batchTimer.UsesGPU() ? "GPU" : "CPU");
 
         // Пост-процесс на лету
         ImGui::SliderFloat("Exposure", &m_currentExposure, 0.0f, 10.0f);
@@ -435,6 +676,7 @@ private:
         ImGui::SameLine();
 
         if (ImGui::Button("STOP", ImVec2(80, 0))) {
+            m_benchmarkQueue.clear();
             StopRendering();
         }
 
@@ -454,19 +696,17 @@ private:
         }
         else if (m_state == AppState::Rendering) {
             DrawStatusUI();
-
-            // Если достигли лимита
-            if (m_frameIndex >= m_maxIterations) {
-                StopRendering();
-            }
         }
 
         // === ГРАФИЧЕСКИЙ ПАЙПЛАЙН ===
 
         // 1. Ray Tracing Pass (Только если идет рендеринг и не пауза)
         if (m_state == AppState::Rendering && !m_isPaused) {
-            // Лимит тайлов на кадр (в конфиге выбираем, чтобы интерфейс не лагал)
-            RenderPTBatches(m_tilesPerFrame);
+            // Лимит тайлов на кадр: по бюджету времени или фиксированный из конфига, чтобы интерфейс не лагал
+            int batchCount = m_frameBudget ? m_budget.GetTilesPerFrame() : m_tilesPerFrame;
+            m_batchTimer.BeginBatch();
+            m_lastBatchTiles = RenderPTBatches(batchCount);
+            m_batchTimer.EndBatch(m_lastBatchTiles, m_tileSize);
         }
 
         // 2. Display Pass (Тонмаппинг) - вызываем ВСЕГДА, 
@@ -491,68 +731,92 @@ private:
         ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 
         m_renderer.Present();
-    }
-
-    void RenderPTBatches(int batchCount) {
-        m_renderer.SetPipelineState(m_stateTileRender);
-
-        int tilesX = (m_renderW + m_tileSize - 1) / m_tileSize;
-        int totalTiles = tilesX * ((m_renderH + m_tileSize - 1) / m_tileSize);
-
-        // Опасность! Если ресайз окна сделан, буфер может не соответствовать
-        // Для простоты предполагаем, что Resolution константно, меняем только тайлы.
 
-        int readIdx = (m_activeBuffer == 0) ? 1 : 0;
-        int writeIdx = m_activeBuffer;
+        // Замеры прошлых кадров уточняют модель стоимости (результаты GPU приходят с задержкой в пару кадров)
+        m_batchTimer.Collect(m_budget);
+    }
 
+    // Возвращает число отрисованных плиток
+    int RenderPTBatches(int batchCount) {
         PTSceneData camData = CalculateCameraData();
 
+        int rendered = 0;
         for (int b = 0; b < batchCount; b++) {
-            // Конец кадра?
-            if (m_currentTileIndex >= totalTiles) {
-                m_currentTileIndex = 0;
-
-                // Фиксируем результат
-                m_displayBuffer = m_activeBuffer;
-                // Меняем буфер
-                m_activeBuffer = !m_activeBuffer;
-
-                m_frameIndex++;
+            // Конец раунда?
+            if (m_roundPos >= (int)m_roundQueue.size()) {
+                // Ошибка тайлов, получивших проходы в этом раунде, решает, сколько им дать дальше
+                if (!m_roundQueue.empty()) {
+                    EvaluateTileErrors();
+                    m_sampler.EndRound();
+                }
+                if (m_sampler.IsFinished()) {
+                    m_currentTileIndex = -1;
+                    OnRenderFinished();
+                    return rendered;
+                }
+                BeginRound();
                 break; // Дадим шанс интерфейсу отрисоваться
             }
 
-            int tx = m_currentTileIndex % tilesX;
-            int ty = m_currentTileIndex / tilesX;
+            int tile = m_roundQueue[m_roundPos++];
+            m_currentTileIndex = tile;
+            int tx = tile % m_tilesX;
+            int ty = tile / m_tilesX;
 
             // Update Constant Data
             m_globalSeedTime += 1.61803f;
             camData.Params.x = m_globalSeedTime;
-            camData.Params.z = (float)m_frameIndex;
 
             // Setup Render
-            m_renderer.SetRenderTarget(m_rtHistory[writeIdx]);
-
-            // Внимание: мы берем картинку для чтения из readIdx, 
-            // которая содержит данные ПРОШЛОГО ПОЛНОГО прохода (если мы правильно свапаем).
-            // Или содержит данные предыдущей пачки тайлов этого прохода?
-            // Ping-Pong история работает корректно, когда читаем Полный Прошлый кадр.
-            m_ptPass.AddTexture("TexHistory", m_rtHistory[readIdx]);
+            m_renderer.SetPipelineState(m_stateTileRender);
+            m_renderer.SetRenderTarget(m_rtAccum, m_rtMoments);
             m_renderer.SetShaderPass(m_ptPass);
 
             m_renderer.SetCustomConstant("SceneBuffer", camData);
-            m_renderer.SetCustomConstant("ObjectBuffer", m_gpuBuffer);
+            m_renderer.SetCustomConstant("SceneCounts", m_sceneCounts);
 
             // Важно: Использование динамического размера тайла
             m_renderer.SetScissor(tx * m_tileSize, ty * m_tileSize, m_tileSize, m_tileSize);
             m_renderer.DrawFullScreenQuad();
+            rendered++;
+        }
+        return rendered;
+    }
 
-            m_currentTileIndex++;
+    // Раунд планировщика -> очередь тайлов. Проходы чередуются (сначала по одному всем тайлам, потом вторые и т.д.),
+    // чтобы картинка уточнялась равномерно
+    void BeginRound() {
+        const std::vector<AdaptiveSampling::TileWork>& work = m_sampler.BeginRound();
+        m_roundQueue.clear();
+        m_roundPos = 0;
+        int maxPasses = 0;
+        for (const auto& w : work) maxPasses = std::max(maxPasses, w.Passes);
+        for (int pass = 0; pass < maxPasses; ++pass) {
+            for (const auto& w : work) {
+                if (w.Passes > pass) m_roundQueue.push_back(w.Tile);
+            }
         }
     }
 
+    // Ошибка всех тайлов считается на GPU (пиксель на тайл) и читается обратно - один маленький readback на раунд
+    void EvaluateTileErrors() {
+        m_renderer.SetPipelineState(m_stateFullScreen);
+        m_renderer.SetRenderTarget(m_rtTileError);
+        m_tileErrorPass.AddTexture("TexAccum", m_rtAccum);
+        m_tileErrorPass.AddTexture("TexMoments", m_rtMoments);
+        m_renderer.SetShaderPass(m_tileErrorPass);
+
+        TileErrorCB params = { (float)m_tileSize, (float)m_renderW, (float)m_renderH, 0 };
+        m_renderer.SetCustomConstant("TileErrorParams", params);
+        m_renderer.DrawFullScreenQuad();
+
+        if (!m_rtTileError.ReadPixels(m_tileErrors.data())) return;
+        for (const auto& w : m_sampler.GetRoundWork()) m_sampler.SetError(w.Tile, m_tileErrors[w.Tile]);
+    }
+
     void RenderDisplayPass() {
         m_renderer.SetPipelineState(m_stateFullScreen);
-        m_displayPass.AddTexture("TexHDR", m_rtHistory[m_displayBuffer]);
+        m_displayPass.AddTexture("TexHDR", m_rtAccum);
         PostProcessData ppData = { m_currentExposure };
         m_renderer.SetCustomConstant("PostProcessParams", ppData);
         m_renderer.SetShaderPass(m_displayPass);
@@ -562,10 +826,9 @@ private:
     void RenderOverlayPass() {
         m_renderer.SetPipelineState(m_stateUI);
 
-        int tilesX = (m_renderW + m_tileSize - 1) / m_tileSize;
         HighlightCB hlParams = {
             (float)m_currentTileIndex,
-            (float)tilesX,
+            (float)m_tilesX,
             (float)m_tileSize, // <--- Передаем динамический размер тайла в шейдер!
             0
         };
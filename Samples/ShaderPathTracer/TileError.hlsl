@@ -0,0 +1,52 @@
+//      .
+//     (  X) x (  Y):   -  .
+//     AdaptiveSampling::PixelError (AdaptiveSampler.h).
+
+Texture2D TexAccum : register(t0);   // rgb =  , a =  
+Texture2D TexMoments : register(t1); // r =    
+
+cbuffer TileErrorParams : register(b0) {
+    float TileSize;
+    float ImageWidth;
+    float ImageHeight;
+    float Padding;
+};
+
+static const float3 LUMA = float3(0.2126, 0.7152, 0.0722);
+static const float ERROR_EPSILON = 0.1;
+static const float NO_ESTIMATE = 3.402823e+38; // FLT_MAX -    
+
+struct VS_OUTPUT {
+    float4 Pos : SV_POSITION;
+    float2 UV  : TEXCOORD0;
+};
+
+VS_OUTPUT VS_Quad(float3 Pos : POSITION, float2 UV : TEXCOORD0) {
+    VS_OUTPUT o; o.Pos = float4(Pos, 1); o.UV = UV; return o;
+}
+
+float4 PS_TileError(VS_OUTPUT input) : SV_Target{
+    int size = (int)TileSize;
+    int2 origin = int2(input.Pos.xy) * size;
+    int2 end = min(origin + size, int2(ImageWidth, ImageHeight));
+
+    float errorSum = 0.0;
+    float count = 0.0;
+
+    [loop]
+    for (int y = origin.y; y < end.y; ++y) {
+        [loop]
+        for (int x = origin.x; x < end.x; ++x) {
+            float4 acc = TexAccum.Load(int3(x, y, 0));
+            float n = acc.a;
+            //       
+            if (n < 2.0) return float4(NO_ESTIMATE, 0, 0, 1);
+
+            float mean = dot(acc.rgb, LUMA) / n;
+            float variance = max(TexMoments.Load(int3(x, y, 0)).r / n - mean * mean, 0.0) * n / (n - 1.0);
+            errorSum += sqrt(variance / n) / (mean + ERROR_EPSILON);
+            count += 1.0;
+        }
+    }
+    return float4(errorSum / max(count, 1.0), 0, 0, 1);
+}
@@ -18,7 +18,8 @@ using namespace Math;
 // CONFIG
 // =========================================================
 
-const int TILE_SIZE = 64; // Размер плитки
+const int TILE_SIZE = 64;            // Начальный размер плитки, дальше подбирается под бюджет
+const double FRAME_BUDGET_MS = 12.0; // Сколько времени кадра отдаем трассировке
 
 struct PTSceneData {
     Math::float4   CameraPos;
@@ -114,12 +115,19 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     float aspectRatio = (float)W / H;
     float tanHalfFov = tan(fovY * 0.5f);
 
-    int tilesX = (W + TILE_SIZE - 1) / TILE_SIZE;
-    int tilesY = (H + TILE_SIZE - 1) / TILE_SIZE;
-    int totalTiles = tilesX * tilesY;
+    // Число и размер плиток за кадр подбираются по замерам так, чтобы трассировка укладывалась в бюджет
+    TileBudgetSettings budgetSettings;
+    budgetSettings.TargetMilliseconds = FRAME_BUDGET_MS;
+    TileBudgetController budget(budgetSettings, TILE_SIZE);
+    TileBatchTimer batchTimer;
+    batchTimer.Create();
+
+    // Курсор обхода: плитки идут строками, высота строки фиксируется в ее начале,
+    // поэтому размер плитки может меняться между строками без дыр и перекрытий
+    int cursorX = 0, cursorY = 0;
+    int rowSize = budget.GetTileSize();
+    int tilesDone = 0;
 
-    // Начальное состояние
-    int currentTileIndex = 0;
     renderer.Clear(rtHDR, 0, 0, 0, 1); // Очищаем HDR буфер перед стартом
 
     MSG msg = {};
@@ -132,7 +140,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
             // --- УПРАВЛЕНИЕ: ПЕРЕЗАПУСК ---
             // Если нажат ПРОБЕЛ -> Сброс рендера
             if (GetAsyncKeyState(VK_SPACE) & 0x8000) {
-                currentTileIndex = 0;
+                cursorX = cursorY = 0;
+                tilesDone = 0;
                 renderer.Clear(rtHDR, 0, 0, 0, 1);
                 SetWindowText(hwnd, "Restarting Render...");
             }
@@ -141,18 +150,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
             // PASS 1: Рендеринг (Только если есть необработанные тайлы)
             // =========================================================
 
-            if (currentTileIndex < totalTiles) {
-
-                // Обновляем заголовок окна для информации
-                char title[64];
-                sprintf_s(title, "Rendering Tile: %d / %d (Press SPACE to reset)", currentTileIndex + 1, totalTiles);
-                SetWindowText(hwnd, title);
-
-                // Координаты тайла
-                int tx = currentTileIndex % tilesX;
-                int ty = currentTileIndex / tilesX;
-                int scissorX = tx * TILE_SIZE;
-                int scissorY = ty * TILE_SIZE;
+            if (cursorY < H) {
 
                 // 1. Считаем базис камеры вручную (так надежнее всего)
                 Math::float3 forward = (camTarget - camPos).normalize();
@@ -172,21 +170,41 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
                 sceneData.Params.x = time;
 
-                // --- DRAW TILE ---
                 renderer.SetRenderTarget(rtHDR);
                 renderer.SetPipelineState(stateTileRender);
-                renderer.SetScissor(scissorX, scissorY, TILE_SIZE, TILE_SIZE);
-
                 renderer.SetShaderPass(ptPass);
                 renderer.SetCustomConstant("SceneBuffer", sceneData);
-                renderer.DrawFullScreenQuad();
 
-                // Переходим к следующему
-                currentTileIndex++;
+                // --- DRAW TILES ---
+                int tiles = 0;
+                int batchSize = rowSize;
+                batchTimer.BeginBatch();
+                while (tiles < budget.GetTilesPerFrame() && cursorY < H) {
+                    renderer.SetScissor(cursorX, cursorY, rowSize, rowSize);
+                    renderer.DrawFullScreenQuad();
+                    tiles++;
+
+                    // Переходим к следующему
+                    cursorX += rowSize;
+                    if (cursorX >= W) {
+                        cursorX = 0;
+                        cursorY += rowSize;
+                        rowSize = budget.GetTileSize(); // новая строка - новый размер
+                    }
+                }
+                batchTimer.EndBatch(tiles, batchSize);
+                tilesDone += tiles;
 
-                if (currentTileIndex >= totalTiles) {
-                    SetWindowText(hwnd, "Rendering FINISHED! (Press SPACE to restart)");
+                // Обновляем заголовок окна для информации
+                char title[128];
+                if (cursorY < H) {
+                    sprintf_s(title, "Rendering: %d%% | %d tiles x %dpx, %.2f ms %s (Press SPACE to reset)",
+                        (cursorY * 100) / H, tiles, batchSize, batchTimer.GetLastMilliseconds(), batchTimer.UsesGPU() ? "GPU" : "CPU");
                 }
+                else {
+                    sprintf_s(title, "Rendering FINISHED! %d tiles (Press SPACE to restart)", tilesDone);
+                }
+                SetWindowText(hwnd, title);
             }
 
             // =========================================================
@@ -202,14 +220,16 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
             renderer.DrawFullScreenQuad();
 
             renderer.Present();
+            batchTimer.Collect(budget);
 
             // Если рендер закончен, даем процессору отдохнуть
-            if (currentTileIndex >= totalTiles) {
+            if (cursorY >= H) {
                 Sleep(16); // ~60 FPS idle
             }
         }
     }
 
+    batchTimer.Release();
     renderer.Destroy();
     return 0;
 }
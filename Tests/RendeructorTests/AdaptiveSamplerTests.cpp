@@ -0,0 +1,246 @@
+﻿#include "TestFramework.h"
+#include <ShaderPathTracer/AdaptiveSampler.h>
+
+namespace {
+
+    // Синтетический "рендер" с известным ответом: у пикселя среднее Mean, а проход возвращает Mean / P с вероятностью P
+    // и 0 иначе (светлячки), умноженное на шум 0.5..1.5. Тайлы сильно различаются по P: ровное небо,
+    // обычная диффузная поверхность и каустики, как в сцене путевой трассировки
+    class SyntheticImage {
+    public:
+        SyntheticImage(int width, int height, int tileSize, unsigned int seed)
+            : m_width(width), m_height(height), m_tileSize(tileSize) {
+            m_tilesX = (width + tileSize - 1) / tileSize;
+            m_tilesY = (height + tileSize - 1) / tileSize;
+
+            Tests::Random random(seed);
+            m_tileProbability.resize((size_t)m_tilesX * m_tilesY);
+            for (float& p : m_tileProbability) {
+                const float kind = random.Float();
+                p = kind < 0.6f ? 1.0f : (kind < 0.9f ? 0.5f : 0.15f);
+            }
+            m_mean.resize((size_t)width * height);
+            for (float& m : m_mean) m = random.Range(0.2f, 1.0f);
+        }
+
+        int GetTileCount() const { return m_tilesX * m_tilesY; }
+
+        // Проходы [firstPass, firstPass + passes) тайла: сумма значений и сумма квадратов яркости по пикселям
+        void RenderTile(int tile, int firstPass, int passes, std::vector<float>& sum, std::vector<float>& sumSq) const {
+            const float p = m_tileProbability[tile];
+            ForEachPixel(tile, [&](int pixel) {
+                for (int pass = firstPass; pass < firstPass + passes; ++pass) {
+                    const unsigned int h = Hash((unsigned int)pixel * 9781u + (unsigned int)pass * 6271u);
+                    const float u = (h & 0xFFFF) / 65536.0f;
+                    const float noise = 0.5f + (h >> 16) / 65536.0f;
+                    const float value = u < p ? m_mean[pixel] / p * noise : 0.0f;
+                    const float luma = AdaptiveSampling::Luminance(value, value, value);
+                    sum[pixel] += value;
+                    sumSq[pixel] += luma * luma;
+                }
+            });
+        }
+
+        // Средняя ошибка пикселей тайла, как в TileError.hlsl
+        float TileError(int tile, int passes, const std::vector<float>& sum, const std::vector<float>& sumSq) const {
+            double error = 0.0;
+            int pixels = 0;
+            ForEachPixel(tile, [&](int pixel) {
+                error += AdaptiveSampling::PixelError(sum[pixel], sumSq[pixel], (float)passes);
+                pixels++;
+            });
+            return (float)(error / pixels);
+        }
+
+        // Настоящая относительная ошибка тайла против известного среднего
+        double TrueTileError(int tile, int passes, const std::vector<float>& sum) const {
+            double error = 0.0;
+            int pixels = 0;
+            ForEachPixel(tile, [&](int pixel) {
+                const double rel = (sum[pixel] / passes - m_mean[pixel]) / (m_mean[pixel] + AdaptiveSampling::kErrorEpsilon);
+                error += rel * rel;
+                pixels++;
+            });
+            return std::sqrt(error / pixels);
+        }
+
+        int GetPixelCount(int tile) const {
+            int pixels = 0;
+            ForEachPixel(tile, [&](int) { pixels++; });
+            return pixels;
+        }
+
+    private:
+        template <typename F>
+        void ForEachPixel(int tile, F&& function) const {
+            const int x0 = (tile % m_tilesX) * m_tileSize, y0 = (tile / m_tilesX) * m_tileSize;
+            const int x1 = std::min(x0 + m_tileSize, m_width), y1 = std::min(y0 + m_tileSize, m_height);
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) function(y * m_width + x);
+            }
+        }
+
+        static unsigned int Hash(unsigned int x) {
+            x ^= x >> 16; x *= 0x7feb352dU;
+            x ^= x >> 15; x *= 0x846ca68bU;
+            x ^= x >> 16;
+            return x;
+        }
+
+        int m_width, m_height, m_tileSize;
+        int m_tilesX, m_tilesY;
+        std::vector<float> m_tileProbability;
+        std::vector<float> m_mean;
+    };
+
+    struct SamplingResult {
+        double Milliseconds = 0.0;
+        long long PixelPasses = 0;
+        AdaptiveSampling::Stats Stats;
+        double TrueRMSE = 0.0;          // по всем тайлам
+        double WorstTrueTileError = 0.0;
+    };
+
+    // Тот же цикл раундов, что в CPUPathTracer: рендер работы раунда, ошибка тайлов, EndRound
+    SamplingResult Run(const SyntheticImage& image, int pixelCount, const AdaptiveSampling::Settings& settings) {
+        std::vector<float> sum(pixelCount, 0.0f), sumSq(pixelCount, 0.0f);
+        AdaptiveSampling::Scheduler sampler;
+        sampler.Reset(image.GetTileCount(), settings);
+
+        SamplingResult result;
+        Tests::Timer timer;
+        while (!sampler.IsFinished()) {
+            const std::vector<AdaptiveSampling::TileWork>& round = sampler.BeginRound();
+            if (round.empty()) break;
+            for (const AdaptiveSampling::TileWork& work : round) {
+                const int firstPass = sampler.GetTilePasses(work.Tile);
+                image.RenderTile(work.Tile, firstPass, work.Passes, sum, sumSq);
+                sampler.SetError(work.Tile, image.TileError(work.Tile, firstPass + work.Passes, sum, sumSq));
+                result.PixelPasses += (long long)image.GetPixelCount(work.Tile) * work.Passes;
+            }
+            sampler.EndRound();
+        }
+        result.Milliseconds = timer.Milliseconds();
+        result.Stats = sampler.GetStats();
+
+        double squares = 0.0;
+        for (int tile = 0; tile < image.GetTileCount(); ++tile) {
+            const double error = image.TrueTileError(tile, std::max(sampler.GetTilePasses(tile), 1), sum);
+            squares += error * error * image.GetPixelCount(tile);
+            result.WorstTrueTileError = std::max(result.WorstTrueTileError, error);
+        }
+        result.TrueRMSE = std::sqrt(squares / pixelCount);
+        return result;
+    }
+
+    AdaptiveSampling::Settings MakeSettings(bool adaptive, float threshold) {
+        AdaptiveSampling::Settings settings;
+        settings.ErrorThreshold = threshold;
+        settings.MaxPasses = 20000;
+        settings.Adaptive = adaptive;
+        return settings;
+    }
+}
+
+TEST(AdaptiveSampling_PixelErrorIsStandardErrorOfTheMean) {
+    // Значения 0 и 2 поровну: среднее 1, несмещенная дисперсия n / (n - 1)
+    const float n = 100.0f;
+    const float sum = 100.0f, sumSq = 200.0f;
+    const float expected = std::sqrt((1.0f * n / (n - 1.0f)) / n) / (1.0f + AdaptiveSampling::kErrorEpsilon);
+    CHECK_NEAR(AdaptiveSampling::PixelError(sum, sumSq, n), expected, 1e-6f);
+    CHECK_EQ(AdaptiveSampling::PixelError(1.0f, 1.0f, 1.0f), FLT_MAX);
+    CHECK_NEAR(AdaptiveSampling::PixelError(5.0f, 5.0f, 5.0f), 0.0f, 1e-6f);
+}
+
+TEST(AdaptiveSampling_SchedulerRespectsPassLimits) {
+    AdaptiveSampling::Settings settings;
+    settings.MinPasses = 4;
+    settings.MaxPasses = 40;
+    settings.MaxPassesPerRound = 8;
+    settings.ErrorThreshold = 0.01f;
+
+    AdaptiveSampling::Scheduler sampler;
+    sampler.Reset(3, settings);
+
+    // Первый раунд - MinPasses всем
+    const std::vector<AdaptiveSampling::TileWork>& first = sampler.BeginRound();
+    REQUIRE(first.size() == 3);
+    for (const auto& work : first) CHECK_EQ(work.Passes, 4);
+    sampler.SetError(0, 0.005f); // уже ниже порога
+    sampler.SetError(1, 0.02f);  // нужно ~4x проходов
+    sampler.SetError(2, 1.0f);   // недостижимо до MaxPasses
+    sampler.EndRound();
+    CHECK(sampler.IsTileConverged(0));
+    CHECK_EQ(sampler.GetStats().ActiveTiles, 2);
+
+    // Нужное число проходов ограничено удвоением и MaxPassesPerRound
+    const std::vector<AdaptiveSampling::TileWork>& second = sampler.BeginRound();
+    REQUIRE(second.size() == 2);
+    CHECK_EQ(second[0].Tile, 1);
+    CHECK_EQ(second[0].Passes, 4);
+    CHECK_EQ(second[1].Passes, 4);
+
+    while (!sampler.IsFinished()) {
+        sampler.EndRound();
+        sampler.BeginRound();
+    }
+    CHECK_EQ(sampler.GetTilePasses(0), 4);
+    CHECK_EQ(sampler.GetTilePasses(2), 40);
+}
+
+TEST(AdaptiveSampling_UniformModeGivesEveryTileTheSamePasses) {
+    const SyntheticImage image(64, 48, 16, 5);
+    const int pixels = 64 * 48;
+    std::vector<float> sum(pixels, 0.0f), sumSq(pixels, 0.0f);
+
+    AdaptiveSampling::Scheduler sampler;
+    sampler.Reset(image.GetTileCount(), MakeSettings(false, 0.05f));
+    while (!sampler.IsFinished()) {
+        const auto& round = sampler.BeginRound();
+        if (round.empty()) break;
+        CHECK_EQ((int)round.size(), image.GetTileCount());
+        for (const auto& work : round) {
+            const int firstPass = sampler.GetTilePasses(work.Tile);
+            image.RenderTile(work.Tile, firstPass, work.Passes, sum, sumSq);
+            sampler.SetError(work.Tile, image.TileError(work.Tile, firstPass + work.Passes, sum, sumSq));
+        }
+        sampler.EndRound();
+    }
+    for (int tile = 1; tile < image.GetTileCount(); ++tile) CHECK_EQ(sampler.GetTilePasses(tile), sampler.GetTilePasses(0));
+    CHECK(sampler.GetStats().MaxError <= 0.05f);
+}
+
+TEST(AdaptiveSampling_AdaptiveReachesTheSameQualityWithFewerPasses) {
+    const SyntheticImage image(96, 64, 16, 9);
+    const int pixels = 96 * 64;
+    const float threshold = 0.05f;
+
+    const SamplingResult uniform = Run(image, pixels, MakeSettings(false, threshold));
+    const SamplingResult adaptive = Run(image, pixels, MakeSettings(true, threshold));
+
+    CHECK(uniform.Stats.MaxError <= threshold);
+    CHECK(adaptive.Stats.MaxError <= threshold);
+    // Настоящая ошибка каждого тайла рядом с порогом: оценка по дисперсии не обманывает планировщик
+    CHECK(adaptive.WorstTrueTileError < threshold * 2.0);
+    CHECK(adaptive.PixelPasses * 2 < uniform.PixelPasses);
+}
+
+// Время до целевого качества: равномерное распределение проходов против адаптивного на синтетическом кадре 320x180
+// с известным ответом. Кроме времени и проходов печатается настоящая ошибка против точного изображения,
+// чтобы было видно, что адаптивный режим экономит работу, а не качество
+BENCHMARK(AdaptiveSampling_TimeToTargetQuality) {
+    const int width = 320, height = 180;
+    const SyntheticImage image(width, height, 16, 21);
+
+    std::printf("    %-9s %7s %10s %12s %8s %10s %10s\n", "mode", "error", "time ms", "pixel passes", "rounds", "true RMSE", "worst tile");
+    for (float threshold : { 0.05f, 0.03f }) {
+        const SamplingResult uniform = Run(image, width * height, MakeSettings(false, threshold));
+        const SamplingResult adaptive = Run(image, width * height, MakeSettings(true, threshold));
+        for (const auto& [name, r] : { std::pair<const char*, const SamplingResult&>{ "uniform", uniform }, { "adaptive", adaptive } }) {
+            std::printf("    %-9s %7.3f %10.1f %12lld %8d %10.4f %10.4f\n", name, threshold, r.Milliseconds, r.PixelPasses,
+                r.Stats.Rounds, r.TrueRMSE, r.WorstTrueTileError);
+        }
+        std::printf("    speedup at %.3f: %.2fx time, %.2fx passes\n", threshold,
+            uniform.Milliseconds / adaptive.Milliseconds, (double)uniform.PixelPasses / adaptive.PixelPasses);
+    }
+}
@@ -0,0 +1,39 @@
+﻿#include "TestFramework.h"
+#include <FrameWriter.h>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+    std::string Format(const std::string& pattern, int frame) {
+        std::string path = "<untouched>";
+        FrameWriter::FormatFramePath(pattern, frame, path);
+        return path;
+    }
+}
+
+TEST(FrameWriter_FormatsFramePathLikePrintf) {
+    const char* patterns[] = { "frames/frame_%04d.png", "%d.exr", "out_%i_final.pfm", "%6d.png", "a%%b_%03u.png", "%1d.png" };
+    const int frames[] = { 0, 7, 123, 98765, -5 };
+    for (const char* pattern : patterns) {
+        for (int frame : frames) {
+            if (frame < 0 && strstr(pattern, "u")) continue;
+            char expected[256];
+            snprintf(expected, sizeof(expected), pattern, frame);
+            CHECK(Format(pattern, frame) == expected);
+        }
+    }
+}
+
+TEST(FrameWriter_RejectsPatternsThatAreNotOneIntegerConversion) {
+    // Все, что могло бы прочитать лишние аргументы printf или писать все кадры в один файл
+    const char* rejected[] = {
+        "frame.png", "frame_%%.png", "%d_%d.png", "%s.png", "%n.png", "%x.png", "%ld.png", "%-4d.png",
+        "%.4d.png", "%*d.png", "%4$d.png", "frame_%", "frame_%04", "%999999999d.png", "",
+    };
+    for (const char* pattern : rejected) {
+        std::string path = "<untouched>";
+        CHECK(!FrameWriter::FormatFramePath(pattern, 1, path));
+        CHECK(path == "<untouched>");
+    }
+}
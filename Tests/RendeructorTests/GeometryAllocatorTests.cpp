@@ -0,0 +1,158 @@
+﻿#include "TestFramework.h"
+#include <GeometryArena.h>
+#include <algorithm>
+#include <map>
+
+namespace {
+
+    // Выделения не пересекаются, лежат внутри диапазона и сходятся со счетчиками аллокатора
+    bool Consistent(const GeometryAllocator& allocator, const std::map<uint32_t, uint32_t>& live) {
+        uint32_t used = 0;
+        uint32_t end = 0;
+        for (const auto& [offset, size] : live) {
+            if (offset < end || (uint64_t)offset + size > allocator.GetCapacity()) return false;
+            end = offset + size;
+            used += size;
+        }
+        return used == allocator.GetUsed() && (int)live.size() == allocator.GetAllocationCount();
+    }
+}
+
+TEST(GeometryAllocator_AllocatesUntilFull) {
+    GeometryAllocator allocator;
+    allocator.Initialize(1024);
+    CHECK_EQ(allocator.GetLargestFreeBlock(), 1024u);
+
+    uint32_t offsets[4];
+    for (int i = 0; i < 4; ++i) REQUIRE(allocator.Allocate(256, offsets[i]));
+    // Из единственного свободного блока выделения идут подряд
+    for (int i = 0; i < 4; ++i) CHECK_EQ(offsets[i], (uint32_t)(i * 256));
+    CHECK_EQ(allocator.GetUsed(), 1024u);
+    CHECK_EQ(allocator.GetFree(), 0u);
+    CHECK_EQ(allocator.GetAllocationCount(), 4);
+
+    uint32_t offset = 0;
+    CHECK(!allocator.Allocate(1, offset));
+    CHECK(!allocator.Allocate(0, offset));
+
+    // Reset сбрасывает и емкость: до нового Initialize выделять неоткуда
+    allocator.Reset();
+    CHECK_EQ(allocator.GetUsed(), 0u);
+    CHECK_EQ(allocator.GetAllocationCount(), 0);
+    CHECK(!allocator.Allocate(1, offset));
+    allocator.Initialize(1024);
+    CHECK(allocator.Allocate(1024, offset));
+    CHECK_EQ(offset, 0u);
+}
+
+TEST(GeometryAllocator_FreeCoalescesNeighbours) {
+    GeometryAllocator allocator;
+    allocator.Initialize(1024);
+    uint32_t offsets[4];
+    for (int i = 0; i < 4; ++i) REQUIRE(allocator.Allocate(256, offsets[i]));
+
+    CHECK(allocator.Free(offsets[1]));
+    CHECK(!allocator.Free(offsets[1]));   // повторное освобождение
+    CHECK(!allocator.Free(offsets[1] + 1)); // не начало блока
+    CHECK_EQ(allocator.GetLargestFreeBlock(), 256u);
+
+    // Свободный сосед справа и слева: блоки склеиваются, а не дробят место
+    CHECK(allocator.Free(offsets[2]));
+    CHECK_EQ(allocator.GetLargestFreeBlock(), 512u);
+    CHECK(allocator.Free(offsets[0]));
+    CHECK_EQ(allocator.GetLargestFreeBlock(), 768u);
+    CHECK(allocator.Free(offsets[3]));
+    CHECK_EQ(allocator.GetLargestFreeBlock(), 1024u);
+    CHECK_EQ(allocator.GetAllocationCount(), 0);
+
+    uint32_t offset = 1;
+    CHECK(allocator.Allocate(1024, offset));
+    CHECK_EQ(offset, 0u);
+}
+
+TEST(GeometryAllocator_RandomAllocationsNeverOverlap) {
+    GeometryAllocator allocator;
+    allocator.Initialize(1u << 20);
+    Tests::Random random(11);
+    std::map<uint32_t, uint32_t> live;
+    int failures = 0;
+
+    for (int step = 0; step < 20000; ++step) {
+        if (!live.empty() && random.Int(0, 2) == 0) {
+            auto it = live.begin();
+            std::advance(it, random.Int(0, (int)live.size() - 1));
+            CHECK(allocator.Free(it->first));
+            live.erase(it);
+        }
+        else {
+            const uint32_t size = (uint32_t)random.Int(1, 4000);
+            uint32_t offset = 0;
+            if (allocator.Allocate(size, offset)) {
+                CHECK(live.emplace(offset, size).second);
+            }
+            else {
+                // Отказ допустим только если подходящего свободного блока действительно нет
+                if (allocator.GetLargestFreeBlock() >= size * 2) failures++;
+            }
+        }
+        if (step % 1000 == 0) CHECK(Consistent(allocator, live));
+    }
+    CHECK(Consistent(allocator, live));
+    CHECK_EQ(failures, 0);
+}
+
+TEST(GeometryAllocator_DefragmentPacksInOrder) {
+    GeometryAllocator allocator;
+    allocator.Initialize(1u << 16);
+    Tests::Random random(5);
+    std::map<uint32_t, uint32_t> live;
+    for (int i = 0; i < 300; ++i) {
+        uint32_t offset = 0;
+        const uint32_t size = (uint32_t)random.Int(1, 200);
+        if (allocator.Allocate(size, offset)) live.emplace(offset, size);
+    }
+    // Освобождаем каждое второе: свободное место раздроблено
+    int index = 0;
+    for (auto it = live.begin(); it != live.end();) {
+        if (index++ % 2 == 0) {
+            CHECK(allocator.Free(it->first));
+            it = live.erase(it);
+        }
+        else ++it;
+    }
+    const uint32_t used = allocator.GetUsed();
+    CHECK(allocator.GetLargestFreeBlock() < allocator.GetFree());
+
+    std::vector<GeometryAllocator::Move> moves;
+    allocator.Defragment(moves);
+    REQUIRE(!moves.empty());
+
+    // Копирование ходов по порядку не затирает еще не перенесенные данные: сверяем на "памяти" из номеров блоков
+    std::vector<int> memory(allocator.GetCapacity(), -1);
+    int id = 0;
+    for (const auto& [offset, size] : live) {
+        std::fill(memory.begin() + offset, memory.begin() + offset + size, id++);
+    }
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const GeometryAllocator::Move& move = moves[i];
+        CHECK(move.To <= move.From);
+        if (i > 0) CHECK(move.From > moves[i - 1].From);
+        std::copy(memory.begin() + move.From, memory.begin() + move.From + move.Size, memory.begin() + move.To);
+    }
+
+    // После переноса блоки лежат подряд с нуля в прежнем порядке, аллокатор знает их по новым смещениям
+    uint32_t cursor = 0;
+    id = 0;
+    std::map<uint32_t, uint32_t> packed;
+    for (const auto& [offset, size] : live) {
+        CHECK(memory[cursor] == id && memory[cursor + size - 1] == id);
+        packed.emplace(cursor, size);
+        cursor += size;
+        id++;
+    }
+    CHECK_EQ(allocator.GetUsed(), used);
+    CHECK_EQ(allocator.GetLargestFreeBlock(), allocator.GetCapacity() - used);
+    CHECK(Consistent(allocator, packed));
+    for (const auto& [offset, size] : packed) CHECK(allocator.Free(offset));
+    CHECK_EQ(allocator.GetAllocationCount(), 0);
+}
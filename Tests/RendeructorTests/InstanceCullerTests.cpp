@@ -0,0 +1,191 @@
+﻿#include "TestFramework.h"
+#include <InstanceCuller.h>
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+    // Единичный куб как сетка: только границы, GPU-буферов без рендерера не создается
+    void CreateUnitCube(Mesh& mesh) {
+        const Vertex vertices[3] = {
+            Vertex(Math::float3(-1, -1, -1), Math::float3(0, 0, 0), Math::float3(0, 0, 0), Math::float3(0, 0, 1), Math::float2(0, 0)),
+            Vertex(Math::float3(1, 1, 1), Math::float3(0, 0, 0), Math::float3(0, 0, 0), Math::float3(0, 0, 1), Math::float2(0, 0)),
+            Vertex(Math::float3(1, -1, 1), Math::float3(0, 0, 0), Math::float3(0, 0, 0), Math::float3(0, 0, 1), Math::float2(0, 0)),
+        };
+        const unsigned int indices[3] = { 0, 1, 2 };
+        mesh.CreateFromMemory(vertices, 3, indices, 3, Math::float3(-1, -1, -1), Math::float3(1, 1, 1));
+    }
+
+    // Случайно повернутые и отмасштабированные кубы в поле side x side вокруг начала координат
+    std::vector<Math::float4x4> GenerateInstances(int count, float side, unsigned int seed) {
+        Tests::Random random(seed);
+        std::vector<Math::float4x4> worlds(count);
+        for (auto& world : worlds) {
+            world = Math::float4x4::scaling(random.Range(0.2f, 2.0f)) *
+                Math::float4x4::rotation_y(random.Range(0.0f, 6.2831853f)) *
+                Math::float4x4::translation(random.Range(-side, side), random.Range(-10.0f, 10.0f), random.Range(-side, side));
+        }
+        return worlds;
+    }
+
+    Frustum MakeFrustum(const Math::float3& eye, const Math::float3& target) {
+        const Math::float4x4 view = Math::float4x4::look_at_lh(eye, target, { 0, 1, 0 });
+        const Math::float4x4 proj = Math::float4x4::perspective_lh_zo(3.14159f / 3.0f, 16.0f / 9.0f, 0.5f, 400.0f);
+        return Frustum::FromViewProjection(view * proj);
+    }
+
+    // Скалярная проверка без SIMD: AABB по восьми углам, затем "положительная" вершина для каждой плоскости.
+    // Возвращает наименьшее расстояние: >= 0 - видим; около нуля решение зависит от округления
+    float ReferenceDistance(const Frustum& frustum, const Math::float4x4& world) {
+        Math::float3 lo(1e30f, 1e30f, 1e30f);
+        Math::float3 hi(-1e30f, -1e30f, -1e30f);
+        for (int c = 0; c < 8; ++c) {
+            const Math::float3 corner((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f);
+            const Math::float3 p = world.transform_point(corner);
+            lo = Math::float3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = Math::float3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+        }
+
+        float minDistance = 1e30f;
+        for (const Math::float4& plane : frustum.Planes) {
+            const float x = plane.x >= 0.0f ? hi.x : lo.x;
+            const float y = plane.y >= 0.0f ? hi.y : lo.y;
+            const float z = plane.z >= 0.0f ? hi.z : lo.z;
+            minDistance = std::min(minDistance, plane.x * x + plane.y * y + plane.z * z + plane.w);
+        }
+        return minDistance;
+    }
+
+    // Совпадение с эталоном, не считая экземпляров на самой границе пирамиды
+    bool MatchesReference(const Frustum& frustum, const std::vector<Math::float4x4>& worlds, const std::vector<unsigned int>& visible) {
+        std::vector<char> marked(worlds.size(), 0);
+        for (unsigned int i : visible) {
+            if (i >= worlds.size() || marked[i]) return false;
+            marked[i] = 1;
+        }
+        for (size_t i = 0; i < worlds.size(); ++i) {
+            const float distance = ReferenceDistance(frustum, worlds[i]);
+            if (std::fabs(distance) < 1e-3f) continue;
+            if ((distance >= 0.0f) != (marked[i] != 0)) return false;
+        }
+        return true;
+    }
+
+    struct CullScene {
+        Mesh Cube;
+        InstanceBuffer Instances;
+        std::vector<Math::float4x4> Worlds;
+
+        explicit CullScene(int count, float side = 300.0f) {
+            CreateUnitCube(Cube);
+            Worlds = GenerateInstances(count, side, 7);
+            Instances.SetKeepCPUData(true);
+            Instances.Create(Worlds.data(), count, sizeof(Math::float4x4));
+            Instances.SetTransformOffset(0);
+        }
+    };
+}
+
+TEST(InstanceCuller_MatchesScalarReference) {
+    CullScene scene(100000);
+    InstanceCuller culler;
+    culler.Build(scene.Instances, scene.Cube);
+    REQUIRE(culler.GetCount() == 100000);
+
+    const Frustum frustum = MakeFrustum({ 0, 20, -250 }, { 30, 0, 0 });
+    std::vector<unsigned int> visible;
+
+    culler.SetThreadCount(1);
+    InstanceCullStats single = culler.Cull(frustum, visible);
+    CHECK_EQ(single.Threads, 1);
+    CHECK(single.Visible > 0 && single.Visible < single.Total);
+    CHECK(MatchesReference(frustum, scene.Worlds, visible));
+    const std::vector<unsigned int> singleVisible = visible;
+
+    culler.SetThreadCount(8);
+    InstanceCullStats parallel = culler.Cull(frustum, visible);
+    CHECK(parallel.Threads > 1);
+    // Участки потоков склеиваются по порядку - результат тот же, что у одного потока
+    CHECK(visible == singleVisible);
+}
+
+TEST(InstanceCuller_WorkerPoolSurvivesChangingThreadCounts) {
+    CullScene scene(120000);
+    InstanceCuller culler;
+    culler.Build(scene.Instances, scene.Cube);
+
+    const Frustum frustum = MakeFrustum({ 50, 10, -200 }, { 0, 0, 40 });
+    std::vector<unsigned int> expected;
+    culler.SetThreadCount(1);
+    culler.Cull(frustum, expected);
+
+    // Пул растет и частично простаивает между вызовами; каждый вызов должен дождаться всех своих участков
+    const int threadCounts[] = { 2, 8, 3, 1, 14, 5, 8, 2 };
+    std::vector<unsigned int> visible;
+    for (int round = 0; round < 25; ++round) {
+        for (int threads : threadCounts) {
+            culler.SetThreadCount(threads);
+            culler.Cull(frustum, visible);
+            if (visible != expected) {
+                CHECK(visible == expected);
+                return;
+            }
+        }
+    }
+}
+
+TEST(InstanceCuller_SmallSetsStaySingleThreaded) {
+    CullScene scene(1000);
+    InstanceCuller culler;
+    culler.Build(scene.Instances, scene.Cube);
+    culler.SetThreadCount(8);
+
+    std::vector<unsigned int> visible;
+    const Frustum frustum = MakeFrustum({ 0, 0, -250 }, { 0, 0, 0 });
+    InstanceCullStats stats = culler.Cull(frustum, visible);
+    CHECK_EQ(stats.Threads, 1);
+    CHECK(MatchesReference(frustum, scene.Worlds, visible));
+}
+
+// Пропускная способность фрустум-теста и сжатия индексов: миллион экземпляров, камера облетает поле
+// (видна заметная часть набора, как в InstancedTeapods), среднее по многим кадрам
+BENCHMARK(InstanceCuller_Throughput) {
+    const int count = 1000000;
+    const int frames = 200;
+    CullScene scene(count, 600.0f);
+    InstanceCuller culler;
+    culler.Build(scene.Instances, scene.Cube);
+
+    std::vector<Frustum> frustums;
+    for (int f = 0; f < frames; ++f) {
+        const float angle = f * (6.2831853f / frames);
+        frustums.push_back(MakeFrustum({ std::sin(angle) * 500.0f, 60.0f, std::cos(angle) * 500.0f }, { 0, 0, 0 }));
+    }
+
+    std::vector<unsigned int> visible;
+    std::printf("    %d instances, %d frames, %s\n", count, frames, culler.Cull(frustums[0], visible).AVX2 ? "AVX2" : "SSE");
+
+    const int hardware = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> threadCounts = { 1, 2, 4, hardware };
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    for (int threads : threadCounts) {
+        if (threads > hardware) continue;
+        culler.SetThreadCount(threads);
+        culler.Cull(frustums[0], visible); // прогрев: пул потоков и память
+
+        double total = 0.0;
+        long long visibleSum = 0;
+        int usedThreads = 0;
+        for (const Frustum& frustum : frustums) {
+            InstanceCullStats stats = culler.Cull(frustum, visible);
+            total += stats.Milliseconds;
+            visibleSum += stats.Visible;
+            usedThreads = stats.Threads;
+        }
+        const double ms = total / frames;
+        std::printf("    %2d threads: %7.3f ms/frame  %9.0f instances/ms  (%.1f%% visible)\n",
+            usedThreads, ms, count / ms, 100.0 * visibleSum / ((double)count * frames));
+    }
+}
@@ -0,0 +1,144 @@
+﻿#include "TestFramework.h"
+#include <MeshCache.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+    struct CacheFile {
+        std::string SourcePath;
+        std::string CachePath;
+        std::vector<char> Bytes;
+    };
+
+    // Кэш для сетки из двух квадов (два материала), прочитанный обратно в память
+    bool WriteTestCache(CacheFile& out) {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path();
+        out.SourcePath = (dir / "rendeructor_cache_test.obj").string();
+        out.CachePath = MeshCache::GetCachePath(out.SourcePath);
+        {
+            std::ofstream source(out.SourcePath, std::ios::binary);
+            source << "# placeholder source\n";
+        }
+
+        std::vector<Vertex> vertices;
+        for (int i = 0; i < 8; ++i) {
+            vertices.push_back(Vertex(Math::float3((float)(i % 4), (float)(i / 4), 0), Math::float3(0, 0, 0),
+                Math::float3(0, 0, 0), Math::float3(0, 0, 1), Math::float2(0, 0)));
+        }
+        const std::vector<unsigned int> indices = { 0, 1, 5, 0, 5, 4, 2, 3, 7, 2, 7, 6 };
+        const std::vector<MeshCache::SubMeshRecord> subMeshes = { { 0, 6, 0, 0 }, { 6, 6, 0, 1 } };
+
+        if (!MeshCache::Write(out.CachePath, out.SourcePath, vertices, indices, Math::float3(0, 0, 0), Math::float3(3, 1, 0),
+                              false, subMeshes, { "Left", "Right" })) {
+            return false;
+        }
+
+        std::ifstream cache(out.CachePath, std::ios::binary);
+        out.Bytes.assign(std::istreambuf_iterator<char>(cache), std::istreambuf_iterator<char>());
+        return !out.Bytes.empty();
+    }
+
+    void RemoveTestCache(const CacheFile& file) {
+        std::error_code ec;
+        std::filesystem::remove(file.SourcePath, ec);
+        std::filesystem::remove(file.CachePath, ec);
+    }
+
+    MeshCache::Header ReadHeader(const std::vector<char>& bytes) {
+        MeshCache::Header header;
+        memcpy(&header, bytes.data(), sizeof(header));
+        return header;
+    }
+
+    void WriteHeader(std::vector<char>& bytes, const MeshCache::Header& header) {
+        memcpy(bytes.data(), &header, sizeof(header));
+    }
+
+    bool IsValid(const std::vector<char>& bytes) {
+        return MeshCache::Validate(bytes.data(), bytes.size());
+    }
+}
+
+TEST(MeshCache_WrittenCacheIsValid) {
+    CacheFile file;
+    REQUIRE(WriteTestCache(file));
+    std::string error;
+    CHECK(MeshCache::Validate(file.Bytes.data(), file.Bytes.size(), &error));
+    CHECK(error.empty());
+    RemoveTestCache(file);
+}
+
+TEST(MeshCache_RejectsIndexOutsideOfVertexBuffer) {
+    CacheFile file;
+    REQUIRE(WriteTestCache(file));
+    const MeshCache::Header header = ReadHeader(file.Bytes);
+
+    std::vector<char> bytes = file.Bytes;
+    const unsigned int badIndex = (unsigned int)header.VertexCount;
+    memcpy(bytes.data() + header.IndexOffset + 4 * sizeof(unsigned int), &badIndex, sizeof(badIndex));
+    std::string error;
+    CHECK(!MeshCache::Validate(bytes.data(), bytes.size(), &error));
+    CHECK(error == "index out of range");
+
+    // Load не должен трогать сетку и должен сообщить о порче
+    {
+        std::ofstream cache(file.CachePath, std::ios::binary | std::ios::trunc);
+        cache.write(bytes.data(), (std::streamsize)bytes.size());
+    }
+    Mesh mesh;
+    CHECK(!MeshCache::Load(file.CachePath, file.SourcePath, mesh));
+    CHECK_EQ(mesh.GetIndexCount(), 0);
+    RemoveTestCache(file);
+}
+
+TEST(MeshCache_RejectsSubMeshOutOfRange) {
+    CacheFile file;
+    REQUIRE(WriteTestCache(file));
+    const MeshCache::Header header = ReadHeader(file.Bytes);
+
+    auto patchRecord = [&](const MeshCache::SubMeshRecord& record) {
+        std::vector<char> bytes = file.Bytes;
+        memcpy(bytes.data() + header.SubMeshOffset + sizeof(record), &record, sizeof(record));
+        return bytes;
+    };
+
+    CHECK(IsValid(patchRecord({ 6, 6, 0, 1 })));
+    CHECK(!IsValid(patchRecord({ 6, 7, 0, 1 })));               // за концом IB
+    CHECK(!IsValid(patchRecord({ 0xFFFFFFF0u, 0x20, 0, 1 })));  // StartIndex + IndexCount переполняет uint32
+    CHECK(!IsValid(patchRecord({ 6, 0, 0, 1 })));
+    CHECK(!IsValid(patchRecord({ 6, 6, -1, 1 })));
+    CHECK(!IsValid(patchRecord({ 6, 6, 1, 1 })));               // 7 + 1 выходит за 8 вершин
+    RemoveTestCache(file);
+}
+
+TEST(MeshCache_RejectsCorruptHeader) {
+    CacheFile file;
+    REQUIRE(WriteTestCache(file));
+    const MeshCache::Header original = ReadHeader(file.Bytes);
+
+    auto withHeader = [&](auto&& patch) {
+        std::vector<char> bytes = file.Bytes;
+        MeshCache::Header header = original;
+        patch(header);
+        WriteHeader(bytes, header);
+        return bytes;
+    };
+
+    // Смещение у конца 64-битного диапазона: offset + size переполнился бы и прошел наивную проверку
+    CHECK(!IsValid(withHeader([](MeshCache::Header& h) { h.VertexOffset = ~0ull - 15; })));
+    CHECK(!IsValid(withHeader([](MeshCache::Header& h) { h.IndexCount = 0x4000000000000003ull; })));
+    CHECK(!IsValid(withHeader([](MeshCache::Header& h) { h.IndexCount = 0x7FFFFFFEull; })));
+    CHECK(!IsValid(withHeader([](MeshCache::Header& h) { h.IndexOffset += 4; })));
+    CHECK(!IsValid(withHeader([](MeshCache::Header& h) { h.IndexCount -= 1; })));
+    CHECK(!IsValid(withHeader([](MeshCache::Header& h) { h.VertexCount = 0; })));
+    CHECK(!IsValid(withHeader([](MeshCache::Header& h) { h.SubMeshCount = 0x7FFFFFFF; })));
+    CHECK(!IsValid(withHeader([](MeshCache::Header& h) { h.MaterialNameBytes = 0xFFFFFFFFu; })));
+    CHECK(!IsValid(withHeader([](MeshCache::Header& h) { h.VertexStride += 4; })));
+
+    std::vector<char> truncated(file.Bytes.begin(), file.Bytes.begin() + (ptrdiff_t)original.IndexOffset + 8);
+    CHECK(!IsValid(truncated));
+    CHECK(!MeshCache::Validate(file.Bytes.data(), sizeof(MeshCache::Header) - 1));
+    RemoveTestCache(file);
+}
@@ -0,0 +1,176 @@
+﻿#include "TestFramework.h"
+#include <MeshSimplifier.h>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+
+    // Сетка (n+1) x (n+1) вершин на квадрате [0,1]^2 с высотой height(x, y), все треугольники смотрят вверх (+z)
+    template <typename HeightFunc>
+    void MakeGrid(int n, HeightFunc height, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        vertices.clear();
+        indices.clear();
+        for (int y = 0; y <= n; ++y) {
+            for (int x = 0; x <= n; ++x) {
+                Vertex v{};
+                const float fx = (float)x / n, fy = (float)y / n;
+                v.Position = Math::float3(fx, fy, height(fx, fy));
+                v.Normal = Math::float3(0.0f, 0.0f, 1.0f);
+                v.UV = Math::float2(fx, fy);
+                vertices.push_back(v);
+            }
+        }
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                const unsigned int a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+                indices.insert(indices.end(), { a, b, d, a, d, c });
+            }
+        }
+    }
+
+    float Flat(float, float) { return 0.0f; }
+
+    float Bumps(float x, float y) {
+        return 0.05f * std::sin(x * 6.0f) * std::cos(y * 5.0f);
+    }
+
+    Math::float3 TriangleNormal(const std::vector<Vertex>& vertices, const unsigned int* t) {
+        const Math::float3& p0 = vertices[t[0]].Position;
+        return Math::cross(vertices[t[1]].Position - p0, vertices[t[2]].Position - p0);
+    }
+
+    // Высота упрощенной поверхности над точкой (x, y); false, если точка не накрыта ни одним треугольником
+    bool SurfaceHeight(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, float x, float y, float& z) {
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            const Math::float3& a = vertices[indices[i]].Position;
+            const Math::float3& b = vertices[indices[i + 1]].Position;
+            const Math::float3& c = vertices[indices[i + 2]].Position;
+            const float det = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+            if (std::abs(det) < 1e-12f) continue;
+            const float u = ((x - a.x) * (c.y - a.y) - (c.x - a.x) * (y - a.y)) / det;
+            const float v = ((b.x - a.x) * (y - a.y) - (x - a.x) * (b.y - a.y)) / det;
+            if (u < -1e-5f || v < -1e-5f || u + v > 1.0f + 1e-5f) continue;
+            z = a.z + u * (b.z - a.z) + v * (c.z - a.z);
+            return true;
+        }
+        return false;
+    }
+}
+
+TEST(MeshSimplifier_FlatGridCollapsesToTwoTriangles) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeGrid(16, Flat, vertices, indices);
+
+    std::vector<unsigned int> simplified;
+    MeshSimplifier::Result r = MeshSimplifier::Simplify(vertices.data(), vertices.size(), indices.data(), indices.size(),
+                                                        6, 1e-5f, simplified);
+    CHECK_EQ(simplified.size(), (size_t)6);
+    CHECK_EQ(r.IndexCount, simplified.size());
+    CHECK(r.Error <= 1e-5f);
+
+    // Остаются углы квадрата, площадь не меняется
+    float area = 0.0f;
+    for (size_t i = 0; i < simplified.size(); i += 3) area += TriangleNormal(vertices, &simplified[i]).z * 0.5f;
+    CHECK_NEAR(area, 1.0f, 1e-4f);
+    for (unsigned int index : simplified) {
+        const Math::float3& p = vertices[index].Position;
+        CHECK((p.x == 0.0f || p.x == 1.0f) && (p.y == 0.0f || p.y == 1.0f));
+    }
+}
+
+TEST(MeshSimplifier_RespectsIndexBudget) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeGrid(32, Bumps, vertices, indices);
+
+    for (size_t target : { indices.size() / 2, indices.size() / 4, indices.size() / 10 }) {
+        std::vector<unsigned int> simplified;
+        MeshSimplifier::Result r = MeshSimplifier::Simplify(vertices.data(), vertices.size(), indices.data(), indices.size(),
+                                                            target, FLT_MAX, simplified);
+        CHECK(simplified.size() <= target);
+        CHECK(simplified.size() >= 3);
+        CHECK_EQ(simplified.size() % 3, (size_t)0);
+        CHECK_EQ(r.IndexCount, simplified.size());
+    }
+
+    // Бюджет не меньше исходника - индексы возвращаются как есть
+    std::vector<unsigned int> same;
+    MeshSimplifier::Simplify(vertices.data(), vertices.size(), indices.data(), indices.size(), indices.size(), FLT_MAX, same);
+    CHECK(same == indices);
+}
+
+TEST(MeshSimplifier_RespectsTargetError) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeGrid(32, Bumps, vertices, indices);
+
+    for (float targetError : { 0.001f, 0.005f, 0.02f }) {
+        std::vector<unsigned int> simplified;
+        MeshSimplifier::Result r = MeshSimplifier::Simplify(vertices.data(), vertices.size(), indices.data(), indices.size(),
+                                                            3, targetError, simplified);
+        CHECK(r.Error <= targetError);
+        CHECK(simplified.size() < indices.size());
+
+        // Реальное отклонение: исходные вершины против упрощенной поверхности по вертикали
+        float deviation = 0.0f;
+        for (const Vertex& v : vertices) {
+            float z = 0.0f;
+            REQUIRE(SurfaceHeight(vertices, simplified, v.Position.x, v.Position.y, z));
+            deviation = std::max(deviation, std::abs(z - v.Position.z));
+        }
+        CHECK(deviation <= targetError * 1.05f);
+    }
+}
+
+TEST(MeshSimplifier_PreservesBorders) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeGrid(24, Bumps, vertices, indices);
+
+    std::vector<unsigned int> simplified;
+    MeshSimplifier::Simplify(vertices.data(), vertices.size(), indices.data(), indices.size(), indices.size() / 8, 0.01f,
+                             simplified);
+    REQUIRE(simplified.size() < indices.size() / 2);
+
+    // Проекция на XY по-прежнему покрывает весь квадрат: граница не ушла внутрь и не вышла наружу
+    float area = 0.0f;
+    for (size_t i = 0; i < simplified.size(); i += 3) area += TriangleNormal(vertices, &simplified[i]).z * 0.5f;
+    CHECK_NEAR(area, 1.0f, 1e-4f);
+
+    // Вершины исходной границы остаются на ней же
+    for (unsigned int index : simplified) {
+        const Math::float3& p = vertices[index].Position;
+        CHECK(p.x >= 0.0f && p.x <= 1.0f && p.y >= 0.0f && p.y <= 1.0f);
+    }
+    const Math::float3 corners[4] = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 } };
+    for (const Math::float3& corner : corners) {
+        float z = 0.0f;
+        CHECK(SurfaceHeight(vertices, simplified, corner.x, corner.y, z));
+    }
+}
+
+TEST(MeshSimplifier_DoesNotFlipTriangles) {
+    // Крутые склоны: треугольники могут встать почти вертикально, но не развернуться против поверхности
+    const float amplitude = 0.2f;
+    auto height = [=](float x, float y) { return amplitude * std::sin(x * 12.0f) * std::sin(y * 9.0f); };
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeGrid(32, height, vertices, indices);
+
+    for (size_t target : { indices.size() / 3, indices.size() / 20 }) {
+        std::vector<unsigned int> simplified;
+        MeshSimplifier::Simplify(vertices.data(), vertices.size(), indices.data(), indices.size(), target, FLT_MAX, simplified);
+        REQUIRE(!simplified.empty());
+        int flipped = 0;
+        for (size_t i = 0; i < simplified.size(); i += 3) {
+            // Нормаль поверхности в центре треугольника
+            Math::float3 center = (vertices[simplified[i]].Position + vertices[simplified[i + 1]].Position +
+                                   vertices[simplified[i + 2]].Position) * (1.0f / 3.0f);
+            Math::float3 surfaceNormal(-amplitude * 12.0f * std::cos(center.x * 12.0f) * std::sin(center.y * 9.0f),
+                                       -amplitude * 9.0f * std::sin(center.x * 12.0f) * std::cos(center.y * 9.0f), 1.0f);
+            if (Math::dot(TriangleNormal(vertices, &simplified[i]), surfaceNormal) <= 0.0f) flipped++;
+        }
+        CHECK_EQ(flipped, 0);
+    }
+}
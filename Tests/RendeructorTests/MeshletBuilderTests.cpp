@@ -0,0 +1,149 @@
+﻿#include "TestFramework.h"
+#include <MeshletBuilder.h>
+#include <array>
+#include <cmath>
+#include <set>
+
+namespace {
+
+    // UV-сфера с волнистым радиусом: нормали смотрят во все стороны, у кластеров конусы разного раствора
+    void MakeBumpySphere(int segments, int rings, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        vertices.clear();
+        indices.clear();
+        for (int r = 0; r <= rings; ++r) {
+            const float theta = 3.14159265f * r / rings;
+            for (int s = 0; s <= segments; ++s) {
+                const float phi = 6.2831853f * s / segments;
+                const float radius = 1.0f + 0.15f * std::sin(theta * 5.0f) * std::cos(phi * 4.0f);
+                Vertex v{};
+                v.Position = Math::float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)) * radius;
+                vertices.push_back(v);
+            }
+        }
+        for (int r = 0; r < rings; ++r) {
+            for (int s = 0; s < segments; ++s) {
+                const unsigned int a = r * (segments + 1) + s, b = a + 1, c = a + segments + 1, d = c + 1;
+                indices.insert(indices.end(), { a, b, d, a, d, c });
+            }
+        }
+    }
+
+    struct MeshletSet {
+        std::vector<Meshlet> Meshlets;
+        std::vector<unsigned int> Vertices;
+        std::vector<unsigned char> Triangles;
+
+        // Глобальные индексы вершин треугольника t кластера m
+        std::array<unsigned int, 3> Triangle(const Meshlet& m, unsigned int t) const {
+            const unsigned char* local = Triangles.data() + ((size_t)m.TriangleOffset + t) * 3;
+            return { Vertices[m.VertexOffset + local[0]], Vertices[m.VertexOffset + local[1]], Vertices[m.VertexOffset + local[2]] };
+        }
+    };
+
+    MeshletSet BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                             size_t maxVertices, size_t maxTriangles) {
+        MeshletSet set;
+        MeshletBuilder::Build(vertices.data(), vertices.size(), indices.data(), indices.size(), maxVertices, maxTriangles,
+                              set.Meshlets, set.Vertices, set.Triangles);
+        return set;
+    }
+
+    // Треугольник смотрит на камеру, если она по ту сторону его плоскости, куда указывает нормаль (cross(p1-p0, p2-p0))
+    bool FacesCamera(const Math::float3& p0, const Math::float3& p1, const Math::float3& p2, const Math::float3& camera) {
+        const Math::float3 n = Math::cross(p1 - p0, p2 - p0);
+        return Math::dot(n, camera - p0) > 1e-5f * Math::length(n);
+    }
+}
+
+TEST(MeshletBuilder_CoversEveryTriangleOnce) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeBumpySphere(48, 32, vertices, indices);
+    const MeshletSet set = BuildMeshlets(vertices, indices, 64, 124);
+    REQUIRE(!set.Meshlets.empty());
+
+    std::multiset<std::array<unsigned int, 3>> expected, built;
+    for (size_t i = 0; i < indices.size(); i += 3) expected.insert({ indices[i], indices[i + 1], indices[i + 2] });
+
+    for (const Meshlet& m : set.Meshlets) {
+        CHECK(m.VertexCount <= 64);
+        CHECK(m.TriangleCount >= 1 && m.TriangleCount <= 124);
+        for (unsigned int t = 0; t < m.TriangleCount; ++t) built.insert(set.Triangle(m, t));
+    }
+    // Порядок вершин внутри треугольника сохраняется - иначе поменялась бы ориентация
+    CHECK(built == expected);
+}
+
+TEST(MeshletBuilder_SpheresContainTriangles) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeBumpySphere(48, 32, vertices, indices);
+    const MeshletSet set = BuildMeshlets(vertices, indices, 64, 124);
+
+    int outside = 0;
+    for (const Meshlet& m : set.Meshlets) {
+        for (unsigned int t = 0; t < m.TriangleCount; ++t) {
+            for (unsigned int v : set.Triangle(m, t)) {
+                if (Math::length(vertices[v].Position - m.Center) > m.Radius * (1.0f + 1e-5f) + 1e-6f) outside++;
+            }
+        }
+    }
+    CHECK_EQ(outside, 0);
+}
+
+TEST(MeshletBuilder_ConeNeverCullsFrontFacingTriangles) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeBumpySphere(48, 32, vertices, indices);
+
+    Mesh mesh;
+    mesh.SetKeepCPUData(true);
+    mesh.CreateFromMemory(vertices.data(), vertices.size(), indices.data(), indices.size(),
+                          Math::float3(-1.2f, -1.2f, -1.2f), Math::float3(1.2f, 1.2f, 1.2f));
+    REQUIRE(mesh.BuildMeshlets(64, 124) > 0);
+
+    int cones = 0;
+    for (const Meshlet& m : mesh.GetMeshlets()) cones += m.ConeCutoff < 1.0f ? 1 : 0;
+    REQUIRE(cones > 0);
+
+    // Фрустум без отсечения: проверяется только конус нормалей
+    Frustum everything;
+    for (Math::float4& plane : everything.Planes) plane = Math::float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    // Неравномерный масштаб поворачивает нормали иначе, чем оси конуса - он тоже не должен терять видимое
+    const Math::float4x4 worlds[3] = {
+        Math::float4x4::identity(),
+        Math::float4x4::scaling(2.5f) * Math::float4x4::rotation_y(0.7f) * Math::float4x4::translation(3.0f, -1.0f, 2.0f),
+        Math::float4x4::scaling(4.0f, 0.25f, 1.0f) * Math::float4x4::rotation_y(0.4f) * Math::float4x4::translation(-2.0f, 0.5f, 1.0f),
+    };
+
+    Tests::Random random(11);
+    int missing = 0;
+    int backfaceCulled = 0;
+    std::vector<unsigned int> culled;
+    for (const Math::float4x4& world : worlds) {
+        std::vector<Math::float3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) positions[i] = world.transform_point(vertices[i].Position);
+
+        for (int c = 0; c < 64; ++c) {
+            // Камеры и вплотную к поверхности, и далеко от нее
+            const float distance = c % 2 ? random.Range(1.5f, 3.0f) : random.Range(5.0f, 40.0f);
+            Math::float3 direction(random.Range(-1.0f, 1.0f), random.Range(-1.0f, 1.0f), random.Range(-1.0f, 1.0f));
+            if (Math::length(direction) < 1e-3f) direction = Math::float3(0.0f, 0.0f, 1.0f);
+            const Math::float3 camera = world.transform_point(Math::float3(0.0f, 0.0f, 0.0f)) + Math::normalize(direction) * distance;
+
+            const MeshletCullStats stats = mesh.CullMeshlets(everything, camera, world, culled);
+            backfaceCulled += stats.BackfaceCulled;
+
+            std::set<std::array<unsigned int, 3>> kept;
+            for (size_t i = 0; i + 2 < culled.size(); i += 3) kept.insert({ culled[i], culled[i + 1], culled[i + 2] });
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                if (!FacesCamera(positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]], camera)) continue;
+                if (!kept.count({ indices[i], indices[i + 1], indices[i + 2] })) missing++;
+            }
+        }
+    }
+    CHECK_EQ(missing, 0);
+    // Тест не вырожден: конусы действительно отсекали кластеры
+    CHECK(backfaceCulled > 0);
+}
@@ -0,0 +1,199 @@
+﻿#include "TestFramework.h"
+#include <ObjParser.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <TinyObjLoader/TinyObjLoader.h>
+
+namespace {
+
+    // Сетка cols x rows квадов с позициями, uv и нормалями - типичный вид фотограмметрии после экспорта
+    std::string GenerateGridObj(int cols, int rows) {
+        std::string text;
+        text.reserve((size_t)(cols + 1) * (rows + 1) * 110 + (size_t)cols * rows * 60);
+        char line[160];
+
+        for (int y = 0; y <= rows; ++y) {
+            for (int x = 0; x <= cols; ++x) {
+                const float fx = x * 0.013f - 3.25f;
+                const float fz = y * 0.017f + 1.5f;
+                const float fy = std::sin(fx * 2.1f) * std::cos(fz * 1.3f) * 0.25f;
+                snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                    fx, fy, fz, (float)x / cols, (float)y / rows, 0.0f, 1.0f, 0.0f);
+                text += line;
+            }
+        }
+
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < cols; ++x) {
+                const int a = y * (cols + 1) + x + 1;
+                const int b = a + 1;
+                const int c = a + cols + 2;
+                const int d = a + cols + 1;
+                snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c, d, d, d);
+                text += line;
+            }
+        }
+        return text;
+    }
+
+    bool SameMesh(const ObjParser::ParsedMesh& a, const ObjParser::ParsedMesh& b) {
+        if (a.Vertices.size() != b.Vertices.size() || a.Indices != b.Indices) return false;
+        for (size_t i = 0; i < a.Vertices.size(); ++i) {
+            if (memcmp(&a.Vertices[i], &b.Vertices[i], sizeof(Vertex)) != 0) return false;
+        }
+        return true;
+    }
+}
+
+TEST(ObjParser_TriangulatesQuadsAndResolvesNegativeIndices) {
+    const std::string obj =
+        "# quad + triangle\n"
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+        "f 1 2 3 4\n"
+        "v 2 0 0\n"
+        "f -4 -1 -3\n";
+
+    ObjParser::ParsedMesh mesh;
+    REQUIRE(ObjParser::Parse(obj.data(), obj.size(), mesh, nullptr, 1));
+    CHECK_EQ(mesh.PositionCount, (size_t)5);
+    CHECK_EQ(mesh.Indices.size(), (size_t)9);
+    // Только позиции: одна вершина на позицию, нормали посчитаны по граням
+    CHECK_EQ(mesh.Vertices.size(), (size_t)5);
+    CHECK(!mesh.HasNormals);
+    CHECK_NEAR(mesh.Vertices[0].Normal.z, 1.0f, 1e-4f);
+
+    // -4 -1 -3 после пятой позиции - это 2, 5, 3
+    CHECK_NEAR(mesh.Vertices[mesh.Indices[6]].Position.x, 1.0f, 0.0f);
+    CHECK_NEAR(mesh.Vertices[mesh.Indices[7]].Position.x, 2.0f, 0.0f);
+    CHECK_NEAR(mesh.Vertices[mesh.Indices[8]].Position.y, 1.0f, 0.0f);
+}
+
+TEST(ObjParser_RejectsOutOfRangeNegativeIndices) {
+    const std::string prefix = "v 0 0 0\nv 1 0 0\nv 1 1 0\nvt 0 0\nvn 0 0 1\n";
+    const char* faces[] = { "f 1/-99/1 2/1/1 3/1/1\n", "f 1/1/-99 2/1/1 3/1/1\n", "f 1//-2 2//1 3//1\n", "f -4 2 3\n" };
+    for (const char* face : faces) {
+        const std::string obj = prefix + face;
+        ObjParser::ParsedMesh mesh;
+        CHECK(!ObjParser::Parse(obj.data(), obj.size(), mesh, nullptr, 1));
+    }
+
+    // Отрицательные индексы в пределах прочитанного по-прежнему допустимы
+    const std::string obj = prefix + "f -3/-1/-1 -2/-1/-1 -1/-1/-1\n";
+    ObjParser::ParsedMesh mesh;
+    REQUIRE(ObjParser::Parse(obj.data(), obj.size(), mesh, nullptr, 1));
+    CHECK(mesh.HasNormals);
+}
+
+TEST(ObjParser_ParsesFloatsLikeStrtod) {
+    const char* values[] = { "1", "-0.5", "3.14159265", "1e-3", "-2.5E+2", "123456.789", ".25", "0.000001234" };
+    std::string obj;
+    for (const char* value : values) obj += std::string("v ") + value + " 0 0\n";
+    obj += "f 1 2 3\nf 4 5 6\nf 6 7 8\n";
+
+    ObjParser::ParsedMesh mesh;
+    REQUIRE(ObjParser::Parse(obj.data(), obj.size(), mesh, nullptr, 1));
+    REQUIRE(mesh.Vertices.size() == 8);
+    for (int i = 0; i < 8; ++i) {
+        const float expected = (float)strtod(values[i], nullptr);
+        CHECK_NEAR(mesh.Vertices[i].Position.x, expected, std::fabs(expected) * 1e-6f);
+    }
+}
+
+TEST(ObjParser_GroupsTrianglesByMaterial) {
+    const std::string obj =
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+        "usemtl Red\nf 1 2 3\n"
+        "usemtl Blue\nf 1 3 4\n"
+        "usemtl Red\nf 2 3 4\n";
+
+    ObjParser::ParsedMesh mesh;
+    REQUIRE(ObjParser::Parse(obj.data(), obj.size(), mesh, nullptr, 1));
+    REQUIRE(mesh.MaterialNames.size() == 2);
+    CHECK(mesh.MaterialNames[0] == "Red");
+    CHECK(mesh.MaterialNames[1] == "Blue");
+    REQUIRE(mesh.SubMeshes.size() == 2);
+    CHECK_EQ(mesh.SubMeshes[0].StartIndex, 0);
+    CHECK_EQ(mesh.SubMeshes[0].IndexCount, 6);
+    CHECK_EQ(mesh.SubMeshes[1].StartIndex, 6);
+    CHECK_EQ(mesh.SubMeshes[1].IndexCount, 3);
+}
+
+TEST(ObjParser_InlineCommentsEndTheLine) {
+    // Все после '#' - комментарий, даже внутри токена: у второй грани остается два угла, и она пропускается
+    // обоими проходами, а не считается пустой и разбирается треугольником
+    const std::string obj =
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0 # last\n"
+        "vt 0.5#0.25\n"
+        "f 1 2 3 # lower half\n"
+        "f 1 3#x 4\n"
+        "f 1 3 4#\n";
+
+    ObjParser::ParsedMesh mesh;
+    REQUIRE(ObjParser::Parse(obj.data(), obj.size(), mesh, nullptr, 1));
+    CHECK_EQ(mesh.PositionCount, (size_t)4);
+    REQUIRE(mesh.Indices.size() == 6);
+    CHECK_NEAR(mesh.Vertices[mesh.Indices[2]].Position.y, 1.0f, 0.0f);
+    CHECK_NEAR(mesh.Vertices[mesh.Indices[5]].Position.x, 0.0f, 0.0f);
+    CHECK_NEAR(mesh.Vertices[mesh.Indices[5]].Position.y, 1.0f, 0.0f);
+}
+
+TEST(ObjParser_RejectsOutOfRangeIndices) {
+    const std::string obj = "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n";
+    ObjParser::ParsedMesh mesh;
+    CHECK(!ObjParser::Parse(obj.data(), obj.size(), mesh, nullptr, 1));
+
+    const std::string noFaces = "v 0 0 0\nv 1 0 0\n";
+    CHECK(!ObjParser::Parse(noFaces.data(), noFaces.size(), mesh, nullptr, 1));
+}
+
+TEST(ObjParser_ResultDoesNotDependOnThreadCount) {
+    // Несколько мегабайт, чтобы файл действительно разрезался на чанки
+    const std::string obj = GenerateGridObj(300, 200);
+
+    ObjParser::ParsedMesh single;
+    ObjParser::ParsedMesh parallel;
+    ObjParser::ParseStats stats;
+    REQUIRE(ObjParser::Parse(obj.data(), obj.size(), single, nullptr, 1));
+    REQUIRE(ObjParser::Parse(obj.data(), obj.size(), parallel, &stats, 8));
+    CHECK(stats.Threads > 1);
+    CHECK_EQ(single.Indices.size(), (size_t)300 * 200 * 6);
+    CHECK_EQ(single.Vertices.size(), (size_t)301 * 201);
+    CHECK(SameMesh(single, parallel));
+}
+
+// Пропускная способность на большом файле: однопоточный и многопоточный разбор из памяти, с диска через
+// отображение файла и, для сравнения, tinyobjloader, через который LoadFromOBJ шел раньше
+BENCHMARK(ObjParser_Throughput) {
+    const std::string obj = GenerateGridObj(1500, 1000);
+    const double megabytes = obj.size() / (1024.0 * 1024.0);
+    std::printf("    OBJ: %.1f MB, %d quads\n", megabytes, 1500 * 1000);
+
+    ObjParser::ParsedMesh mesh;
+    ObjParser::ParseStats stats;
+    REQUIRE(ObjParser::Parse(obj.data(), obj.size(), mesh, &stats, 1));
+    std::printf("    ObjParser, 1 thread:     %8.1f MB/s\n", stats.MegabytesPerSecond());
+
+    REQUIRE(ObjParser::Parse(obj.data(), obj.size(), mesh, &stats, 0));
+    std::printf("    ObjParser, %2d threads:   %8.1f MB/s\n", stats.Threads, stats.MegabytesPerSecond());
+
+    const std::string path = (std::filesystem::temp_directory_path() / "rendeructor_bench.obj").string();
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(obj.data(), (std::streamsize)obj.size());
+    }
+    const bool fromFile = ObjParser::ParseFile(path, mesh, &stats, 0);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    REQUIRE(fromFile);
+    std::printf("    ObjParser, mapped file:  %8.1f MB/s\n", stats.MegabytesPerSecond());
+
+    tinyobj::ObjReader reader;
+    Tests::Timer timer;
+    const bool tinyOk = reader.ParseFromString(obj, "");
+    const double tinyMs = timer.Milliseconds();
+    CHECK(tinyOk);
+    std::printf("    tinyobjloader:           %8.1f MB/s\n", megabytes / (tinyMs / 1000.0));
+}
@@ -0,0 +1,311 @@
+﻿#include "TestFramework.h"
+#include <OcclusionCuller.h>
+#include <InstanceCuller.h>
+#include <algorithm>
+
+namespace {
+
+    const Math::float3 kEye = { 0.0f, 2.0f, -20.0f };
+    const float kNear = 0.5f;
+    const float kFar = 200.0f;
+
+    struct Box {
+        Math::float3 Min;
+        Math::float3 Max;
+    };
+
+    Box MakeBox(const Math::float3& center, const Math::float3& size) {
+        return { center - size * 0.5f, center + size * 0.5f };
+    }
+
+    Math::float4x4 MakeViewProjection(const Math::float3& eye, const Math::float3& target) {
+        return Math::float4x4::look_at_lh(eye, target, { 0, 1, 0 }) *
+            Math::float4x4::perspective_lh_zo(3.14159265f / 3.0f, 2.0f, kNear, kFar);
+    }
+
+    // Замкнутый бокс из 12 треугольников - окклюдер, сплошной с любой стороны
+    void AppendBox(const Box& box, std::vector<Math::float3>& positions, std::vector<unsigned int>& indices) {
+        const unsigned int base = (unsigned int)positions.size();
+        for (int c = 0; c < 8; ++c) {
+            positions.push_back(Math::float3((c & 1) ? box.Max.x : box.Min.x, (c & 2) ? box.Max.y : box.Min.y, (c & 4) ? box.Max.z : box.Min.z));
+        }
+        const unsigned int faces[12][3] = {
+            { 0, 2, 3 }, { 0, 3, 1 }, { 4, 5, 7 }, { 4, 7, 6 }, // -z, +z
+            { 0, 4, 6 }, { 0, 6, 2 }, { 1, 3, 7 }, { 1, 7, 5 }, // -x, +x
+            { 0, 1, 5 }, { 0, 5, 4 }, { 2, 6, 7 }, { 2, 7, 3 }, // -y, +y
+        };
+        for (const auto& face : faces) {
+            for (unsigned int corner : face) indices.push_back(base + corner);
+        }
+    }
+
+    void RenderBoxes(OcclusionCuller& culler, const std::vector<Box>& boxes) {
+        std::vector<Math::float3> positions;
+        std::vector<unsigned int> indices;
+        for (const Box& box : boxes) AppendBox(box, positions, indices);
+        culler.RenderOccluder(positions.data(), (int)positions.size(), indices.data(), (int)indices.size(), Math::float4x4::identity());
+    }
+
+    bool IsVisible(const OcclusionCuller& culler, const Box& box) {
+        return culler.IsVisible(box.Min, box.Max);
+    }
+
+    // Отрезок eye -> point пересекает бокс (метод плит)
+    bool SegmentHitsBox(const Math::float3& eye, const Math::float3& point, const Box& box) {
+        const float origin[3] = { eye.x, eye.y, eye.z };
+        const float dir[3] = { point.x - eye.x, point.y - eye.y, point.z - eye.z };
+        const float lo[3] = { box.Min.x, box.Min.y, box.Min.z };
+        const float hi[3] = { box.Max.x, box.Max.y, box.Max.z };
+        float tMin = 0.0f;
+        float tMax = 1.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (std::fabs(dir[axis]) < 1e-12f) {
+                if (origin[axis] < lo[axis] || origin[axis] > hi[axis]) return false;
+                continue;
+            }
+            float t0 = (lo[axis] - origin[axis]) / dir[axis];
+            float t1 = (hi[axis] - origin[axis]) / dir[axis];
+            if (t0 > t1) std::swap(t0, t1);
+            tMin = std::max(tMin, t0);
+            tMax = std::min(tMax, t1);
+            if (tMin > tMax) return false;
+        }
+        return true;
+    }
+
+    // Точка бокса видна с запасом: на экране не у самого края и луч к ней не задевает ни один окклюдер,
+    // раздутый на пару пикселей (растеризация по центрам пикселей точна только до пикселя)
+    bool ClearlyVisible(const Math::float3& point, const Math::float4x4& viewProjection, int width, int height,
+                        const Math::float3& eye, const std::vector<Box>& inflatedOccluders) {
+        const Math::float4 clip = viewProjection.row0() * point.x + viewProjection.row1() * point.y +
+            viewProjection.row2() * point.z + viewProjection.row3();
+        if (clip.w < kNear) return false;
+        const float sx = (clip.x / clip.w * 0.5f + 0.5f) * width;
+        const float sy = (0.5f - clip.y / clip.w * 0.5f) * height;
+        if (sx < 1.0f || sy < 1.0f || sx > width - 1.0f || sy > height - 1.0f || clip.z / clip.w > 1.0f) return false;
+
+        for (const Box& occluder : inflatedOccluders) {
+            if (SegmentHitsBox(eye, point, occluder)) return false;
+        }
+        return true;
+    }
+
+    bool AnyPointClearlyVisible(const Box& box, const Math::float4x4& viewProjection, int width, int height,
+                                const Math::float3& eye, const std::vector<Box>& inflatedOccluders) {
+        const int steps = 4;
+        for (int axis = 0; axis < 3; ++axis) {
+            for (int side = 0; side < 2; ++side) {
+                for (int i = 0; i < steps; ++i) {
+                    for (int j = 0; j < steps; ++j) {
+                        float coords[3];
+                        const float u = (float)i / (steps - 1), v = (float)j / (steps - 1);
+                        const float lo[3] = { box.Min.x, box.Min.y, box.Min.z };
+                        const float hi[3] = { box.Max.x, box.Max.y, box.Max.z };
+                        coords[axis] = side ? hi[axis] : lo[axis];
+                        coords[(axis + 1) % 3] = lo[(axis + 1) % 3] + (hi[(axis + 1) % 3] - lo[(axis + 1) % 3]) * u;
+                        coords[(axis + 2) % 3] = lo[(axis + 2) % 3] + (hi[(axis + 2) % 3] - lo[(axis + 2) % 3]) * v;
+                        if (ClearlyVisible(Math::float3(coords[0], coords[1], coords[2]), viewProjection, width, height, eye, inflatedOccluders)) {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+}
+
+TEST(OcclusionCuller_WallHidesWhatIsBehindIt) {
+    OcclusionCuller culler;
+    culler.Begin(MakeViewProjection(kEye, { 0, 2, 0 }));
+    RenderBoxes(culler, { MakeBox({ 0, 2, 0 }, { 10, 6, 0.5f }) });
+    culler.End();
+    CHECK_EQ(culler.GetStats().Occluders, 1);
+    CHECK(culler.GetStats().Triangles > 0);
+
+    CHECK(!IsVisible(culler, MakeBox({ 0, 2, 10 }, { 1, 1, 1 })));      // прямо за стеной
+    CHECK(!IsVisible(culler, MakeBox({ 2, 1.5f, 30 }, { 2, 2, 2 })));   // далеко за стеной
+    CHECK(IsVisible(culler, MakeBox({ 0, 2, -5 }, { 1, 1, 1 })));       // перед стеной
+    CHECK(IsVisible(culler, MakeBox({ 20, 2, 10 }, { 1, 1, 1 })));      // сбоку, стена его не закрывает
+    // За стеной, но верх выглядывает: луч от глаза над краем стены (y = 5) на глубине 30 проходит на высоте 6.5
+    CHECK(IsVisible(culler, MakeBox({ 0, 7, 10 }, { 1, 2, 1 })));
+    CHECK(!IsVisible(culler, MakeBox({ 0, 1.5f, 10 }, { 1, 3, 1 })));
+    // Больше стены в проекции - часть тайлов пустая
+    CHECK(IsVisible(culler, MakeBox({ 0, 2, 10 }, { 30, 1, 1 })));
+}
+
+TEST(OcclusionCuller_NoOccludersMeansEverythingIsVisible) {
+    OcclusionCuller notStarted;
+    CHECK(IsVisible(notStarted, MakeBox({ 0, 0, 0 }, { 1, 1, 1 })));
+
+    OcclusionCuller culler;
+    culler.Begin(MakeViewProjection(kEye, { 0, 2, 0 }));
+    culler.End();
+    for (float z = -10.0f; z < 150.0f; z += 10.0f) CHECK(IsVisible(culler, MakeBox({ 0, 2, z }, { 1, 1, 1 })));
+    for (float depth : culler.GetDepth()) {
+        if (depth != 1.0f) {
+            CHECK_EQ(depth, 1.0f);
+            break;
+        }
+    }
+}
+
+TEST(OcclusionCuller_NearPlaneAndOffscreenBoxesStayVisible) {
+    OcclusionCuller culler;
+    culler.Begin(MakeViewProjection(kEye, { 0, 2, 0 }));
+    // Стена закрывает весь экран
+    RenderBoxes(culler, { MakeBox({ 0, 2, -10 }, { 200, 200, 0.5f }) });
+    culler.End();
+
+    CHECK(!IsVisible(culler, MakeBox({ 0, 2, 10 }, { 1, 1, 1 })));
+    // Бокс вокруг камеры пересекает ближнюю плоскость - спроецировать его нельзя, считаем видимым
+    CHECK(IsVisible(culler, MakeBox(kEye, { 2, 2, 2 })));
+    // Позади камеры и вне экрана - это решает фрустум, не окклюзия
+    CHECK(IsVisible(culler, MakeBox({ 0, 2, -40 }, { 1, 1, 1 })));
+}
+
+TEST(OcclusionCuller_DepthMatchesProjection) {
+    OcclusionCuller culler;
+    culler.Begin(MakeViewProjection({ 0, 0, 0 }, { 0, 0, 1 }), 64, 32);
+    CHECK_EQ(culler.GetWidth(), 64);
+    CHECK_EQ(culler.GetHeight(), 32);
+
+    const float distance = 10.0f;
+    RenderBoxes(culler, { MakeBox({ 0, 0, distance + 1.0f }, { 100, 100, 2.0f }) });
+    culler.End();
+
+    // Передняя грань на глубине 10: z = f / (f - n) * (1 - n / d)
+    const float expected = kFar / (kFar - kNear) * (1.0f - kNear / distance);
+    const std::vector<float>& depth = culler.GetDepth();
+    CHECK_NEAR(depth[16 * 64 + 32], expected, 1e-4f);
+    CHECK_NEAR(depth[0], expected, 1e-4f);
+    CHECK_NEAR(depth[31 * 64 + 63], expected, 1e-4f);
+}
+
+// Случайная сцена: окклюдер не имеет права спрятать бокс, хоть одна точка которого видна с запасом.
+// Заодно проверяем, что перекрытие вообще находится, иначе тест ничего не доказывает
+TEST(OcclusionCuller_IsConservativeOnRandomScenes) {
+    const int width = 256;
+    const int height = 128;
+    int totalOccluded = 0;
+
+    for (unsigned int seed = 1; seed <= 4; ++seed) {
+        Tests::Random random(seed * 7919);
+        const Math::float3 eye(random.Range(-5.0f, 5.0f), random.Range(2.0f, 5.0f), -30.0f);
+        const Math::float4x4 viewProjection = MakeViewProjection(eye, { 0, 2, 0 });
+
+        std::vector<Box> occluders;
+        for (int i = 0; i < 6; ++i) {
+            occluders.push_back(MakeBox({ random.Range(-15.0f, 15.0f), random.Range(1.0f, 4.0f), random.Range(-5.0f, 15.0f) },
+                { random.Range(2.0f, 8.0f), random.Range(2.0f, 6.0f), random.Range(0.5f, 3.0f) }));
+        }
+
+        OcclusionCuller culler;
+        culler.Begin(viewProjection, width, height);
+        RenderBoxes(culler, occluders);
+        culler.End();
+
+        // Пиксель на глубине d - около 0.009 * d, раздуваем на два пикселя самой дальней точки окклюдера
+        std::vector<Box> inflated;
+        for (const Box& box : occluders) {
+            const float farthest = Math::length(Math::float3(std::max(std::fabs(box.Min.x - eye.x), std::fabs(box.Max.x - eye.x)),
+                std::max(std::fabs(box.Min.y - eye.y), std::fabs(box.Max.y - eye.y)), box.Max.z - eye.z));
+            const Math::float3 margin(0.02f * farthest, 0.02f * farthest, 0.02f * farthest);
+            inflated.push_back({ box.Min - margin, box.Max + margin });
+        }
+
+        for (int q = 0; q < 2000; ++q) {
+            const Box query = MakeBox({ random.Range(-25.0f, 25.0f), random.Range(0.0f, 6.0f), random.Range(-5.0f, 50.0f) },
+                { random.Range(0.3f, 2.0f), random.Range(0.3f, 2.0f), random.Range(0.3f, 2.0f) });
+            if (IsVisible(culler, query)) continue;
+
+            totalOccluded++;
+            if (AnyPointClearlyVisible(query, viewProjection, width, height, eye, inflated)) {
+                CHECK(!AnyPointClearlyVisible(query, viewProjection, width, height, eye, inflated));
+                return;
+            }
+        }
+    }
+    CHECK(totalOccluded > 200);
+}
+
+TEST(OcclusionCuller_MeshOccluderMatchesRawTriangles) {
+    std::vector<Math::float3> positions;
+    std::vector<unsigned int> indices;
+    AppendBox(MakeBox({ 0, 0, 0 }, { 2, 2, 2 }), positions, indices);
+
+    std::vector<Vertex> vertices;
+    for (const Math::float3& p : positions) {
+        vertices.push_back(Vertex(p, Math::float3(0, 0, 0), Math::float3(0, 0, 0), Math::float3(0, 0, 1), Math::float2(0, 0)));
+    }
+    Mesh mesh;
+    mesh.SetKeepCPUData(true);
+    mesh.CreateFromMemory(vertices.data(), vertices.size(), indices.data(), indices.size(), Math::float3(-1, -1, -1), Math::float3(1, 1, 1));
+    REQUIRE(mesh.BuildOccluder(64) == 12);
+
+    const Math::float4x4 world = Math::float4x4::scaling(5.0f, 3.0f, 0.25f) * Math::float4x4::translation(0, 2, 0);
+    const Math::float4x4 viewProjection = MakeViewProjection(kEye, { 0, 2, 0 });
+
+    OcclusionCuller fromMesh;
+    fromMesh.Begin(viewProjection);
+    fromMesh.RenderOccluder(mesh, world);
+    fromMesh.End();
+
+    OcclusionCuller fromBoxes;
+    fromBoxes.Begin(viewProjection);
+    RenderBoxes(fromBoxes, { MakeBox({ 0, 2, 0 }, { 10, 6, 0.5f }) });
+    fromBoxes.End();
+
+    CHECK(fromMesh.GetDepth() == fromBoxes.GetDepth());
+    // Тест по сетке и мировой матрице - тот же AABB, что и вручную
+    CHECK(!fromMesh.IsVisible(mesh, Math::float4x4::translation(0, 2, 10)));
+    CHECK(fromMesh.IsVisible(mesh, Math::float4x4::translation(0, 2, -5)));
+}
+
+TEST(OcclusionCuller_InstanceCullerCountsOccludedInstances) {
+    // Ряд стен перед полем кубов: часть экземпляров проходит фрустум, но закрыта
+    Mesh cube;
+    const Vertex corners[2] = {
+        Vertex(Math::float3(-0.5f, -0.5f, -0.5f), Math::float3(0, 0, 0), Math::float3(0, 0, 0), Math::float3(0, 0, 1), Math::float2(0, 0)),
+        Vertex(Math::float3(0.5f, 0.5f, 0.5f), Math::float3(0, 0, 0), Math::float3(0, 0, 0), Math::float3(0, 0, 1), Math::float2(0, 0)),
+    };
+    const unsigned int triangle[3] = { 0, 1, 0 };
+    cube.CreateFromMemory(corners, 2, triangle, 3, Math::float3(-0.5f, -0.5f, -0.5f), Math::float3(0.5f, 0.5f, 0.5f));
+
+    std::vector<Math::float4x4> worlds;
+    for (int z = 0; z < 40; ++z) {
+        for (int x = -40; x < 40; ++x) worlds.push_back(Math::float4x4::translation(x * 1.5f, 1.0f, 5.0f + z * 1.5f));
+    }
+    InstanceBuffer instances;
+    instances.SetKeepCPUData(true);
+    instances.Create(worlds.data(), (int)worlds.size(), sizeof(Math::float4x4));
+    instances.SetTransformOffset(0);
+
+    const Math::float4x4 viewProjection = MakeViewProjection(kEye, { 0, 2, 0 });
+    OcclusionCuller occlusion;
+    occlusion.Begin(viewProjection);
+    RenderBoxes(occlusion, { MakeBox({ -6, 2, 0 }, { 8, 6, 0.5f }), MakeBox({ 6, 2, 0 }, { 8, 6, 0.5f }) });
+    occlusion.End();
+
+    InstanceCuller culler;
+    culler.Build(instances, cube);
+    std::vector<unsigned int> frustumOnly;
+    std::vector<unsigned int> visible;
+    const Frustum frustum = Frustum::FromViewProjection(viewProjection);
+    InstanceCullStats withoutOcclusion = culler.Cull(frustum, frustumOnly);
+    InstanceCullStats stats = culler.Cull(frustum, visible, &occlusion);
+
+    CHECK_EQ(withoutOcclusion.Occluded, 0);
+    CHECK(stats.Occluded > 0);
+    CHECK_EQ(stats.Visible + stats.Occluded, withoutOcclusion.Visible);
+
+    // Каждый выброшенный экземпляр действительно закрыт по IsVisible, каждый оставшийся - нет
+    size_t next = 0;
+    for (unsigned int i : frustumOnly) {
+        const Box box = MakeBox(worlds[i].transform_point(Math::float3(0, 0, 0)), { 1, 1, 1 });
+        const bool kept = next < visible.size() && visible[next] == i;
+        if (kept) next++;
+        CHECK_EQ(kept, IsVisible(occlusion, box));
+    }
+    CHECK_EQ(next, visible.size());
+}
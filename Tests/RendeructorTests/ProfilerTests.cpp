@@ -0,0 +1,187 @@
+﻿#include "TestFramework.h"
+#include <Profiler.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+    const ProfileScopeStats* FindScope(const ProfileFrameSummary& summary, const char* name, int depth) {
+        for (const ProfileScopeStats& s : summary.Scopes) {
+            if (s.Name == name && s.Depth == depth) return &s;
+        }
+        return nullptr;
+    }
+
+    // Без бэкенда: только CPU, сводка публикуется сразу в EndFrame
+    struct CPUProfiler {
+        Profiler Instance;
+        CPUProfiler() {
+            Instance.Initialize(nullptr);
+        }
+        ~CPUProfiler() {
+            Instance.SetEnabled(true);
+            Instance.EndFrame();
+            Instance.Shutdown();
+        }
+    };
+}
+
+TEST(Profiler_SummarizesNestedScopes) {
+    CPUProfiler profiler;
+    for (int i = 0; i < 3; ++i) {
+        profiler.Instance.BeginScope("Frame", false);
+        {
+            RENDER_PROFILE_CPU_SCOPE("Inner");
+        }
+        Profiler::BeginCPUScope("Inner");
+        Profiler::EndCPUScope();
+        profiler.Instance.EndScope();
+    }
+    profiler.Instance.EndFrame();
+
+    const ProfileFrameSummary& summary = profiler.Instance.GetFrameSummary();
+    const ProfileScopeStats* frame = FindScope(summary, "Frame", 0);
+    const ProfileScopeStats* inner = FindScope(summary, "Inner", 1);
+    REQUIRE(frame && inner);
+    CHECK_EQ(frame->Calls, 3);
+    CHECK_EQ(inner->Calls, 6);
+    CHECK(frame->CpuMilliseconds >= inner->CpuMilliseconds);
+    CHECK_EQ(frame->GpuMilliseconds, -1.0);
+    CHECK_EQ(summary.DroppedEvents, 0ull);
+    // Порядок - по первому открытию
+    CHECK(summary.Scopes[0].Name == "Frame");
+}
+
+TEST(Profiler_DisabledRecordsNothingAndStaysBalanced) {
+    CPUProfiler profiler;
+    profiler.Instance.SetEnabled(false);
+    profiler.Instance.EndFrame();
+
+    // Scope открыт при выключенном профайлере и закрыт после включения: End не должен закрыть чужой scope
+    Profiler::BeginCPUScope("Outer");
+    profiler.Instance.SetEnabled(true);
+    profiler.Instance.EndFrame();
+    Profiler::BeginCPUScope("Recorded");
+    Profiler::EndCPUScope();
+    Profiler::EndCPUScope();
+    profiler.Instance.EndFrame();
+
+    const ProfileFrameSummary& summary = profiler.Instance.GetFrameSummary();
+    CHECK(FindScope(summary, "Outer", 0) == nullptr);
+    const ProfileScopeStats* recorded = FindScope(summary, "Recorded", 1);
+    REQUIRE(recorded != nullptr);
+    CHECK_EQ(recorded->Calls, 1);
+
+    // Поток, который пишет только при выключенном профайлере, кольцо не получает
+    profiler.Instance.SetEnabled(false);
+    profiler.Instance.EndFrame();
+    const int buffers = Profiler::GetThreadBufferCount();
+    std::thread([] {
+        for (int i = 0; i < 100; ++i) {
+            RENDER_PROFILE_CPU_SCOPE("Disabled");
+        }
+    }).join();
+    CHECK_EQ(Profiler::GetThreadBufferCount(), buffers);
+}
+
+TEST(Profiler_CPUSwitchIsProcessWide) {
+    CPUProfiler profiler;
+    profiler.Instance.EndFrame();
+
+    // Выключено напрямую: EndFrame экземпляра без изменения SetEnabled переключатель не возвращает
+    Profiler::SetCPUScopesEnabled(false);
+    profiler.Instance.EndFrame();
+    CHECK(!Profiler::AreCPUScopesEnabled());
+    std::thread([] { RENDER_PROFILE_CPU_SCOPE("Silenced"); }).join();
+    profiler.Instance.EndFrame();
+    CHECK(FindScope(profiler.Instance.GetFrameSummary(), "Silenced", 0) == nullptr);
+
+    Profiler::SetCPUScopesEnabled(true);
+    std::thread([] { RENDER_PROFILE_CPU_SCOPE("Heard"); }).join();
+    profiler.Instance.EndFrame();
+    CHECK(FindScope(profiler.Instance.GetFrameSummary(), "Heard", 0) != nullptr);
+
+    // Изменение SetEnabled применяется к переключателю для всех потоков
+    profiler.Instance.SetEnabled(false);
+    profiler.Instance.EndFrame();
+    CHECK(!Profiler::AreCPUScopesEnabled());
+    profiler.Instance.SetEnabled(true);
+    profiler.Instance.EndFrame();
+    CHECK(Profiler::AreCPUScopesEnabled());
+}
+
+TEST(Profiler_ExitedThreadsHandTheirBuffersOn) {
+    CPUProfiler profiler;
+    std::thread([] { RENDER_PROFILE_CPU_SCOPE("Warmup"); }).join();
+    const int buffers = Profiler::GetThreadBufferCount();
+
+    // Последовательные короткоживущие потоки (как задачи пула) не должны плодить кольца
+    for (int i = 0; i < 20; ++i) {
+        std::thread([] {
+            RENDER_PROFILE_CPU_SCOPE("Worker");
+        }).join();
+    }
+    CHECK_EQ(Profiler::GetThreadBufferCount(), buffers);
+
+    // События завершившихся потоков не теряются: кольцо с ними переходит к следующему потоку
+    profiler.Instance.EndFrame();
+    const ProfileScopeStats* worker = FindScope(profiler.Instance.GetFrameSummary(), "Worker", 0);
+    REQUIRE(worker != nullptr);
+    CHECK_EQ(worker->Calls, 20);
+}
+
+TEST(Profiler_CountsEventsOverwrittenBeforeTheyWereRead) {
+    CPUProfiler profiler;
+    profiler.Instance.EndFrame();
+
+    // Больше кольца за один кадр: старые события перезаписаны и должны попасть в DroppedEvents, а не в сводку
+    const int events = Profiler::kThreadEvents + 1000;
+    for (int i = 0; i < events; ++i) {
+        RENDER_PROFILE_CPU_SCOPE("Flood");
+    }
+    profiler.Instance.EndFrame();
+
+    const ProfileFrameSummary& summary = profiler.Instance.GetFrameSummary();
+    const ProfileScopeStats* flood = FindScope(summary, "Flood", 0);
+    REQUIRE(flood != nullptr);
+    CHECK_EQ(flood->Calls, Profiler::kThreadEvents);
+    CHECK_EQ(summary.DroppedEvents, 1000ull);
+}
+
+TEST(Profiler_ReaderNeverSeesTornEvents) {
+    CPUProfiler profiler;
+    profiler.Instance.EndFrame();
+
+    // Писатели без пауз обгоняют читателя; каждое прочитанное событие должно быть целым
+    std::atomic<bool> stop{ false };
+    std::atomic<int> started{ 0 };
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 3; ++t) {
+        writers.emplace_back([&stop, &started] {
+            started++;
+            while (!stop.load(std::memory_order_relaxed)) {
+                RENDER_PROFILE_CPU_SCOPE("Outer");
+                RENDER_PROFILE_CPU_SCOPE("Inner");
+            }
+        });
+    }
+
+    int badFrames = 0;
+    unsigned long long events = 0;
+    while (started < 3) std::this_thread::yield();
+    for (int frame = 0; frame < 200; ++frame) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        profiler.Instance.EndFrame();
+        for (const ProfileScopeStats& s : profiler.Instance.GetFrameSummary().Scopes) {
+            const bool known = (s.Name == "Outer" && s.Depth == 0) || (s.Name == "Inner" && s.Depth == 1);
+            if (!known || s.CpuMilliseconds < 0.0) badFrames++;
+            events += s.Calls;
+        }
+    }
+    stop = true;
+    for (auto& writer : writers) writer.join();
+
+    CHECK_EQ(badFrames, 0);
+    CHECK(events > 0);
+}
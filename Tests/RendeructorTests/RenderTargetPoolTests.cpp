@@ -0,0 +1,213 @@
+﻿#include "TestFramework.h"
+#include <RenderTargetPool.h>
+#include <algorithm>
+#include <utility>
+#include <set>
+
+namespace {
+
+    // Фейковое устройство: хэндлы - возрастающие номера, живые цели видны в Live
+    struct FakeDevice {
+        std::set<void*> Live;
+        size_t NextHandle = 1;
+        int Creates = 0;
+        int Destroys = 0;
+        int DoubleDestroys = 0;
+        bool FailCreate = false;
+
+        void Attach(RenderTargetPool& pool, size_t budget, int maxUnusedFrames = 60) {
+            pool.Initialize(
+                [this](const RenderTargetDesc&) -> void* {
+                    if (FailCreate) return nullptr;
+                    Creates++;
+                    void* handle = (void*)(NextHandle++);
+                    Live.insert(handle);
+                    return handle;
+                },
+                [this](void* handle) {
+                    Destroys++;
+                    if (Live.erase(handle) == 0) DoubleDestroys++;
+                },
+                budget, maxUnusedFrames);
+        }
+    };
+
+    RenderTargetDesc Desc(int width, int height, TextureFormat format = TextureFormat::RGBA8, unsigned int flags = 0) {
+        RenderTargetDesc desc;
+        desc.Width = width;
+        desc.Height = height;
+        desc.Format = format;
+        desc.Flags = flags;
+        return desc;
+    }
+
+    const size_t kUnlimited = ~(size_t)0;
+}
+
+TEST(RenderTargetPool_ReusesReleasedTargetsByDescriptor) {
+    FakeDevice device;
+    RenderTargetPool pool;
+    device.Attach(pool, kUnlimited);
+
+    void* a = pool.Acquire(Desc(256, 256));
+    REQUIRE(a != nullptr);
+    CHECK(pool.Release(a));
+    CHECK(!pool.Release(a));            // повторный Release - ошибка вызывающего
+    CHECK(!pool.Release((void*)0x999)); // чужой хэндл
+
+    // Тот же дескриптор - та же цель, без нового создания
+    CHECK(pool.Acquire(Desc(256, 256)) == a);
+    CHECK_EQ(device.Creates, 1);
+    pool.Release(a);
+
+    // Любое отличие в ключе - новая цель
+    void* other[] = {
+        pool.Acquire(Desc(256, 128)),
+        pool.Acquire(Desc(256, 256, TextureFormat::RGBA16F)),
+        pool.Acquire(Desc(256, 256, TextureFormat::RGBA8, RenderTargetFlagStorage)),
+    };
+    for (void* handle : other) CHECK(handle != nullptr && handle != a);
+    CHECK_EQ(device.Creates, 4);
+
+    const RenderTargetPoolStats& stats = pool.GetStats();
+    CHECK_EQ(stats.Acquires, 5ull);
+    CHECK_EQ(stats.Allocations, 4ull);
+    CHECK_EQ(stats.TargetsInUse, 3);
+    CHECK_EQ(stats.Targets, 4);
+    CHECK_EQ(stats.BytesAllocated, (size_t)256 * 256 * 4 * 2 + 256 * 128 * 4 + 256 * 256 * 8);
+
+    pool.Shutdown();
+    CHECK(device.Live.empty());
+    CHECK_EQ(device.DoubleDestroys, 0);
+    CHECK_EQ(pool.GetStats().Targets, 0);
+    CHECK_EQ(pool.GetStats().BytesAllocated, (size_t)0);
+}
+
+TEST(RenderTargetPool_TargetsInUseAreNeverAliased) {
+    FakeDevice device;
+    RenderTargetPool pool;
+    device.Attach(pool, kUnlimited, 1 << 30);
+
+    // Пинг-понг и цепочки пассов: каждый одновременно занятый хэндл уникален и жив
+    Tests::Random random(7);
+    std::set<void*> inUse;
+    std::vector<std::pair<void*, int>> held;
+    int heldPerSize[2] = {};
+    int peakPerSize[2] = {};
+    int aliased = 0;
+    int dead = 0;
+    for (int step = 0; step < 5000; ++step) {
+        if (!held.empty() && random.Int(0, 1) == 0) {
+            const size_t i = (size_t)random.Int(0, (int)held.size() - 1);
+            CHECK(pool.Release(held[i].first));
+            inUse.erase(held[i].first);
+            heldPerSize[held[i].second]--;
+            held.erase(held.begin() + (ptrdiff_t)i);
+        }
+        else {
+            const int size = random.Int(0, 1);
+            void* handle = pool.Acquire(Desc(64 << size, 64));
+            REQUIRE(handle != nullptr);
+            if (!inUse.insert(handle).second) aliased++;
+            if (!device.Live.count(handle)) dead++;
+            held.push_back({ handle, size });
+            peakPerSize[size] = std::max(peakPerSize[size], ++heldPerSize[size]);
+        }
+        if (step % 50 == 0) pool.EndFrame();
+    }
+
+    CHECK_EQ(aliased, 0);
+    CHECK_EQ(dead, 0);
+    CHECK_EQ(pool.GetStats().TargetsInUse, (int)held.size());
+    // Без вытеснения пул создает не больше целей, чем было занято одновременно в пике
+    CHECK(device.Creates <= peakPerSize[0] + peakPerSize[1]);
+    CHECK_EQ(pool.GetStats().Evictions, 0ull);
+}
+
+TEST(RenderTargetPool_EvictsLeastRecentlyUsedToFitBudget) {
+    FakeDevice device;
+    RenderTargetPool pool;
+    const size_t target = RenderTargetPool::GetTargetBytes(Desc(128, 128));
+    device.Attach(pool, target * 3);
+
+    // Один размер в байтах, но разные ключи
+    void* a = pool.Acquire(Desc(128, 128));
+    pool.EndFrame();
+    void* b = pool.Acquire(Desc(64, 256));
+    pool.Release(b);
+    pool.EndFrame();
+    void* c = pool.Acquire(Desc(256, 64));
+    pool.Release(a);
+    pool.Release(c);
+
+    // Бюджет на три цели, нужна четвертая с другим ключом: уходит дольше всех свободная b, хотя создана она позже a
+    void* d = pool.Acquire(Desc(128, 128, TextureFormat::R32F));
+    REQUIRE(d != nullptr);
+    CHECK(!device.Live.count(b));
+    CHECK(device.Live.count(a) && device.Live.count(c));
+    CHECK_EQ(pool.GetStats().Evictions, 1ull);
+    CHECK(pool.GetStats().BytesAllocated <= pool.GetBudget());
+    CHECK_EQ(pool.GetStats().OverBudgetAllocations, 0ull);
+
+    // Занятые цели не вытесняются: бюджет превышается и это видно в статистике
+    void* e = pool.Acquire(Desc(128, 128));
+    void* f = pool.Acquire(Desc(256, 64));
+    void* g = pool.Acquire(Desc(64, 64));
+    CHECK(e && f && g);
+    CHECK(device.Live.count(d));
+    CHECK_EQ(pool.GetStats().OverBudgetAllocations, 1ull);
+
+    // Уменьшение бюджета сразу освобождает свободные цели, но не занятые
+    pool.Release(d);
+    pool.SetBudget(0);
+    CHECK(!device.Live.count(d));
+    CHECK_EQ(pool.GetStats().Targets, 3);
+    CHECK_EQ(pool.GetStats().TargetsInUse, 3);
+
+    pool.Shutdown();
+    CHECK(device.Live.empty());
+    CHECK_EQ(device.DoubleDestroys, 0);
+}
+
+TEST(RenderTargetPool_EvictsTargetsUnusedForTooLong) {
+    FakeDevice device;
+    RenderTargetPool pool;
+    device.Attach(pool, kUnlimited, 3);
+
+    // Старый размер после ресайза окна
+    pool.Release(pool.Acquire(Desc(1280, 720)));
+    for (int frame = 0; frame < 3; ++frame) {
+        pool.Release(pool.Acquire(Desc(1920, 1080)));
+        pool.EndFrame();
+        CHECK_EQ(pool.GetStats().Targets, 2);
+    }
+    pool.EndFrame();
+    CHECK_EQ(pool.GetStats().Targets, 1);
+    CHECK_EQ(pool.GetStats().Evictions, 1ull);
+
+    // Занятая цель живет сколько угодно
+    void* held = pool.Acquire(Desc(1920, 1080));
+    for (int frame = 0; frame < 10; ++frame) pool.EndFrame();
+    CHECK(device.Live.count(held));
+    pool.Release(held);
+    pool.Trim();
+    CHECK(device.Live.empty());
+    CHECK_EQ(device.DoubleDestroys, 0);
+}
+
+TEST(RenderTargetPool_FailedCreationReturnsNull) {
+    FakeDevice device;
+    RenderTargetPool pool;
+    device.Attach(pool, kUnlimited);
+
+    device.FailCreate = true;
+    CHECK(pool.Acquire(Desc(32, 32)) == nullptr);
+    CHECK_EQ(pool.GetStats().Targets, 0);
+    CHECK_EQ(pool.GetStats().TargetsInUse, 0);
+
+    device.FailCreate = false;
+    CHECK(pool.Acquire(Desc(32, 32)) != nullptr);
+
+    RenderTargetPool detached;
+    CHECK(detached.Acquire(Desc(32, 32)) == nullptr);
+}
@@ -0,0 +1,529 @@
+﻿#include "TestFramework.h"
+#include <Rendeructor.h>
+#include <ShardedRegistry.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+    // Бэкенд без GPU: ресурсы - куски памяти в куче. Создавать можно из любого потока, а все, что в DX11 шло бы через
+    // immediate context (освобождение, запись, копирование, чтение, отрисовка), вне потока рендера считается ошибкой
+    class CPUBackend : public BackendInterface {
+    public:
+        struct Resource {
+            std::vector<unsigned char> Bytes;
+        };
+
+        std::atomic<int> Violations = 0;   // операции контекста вне потока рендера
+        std::atomic<int> BadHandles = 0;   // освобождение/запись неизвестного или уже освобожденного ресурса
+        std::atomic<int> Created = 0;
+        int LeakedAtShutdown = 0;
+
+        size_t GetLiveResources() const { return m_resources.Size(); }
+        bool IsLive(void* handle) const { return m_resources.Contains((Resource*)handle); }
+
+        void SetMemoryTracker(MemoryTracker* tracker) override { m_tracker = tracker; }
+        bool Initialize(const BackendConfig&) override {
+            m_renderThread = std::this_thread::get_id();
+            return true;
+        }
+        void Shutdown() override {
+            CheckRenderThread();
+            for (Resource* resource : m_resources.TakeAll()) {
+                if (m_tracker) m_tracker->Untrack(resource);
+                delete resource;
+                LeakedAtShutdown++;
+            }
+        }
+        void Resize(int, int) override { CheckRenderThread(); }
+        void BeginFrame() override { CheckRenderThread(); }
+        void EndFrame() override { CheckRenderThread(); }
+
+        void* GetDevice() override { return nullptr; }
+        void* GetContext() override { return nullptr; }
+        void* GetBackBufferHandle() override { return nullptr; }
+
+        void SetPipelineState(const PipelineState&) override { CheckRenderThread(); }
+        void ResetPipelineStateCache() override { CheckRenderThread(); }
+        void SetScissorRect(int, int, int, int) override { CheckRenderThread(); }
+
+        void* CreateTextureResource(int width, int height, int format, const void*) override {
+            return CreateTexture(MemoryTracker::GetTextureBytes((TextureFormat)format, width, height), (TextureFormat)format,
+                                 TextureType::Tex2D);
+        }
+        void* CreateStorageTextureResource(int width, int height, int format, const void* data) override {
+            return CreateTextureResource(width, height, format, data);
+        }
+        void* CreateSamplerResource(const std::string&) override { return Create(MemoryCategory::Texture, 0); }
+        void* CreateTexture3DResource(int width, int height, int depth, int, const void*) override {
+            return CreateTexture(MemoryTracker::GetTextureBytes(TextureFormat::RGBA8, width, height, depth), TextureFormat::RGBA8,
+                                 TextureType::Tex3D);
+        }
+        void* CreateTextureCubeResource(int width, int height, int format, const void**) override {
+            return CreateTexture(MemoryTracker::GetTextureBytes((TextureFormat)format, width, height) * 6, (TextureFormat)format,
+                                 TextureType::TexCube);
+        }
+        void* CreateDepthTextureResource(int width, int height, int, bool) override {
+            return Create(MemoryCategory::DepthTexture, (size_t)width * height * 4);
+        }
+        void ReleaseTexture(void* handle) override { Release(handle); }
+        void* CreateVertexBuffer(const void* data, size_t size, int) override { return Create(MemoryCategory::VertexBuffer, size, data); }
+        void* CreateIndexBuffer(const void* data, size_t size) override { return Create(MemoryCategory::IndexBuffer, size, data); }
+        void* CreateInstanceBuffer(const void* data, size_t size, int) override { return Create(MemoryCategory::InstanceBuffer, size, data); }
+        void* CreateDynamicInstanceBuffer(const void* data, size_t size, int) override {
+            return Create(MemoryCategory::InstanceBuffer, size, data);
+        }
+        void UpdateBuffer(void* handle, const void* data, size_t size, size_t offset) override {
+            CheckRenderThread();
+            Resource* resource = Find(handle);
+            if (!resource || offset + size > resource->Bytes.size()) return;
+            memcpy(resource->Bytes.data() + offset, data, size);
+        }
+        void* CreateStructuredBuffer(const void* data, size_t count, int stride, bool) override {
+            return Create(MemoryCategory::StructuredBuffer, count * stride, data);
+        }
+        void* CreateComputeBuffer(const void* data, size_t count, int stride, int) override {
+            return Create(MemoryCategory::ComputeBuffer, count * stride, data);
+        }
+        bool ReadBuffer(void* handle, void* data, size_t size) override {
+            CheckRenderThread();
+            Resource* resource = Find(handle);
+            if (!resource || size > resource->Bytes.size()) return false;
+            memcpy(data, resource->Bytes.data(), size);
+            return true;
+        }
+        void CopyBufferRegion(void* dstHandle, size_t dstOffset, void* srcHandle, size_t srcOffset, size_t size) override {
+            CheckRenderThread();
+            Resource* dst = Find(dstHandle);
+            Resource* src = Find(srcHandle);
+            if (!dst || !src || dstOffset + size > dst->Bytes.size() || srcOffset + size > src->Bytes.size()) return;
+            memcpy(dst->Bytes.data() + dstOffset, src->Bytes.data() + srcOffset, size);
+        }
+        void ReleaseBuffer(void* handle) override { Release(handle); }
+
+        // Без запросов времени: Profiler и GPUTimer обходятся без GPU
+        void* CreateGPUTimer() override { return nullptr; }
+        void BeginGPUTimer(void*) override { CheckRenderThread(); }
+        void EndGPUTimer(void*) override { CheckRenderThread(); }
+        bool GetGPUTimerResult(void*, double&) override { CheckRenderThread(); return false; }
+        void ReleaseGPUTimer(void*) override { CheckRenderThread(); }
+
+        void CopyTexture(void* dstHandle, void* srcHandle) override {
+            CheckRenderThread();
+            Find(dstHandle);
+            Find(srcHandle);
+        }
+        bool ReadTexture(void* handle, void*, size_t) override {
+            CheckRenderThread();
+            return Find(handle) != nullptr;
+        }
+        void* RequestTextureReadback(void*) override { CheckRenderThread(); return nullptr; }
+        int ResolveTextureReadback(void*, void*, size_t, bool) override { CheckRenderThread(); return -1; }
+        void SetRenderTarget(void*, void*, void*, void*) override { CheckRenderThread(); }
+        void SetRenderTargetWithDepth(void*, void*, void*, void*, void*, bool) override { CheckRenderThread(); }
+        void SetAutoDepthBudget(size_t) override {}
+        size_t GetAutoDepthMemory() override { return 0; }
+        void Clear(float, float, float, float) override { CheckRenderThread(); }
+        void ClearTexture(void*, float, float, float, float) override { CheckRenderThread(); }
+        void ClearDepth(float, int) override { CheckRenderThread(); }
+
+        void PrepareShaderPass(const ShaderPass&) override {}
+        void SetShaderPass(const ShaderPass&) override { CheckRenderThread(); }
+        void UpdateConstantRaw(const std::string&, const void*, size_t) override { CheckRenderThread(); }
+
+        void DrawFullScreenQuad() override { CheckRenderThread(); }
+        void DrawMesh(void*, void*, int, int, int) override { CheckRenderThread(); }
+        void DrawMeshInstanced(void*, void*, int, void*, int, int, int, int, int) override { CheckRenderThread(); }
+        bool DrawMeshInstancedVariant(void*, void*, int, void*, int, int, int, int, int) override { CheckRenderThread(); return false; }
+        void DrawMeshIndirect(void*, void*, void*, int, void*, unsigned int, int, unsigned int) override { CheckRenderThread(); }
+        void Dispatch(int, int, int) override { CheckRenderThread(); }
+        void DispatchIndirect(void*, unsigned int) override { CheckRenderThread(); }
+
+    private:
+        void CheckRenderThread() {
+            if (std::this_thread::get_id() != m_renderThread) Violations++;
+        }
+
+        Resource* Find(void* handle) {
+            if (m_resources.Contains((Resource*)handle)) return (Resource*)handle;
+            BadHandles++;
+            return nullptr;
+        }
+
+        void* Create(MemoryCategory category, size_t bytes, const void* data = nullptr) {
+            Resource* resource = new Resource();
+            resource->Bytes.assign(bytes, 0);
+            if (data && bytes) memcpy(resource->Bytes.data(), data, bytes);
+            m_resources.Insert(resource);
+            Created++;
+            if (m_tracker) m_tracker->Track(resource, category, bytes);
+            return resource;
+        }
+
+        void* CreateTexture(size_t bytes, TextureFormat format, TextureType type) {
+            Resource* resource = new Resource();
+            resource->Bytes.assign(bytes, 0);
+            m_resources.Insert(resource);
+            Created++;
+            if (m_tracker) m_tracker->TrackTexture(resource, bytes, format, type);
+            return resource;
+        }
+
+        void Release(void* handle) {
+            CheckRenderThread();
+            Resource* resource = (Resource*)handle;
+            if (!m_resources.Erase(resource)) {
+                BadHandles++;
+                return;
+            }
+            if (m_tracker) m_tracker->Untrack(resource);
+            delete resource;
+        }
+
+        std::thread::id m_renderThread;
+        MemoryTracker* m_tracker = nullptr;
+        ShardedRegistry<Resource> m_resources;
+    };
+
+    BackendConfig MakeConfig(bool geometryArena = false, size_t memoryBudget = 0) {
+        BackendConfig config;
+        config.UseGeometryArena = geometryArena;
+        config.GeometryArenaPageVertices = 1024;
+        config.GeometryArenaPageIndices = 2048;
+        config.MemoryBudgetBytes = memoryBudget;
+        return config;
+    }
+
+    void MakeQuad(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float offset) {
+        vertices.assign(4, Vertex());
+        for (int i = 0; i < 4; ++i) {
+            vertices[i].Position = Math::float3((float)(i & 1) + offset, (float)(i >> 1), 0.0f);
+        }
+        indices = { 0, 1, 2, 2, 1, 3 };
+    }
+}
+
+TEST(ShardedRegistry_ConcurrentInsertErase) {
+    const int threadCount = 4;
+    const int perThread = 2000;
+    ShardedRegistry<int> registry;
+    std::vector<std::vector<int>> objects(threadCount, std::vector<int>(perThread));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            for (int& object : objects[t]) registry.Insert(&object);
+            // Каждый второй объект удаляется сразу, пока другие потоки еще вставляют
+            for (int i = 0; i < perThread; i += 2) registry.Erase(&objects[t][i]);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    CHECK_EQ(registry.Size(), (size_t)(threadCount * perThread / 2));
+    CHECK(registry.Contains(&objects[0][1]));
+    CHECK(!registry.Contains(&objects[0][0]));
+    CHECK(!registry.Erase(&objects[1][0]));
+
+    std::vector<int*> all = registry.TakeAll();
+    CHECK_EQ(all.size(), (size_t)(threadCount * perThread / 2));
+    CHECK_EQ(registry.Size(), (size_t)0);
+}
+
+TEST(RenderThreading_WorkerReleasesWaitForPresent) {
+    CPUBackend backend;
+    Rendeructor renderer;
+    REQUIRE(renderer.Create(MakeConfig(), &backend));
+
+    Texture texture(renderer);
+    ComputeBuffer buffer(renderer);
+    std::vector<int> values(64);
+    for (int i = 0; i < 64; ++i) values[i] = i;
+
+    std::thread worker([&] {
+        texture.Create(64, 64, TextureFormat::RGBA8);
+        buffer.Create(64, sizeof(int), ComputeBufferType::Structured);
+        // Данные записи копируются: буфер вызывающего свободен сразу после Update
+        std::vector<int> update(values);
+        buffer.Update(update.data(), 64);
+        update.assign(64, -1);
+        texture.Release();
+    });
+    worker.join();
+
+    CHECK_EQ(backend.Violations.load(), 0);
+    CHECK_EQ(backend.GetLiveResources(), (size_t)2);
+    CHECK_EQ(renderer.GetPendingRenderThreadTasks(), 2);
+    CHECK_EQ(renderer.GetFrameStats().MapCalls, 0);
+
+    renderer.Present();
+    CHECK_EQ(renderer.GetPendingRenderThreadTasks(), 0);
+    CHECK_EQ(backend.GetLiveResources(), (size_t)1);
+    CHECK_EQ(renderer.GetFrameStatsHistory().back().MapCalls, 1);
+
+    std::vector<int> read(64, 0);
+    REQUIRE(buffer.Read(read.data()));
+    CHECK(read == values);
+    buffer.Release();
+
+    CHECK_EQ(backend.Violations.load(), 0);
+    CHECK_EQ(backend.BadHandles.load(), 0);
+    CHECK_EQ(backend.GetLiveResources(), (size_t)0);
+    CHECK_EQ(renderer.GetMemoryTracker().GetTotalBytes(), (size_t)0);
+}
+
+TEST(RenderThreading_ReadsAndTransientsStayOnRenderThread) {
+    CPUBackend backend;
+    Rendeructor renderer;
+    REQUIRE(renderer.Create(MakeConfig(), &backend));
+
+    Texture texture(renderer);
+    texture.Create(16, 16, TextureFormat::RGBA8);
+    ComputeBuffer buffer(renderer);
+    buffer.Create(16, sizeof(int));
+
+    bool readPixels = true, readBuffer = true, readbackAsync = true;
+    Texture transient;
+    std::thread worker([&] {
+        std::vector<unsigned char> pixels(16 * 16 * 4);
+        std::vector<int> elements(16);
+        readPixels = texture.ReadPixels(pixels.data());
+        readBuffer = buffer.Read(elements.data());
+        readbackAsync = texture.ReadbackAsync([](const void*, int, int) {});
+        transient = Texture::AcquireTransient(renderer, 16, 16, TextureFormat::RGBA8);
+    });
+    worker.join();
+
+    CHECK(!readPixels);
+    CHECK(!readBuffer);
+    CHECK(!readbackAsync);
+    CHECK(transient.GetHandle() == nullptr);
+    CHECK_EQ(backend.Violations.load(), 0);
+
+    transient = Texture::AcquireTransient(renderer, 16, 16, TextureFormat::RGBA8);
+    CHECK(transient.GetHandle() != nullptr);
+    CHECK(transient.GetRenderer() == &renderer);
+    transient.Release();
+    texture.Release();
+    buffer.Release();
+}
+
+TEST(RenderThreading_OffThreadRecreateFreesArenaRange) {
+    CPUBackend backend;
+    Rendeructor renderer;
+    REQUIRE(renderer.Create(MakeConfig(true), &backend));
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeQuad(vertices, indices, 0.0f);
+
+    Mesh mesh(renderer);
+    mesh.Create(vertices, indices);
+    REQUIRE(mesh.IsInGeometryArena());
+    CHECK_EQ(renderer.GetGeometryArenaStats().Allocations, 1);
+
+    // Из рабочего потока арена недоступна: новая сетка получает свои буферы, старый диапазон ждет Present
+    MakeQuad(vertices, indices, 1.0f);
+    std::thread worker([&] { mesh.Create(vertices, indices); });
+    worker.join();
+
+    CHECK(!mesh.IsInGeometryArena());
+    CHECK(mesh.GetVB() != nullptr);
+    CHECK_EQ(renderer.GetGeometryArenaStats().Allocations, 1);
+    renderer.Present();
+    CHECK_EQ(renderer.GetGeometryArenaStats().Allocations, 0);
+
+    // На потоке рендера пересоздание снова идет в арену
+    mesh.Create(vertices, indices);
+    CHECK(mesh.IsInGeometryArena());
+    mesh.Release();
+    CHECK_EQ(renderer.GetGeometryArenaStats().Allocations, 0);
+    CHECK_EQ(backend.Violations.load(), 0);
+    CHECK_EQ(backend.BadHandles.load(), 0);
+}
+
+TEST(RenderThreading_InstanceBufferGrowsWithoutCPUCopy) {
+    CPUBackend backend;
+    Rendeructor renderer;
+    REQUIRE(renderer.Create(MakeConfig(), &backend));
+
+    std::vector<float> first(16), second(16);
+    for (int i = 0; i < 16; ++i) {
+        first[i] = (float)i;
+        second[i] = 100.0f + i;
+    }
+
+    InstanceBuffer instances(renderer);
+    instances.Create(first.data(), 4, sizeof(float) * 4);
+    CHECK(instances.GetCPUData() == nullptr);
+
+    // Рост из рабочего потока: копирование старых записей на GPU должно встать в очередь раньше освобождения
+    std::thread worker([&] { instances.Update(second.data(), 4, 4); });
+    worker.join();
+    CHECK_EQ(instances.GetCount(), 8);
+    CHECK_EQ(instances.GetCapacity(), 8);
+    renderer.Present();
+
+    std::vector<float> contents(32, -1.0f);
+    REQUIRE(backend.ReadBuffer(instances.GetHandle(), contents.data(), contents.size() * sizeof(float)));
+    CHECK(std::equal(first.begin(), first.end(), contents.begin()));
+    CHECK(std::equal(second.begin(), second.end(), contents.begin() + 16));
+    CHECK(instances.GetCPUData() == nullptr);
+    CHECK_EQ(backend.Violations.load(), 0);
+    CHECK_EQ(backend.BadHandles.load(), 0);
+}
+
+TEST(RenderThreading_BudgetCallbacksRunOnRenderThread) {
+    CPUBackend backend;
+    Rendeructor renderer;
+    REQUIRE(renderer.Create(MakeConfig(false, 1024), &backend));
+
+    std::atomic<int> calls = 0;
+    std::atomic<bool> onRenderThread = true;
+    renderer.GetMemoryTracker().AddBudgetCallback([&](const MemoryBudgetEvent& event) {
+        calls++;
+        if (!renderer.IsRenderThread()) onRenderThread = false;
+        CHECK_EQ(event.BudgetBytes, (size_t)1024);
+    });
+
+    Texture texture(renderer);
+    std::thread worker([&] { texture.Create(64, 64, TextureFormat::RGBA8); });
+    worker.join();
+
+    CHECK_EQ(calls.load(), 0);
+    renderer.Present();
+    CHECK_EQ(calls.load(), 1);
+    CHECK(onRenderThread.load());
+
+    // На потоке рендера уведомление приходит сразу
+    texture.Release();
+    texture.Create(64, 64, TextureFormat::RGBA8);
+    CHECK_EQ(calls.load(), 2);
+    texture.Release();
+}
+
+TEST(RenderThreading_WorkerScopeLeavesAutoInstancesPending) {
+    CPUBackend backend;
+    Rendeructor renderer;
+    REQUIRE(renderer.Create(MakeConfig(), &backend));
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeQuad(vertices, indices, 0.0f);
+    Mesh mesh(renderer);
+    mesh.Create(vertices, indices);
+
+    ShaderPass pass;
+    pass.InstancedVertexShaderEntryPoint = "mainInstanced";
+    renderer.SetShaderPass(pass);
+    for (int i = 0; i < 2; ++i) {
+        renderer.SetConstant("World", Math::float4x4::identity());
+        renderer.DrawMesh(mesh);
+    }
+    CHECK_EQ(renderer.GetFrameStats().DrawCalls, 0);
+
+    // Область профилировщика из рабочего потока не должна сбрасывать отложенные отрисовки через контекст
+    std::thread worker([&] {
+        ProfileScope scope(&renderer, "Worker");
+    });
+    worker.join();
+
+    CHECK_EQ(backend.Violations.load(), 0);
+    CHECK_EQ(renderer.GetFrameStats().DrawCalls, 0);
+
+    renderer.Present();
+    CHECK_EQ(renderer.GetFrameStatsHistory().back().DrawCalls, 2);
+    CHECK_EQ(backend.Violations.load(), 0);
+    mesh.Release();
+}
+
+TEST(RenderThreading_WorkersCreateAndReleaseWhilePresenting) {
+    CPUBackend backend;
+    Rendeructor renderer;
+    REQUIRE(renderer.Create(MakeConfig(true, 256 * 1024), &backend));
+
+    std::atomic<int> budgetCalls = 0;
+    std::atomic<int> budgetCallsOffThread = 0;
+    renderer.GetMemoryTracker().AddBudgetCallback([&](const MemoryBudgetEvent&) {
+        budgetCalls++;
+        if (!renderer.IsRenderThread()) budgetCallsOffThread++;
+    });
+
+    const int workerCount = 4;
+    const int iterations = 300;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    MakeQuad(vertices, indices, 0.0f);
+
+    // Сетки в арене заводит поток рендера, рабочие потоки их пересоздают и освобождают
+    std::vector<Mesh> meshes;
+    meshes.reserve(workerCount);
+    for (int w = 0; w < workerCount; ++w) {
+        meshes.emplace_back(renderer);
+        meshes.back().Create(vertices, indices);
+        REQUIRE(meshes.back().IsInGeometryArena());
+    }
+    std::vector<InstanceBuffer> instances(workerCount, InstanceBuffer(renderer));
+
+    std::atomic<int> started = 0;
+    std::atomic<int> finished = 0;
+    std::vector<std::thread> workers;
+    for (int w = 0; w < workerCount; ++w) {
+        workers.emplace_back([&, w] {
+            started++;
+            Tests::Random random(w + 1);
+            Texture texture(renderer);
+            StructuredBuffer structured(renderer);
+            Mesh& mesh = meshes[w];
+            InstanceBuffer& instanceBuffer = instances[w];
+            std::vector<float> data(256, (float)w);
+
+            for (int i = 0; i < iterations; ++i) {
+                const int size = 8 << random.Int(0, 4);
+                texture.Release();
+                texture.Create(size, size, TextureFormat::RGBA8);
+                structured.Create(data.data(), 64 + random.Int(0, 192), sizeof(float));
+                structured.Update(data.data(), 16, random.Int(0, 48));
+                instanceBuffer.Create(data.data(), 16, sizeof(float) * 4);
+                instanceBuffer.Update(data.data(), 8, random.Int(0, 8));
+                if (i % 3 == 0) mesh.Create(vertices, indices);
+                if (i % 7 == 0) mesh.Release();
+                std::this_thread::yield();
+            }
+            texture.Release();
+            structured.Release();
+            mesh.Release();
+            finished++;
+        });
+    }
+
+    // Поток рендера тем временем выпускает кадры и разбирает очередь
+    int frames = 0;
+    while (finished.load() < workerCount) {
+        renderer.Present();
+        frames++;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    for (auto& worker : workers) worker.join();
+    renderer.Present();
+
+    CHECK_EQ(started.load(), workerCount);
+    CHECK(frames > 0);
+    CHECK_EQ(backend.Violations.load(), 0);
+    CHECK_EQ(backend.BadHandles.load(), 0);
+    CHECK_EQ(renderer.GetPendingRenderThreadTasks(), 0);
+    CHECK_EQ(renderer.GetGeometryArenaStats().Allocations, 0);
+    CHECK(budgetCalls.load() > 0);
+    CHECK_EQ(budgetCallsOffThread.load(), 0);
+
+    // InstanceBuffer освобождается только пересозданием: живы последние буферы рабочих и страницы арены
+    const size_t arenaBuffers = (size_t)renderer.GetGeometryArenaStats().Pages * 2;
+    CHECK_EQ(backend.GetLiveResources(), (size_t)workerCount + arenaBuffers);
+    for (const InstanceBuffer& instanceBuffer : instances) CHECK(backend.IsLive(instanceBuffer.GetHandle()));
+
+    renderer.Destroy();
+    CHECK_EQ(backend.LeakedAtShutdown, workerCount);
+    CHECK_EQ(renderer.GetMemoryTracker().GetTotalBytes(), (size_t)0);
+}
@@ -0,0 +1,279 @@
+﻿#include "TestFramework.h"
+#include <ShaderPathTracer/SceneBVH.h>
+#include <algorithm>
+
+using namespace Math;
+
+namespace {
+
+    struct Sphere {
+        float3 Center;
+        float Radius;
+    };
+
+    // Случайные сферы в плоском слое, как в сцене ShaderPathTracer (объекты в основном лежат на полу)
+    std::vector<Sphere> GenerateSpheres(int count, unsigned int seed) {
+        Tests::Random random(seed);
+        std::vector<Sphere> spheres(count);
+        for (Sphere& s : spheres) {
+            s.Center = float3(random.Range(0.0f, 100.0f), random.Range(0.0f, 20.0f), random.Range(0.0f, 100.0f));
+            s.Radius = random.Range(0.2f, 1.5f);
+        }
+        return spheres;
+    }
+
+    std::vector<SceneBVH::AABB> GetBounds(const std::vector<Sphere>& spheres) {
+        std::vector<SceneBVH::AABB> bounds(spheres.size());
+        for (size_t i = 0; i < spheres.size(); ++i) {
+            const float r = spheres[i].Radius;
+            bounds[i].Min = spheres[i].Center - float3(r, r, r);
+            bounds[i].Max = spheres[i].Center + float3(r, r, r);
+        }
+        return bounds;
+    }
+
+    float SphereDistance(const Sphere& s, const float3& p) {
+        return length(p - s.Center) - s.Radius;
+    }
+
+    float BoxDistance(const float3& p, const SceneBVH::AABB& box) {
+        const float3 q = max(max(box.Min - p, p - box.Max), float3(0, 0, 0));
+        return length(q);
+    }
+
+    struct QueryCounters {
+        long long Nodes = 0;
+        long long Objects = 0;
+    };
+
+    // CPU-копия обхода из Map() в PathTracer.hlsl: ближний ребенок первым, узлы дальше текущего минимума пропускаются
+    float MapBVH(const std::vector<Sphere>& spheres, const std::vector<SceneBVH::Node>& nodes, const std::vector<int>& order,
+                 const float3& p, QueryCounters& counters) {
+        float minDist = 1e30f;
+        int stack[32];
+        int sp = 0;
+        stack[sp++] = 0;
+
+        while (sp > 0) {
+            const int n = stack[--sp];
+            const SceneBVH::Node& node = nodes[n];
+            counters.Nodes++;
+
+            const float nodeDist = BoxDistance(p, node.Bounds);
+            if (nodeDist > 0.0f && nodeDist >= minDist) continue;
+
+            if (node.Count > 0) {
+                for (int k = 0; k < node.Count; ++k) {
+                    minDist = std::min(minDist, SphereDistance(spheres[order[node.RightOrFirst + k]], p));
+                    counters.Objects++;
+                }
+            }
+            else {
+                const int left = n + 1;
+                const int right = node.RightOrFirst;
+                const float dl = BoxDistance(p, nodes[left].Bounds);
+                const float dr = BoxDistance(p, nodes[right].Bounds);
+                const int nearChild = dl <= dr ? left : right;
+                const int farChild = dl <= dr ? right : left;
+                const float nearDist = std::min(dl, dr), farDist = std::max(dl, dr);
+
+                if (sp < 32 && (farDist < minDist || farDist == 0.0f)) stack[sp++] = farChild;
+                if (sp < 32 && (nearDist < minDist || nearDist == 0.0f)) stack[sp++] = nearChild;
+            }
+        }
+        return minDist;
+    }
+
+    float MapBruteForce(const std::vector<Sphere>& spheres, const float3& p) {
+        float minDist = 1e30f;
+        for (const Sphere& s : spheres) minDist = std::min(minDist, SphereDistance(s, p));
+        return minDist;
+    }
+
+    std::vector<float3> GenerateQueryPoints(int count, unsigned int seed) {
+        Tests::Random random(seed);
+        std::vector<float3> points(count);
+        for (float3& p : points) p = float3(random.Range(-10.0f, 110.0f), random.Range(-2.0f, 25.0f), random.Range(-10.0f, 110.0f));
+        return points;
+    }
+
+    // Медианное разбиение по самой длинной оси центров - простая базовая линия для качества SAH
+    struct MedianBuilder {
+        const std::vector<SceneBVH::AABB>& Bounds;
+        std::vector<int> Order;
+        float Cost = 0.0f;
+        float RootArea = 1.0f;
+
+        void Build(int first, int count) {
+            SceneBVH::AABB box, centers;
+            for (int i = first; i < first + count; ++i) {
+                box.Grow(Bounds[Order[i]]);
+                centers.Grow(Bounds[Order[i]].Center());
+            }
+            const float p = box.Area() / RootArea;
+            if (count <= 2) {
+                Cost += p * SceneBVH::kObjectCost * count;
+                return;
+            }
+            Cost += p * SceneBVH::kTraversalCost;
+
+            const float3 extent = centers.Max - centers.Min;
+            const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            const int half = count / 2;
+            std::nth_element(Order.begin() + first, Order.begin() + first + half, Order.begin() + first + count,
+                [&](int a, int b) { return Bounds[a].Center()[axis] < Bounds[b].Center()[axis]; });
+            Build(first, half);
+            Build(first + half, count - half);
+        }
+    };
+
+    float MedianSplitCost(const std::vector<SceneBVH::AABB>& bounds) {
+        MedianBuilder builder{ bounds };
+        SceneBVH::AABB root;
+        for (const auto& b : bounds) root.Grow(b);
+        builder.RootArea = root.Area();
+        builder.Order.resize(bounds.size());
+        for (size_t i = 0; i < bounds.size(); ++i) builder.Order[i] = (int)i;
+        builder.Build(0, (int)bounds.size());
+        return builder.Cost;
+    }
+
+    bool Contains(const SceneBVH::AABB& outer, const SceneBVH::AABB& inner) {
+        return inner.Min.x >= outer.Min.x && inner.Min.y >= outer.Min.y && inner.Min.z >= outer.Min.z &&
+            inner.Max.x <= outer.Max.x && inner.Max.y <= outer.Max.y && inner.Max.z <= outer.Max.z;
+    }
+}
+
+TEST(SceneBVH_TreeIsWellFormed) {
+    const std::vector<Sphere> spheres = GenerateSpheres(5000, 3);
+    const std::vector<SceneBVH::AABB> bounds = GetBounds(spheres);
+
+    std::vector<SceneBVH::Node> nodes;
+    std::vector<int> order;
+    SceneBVH::BuildStats stats;
+    SceneBVH::Build(bounds, nodes, order, &stats, 2);
+
+    REQUIRE(!nodes.empty());
+    CHECK_EQ(stats.Nodes, (int)nodes.size());
+    CHECK_EQ(stats.Nodes, 2 * stats.Leaves - 1);
+    CHECK(stats.MaxDepth <= SceneBVH::kMaxDepth);
+
+    // Каждый объект ровно в одном листе, листья покрывают order подряд, дети лежат внутри родителя
+    std::vector<int> seen(spheres.size(), 0);
+    int covered = 0;
+    bool nested = true;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const SceneBVH::Node& node = nodes[i];
+        if (node.Count > 0) {
+            CHECK_EQ(node.RightOrFirst, covered);
+            covered += node.Count;
+            for (int k = 0; k < node.Count; ++k) {
+                seen[order[node.RightOrFirst + k]]++;
+                nested = nested && Contains(node.Bounds, bounds[order[node.RightOrFirst + k]]);
+            }
+        }
+        else {
+            REQUIRE(node.RightOrFirst > (int)i + 1 && node.RightOrFirst < (int)nodes.size());
+            nested = nested && Contains(node.Bounds, nodes[i + 1].Bounds) && Contains(node.Bounds, nodes[node.RightOrFirst].Bounds);
+        }
+    }
+    CHECK(nested);
+    CHECK_EQ(covered, (int)spheres.size());
+    CHECK(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+}
+
+TEST(SceneBVH_TraversalMatchesBruteForce) {
+    const std::vector<Sphere> spheres = GenerateSpheres(2000, 11);
+    std::vector<SceneBVH::Node> nodes;
+    std::vector<int> order;
+    SceneBVH::Build(GetBounds(spheres), nodes, order);
+
+    QueryCounters counters;
+    int mismatches = 0;
+    const std::vector<float3> points = GenerateQueryPoints(2000, 5);
+    for (const float3& p : points) {
+        if (MapBVH(spheres, nodes, order, p, counters) != MapBruteForce(spheres, p)) mismatches++;
+    }
+    CHECK_EQ(mismatches, 0);
+    // Обход должен заметно сокращать число вычислений объектов
+    CHECK(counters.Objects < (long long)points.size() * (long long)spheres.size() / 10);
+}
+
+TEST(SceneBVH_DegenerateInputs) {
+    std::vector<SceneBVH::Node> nodes;
+    std::vector<int> order;
+    SceneBVH::BuildStats stats;
+
+    SceneBVH::Build({}, nodes, order, &stats);
+    CHECK(nodes.empty());
+    CHECK_EQ(stats.Nodes, 0);
+
+    // Одинаковые центры разделить нельзя - один лист со всеми объектами
+    std::vector<SceneBVH::AABB> same(16);
+    for (auto& b : same) { b.Min = float3(-1, -1, -1); b.Max = float3(1, 1, 1); }
+    SceneBVH::Build(same, nodes, order, &stats);
+    CHECK_EQ(stats.Nodes, 1);
+    CHECK_EQ(nodes[0].Count, 16);
+}
+
+TEST(SceneBVH_SAHBeatsMedianSplit) {
+    // Сгустки разного размера: на них медианное разбиение заметно проигрывает
+    Tests::Random random(17);
+    std::vector<Sphere> spheres;
+    for (int cluster = 0; cluster < 20; ++cluster) {
+        const float3 center(random.Range(0.0f, 200.0f), random.Range(0.0f, 10.0f), random.Range(0.0f, 200.0f));
+        const float spread = random.Range(1.0f, 15.0f);
+        const int count = random.Int(10, 400);
+        for (int i = 0; i < count; ++i) {
+            spheres.push_back({ center + float3(random.Range(-spread, spread), random.Range(-spread, spread) * 0.3f, random.Range(-spread, spread)),
+                random.Range(0.2f, 1.0f) });
+        }
+    }
+    const std::vector<SceneBVH::AABB> bounds = GetBounds(spheres);
+
+    std::vector<SceneBVH::Node> nodes;
+    std::vector<int> order;
+    SceneBVH::BuildStats stats;
+    SceneBVH::Build(bounds, nodes, order, &stats);
+    CHECK(stats.SAHCost < MedianSplitCost(bounds));
+}
+
+// Скорость построения и качество дерева: SAH стоимость против медианного разбиения, глубина,
+// и на запросах расстояния (как Map() в шейдере) - узлы и объекты на запрос против полного перебора
+BENCHMARK(SceneBVH_BuildAndQuery) {
+    std::printf("    %8s %10s %10s %8s %8s %6s %10s %10s %9s\n",
+        "objects", "build ms", "Mobj/s", "SAH", "median", "depth", "nodes/q", "objects/q", "speedup");
+
+    for (int count : { 128, 1000, 10000, 100000 }) {
+        const std::vector<Sphere> spheres = GenerateSpheres(count, 1337);
+        const std::vector<SceneBVH::AABB> bounds = GetBounds(spheres);
+
+        std::vector<SceneBVH::Node> nodes;
+        std::vector<int> order;
+        SceneBVH::BuildStats stats;
+        double buildMs = 1e30;
+        for (int run = 0; run < 5; ++run) {
+            SceneBVH::Build(bounds, nodes, order, &stats);
+            buildMs = std::min(buildMs, stats.Milliseconds);
+        }
+
+        const int queryCount = count >= 10000 ? 2000 : 20000;
+        const std::vector<float3> points = GenerateQueryPoints(queryCount, 99);
+
+        QueryCounters counters;
+        float checksum = 0.0f;
+        Tests::Timer bvhTimer;
+        for (const float3& p : points) checksum += MapBVH(spheres, nodes, order, p, counters);
+        const double bvhMs = bvhTimer.Milliseconds();
+
+        float bruteChecksum = 0.0f;
+        Tests::Timer bruteTimer;
+        for (const float3& p : points) bruteChecksum += MapBruteForce(spheres, p);
+        const double bruteMs = bruteTimer.Milliseconds();
+        CHECK(checksum == bruteChecksum);
+
+        std::printf("    %8d %10.3f %10.2f %8.2f %8.2f %6d %10.1f %10.1f %8.1fx\n",
+            count, buildMs, count / buildMs / 1000.0, stats.SAHCost, MedianSplitCost(bounds), stats.MaxDepth,
+            (double)counters.Nodes / queryCount, (double)counters.Objects / queryCount, bruteMs / std::max(bvhMs, 1e-6));
+    }
+}
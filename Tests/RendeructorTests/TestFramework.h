@@ -0,0 +1,103 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Minimal self-registering test runner for the CPU-side parts of Rendeructor (no GPU or window needed).
+// TEST bodies run by default, BENCHMARK bodies only with --bench. A failed CHECK reports the expression and the test
+// continues; REQUIRE returns from the test. The process exit code is the number of failed tests.
+namespace Tests {
+
+    struct TestCase {
+        const char* Name;
+        void (*Function)();
+        bool Benchmark;
+    };
+
+    inline std::vector<TestCase>& GetRegistry() {
+        static std::vector<TestCase> tests;
+        return tests;
+    }
+
+    // Failed checks of the test that is running
+    inline int& GetFailureCount() {
+        static int failures = 0;
+        return failures;
+    }
+
+    struct Registrar {
+        Registrar(const char* name, void (*function)(), bool benchmark) {
+            GetRegistry().push_back({ name, function, benchmark });
+        }
+    };
+
+    inline void ReportFailure(const char* file, int line, const std::string& message) {
+        std::printf("    %s(%d): %s\n", file, line, message.c_str());
+        GetFailureCount()++;
+    }
+
+    template <typename T>
+    std::string ToString(const T& value) {
+        if constexpr (std::is_enum_v<T>) return std::to_string((long long)value);
+        else return std::to_string(value);
+    }
+
+    class Timer {
+    public:
+        Timer() : m_start(std::chrono::high_resolution_clock::now()) {}
+        double Milliseconds() const {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+        }
+    private:
+        std::chrono::high_resolution_clock::time_point m_start;
+    };
+
+    // Deterministic xorshift generator, so every run of a test or benchmark sees the same data
+    class Random {
+    public:
+        explicit Random(unsigned int seed = 1) : m_state(seed ? seed : 1) {}
+        unsigned int Next() {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+        // [0, 1)
+        float Float() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+        float Range(float minValue, float maxValue) { return minValue + (maxValue - minValue) * Float(); }
+        int Int(int minValue, int maxValue) { return minValue + (int)(Next() % (unsigned int)(maxValue - minValue + 1)); }
+    private:
+        unsigned int m_state;
+    };
+}
+
+#define RT_TEST_REGISTER(name, benchmark) \
+    static void name(); \
+    static Tests::Registrar name##_registrar(#name, &name, benchmark); \
+    static void name()
+
+#define TEST(name) RT_TEST_REGISTER(name, false)
+#define BENCHMARK(name) RT_TEST_REGISTER(name, true)
+
+#define CHECK(expr) \
+    do { if (!(expr)) Tests::ReportFailure(__FILE__, __LINE__, "CHECK(" #expr ") failed"); } while (0)
+
+#define REQUIRE(expr) \
+    do { if (!(expr)) { Tests::ReportFailure(__FILE__, __LINE__, "REQUIRE(" #expr ") failed"); return; } } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        const auto rtA = (a); const auto rtB = (b); \
+        if (!(rtA == rtB)) Tests::ReportFailure(__FILE__, __LINE__, \
+            "CHECK_EQ(" #a ", " #b ") failed: " + Tests::ToString(rtA) + " != " + Tests::ToString(rtB)); \
+    } while (0)
+
+#define CHECK_NEAR(a, b, epsilon) \
+    do { \
+        const double rtA = (double)(a); const double rtB = (double)(b); \
+        if (!(std::fabs(rtA - rtB) <= (double)(epsilon))) Tests::ReportFailure(__FILE__, __LINE__, \
+            "CHECK_NEAR(" #a ", " #b ") failed: " + std::to_string(rtA) + " vs " + std::to_string(rtB)); \
+    } while (0)
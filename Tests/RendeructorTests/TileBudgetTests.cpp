@@ -0,0 +1,130 @@
+﻿#include "TestFramework.h"
+#include <TileBudget.h>
+
+namespace {
+
+    // Модель стоимости пакета: накладные кадра + стоимость пикселя, с детерминированным шумом замера
+    struct CostModel {
+        double Overhead = 8.0;
+        double MillisecondsPerPixel = 1e-5;
+        double Noise = 0.0; // относительная амплитуда
+
+        double Measure(int tiles, int tileSize, Tests::Random& random) const {
+            const double ms = Overhead + MillisecondsPerPixel * (double)tiles * tileSize * tileSize;
+            return ms * (1.0 + Noise * (random.Float() * 2.0 - 1.0));
+        }
+    };
+
+    struct SimulationResult {
+        int Tiles = 0;
+        int TileSize = 0;
+        int FramesOverBudget = 0; // замеры дольше бюджета больше чем на 10%
+        double WorstMilliseconds = 0.0;
+    };
+
+    SimulationResult Simulate(TileBudgetController& controller, const CostModel& cost, int frames, unsigned int seed = 1) {
+        Tests::Random random(seed);
+        SimulationResult result;
+        const double budget = controller.GetSettings().TargetMilliseconds;
+        for (int frame = 0; frame < frames; ++frame) {
+            const double ms = cost.Measure(controller.GetTilesPerFrame(), controller.GetTileSize(), random);
+            if (ms > budget * 1.1) result.FramesOverBudget++;
+            result.WorstMilliseconds = std::max(result.WorstMilliseconds, ms);
+            controller.AddMeasurement(controller.GetTilesPerFrame(), controller.GetTileSize(), ms);
+        }
+        result.Tiles = controller.GetTilesPerFrame();
+        result.TileSize = controller.GetTileSize();
+        return result;
+    }
+
+    TileBudgetSettings FixedTileSettings() {
+        TileBudgetSettings settings;
+        settings.TargetMilliseconds = 12.0;
+        settings.MaxTilesPerFrame = 256;
+        settings.AdaptTileSize = false;
+        return settings;
+    }
+}
+
+TEST(TileBudget_LargeOverheadDoesNotPinTheBatchToOneTile) {
+    // 8 мс накладных, 1e-5 мс на пиксель, бюджет 12 мс, тайлы 64x64: влезает (12 - 8) / 0.04096 = 97 тайлов
+    TileBudgetController controller(FixedTileSettings(), 64);
+    const SimulationResult result = Simulate(controller, CostModel(), 30);
+
+    CHECK_EQ(result.TileSize, 64);
+    CHECK(result.Tiles >= 95 && result.Tiles <= 97);
+    CHECK_NEAR(controller.GetOverheadMilliseconds(), 8.0, 0.05);
+    CHECK_NEAR(controller.GetMillisecondsPerMegapixel(), 10.0, 0.1);
+    CHECK(result.WorstMilliseconds <= 12.0);
+}
+
+TEST(TileBudget_ConvergesWithoutOverhead) {
+    // Чисто попиксельная стоимость: вырожденная модель уже верна, шаг вверх возможен только с запасом по бюджету
+    CostModel cost;
+    cost.Overhead = 0.0;
+    cost.MillisecondsPerPixel = 2e-4;
+    TileBudgetController controller(FixedTileSettings(), 32);
+    const SimulationResult result = Simulate(controller, cost, 40);
+
+    const int expected = (int)(12.0 / (2e-4 * 32 * 32)); // 58
+    CHECK(result.Tiles >= expected - 2 && result.Tiles <= expected);
+    CHECK_EQ(result.FramesOverBudget, 0);
+}
+
+TEST(TileBudget_NoisyMeasurementsStayNearBudget) {
+    CostModel cost;
+    cost.Noise = 0.03;
+    TileBudgetController controller(FixedTileSettings(), 64);
+    Simulate(controller, cost, 20, 7);
+
+    // После схождения: средний кадр около бюджета, перерасход только в пределах шума
+    Tests::Random random(11);
+    double total = 0.0;
+    int over = 0;
+    for (int frame = 0; frame < 200; ++frame) {
+        const double ms = cost.Measure(controller.GetTilesPerFrame(), controller.GetTileSize(), random);
+        total += ms;
+        if (ms > 12.0 * 1.05) over++;
+        controller.AddMeasurement(controller.GetTilesPerFrame(), controller.GetTileSize(), ms);
+    }
+    CHECK_NEAR(total / 200.0, 12.0, 0.6);
+    CHECK_EQ(over, 0);
+}
+
+TEST(TileBudget_FollowsLoadChanges) {
+    TileBudgetController controller(FixedTileSettings(), 64);
+    Simulate(controller, CostModel(), 30);
+    const int before = controller.GetTilesPerFrame();
+
+    // Пиксели подорожали вдвое (больше проходов) - число тайлов должно упасть примерно вдвое за несколько кадров,
+    // дальше кадры снова в бюджете
+    CostModel heavier;
+    heavier.MillisecondsPerPixel = 2e-5;
+    const SimulationResult adapting = Simulate(controller, heavier, 10);
+    CHECK(adapting.FramesOverBudget <= 5);
+    const SimulationResult result = Simulate(controller, heavier, 20);
+    CHECK(result.Tiles >= 46 && result.Tiles <= 49);
+    CHECK_EQ(result.FramesOverBudget, 0);
+    CHECK(before > result.Tiles);
+}
+
+TEST(TileBudget_AdaptsTileSize) {
+    // Тот же случай с подбором размера: 97 тайлов 64x64 больше MaxTilesPerFrame, тайлы укрупняются
+    TileBudgetSettings settings = FixedTileSettings();
+    settings.AdaptTileSize = true;
+    settings.MaxTilesPerFrame = 64;
+    TileBudgetController controller(settings, 64);
+    const SimulationResult result = Simulate(controller, CostModel(), 40);
+
+    CHECK_EQ(result.TileSize, 128);
+    const double pixels = (double)result.Tiles * result.TileSize * result.TileSize;
+    CHECK(pixels >= 0.9 * 4.0 / 1e-5 && pixels <= 4.0 / 1e-5);
+
+    // Дорогие пиксели: даже один тайл 256x256 не влезает - тайлы мельчают
+    CostModel expensive;
+    expensive.MillisecondsPerPixel = 1e-3;
+    TileBudgetController small(settings, 256);
+    Simulate(small, expensive, 20);
+    CHECK(small.GetTileSize() <= 64);
+    CHECK(small.PredictMilliseconds(small.GetTilesPerFrame(), small.GetTileSize()) <= 12.0);
+}
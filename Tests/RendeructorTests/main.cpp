@@ -0,0 +1,47 @@
+﻿// Юнит-тесты и бенчмарки CPU части Rendeructor.
+//
+// Использование:
+//   RendeructorTests [filter]           - все тесты (или только те, в имени которых есть filter)
+//   RendeructorTests --bench [filter]   - бенчмарки
+//
+// Код возврата - число упавших тестов, так что запуск годится и для CI.
+
+#include "TestFramework.h"
+#include <cstring>
+
+#pragma comment(lib, "Rendeructor.lib")
+
+int main(int argc, char** argv) {
+    bool benchmarks = false;
+    const char* filter = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench") == 0) benchmarks = true;
+        else filter = argv[i];
+    }
+
+    int run = 0;
+    int failed = 0;
+    for (const Tests::TestCase& test : Tests::GetRegistry()) {
+        if (test.Benchmark != benchmarks) continue;
+        if (filter && !strstr(test.Name, filter)) continue;
+
+        std::printf("[ RUN      ] %s\n", test.Name);
+        std::fflush(stdout);
+        Tests::GetFailureCount() = 0;
+        Tests::Timer timer;
+        test.Function();
+        const double ms = timer.Milliseconds();
+
+        run++;
+        if (Tests::GetFailureCount() > 0) {
+            failed++;
+            std::printf("[   FAILED ] %s (%.1f ms)\n", test.Name, ms);
+        }
+        else {
+            std::printf("[       OK ] %s (%.1f ms)\n", test.Name, ms);
+        }
+    }
+
+    std::printf("\n%d of %d %s passed\n", run - failed, run, benchmarks ? "benchmarks" : "tests");
+    return failed;
+}